@@ -246,11 +246,29 @@ void Adafruit_LEDBackpack::begin(uint8_t _addr = 0x70) {
 }
 
 void Adafruit_LEDBackpack::writeDisplay(void) {
+	writeRows(0, 7);
+}
+
+// Writes only the span of rows that changed since the last write. Nothing if none did.
+void Adafruit_LEDBackpack::writeDisplayChanged(void) {
+	uint8_t first = 8, last = 0;
+	for (uint8_t i = 0; i < 8; i++)
+		if (!writtenValid || displaybuffer[i] != writtenbuffer[i]) {
+			if (first == 8)
+				first = i;
+			last = i;
+		}
+	if (first < 8)
+		writeRows(first, last);
+}
+
+// HT16K33 auto-increments RAM address, 2 bytes per row, so a span of rows is a single transaction.
+void Adafruit_LEDBackpack::writeRows(uint8_t first, uint8_t last) {
 	if (_isI2C0){
 		Wire.beginTransmission(i2c_addr);
-		Wire.write((uint8_t)0x00); // start at address $00
+		Wire.write((uint8_t)(first * 2)); // start at row's address
 
-		for (uint8_t i = 0; i < 8; i++) {
+		for (uint8_t i = first; i <= last; i++) {
 			Wire.write(displaybuffer[i] & 0xFF);
 			Wire.write(displaybuffer[i] >> 8);
 		}
@@ -258,14 +276,18 @@ void Adafruit_LEDBackpack::writeDisplay(void) {
 	}
 	else {
 		Wire1.beginTransmission(i2c_addr);
-		Wire1.write((uint8_t)0x00); // start at address $00
+		Wire1.write((uint8_t)(first * 2)); // start at row's address
 
-		for (uint8_t i = 0; i < 8; i++) {
+		for (uint8_t i = first; i <= last; i++) {
 			Wire1.write(displaybuffer[i] & 0xFF);
 			Wire1.write(displaybuffer[i] >> 8);
 		}
 		Wire1.endTransmission();
 	}
+	for (uint8_t i = first; i <= last; i++)
+		writtenbuffer[i] = displaybuffer[i];
+	if (first == 0 && last == 7)
+		writtenValid = true;
 }
 
 void Adafruit_LEDBackpack::clear(void) {
@@ -62,6 +62,7 @@ class Adafruit_LEDBackpack {
   void setBrightness(uint8_t b);
   void blinkRate(uint8_t b);
   void writeDisplay(void);
+  void writeDisplayChanged(void); // Only rows changed since the last write
   void clear(void);
 
   uint16_t displaybuffer[8]; 
@@ -70,6 +71,10 @@ class Adafruit_LEDBackpack {
  protected:
   uint8_t i2c_addr;
 	bool _isI2C0;
+	uint16_t writtenbuffer[8]; // displaybuffer as last written to HT16K33
+	bool writtenValid = false;
+
+	void writeRows(uint8_t first, uint8_t last);
 };
 
 class Adafruit_AlphaNum4 : public Adafruit_LEDBackpack {
@@ -120,24 +120,108 @@ void Displays::print(uint8_t displayNumber, String str) {
 		timeout();
 }
 
-/** Scrolls a string
+/** Advances scrolling texts. Call as often as possible, in every loop pass. It never waits.
+*/
+void Displays::refresh() {
+	for (uint8_t i = 0; i < nextFree; i++) {
+		DisplayScroll* s = &scroll[i];
+		if (!s->active)
+			continue;
+		uint32_t elapsedMs = millis() - s->frameStartMs;
+		if (elapsedMs < s->frameMs)
+			continue;
+		uint16_t frames = elapsedMs / s->frameMs; // If loop was late, skip frames so that the speed does not depend on loop's.
+		s->frameStartMs += frames * s->frameMs;
+		if (s->x - frames < s->endX)
+			s->active = false;
+		else {
+			s->x -= frames;
+			scrollFrameWrite(i);
+		}
+	}
+}
+
+/** Draws the current scroll frame and writes only changed rows
+@param displayNumber - display's ordinal number.
+*/
+void Displays::scrollFrameWrite(uint8_t displayNumber) {
+	DisplayScroll* s = &scroll[displayNumber];
+	matrix[displayNumber]->clear();
+	for (int8_t column = 0; column < 8; column++) {
+		int16_t i = column - s->x;
+		if (i >= 0 && i < s->count)
+			for (uint8_t row = 0; row < 8; row++)
+				if (s->columns[i] & (1 << row))
+					matrix[displayNumber]->drawPixel(column, row, s->color);
+	}
+	uint32_t ms = millis();
+	matrix[displayNumber]->writeDisplayChanged();
+	if (millis() - ms > 100)
+		timeout();
+}
+
+/** Starts scrolling a string in background. refresh() moves it.
+@param displayNumber - display's ordinal number. Each call of function add() assigns an increasing number to the
+addes display.
+@param message - string to be scrolled.
+@param fontSize - font size, default 1
+@param frameMs - ms between shifts, default 60
+@param color - for example LED_GREEN, LED_RED, LED_YELLOW
+@param lastXScroll - total number of pixel columns to be scrolled. 0 - until the whole text leaves the display.
+*/
+void Displays::scrollStart(uint8_t displayNumber, String message, uint8_t fontSize, uint16_t frameMs, uint16_t color, int lastXScroll) {
+	DisplayScroll* s = &scroll[displayNumber];
+	Adafruit_BicolorMatrix* m = matrix[displayNumber];
+	if (fontSize == 0)
+		fontSize = 1;
+
+	// Rasterise each character once, using library's font. Pixels are read back from displaybuffer, so no rotation.
+	uint8_t rotation = m->getRotation();
+	m->setRotation(0);
+	s->count = 0;
+	for (uint16_t i = 0; i < message.length() && s->count < SCROLL_COLUMNS_MAX; i++) {
+		m->clear();
+		m->drawChar(0, 0, message[i], LED_GREEN, LED_GREEN, 1);
+		for (uint8_t column = 0; column < 6; column++) { // 5 columns and a space
+			uint8_t pixels = 0;
+			for (uint8_t row = 0; row < 8; row++)
+				if (m->displaybuffer[row / fontSize] & (1 << column))
+					pixels |= 1 << row;
+			for (uint8_t j = 0; j < fontSize && s->count < SCROLL_COLUMNS_MAX; j++)
+				s->columns[s->count++] = pixels;
+		}
+	}
+	m->setRotation(rotation);
+
+	s->color = color;
+	s->endX = lastXScroll == 0 ? -(int16_t)s->count : -lastXScroll;
+	s->frameMs = frameMs == 0 ? 1 : frameMs;
+	s->frameStartMs = millis();
+	s->x = 7;
+	s->active = true;
+	scrollFrameWrite(displayNumber);
+}
+
+/** Stops scrolling. Display keeps the last frame.
+@param displayNumber - display's ordinal number.
+*/
+void Displays::scrollStop(uint8_t displayNumber) {
+	scroll[displayNumber].active = false;
+}
+
+/** Scrolls a string, waiting until finished. Use scrollStart() and refresh() not to block the program.
 @param displayNumber - Display number.
 @param message - string to be scrolled.
-@param lastXScroll - total number of pixel columns to be scrolled. A letter has a certain number of columns, like 5.
+@param lastXScroll - total number of pixel columns to be scrolled. A letter has a certain number of columns, like 5. 0 - no scrolling
+past the left edge, unlike scrollStart().
 @param fontSize - veliina fonta, implicitno 1
 @param delayMs - ms izmeu pomaka, implicitno 70
 */
 void Displays::scrollString(uint8_t displayNumber, String message, int lastXScroll, uint8_t fontSize, uint16_t delayMs) {
-	matrix[displayNumber]->setTextWrap(false);  // we dont want text to wrap so it scrolls nicely
-	matrix[displayNumber]->setTextSize(fontSize);
-	matrix[displayNumber]->setTextColor(LED_GREEN);
-	for (int8_t x = 7; x >= -lastXScroll; x--) {
-		matrix[displayNumber]->clear();
-		matrix[displayNumber]->setCursor(x, 0);
-		matrix[displayNumber]->print(message);
-		matrix[displayNumber]->writeDisplay();
-		delay(delayMs);
-	}
+	scrollStart(displayNumber, message, fontSize, delayMs, LED_GREEN, lastXScroll);
+	scroll[displayNumber].endX = -lastXScroll; // Here 0 is not a special value.
+	while (scrolling(displayNumber))
+		refresh();
 }
 
 /** Sets cursor's position
@@ -5,18 +5,33 @@
 /**
 Purpose: Adafruit tricolor display (Adafruit's product id 902) control. In fact, a wrapper for Adafruit library.
 @author MRMS team
-@version 0.2 2018-07-28
+@version 0.3 2026-10-19
 Licence: You can use this code any way you like.
 */
 
 #define MAX_DISPLAYS 1 // Maximum number of displays. 
 #define I2C_TIMEOUT 100 // Maximum allowed ms to wait for a I2C command to complete
+#define SCROLL_COLUMNS_MAX 256 // Maximum width of a scrolled text in pixel columns. A letter of size 1 is 6 columns wide.
 
 typedef bool(*BreakCondition)();
 
+/** Text being scrolled, rasterised once in scrollStart()
+*/
+struct DisplayScroll {
+	bool active = false;
+	uint16_t color;
+	uint8_t columns[SCROLL_COLUMNS_MAX]; // One byte for each pixel column, bit 0 is the top row.
+	uint16_t count; // Columns used
+	int16_t endX; // Scrolling ends after x passes this value.
+	uint16_t frameMs; // Time of 1 pixel shift
+	uint32_t frameStartMs;
+	int16_t x; // Display column of the text's first column, as cursor's x in print().
+};
+
 class Displays
 {
 	Adafruit_BicolorMatrix *matrix[MAX_DISPLAYS]; //Pointers to the devices
+	DisplayScroll scroll[MAX_DISPLAYS];
 	int nextFree; //Number of displays - 1
 	HardwareSerial * serial; //Additional serial port
 
@@ -26,6 +41,11 @@ class Displays
 	*/
 	void printUART(String message, bool eol = false);
 
+	/** Draws the current scroll frame and writes only changed rows
+	@param displayNumber - display's ordinal number.
+	*/
+	void scrollFrameWrite(uint8_t displayNumber);
+
 	/** Handles timeout
 	*/
 	void timeout();
@@ -96,16 +116,44 @@ control.
 	*/
 	void print(uint8_t displayNumber, String str);
 
-	/** Scrolls a string
+	/** Advances scrolling texts. Call as often as possible, in every loop pass. It never waits.
+	*/
+	void refresh();
+
+	/** Starts scrolling a string in background. refresh() moves it.
+	@param displayNumber - display's ordinal number. Each call of function add() assigns an increasing number to the
+	addes display.
+	@param message - string to be scrolled.
+	@param fontSize - font size, default 1
+	@param frameMs - ms between shifts, default 60
+	@param color - for example LED_GREEN, LED_RED, LED_YELLOW
+	@param lastXScroll - total number of pixel columns to be scrolled. 0 - until the whole text leaves the display.
+	*/
+	void scrollStart(uint8_t displayNumber, String message, uint8_t fontSize = 1, uint16_t frameMs = 60, uint16_t color = LED_GREEN,
+		int lastXScroll = 0);
+
+	/** Stops scrolling. Display keeps the last frame.
+	@param displayNumber - display's ordinal number.
+	*/
+	void scrollStop(uint8_t displayNumber);
+
+	/** Scrolls a string, waiting until finished
 	@param displayNumber - display's ordinal number. Each call of function add() assigns an increasing number to the
 	addes display.
 	@param message - string to be scrolled.
-	@param lastXScroll - total number of pixel columns to be scrolled. A letter has a certain number of columns, like 5.
+	@param lastXScroll - total number of pixel columns to be scrolled. A letter has a certain number of columns, like 5. 0 - no scrolling
+	past the left edge, unlike scrollStart().
 	@param fontSize - veliina fonta, implicitno 1
 	@param delay - ms izmeu pomaka, implicitno 60
 	*/
 	void scrollString(uint8_t displayNumber, String message, int lastXScroll, uint8_t fontSize = 1, uint16_t delayMs = 60);
 
+	/** Is text still scrolling?
+	@param displayNumber - display's ordinal number.
+	@return - scrolling or not
+	*/
+	bool scrolling(uint8_t displayNumber) { return scroll[displayNumber].active; }
+
 	/** Sets cursor's position
 	@param displayNumber - display's ordinal number. Each call of function add() assigns an increasing number to the
 		addes display.
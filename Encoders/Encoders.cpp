@@ -1,22 +1,52 @@
 #include "Encoders.h"
 
-volatile uint32_t encoderCounters[MAX_ENCODERS];//Counters
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+volatile int32_t encoderCounters[MAX_ENCODERS];//Counters, quadrature ones count down, too.
+volatile int8_t encoderDirection[MAX_ENCODERS]; // Last step's direction
+volatile uint32_t encoderLastEdgeMicros[MAX_ENCODERS]; // Last edge's time
+volatile uint32_t encoderPeriodMicros[MAX_ENCODERS]; // Time between last 2 edges
+volatile uint32_t encoderSequence = 0; // Odd while an interrupt is changing the data above
+uint8_t encoderPinA[MAX_ENCODERS];
+uint8_t encoderPinB[MAX_ENCODERS];
+volatile uint8_t encoderState[MAX_ENCODERS]; // Last A and B levels, A in bit 1
+
+// Quadrature step for previous state (bits 3 and 2) and current state (bits 1 and 0). 0 - no change or an invalid transition (a skipped step).
+const int8_t quadratureSteps[16] = { 0, -1, 1, 0, 1, 0, 0, -1, -1, 0, 0, 1, 0, 1, -1, 0 };
+
+/**Processes an edge in an interrupt
+@param encoderNumber - Encoder's ordinal number.
+*/
+void IRAM_ATTR encoderEdge(uint8_t encoderNumber) {
+	uint32_t now = micros();
+	int8_t step = 1;
+	if (encoderPinB[encoderNumber] != ENCODER_NO_PIN) {
+		uint8_t state = (digitalRead(encoderPinA[encoderNumber]) << 1) | digitalRead(encoderPinB[encoderNumber]);
+		step = quadratureSteps[(encoderState[encoderNumber] << 2) | state];
+		encoderState[encoderNumber] = state;
+		if (step == 0)
+			return;
+	}
+	encoderSequence++;
+	encoderCounters[encoderNumber] += step;
+	encoderDirection[encoderNumber] = step;
+	encoderPeriodMicros[encoderNumber] = encoderLastEdgeMicros[encoderNumber] == 0 ? 0 : now - encoderLastEdgeMicros[encoderNumber];
+	encoderLastEdgeMicros[encoderNumber] = now;
+	encoderSequence++;
+}
 
 //Interrupt functions
-void f0() { encoderCounters[0]++; }
-void f1() { encoderCounters[1]++; }
-void f2() { encoderCounters[2]++; }
-void f3() { encoderCounters[3]++; }
-void f4() { encoderCounters[4]++; }
-void f5() { encoderCounters[5]++; }
-void f6() { encoderCounters[6]++; }
-void f7() { encoderCounters[7]++; }
-ArgumenlessFunction encoderHandlers[] = { f0, f1, f2, f3, f4, f5, f6, f7 };
+template<uint8_t encoderNumber> void IRAM_ATTR encoderIsr() { encoderEdge(encoderNumber); }
+ArgumenlessFunction encoderHandlers[] = { encoderIsr<0>, encoderIsr<1>, encoderIsr<2>, encoderIsr<3>, encoderIsr<4>, encoderIsr<5>,
+	encoderIsr<6>, encoderIsr<7> };
 
 /**Add an encoder
-@param pin - Pin the encoder uses.
+@param pin - Pin the encoder uses. Channel A for quadrature encoders.
+@param pinB - Channel B for quadrature encoders, ENCODER_NO_PIN for single channel ones, which count only forward.
 */
-void Encoders::add(uint8_t pin)
+void Encoders::add(uint8_t pin, uint8_t pinB)
 {
 	if (nextFree >= MAX_ENCODERS)
 		error("Too many encoders");
@@ -25,9 +55,21 @@ void Encoders::add(uint8_t pin)
 		error("Not enough interrupt handlers.");
 
 	pins[nextFree] = pin;
+	encoderPinA[nextFree] = pin;
+	encoderPinB[nextFree] = pinB;
 	encoderCounters[nextFree] = 0;
+	encoderDirection[nextFree] = 1;
+	encoderLastEdgeMicros[nextFree] = 0;
+	encoderPeriodMicros[nextFree] = 0;
 	pinMode(pin, INPUT);
-	attachInterrupt(pin, encoderHandlers[nextFree], RISING);
+	if (pinB == ENCODER_NO_PIN)
+		attachInterrupt(pin, encoderHandlers[nextFree], RISING);
+	else {
+		pinMode(pinB, INPUT);
+		encoderState[nextFree] = (digitalRead(pin) << 1) | digitalRead(pinB);
+		attachInterrupt(pin, encoderHandlers[nextFree], CHANGE);
+		attachInterrupt(pinB, encoderHandlers[nextFree], CHANGE);
+	}
 	nextFree++;
 }
 
@@ -40,12 +82,19 @@ void Encoders::backup() {
 
 /**Read a counter.
 @param encoderNumber - Encoder's ordinal number. Each call of function add() assigns a increasing number to the sensor, starting with 0.
+@return - steps, negative after rotating backwards from 0.
 */
-uint32_t Encoders::counter(int encoderNumber)
+int32_t Encoders::counter(int encoderNumber)
 {
 	if (encoderNumber >= nextFree)
 		error("Out of range");
-	return encoderCounters[encoderNumber];
+	uint32_t sequence;
+	int32_t value;
+	do {
+		sequence = encoderSequence;
+		value = encoderCounters[encoderNumber];
+	} while ((sequence & 1) || sequence != encoderSequence);
+	return value;
 }
 
 /** Print to all serial ports
@@ -69,16 +118,40 @@ void Encoders::print(String message, bool eol) {
 @param to0 - reset to 0. Otherwise to backup. In that case, backup() function had to be called before.
 */
 void Encoders::reset(bool to0) {
-	for (uint8_t i = 0; i < nextFree; i++)
+	noInterrupts();
+	for (uint8_t i = 0; i < nextFree; i++) {
 		encoderCounters[i] = to0 ? 0 : backupSteps[i];
+		encoderLastEdgeMicros[i] = 0;
+		encoderPeriodMicros[i] = 0;
+	}
+	interrupts();
 }
 
 /**Set a counter.
 @param encoderNumber - Encoder's ordinal number. Each call of function add() assigns a increasing number to the sensor, starting with 0.
 @param value - Value
 */
-void Encoders::set(int encoderNumber, uint32_t value) {
+void Encoders::set(int encoderNumber, int32_t value) {
+	noInterrupts();
 	encoderCounters[encoderNumber] = value;
+	interrupts();
+}
+
+/**Takes a consistent copy of all the counters. Interrupts are not blocked: if an edge arrives while copying, copying is repeated.
+@param snapshot - output.
+*/
+void Encoders::snapshot(EncodersSnapshot* snapshot) {
+	uint32_t sequence;
+	do {
+		sequence = encoderSequence;
+		for (uint8_t i = 0; i < nextFree; i++) {
+			snapshot->counter[i] = encoderCounters[i];
+			snapshot->direction[i] = encoderDirection[i];
+			snapshot->lastEdgeMicros[i] = encoderLastEdgeMicros[i];
+			snapshot->periodMicros[i] = encoderPeriodMicros[i];
+		}
+		snapshot->micros = micros();
+	} while ((sequence & 1) || sequence != encoderSequence);
 }
 
 /**Test
@@ -93,7 +166,7 @@ void Encoders::test(ArgumenlessFunction motorStartFunction, BreakCondition break
 		for (int i = 0; i < nextFree; i++) {
 			if (i != 0) 
 				print(" ");
-			print(encoderCounters[i]);
+			print((String)counter(i) + " (" + (String)velocity(i) + "/s)");
 		}
 		print("", true);
 		delay(100);
@@ -109,3 +182,30 @@ Encoders::Encoders(HardwareSerial * hardwareSerial) {
 }
 
 Encoders::~Encoders(){}
+
+/**Speed. Based on the time between last 2 edges, so it is accurate for slow rotation, too. When edges stop coming, time since last one
+is used instead, so the speed decreases to 0 and does not freeze at last value.
+@param encoderNumber - Encoder's ordinal number. Each call of function add() assigns a increasing number to the sensor, starting with 0.
+@return - edges per second, negative when rotating backwards. 0 if no edge in last ENCODER_STOPPED_MICROS.
+*/
+float Encoders::velocity(int encoderNumber) {
+	if (encoderNumber >= nextFree)
+		error("Out of range");
+	uint32_t sequence;
+	uint32_t lastEdge;
+	uint32_t period;
+	int8_t direction;
+	do {
+		sequence = encoderSequence;
+		lastEdge = encoderLastEdgeMicros[encoderNumber];
+		period = encoderPeriodMicros[encoderNumber];
+		direction = encoderDirection[encoderNumber];
+	} while ((sequence & 1) || sequence != encoderSequence);
+
+	uint32_t sinceLast = micros() - lastEdge;
+	if (lastEdge == 0 || period == 0 || sinceLast > ENCODER_STOPPED_MICROS)
+		return 0;
+	if (sinceLast > period)
+		period = sinceLast;
+	return direction * 1000000.0 / period;
+}
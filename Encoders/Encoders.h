@@ -3,18 +3,32 @@
 
 /**
 Purpose: using encoders. Rotating motors with encoders increase their counters, so, for example, exact distance can be calculated.
+Encoders with 2 channels (A and B) are decoded in quadrature (x4), so they count backwards, too. Time of each edge is recorded in order to calculate
+speed, even a very low one.
 @author MRMS team
-@version 0.1 2018-05-19
+@version 0.2 2026-10-19
 Licence: You can use this code any way you like.
 */
 #define MAX_ENCODERS 8 // Maximum number of encoders. 
+#define ENCODER_NO_PIN 0xFF // Single channel encoder, no B pin.
+#define ENCODER_STOPPED_MICROS 500000 // No edge for this long means the encoder has stopped.
 
 typedef void(*ArgumenlessFunction)();
 typedef bool(*BreakCondition)();
 
+/** Consistent copy of all the encoders' data, taken at the same moment.
+*/
+struct EncodersSnapshot {
+	int32_t counter[MAX_ENCODERS]; // Negative after rotating backwards from 0.
+	int8_t direction[MAX_ENCODERS]; // Direction of the last step, 1 or -1.
+	uint32_t lastEdgeMicros[MAX_ENCODERS]; // micros() of the last edge. 0 - no edge yet.
+	uint32_t periodMicros[MAX_ENCODERS]; // Time between last 2 edges.
+	uint32_t micros; // When the snapshot was taken.
+};
+
 class Encoders
 {
-	uint16_t backupSteps[MAX_ENCODERS]; //For state restore.
+	int32_t backupSteps[MAX_ENCODERS]; //For state restore.
 	int nextFree;
 	uint8_t pins[MAX_ENCODERS]; // Pins the encoders use.
 	HardwareSerial * serial; //Additional serial port
@@ -34,9 +48,10 @@ public:
 	~Encoders();
 
 	/**Add an encoder
-	@param pin - Pin the encoder uses.
+	@param pin - Pin the encoder uses. Channel A for quadrature encoders.
+	@param pinB - Channel B for quadrature encoders, ENCODER_NO_PIN for single channel ones, which count only forward.
 	*/
-	void add(uint8_t pin);
+	void add(uint8_t pin, uint8_t pinB = ENCODER_NO_PIN);
 
 	/**Backup positions
 	*/
@@ -44,25 +59,37 @@ public:
 
 	/**Read a counter.
 	@param encoderNumber - Encoder's ordinal number. Each call of function add() assigns a increasing number to the sensor, starting with 0.
+	@return - steps, negative after rotating backwards from 0.
 	*/
-	uint32_t counter(int encoderNumber);
+	int32_t counter(int encoderNumber);
 
 	/**Resets all the counters.
 	@param to0 - reset to 0. Otherwise to backup. In that case, backup() function had to be called before.
 	*/
 	void reset(bool to0 = true);
 
+	/**Takes a consistent copy of all the counters. Interrupts are not blocked: if an edge arrives while copying, copying is repeated.
+	@param snapshot - output.
+	*/
+	void snapshot(EncodersSnapshot* snapshot);
+
 	/**Set a counter.
 	@param encoderNumber - Encoder's ordinal number. Each call of function add() assigns a increasing number to the sensor, starting with 0.
 	@param value - Value
 	*/
-	void set(int encoderNumber, uint32_t value);
+	void set(int encoderNumber, int32_t value);
 
 	/**Test
 	@param motorStartFunction - Motor starting function. It is necessary because encoders produce no results without the motors revolving.
 	@param breakWhen - A function returning bool, without arguments. If it returns true, the test() will be interrupted.
 	*/
 	void test(ArgumenlessFunction motorStartFunction = 0, BreakCondition breakWhen = 0);
+
+	/**Speed
+	@param encoderNumber - Encoder's ordinal number. Each call of function add() assigns a increasing number to the sensor, starting with 0.
+	@return - edges per second, negative when rotating backwards. 0 if no edge in last ENCODER_STOPPED_MICROS.
+	*/
+	float velocity(int encoderNumber);
 };
 
 //Declaration of error function. Definition is in Your code.
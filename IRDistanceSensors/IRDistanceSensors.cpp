@@ -113,6 +113,7 @@ void IRDistanceSensors::calibrate(uint8_t sensorNumber, float(*externalCalibrati
 
 	eepromWrite();
 	eepromRead(true);
+	lookupBuild();
 	print("End.", true);
 }
 
@@ -136,6 +137,7 @@ void IRDistanceSensors::calibrationDisplay(uint8_t sensorNumber) {
 void IRDistanceSensors::calibrationSet(uint16_t readings[]) {
 	for (uint8_t i = 0; i < pointCount; i++)
 		reading[i] = readings[i];
+	lookupBuild();
 }
 
 /**Number of sensors
@@ -146,24 +148,16 @@ int IRDistanceSensors::count()
 	return nextFree;
 }
 
-/**Distance
+/**Distance. Readings are refreshed for all the sensors at once, if older than IR_DISTANCE_MAX_AGE_MS.
 @param sensorNumber - Sensor's ordinal number. Each call of function add() assigns a increasing number to the sensor, starting with 0.
 @return - Distance in cm.
 */
 float IRDistanceSensors::distance(byte sensorNumber) {
 	if (!enabled[sensorNumber])
 		return 0;
-	uint16_t value = analogRead(pins[sensorNumber]);
-	uint16_t distance = 0;
-	if (value >= reading[0])
-		distance = cm[0];
-	else if (value < reading[pointCount - 1])
-		distance = cm[pointCount - 1];
-	else
-		for (int i = 0; i < pointCount - 1; i++)
-			if (value < reading[i] && value >= reading[i + 1])
-				distance = map(value, reading[i], reading[i + 1], cm[i], cm[i + 1]);
-	return distance;
+	if (lastRefreshMs == 0 || millis() - lastRefreshMs > IR_DISTANCE_MAX_AGE_MS)
+		refresh();
+	return distanceMm(lastReading[sensorNumber]) / 10.0;
 }
 
 /**
@@ -179,7 +173,7 @@ void IRDistanceSensors::eepromRead(bool verbose) {
 		if (verbose)
 			print("Reading from EEPROM: ");
 
-		for (int i = 0; i < nextFree; i++) {
+		for (int i = 0; i < pointCount; i++) {
 			uint8_t highByte = EEPROM.read(eeAddress++);
 			uint8_t lowByte = EEPROM.read(eeAddress++);
 			int value = (highByte << 8) | lowByte;
@@ -192,6 +186,7 @@ void IRDistanceSensors::eepromRead(bool verbose) {
 		}
 		if (verbose)
 			print("", true);
+		lookupBuild();
 	}
 }
 
@@ -223,6 +218,36 @@ void IRDistanceSensors::eepromWrite() {
 	print("", true);
 }
 
+/** Builds lookup table from calibration points, interpolating linearly between them. Must be called after any change of points.
+Readings decrease with distance, so the table is filled from the highest reading down, advancing through the points once.
+*/
+void IRDistanceSensors::lookupBuild() {
+	int point = 0;
+	for (int value = (1 << IR_DISTANCE_ADC_BITS) - 1; value >= 0; value--) {
+		if (value >= reading[0])
+			lookup[value] = cm[0] * 10;
+		else if (value < reading[pointCount - 1])
+			lookup[value] = cm[pointCount - 1] * 10;
+		else {
+			while (value < reading[point + 1]) // Now reading[point] > value >= reading[point + 1]
+				point++;
+			lookup[value] = round(10 * (cm[point] + (reading[point] - value) * (cm[point + 1] - cm[point]) /
+				(float)(reading[point] - reading[point + 1])));
+		}
+	}
+}
+
+/** Reads all the enabled sensors, one after another
+*/
+void IRDistanceSensors::refresh() {
+	for (int i = 0; i < nextFree; i++)
+		if (enabled[i])
+			lastReading[i] = analogRead(pins[i]);
+	lastRefreshMs = millis();
+	if (lastRefreshMs == 0) // 0 means never refreshed
+		lastRefreshMs = 1;
+}
+
 /** Print to all serial ports
 @param message
 @param eol - end of line
@@ -303,4 +328,5 @@ IRDistanceSensors::IRDistanceSensors(bool useCalibrationFromEEPROM, HardwareSeri
 	reading[9] = IR_READING_FOR_10;
 	reading[10] = IR_READING_FOR_11;
 	reading[11] = IR_READING_FOR_12;
+	lookupBuild();
 }
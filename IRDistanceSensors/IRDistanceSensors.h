@@ -4,11 +4,13 @@
 /**
 Purpose: using MRMS infrared distance sensors
 @author MRMS team
-@version 0.3 2018-05-12
+@version 0.4 2026-10-19
 Licence: You can use this code any way you like.
 */
 
 #define MAX_IR_DISTANCE_SENSORS 16 //Maximum number of sensors. You can use a smaller number, with a small memory waste.
+#define IR_DISTANCE_ADC_BITS 10 // analogRead() resolution. Lookup table has 2^IR_DISTANCE_ADC_BITS entries, 2 bytes each.
+#define IR_DISTANCE_MAX_AGE_MS 5 // distance() reads all the enabled sensors again when their readings are older than this.
 
 /*Start EEPROM address for calibration data. If You use EEPROM for other purposes, use different addresses. For example, if You use ReflectanceSensors class,
 and TOP_EEPROM_ADDRESS_REFLECTANCE = 0,  MAX_REFLECTANCE_SENSORS = 20, first 40 (or 60) bytes will be used there. So,  TOP_EEPROM_ADDRESS_IR_DISTANCE
@@ -48,6 +50,9 @@ class IRDistanceSensors {
 	bool calibrated;
 	uint16_t cm[pointCount]; //For array 'reading', for the same index, stores number of cm.
 	bool enabled[MAX_IR_DISTANCE_SENSORS]; // Enabled
+	uint16_t lastReading[MAX_IR_DISTANCE_SENSORS]; // Analog readings of the last refresh()
+	uint32_t lastRefreshMs = 0;
+	uint16_t lookup[1 << IR_DISTANCE_ADC_BITS]; // Distance in mm for each analog reading
 	byte pins[MAX_IR_DISTANCE_SENSORS]; //Analog pin the sensor uses.
 	int nextFree;
 	uint16_t reading[pointCount]; //Analog readings
@@ -64,6 +69,10 @@ class IRDistanceSensors {
 	*/
 	void eepromWrite();
 
+	/** Builds lookup table from calibration points, interpolating linearly between them. Must be called after any change of points.
+	*/
+	void lookupBuild();
+
 	/** Print to all serial ports
 	@param message
 	@param eol - end of line
@@ -108,12 +117,22 @@ public:
 	*/
 	int count();
 
-	/** Distance
+	/** Distance. Readings are refreshed for all the sensors at once, if older than IR_DISTANCE_MAX_AGE_MS.
 	@param sensorNumber - Sensor's ordinal number. Each call of function add() assigns a increasing number to the sensor, starting with 0.
 	@return - Distance in cm.
 	*/
 	float distance(byte sensorNumber);
 
+	/** Distance for an analog reading, according to calibration
+	@param analogReading - analog value
+	@return - Distance in mm.
+	*/
+	uint16_t distanceMm(uint16_t analogReading) { return lookup[analogReading < (1 << IR_DISTANCE_ADC_BITS) ? analogReading : (1 << IR_DISTANCE_ADC_BITS) - 1]; }
+
+	/** Reads all the enabled sensors, one after another
+	*/
+	void refresh();
+
 	/**Test
 	@param numericValues - If true, numeric (analog) values will be displayed. If not, distance in cm.
 	@param breakWhen - A function returning bool, without arguments. If it returns true, the test() will be interrupted.
@@ -1,5 +1,22 @@
 #include "IRReceivers.h"
 
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+#define IR_WINDOW_MASK (0xFFFFFFFFUL >> (32 - SAMPLE_LENGTH)) // SAMPLE_LENGTH ones
+#define IR_RECEIVERS_TIMER 1 // ESP32 hardware timer for fixed rate sampling
+
+#if defined(ESP32)
+hw_timer_t* irReceiversTimer = NULL;
+IRReceivers* irReceiversSampled = NULL; // Object sampled by the timer
+
+void IRAM_ATTR irReceiversOnTimer() {
+	if (irReceiversSampled != NULL)
+		irReceiversSampled->update();
+}
+#endif
+
 /**Add a sensor
 @param pin - Digital pin the sensor uses
 @param angleDegrees - Angle in degrees. Robot front is 0 degrees and positive angles are to the right.
@@ -11,10 +28,15 @@ void IRReceivers::add(byte pin, double angleDegrees)
 	pinMode(pin, INPUT);
 	pins[nextFree] = pin;
 	angles[nextFree] = angleDegrees;
+	cosines[nextFree] = round(cos(angleDegrees / 180 * PI) * IR_WEIGHT_SCALE);
+	sines[nextFree] = round(sin(angleDegrees / 180 * PI) * IR_WEIGHT_SCALE);
+	cumulatives[nextFree] = 0;
+	windows[nextFree] = 0;
 	nextFree++;
 }
 
 /** Does a light source exist (like an RCJ IR ball) or not?
+@param threshold - a receiver must have more hits than this in its window, 0 - SAMPLE_LENGTH.
 @return - Exists or not.
 */
 bool IRReceivers::anyIRSource(uint16_t threshold) {
@@ -24,82 +46,27 @@ bool IRReceivers::anyIRSource(uint16_t threshold) {
 	return false;
 }
 
-/** Index of a sensor left to the current.
-@param currentIndex - index of the current sensor.
-@return - index of a left sensor.
-*/
-uint8_t IRReceivers::indexLeft(uint8_t currentIndex) {
-	if (currentIndex == 0)
-		return nextFree - 1;
-	else
-		return currentIndex - 1;
-}
-
-/** Index of a sensor right to the current.
-@param currentIndex - index of the current sensor.
-@return - index of a right sensor.
-*/
-uint8_t IRReceivers::indexRight(uint8_t currentIndex) {
-	if (currentIndex == nextFree - 1)
-		return 0;
-	else
-		return currentIndex + 1;
-}
-
-/** Angle of the light source (like an RCJ IR ball)
+/** Angle of the light source (like an RCJ IR ball). Direction of the vector sum, so no search and no wraparound at 180 degrees are needed.
 @return - Angle in degrees. Robot front is 0 degrees and positive angles are to the right.
 */
 IRSource IRReceivers::irSource() {
-	//First find 3 adjacent sensors with the most readings.
-	int maxValue = -1;
-	int indexForMaxValue = 0;
-	for (int i = 0; i < nextFree; i++) {
-		float currValue = cumulatives[i] + cumulatives[indexLeft(i)] + cumulatives[indexRight(i)];//Current + 2 adjacent
-		if (currValue > maxValue) {
-			maxValue = currValue;
-			indexForMaxValue = i;
-		}
-	}
+	noInterrupts(); // Timer may change the sums
+	int32_t x = sumX;
+	int32_t y = sumY;
+	uint16_t strength = strengthTotal;
+	interrupts();
 
 	IRSource source;
-	float nominator = 0;
-	float denominator = 0;
-	bool add360Degrees = false;
-	if (indexForMaxValue != -1) {
-		for (int i = -3; i <= 3; i++) {
-
-			int shiftedIndex = indexForMaxValue + i;
-			if (shiftedIndex < 0)
-				shiftedIndex += nextFree;
-			if (shiftedIndex >= nextFree) 
-				shiftedIndex -= nextFree;
-
-			if (i!= 2 && shiftedIndex == 0)
-				add360Degrees = true;
-
-			float angle = angles[shiftedIndex];
-			if (add360Degrees)
-				angle += 360;
-			nominator += angle * cumulatives[shiftedIndex];
-			denominator += cumulatives[shiftedIndex];
-
-		}
-
-		if (abs(denominator) < 0.01)
-			source.any = false;
-		else {
-			float ratio = nominator / denominator;
-			if (ratio < -180)
-				ratio += 360;
-			else if (ratio > 180)
-				ratio -= 360;
-			source.angle = ratio;
-			source.any = true;
-		}
-	}
-	else {
+	source.strength = strength;
+	if (strength == 0) {
 		source.angle = 0;
 		source.any = false;
+		source.confidence = 0;
+	}
+	else {
+		source.angle = atan2((float)y, (float)x) / PI * 180;
+		source.any = true;
+		source.confidence = sqrt((float)x * x + (float)y * y) / ((float)strength * IR_WEIGHT_SCALE);
 	}
 	return source;
 }
@@ -129,7 +96,7 @@ void IRReceivers::test(BreakCondition breakWhen, bool updateByTimerInterrupts) {
 	while (breakWhen == 0 || !(*breakWhen)()) {
 		for (int i = 0; i < nextFree; i++) {
 			print((String)(int)angles[i] + "D:");
-			char buffer[SAMPLE_LENGTH > 99 ? 3 : 2];
+			char buffer[6];
 			sprintf(buffer, "%2d", cumulatives[i]);
 			print(buffer);
 			print("   ");
@@ -138,31 +105,98 @@ void IRReceivers::test(BreakCondition breakWhen, bool updateByTimerInterrupts) {
 		IRSource source = irSource();
 		if (source.any) {
 			float direction = source.angle;
-			print(" source: " + (String)round(direction) + " deg");
+			print(" source: " + (String)round(direction) + " deg, confidence " + (String)(int)(source.confidence * 100) + "%");
 		}
 		else
 			print(" No source.");
 
+		if (!updateByTimerInterrupts) {
+			uint32_t startMicros = micros();
+			update();
+			print(" update: " + (String)(micros() - startMicros) + " us");
+		}
+
 		print("", true);
 
 		uint32_t startMs = millis();
 		while (millis() - startMs < 200)
-			if (!updateByTimerInterrupts)
-				update();
+			if (!updateByTimerInterrupts) {
+				if (samplePeriodMicros != 0)
+					refresh();
+				else
+					update();
+			}
 	}
 }
 
-/** Periodically updates internal cumulatives.
+/** Takes samples at a fixed rate. Call in every loop pass if sampling was started without a timer.
 */
-void IRReceivers::update() {
-	for (int i = 0; i < nextFree; i++)
-		if (!digitalRead(pins[i])) {
-			if (cumulatives[i] < 2)
-			cumulatives[i]++;
+void IRReceivers::refresh() {
+	if (samplePeriodMicros == 0 || sampledByTimer)
+		return;
+	uint8_t count = 0;
+	while ((int32_t)(micros() - nextSampleMicros) >= 0) {
+		if (count++ >= SAMPLE_LENGTH) { // Too late, the whole window is already stale. Continue from now on.
+			nextSampleMicros = micros() + samplePeriodMicros;
+			break;
 		}
-		else
-			if (cumulatives[i] > 0)
-				cumulatives[i]--;
+		update();
+		nextSampleMicros += samplePeriodMicros;
+	}
+}
+
+/** Starts sampling at a fixed rate. After that, update() should not be called any more.
+@param frequencyHz - samples per second.
+@param useTimer - on ESP32, a hardware timer interrupt calls update(). Otherwise refresh() must be called as often as possible.
+*/
+void IRReceivers::samplingStart(uint16_t frequencyHz, bool useTimer) {
+	if (frequencyHz == 0)
+		error("Frequency 0");
+	samplePeriodMicros = 1000000UL / frequencyHz;
+	nextSampleMicros = micros();
+	sampledByTimer = false;
+#if defined(ESP32)
+	if (useTimer) {
+		irReceiversSampled = this;
+		if (irReceiversTimer == NULL)
+			irReceiversTimer = timerBegin(IR_RECEIVERS_TIMER, 80, true); // 80 MHz / 80: 1 tick is 1 us
+		timerAttachInterrupt(irReceiversTimer, &irReceiversOnTimer, true);
+		timerAlarmWrite(irReceiversTimer, samplePeriodMicros, true);
+		timerAlarmEnable(irReceiversTimer);
+		sampledByTimer = true;
+	}
+#endif
+}
+
+/** Stops sampling at a fixed rate.
+*/
+void IRReceivers::samplingStop() {
+#if defined(ESP32)
+	if (sampledByTimer && irReceiversTimer != NULL) {
+		timerAlarmDisable(irReceiversTimer);
+		irReceiversSampled = NULL;
+	}
+#endif
+	sampledByTimer = false;
+	samplePeriodMicros = 0;
+}
+
+/** Periodically updates internal cumulatives. Takes one sample of each receiver. Short enough to be called from a timer interrupt.
+Only the sample entering and the one leaving the window change the sums, so there is no need to rescan the window.
+*/
+void IRAM_ATTR IRReceivers::update() {
+	for (int i = 0; i < nextFree; i++) {
+		uint32_t hit = digitalRead(pins[i]) ? 0 : 1;
+		uint32_t leaving = (windows[i] >> (SAMPLE_LENGTH - 1)) & 1;
+		windows[i] = ((windows[i] << 1) | hit) & IR_WINDOW_MASK;
+		if (hit != leaving) {
+			int8_t delta = hit ? 1 : -1;
+			cumulatives[i] += delta;
+			strengthTotal += delta;
+			sumX += delta * cosines[i];
+			sumY += delta * sines[i];
+		}
+	}
 }
 
 /**Constructor
@@ -171,8 +205,10 @@ void IRReceivers::update() {
 IRReceivers::IRReceivers(HardwareSerial * hardwareSerial) {
 	serial = hardwareSerial;
 	nextFree = 0;
-	for (int i = 0; i < MAX_IR_RECEIVERS; i++)
+	for (int i = 0; i < MAX_IR_RECEIVERS; i++) {
 		cumulatives[i] = 0;
+		windows[i] = 0;
+	}
 }
 
 IRReceivers::~IRReceivers(){}
@@ -3,41 +3,44 @@
 
 /**
 Purpose: Using MRMS IR detector. Separate sensors can be used or as a group, for detection of a RCJ ball.
+Each receiver keeps a sliding window of last samples. A vector sum of all the receivers' directions, weighted by the number of hits in the window,
+is updated incrementally in every sample, so the direction is available at once, without scanning the receivers.
 @author MRMS team
-@version 0.2 2018-02-19
+@version 0.3 2026-10-19
 Licence: You can use this code any way you like.
 */
 
 #define MAX_IR_RECEIVERS 20 //Maximum number of IR receivers. 
-#define SAMPLE_LENGTH 100 //A bigger number increases precision but takes more time.
+#define SAMPLE_LENGTH 32 //Sliding window, in samples. A bigger number increases precision but reacts slower. Maximum 32.
+#define IR_WEIGHT_SCALE 256 //Fixed point scale of sine and cosine weights.
+#define IR_SOURCE_HITS_MIN (SAMPLE_LENGTH / 8) //Default threshold of anyIRSource(). Fewer hits in a window are noise.
 typedef bool(*BreakCondition)();
 
 struct IRSource {
 public:
 	float angle;
 	bool any;
+	float confidence; // 0 - receivers see the source from all sides equally, 1 - all the hits are from a single direction.
+	uint16_t strength; // Number of hits in the window, all the receivers together.
 };
 
 class IRReceivers
 {
 	double angles[MAX_IR_RECEIVERS]; // Angle in degrees. Robot front is 0 degrees and positive angles are to the right.
-	uint16_t cumulatives[MAX_IR_RECEIVERS];
+	int16_t cosines[MAX_IR_RECEIVERS]; // Fixed point weights, IR_WEIGHT_SCALE is 1.
+	volatile uint16_t cumulatives[MAX_IR_RECEIVERS]; // Hits in the window.
 	int nextFree;
+	uint32_t nextSampleMicros = 0;
+	bool sampledByTimer = false;
+	uint32_t samplePeriodMicros = 0; // 0 - no fixed rate sampling.
+	int16_t sines[MAX_IR_RECEIVERS];
+	volatile uint16_t strengthTotal = 0; // Sum of all cumulatives.
+	volatile int32_t sumX = 0; // Running vector sum, towards robot's front.
+	volatile int32_t sumY = 0; // Running vector sum, towards robot's right.
+	uint32_t windows[MAX_IR_RECEIVERS]; // Last SAMPLE_LENGTH samples, bitwise. 1 - hit.
 	byte pins[MAX_IR_RECEIVERS]; //Digital pins the sensor use
 	HardwareSerial * serial; //Additional serial port
 
-	/** Index of a sensor left to the current.
-	@param currentIndex - index of the current sensor.
-	@return - index of a left sensor.
-	*/
-	uint8_t indexLeft(uint8_t currentIndex);
-
-	/** Index of a sensor right to the current.
-	@param currentIndex - index of the current sensor.
-	@return - index of a right sensor.
-	*/
-	uint8_t indexRight(uint8_t currentIndex);
-	
 	/** Print to all serial ports
 	@param message
 	@param eol - end of line
@@ -59,22 +62,38 @@ public:
 	void add(byte pin, double angleDegrees = 0);
 
 	/** Does a light source exist (like an RCJ IR ball) or not?
+	@param threshold - a receiver must have more hits than this in its window, 0 - SAMPLE_LENGTH. Before version 0.3 the counter
+	saturated at 2, so thresholds written for it (0 or 1) now let a single noise hit through.
 	@return - Exists or not.
 	*/
-	bool anyIRSource(uint16_t threshold = 0);
+	bool anyIRSource(uint16_t threshold = IR_SOURCE_HITS_MIN);
 
 	/** Angle of the light source (like an RCJ IR ball)
 	@return - Angle in degrees. Robot front is 0 degrees and positive angles are to the right.
 	*/
 	IRSource irSource();
 
+	/** Takes samples at a fixed rate. Call in every loop pass if sampling was started without a timer.
+	*/
+	void refresh();
+
+	/** Starts sampling at a fixed rate. After that, update() should not be called any more.
+	@param frequencyHz - samples per second.
+	@param useTimer - on ESP32, a hardware timer interrupt calls update(). Otherwise refresh() must be called as often as possible.
+	*/
+	void samplingStart(uint16_t frequencyHz = 2000, bool useTimer = true);
+
+	/** Stops sampling at a fixed rate.
+	*/
+	void samplingStop();
+
 	/**Test
 	@param breakWhen - A function returning bool, without arguments. If it returns true, the test() will be interrupted.
 	@param updateByTimerInterrupts - If so, no update() will be called in the function.
 	*/
 	void test(BreakCondition breakWhen = 0, bool updateByTimerInterrupts = false);
 
-	/** Periodically updates internal cumulatives.
+	/** Periodically updates internal cumulatives. Takes one sample of each receiver. Short enough to be called from a timer interrupt.
 	*/
 	void update();
 };
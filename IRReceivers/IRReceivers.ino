@@ -12,6 +12,7 @@ void setup() {
   delay(500);
   Serial.println("Start");
 
+  ir.samplingStart(2000, false); // 2000 samples per second, paced by refresh(). On ESP32, true will use a timer interrupt instead.
   ir.test(); // Study the test() function in order to use it in Your code.
 }
 
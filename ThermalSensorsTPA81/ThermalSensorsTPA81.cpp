@@ -8,25 +8,114 @@ void ThermalSensorsTPA81::add(uint8_t address) {
 		error("Too many TPA81s.");
 
 	addresses[nextFree] = address;
+	frames[nextFree].ms = 0;
+	frames[nextFree].valid = false;
 	nextFree++;
 }
 
-/** Read a sensor
-@param senzorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
-@param reg - Register. Check Devantech's documentation.
-@return - Result of reading.
+/** Ambient temperature
+@param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
+@return - Temperature in degrees Celsius.
+*/
+int ThermalSensorsTPA81::ambient(uint8_t sensorNumber) {
+	return frameFresh(sensorNumber)->ambient;
+}
+
+/** Cached frame, as last read. Does not read.
+@param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
+@return - Frame.
+*/
+const TPA81Frame * ThermalSensorsTPA81::frame(uint8_t sensorNumber) {
+	if (sensorNumber >= nextFree)
+		error("TPA81 index out of range");
+	return &frames[sensorNumber];
+}
+
+/** Returns a frame no older than TPA81_FRAME_MAX_AGE_MS, reading it if needed.
+@param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
+@return - Frame.
+*/
+TPA81Frame * ThermalSensorsTPA81::frameFresh(uint8_t sensorNumber) {
+	if (sensorNumber >= nextFree)
+		error("TPA81 index out of range");
+	TPA81Frame * frame = &frames[sensorNumber];
+	if (frame->ms == 0 || millis() - frame->ms > TPA81_FRAME_MAX_AGE_MS)
+		frameRead(sensorNumber);
+	return frame;
+}
+
+/** Reads ambient and all the pixels' temperatures in one I2C transaction into the cached frame.
+@param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
+@return - true if read, false on timeout. The previous frame's temperatures are kept in that case.
 */
-byte ThermalSensorsTPA81::readSensor(byte sensorNumber, byte reg) { // Function to receive one byte of data from TPA81
-	Wire.beginTransmission(addresses[sensorNumber]);                // Begin communication with TPA81
-	Wire.write(reg);											// Send reg to TPA81
+bool ThermalSensorsTPA81::frameRead(uint8_t sensorNumber) {
+	TPA81Frame * frame = &frames[sensorNumber];
+	_transactions++;
+	Wire.beginTransmission(addresses[sensorNumber]);
+	Wire.write(TPA81_REGISTER_AMBIENT);
 	Wire.endTransmission();
-	Wire.requestFrom((int)addresses[sensorNumber], 1);          // Request 1 byte
-	while (Wire.available() < 1);								// Wait for byte to arrive
-	byte data = Wire.read();									// Get byte
-	return(data);												// return byte
+	Wire.requestFrom((int)addresses[sensorNumber], 1 + TPA81_RAYS); // TPA81 auto-increments register, so all in one burst.
+	uint32_t startMicros = micros();
+	while (Wire.available() < 1 + TPA81_RAYS)
+		if (micros() - startMicros > TPA81_TIMEOUT_MICROS) {
+			while (Wire.available()) // Discard partial frame
+				Wire.read();
+			_timeouts++;
+			frame->ms = millis(); // Not to retry immediately
+			frame->valid = false;
+			return false;
+		}
+
+	frame->ambient = Wire.read();
+	for (uint8_t i = 0; i < TPA81_RAYS; i++)
+		frame->pixel[i] = Wire.read();
+	frame->ms = millis();
+	frame->valid = true;
+	hotspotCalculate(frame);
+	return true;
+}
+
+/** Hottest point
+@param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
+@param position - output, ray of the hottest point, interpolated between pixels, 0.0 - 7.0. Optional.
+@return - Hottest pixel's temperature in degrees Celsius.
+*/
+int ThermalSensorsTPA81::hotspot(uint8_t sensorNumber, float * position) {
+	TPA81Frame * frame = frameFresh(sensorNumber);
+	if (position != 0)
+		*position = frame->hotspotPosition;
+	return frame->pixel[frame->hotspotRay];
+}
+
+/** Finds the hottest pixel and interpolates the hottest point using its neighbours. A parabola is fitted through the hottest pixel
+and the 2 adjacent ones, its vertex is the hottest point. Edge pixels are not interpolated.
+@param frame - frame just read.
+*/
+void ThermalSensorsTPA81::hotspotCalculate(TPA81Frame * frame) {
+	uint8_t hottest = 0;
+	for (uint8_t i = 1; i < TPA81_RAYS; i++)
+		if (frame->pixel[i] > frame->pixel[hottest])
+			hottest = i;
+	frame->hotspotRay = hottest;
+	frame->hotspotPosition = hottest;
+	if (hottest > 0 && hottest < TPA81_RAYS - 1) {
+		int left = frame->pixel[hottest - 1];
+		int center = frame->pixel[hottest];
+		int right = frame->pixel[hottest + 1];
+		int curvature = left - 2 * center + right;
+		if (curvature != 0)
+			frame->hotspotPosition += 0.5 * (left - right) / (float)curvature;
+	}
 }
 
-/** Read a temperature.
+/** Reads frames of all the sensors
+*/
+void ThermalSensorsTPA81::refresh() {
+	for (uint8_t i = 0; i < nextFree; i++)
+		frameRead(i);
+}
+
+/** Read a temperature, from cached frame if it is fresh.
 @param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
 @param rayNumber - Ray's number, 0 to 7.
 @return - Temperature in degrees Celsius.
@@ -35,7 +124,7 @@ int ThermalSensorsTPA81::temperature(uint8_t sensorNumber, uint8_t rayNumber)
 {
 	if (rayNumber > 7)
 		error("Ray index out of range");
-	return readSensor(sensorNumber, rayNumber + 2);
+	return frameFresh(sensorNumber)->pixel[rayNumber];
 }
 
 /**Test
@@ -43,14 +132,21 @@ int ThermalSensorsTPA81::temperature(uint8_t sensorNumber, uint8_t rayNumber)
 */
 void ThermalSensorsTPA81::test(BreakCondition breakWhen) {
 	while (breakWhen == 0 || !(*breakWhen)()) {
+		refresh();
 		for (int i = 0; i < nextFree; i++) {
 			for (int j = 0; j < 8; j++) {
 				if (j != 0) {
 					Serial.print(" ");
 					if (serial != 0) serial->print(" ");
 				}
-				Serial.print(temperature(i, j));
-				if (serial != 0) serial->print(temperature(i, j));
+				Serial.print(frames[i].pixel[j]);
+				if (serial != 0) serial->print(frames[i].pixel[j]);
+			}
+			Serial.print(" hot: ");
+			Serial.print(frames[i].hotspotPosition);
+			if (serial != 0) {
+				serial->print(" hot: ");
+				serial->print(frames[i].hotspotPosition);
 			}
 			Serial.print("   ");
 			if (serial != 0) serial->print("   ");
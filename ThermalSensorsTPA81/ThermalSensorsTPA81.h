@@ -4,27 +4,51 @@
 
 /**
 Svrha: reading of Devantech TPA81 thermal sensors.
+All the pixels and ambient temperature are read in a single I2C transaction and cached, so reading 8 rays costs 1 transaction, not 8.
 @author MRMS team
-@version 0.1 2018-02-19
+@version 0.2 2026-10-19
 Licence: You can use this code any way you like.
 */
 
 #define MAX_THERMAL_SENSORS_TPA81 6 // Maximum number of sensors.
+#define TPA81_FRAME_MAX_AGE_MS 40 // A cached frame older than this is read again. TPA81 refreshes pixels at about this rate.
+#define TPA81_REGISTER_AMBIENT 1 // First register of a frame: ambient, followed by 8 pixels. Registers auto-increment.
+#define TPA81_RAYS 8
+#define TPA81_TIMEOUT_MICROS 2000 // No complete frame in this time is an error.
 
 typedef bool(*BreakCondition)();
 
+/** All the temperatures of a sensor, read at once.
+*/
+struct TPA81Frame {
+	uint8_t ambient; // Degrees Celsius.
+	uint8_t hotspotRay; // Hottest pixel, 0 - 7.
+	float hotspotPosition; // Hottest point, interpolated between pixels, 0.0 - 7.0.
+	uint32_t ms; // Time of reading. 0 - never read.
+	uint8_t pixel[TPA81_RAYS]; // Degrees Celsius.
+	bool valid; // Last reading succeeded.
+};
+
 class ThermalSensorsTPA81
 {
 	uint8_t addresses[MAX_THERMAL_SENSORS_TPA81]; // I2C addresses TPA81 use
+	TPA81Frame frames[MAX_THERMAL_SENSORS_TPA81]; // Last frame read for each sensor.
 	int nextFree;
 	HardwareSerial * serial; //Additional serial port
+	uint16_t _timeouts = 0; // Frames not read because of a timeout.
+	uint32_t _transactions = 0; // I2C transactions (register write and burst read) since start.
 
-	/** Read a sensor
-	@param senzorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
-	@param reg - Register. Check Devantech's documentation.
-	@return - Result of reading.
+	/** Finds the hottest pixel and interpolates the hottest point using its neighbours.
+	@param frame - frame just read.
 	*/
-	byte readSensor(byte sensorNumber, byte reg);
+	void hotspotCalculate(TPA81Frame * frame);
+
+	/** Returns a frame no older than TPA81_FRAME_MAX_AGE_MS, reading it if needed.
+	@param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
+	@return - Frame.
+	*/
+	TPA81Frame * frameFresh(uint8_t sensorNumber);
+
 public:
 	/**Constructor
 	@param hardwareSerial - Serial, Serial1, Serial2,... - an optional serial port, for example for Bluetooth communication
@@ -38,7 +62,36 @@ public:
 	*/
 	void add(uint8_t address);
 
-	/** Reads a temperature.
+	/** Ambient temperature
+	@param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
+	@return - Temperature in degrees Celsius.
+	*/
+	int ambient(uint8_t sensorNumber);
+
+	/** Cached frame, as last read. Does not read.
+	@param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
+	@return - Frame.
+	*/
+	const TPA81Frame * frame(uint8_t sensorNumber);
+
+	/** Reads ambient and all the pixels' temperatures in one I2C transaction into the cached frame.
+	@param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
+	@return - true if read, false on timeout. The previous frame's temperatures are kept in that case.
+	*/
+	bool frameRead(uint8_t sensorNumber);
+
+	/** Hottest point
+	@param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
+	@param position - output, ray of the hottest point, interpolated between pixels, 0.0 - 7.0. Optional.
+	@return - Hottest pixel's temperature in degrees Celsius.
+	*/
+	int hotspot(uint8_t sensorNumber, float * position = 0);
+
+	/** Reads frames of all the sensors
+	*/
+	void refresh();
+
+	/** Reads a temperature, from cached frame if it is fresh.
 	@param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
 	@param rayNumber - Ray's number, 0 to 7.
 	@return - Temperature in degrees Celsius.
@@ -49,6 +102,16 @@ public:
 	@param breakWhen - A function returning bool, without arguments. If it returns true, the test() will be interrupted.
 	*/
 	void test(BreakCondition breakWhen = 0);
+
+	/** Frames not read because of a timeout
+	@return - count
+	*/
+	uint16_t timeouts() { return _timeouts; }
+
+	/** I2C transactions since start. Each frame is one.
+	@return - count
+	*/
+	uint32_t transactions() { return _transactions; }
 };
 
 //Declaration of error function. Definition is in Your code.
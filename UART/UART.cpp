@@ -15,35 +15,40 @@ uint8_t& Message::operator[](uint8_t index) {
 @param data - data to be appended
 */
 void Message::append(uint8_t data) {
-	if (nextBufferPos == MAXIMUM_MESSAGE_SIZE - 1)
+	if (nextBufferPos >= MAXIMUM_MESSAGE_SIZE)
 		error("Message overflow");
 	buffer[nextBufferPos] = data;
 	nextBufferPos++;
-	bufferTypes[nextTypesPos] = UINT8;
-	nextTypesPos++;
 }
 
 /** Continue building messageText by appending to the tail
 @param data - data to be appended
 */
 void Message::append(uint16_t data) {
-	if (nextBufferPos == MAXIMUM_MESSAGE_SIZE - 2)
+	if (nextBufferPos + 2 > MAXIMUM_MESSAGE_SIZE)
 		error("Message overflow");
 	Mix mix;
 	mix.int16 = data;
 	buffer[nextBufferPos++] = mix.bytes[0];
 	buffer[nextBufferPos++] = mix.bytes[1];
-	bufferTypes[nextTypesPos] = UINT16;
-	nextTypesPos++;
 }
 
 /** Continue building messageText by appending to the tail
 @param data - data to be appended
 */
 void Message::append(String data) {
-	for (uint8_t i = 0; i < data.length(); i++)
-		append((uint8_t)data[i]);
-	append((uint8_t)0);
+	append((const uint8_t*)data.c_str(), data.length() + 1); // Including terminating 0
+}
+
+/** Continue building message by appending to the tail
+@param data - data to be appended
+@param size - number of bytes
+*/
+void Message::append(const uint8_t* data, uint8_t size) {
+	if (nextBufferPos + size > MAXIMUM_MESSAGE_SIZE)
+		error("Message overflow");
+	memcpy(buffer + nextBufferPos, data, size);
+	nextBufferPos += size;
 }
 
 /** Buffer
@@ -108,11 +113,40 @@ String Message::readString() {
 	return str;
 }
 
+/** Next record, without copying it.
+@param recordType - output, record's type
+@param recordSize - output, record's length
+@return - pointer to record's content inside the message, NULL if no more records. Content need not be aligned, use recordRead() to get a struct.
+*/
+const uint8_t* Message::recordNext(uint8_t* recordType, uint8_t* recordSize) {
+	if (nextReadPos + RECORD_HEADER_SIZE > nextBufferPos)
+		return NULL;
+	uint8_t type = buffer[nextReadPos];
+	uint8_t length = buffer[nextReadPos + 1];
+	if (nextReadPos + RECORD_HEADER_SIZE + length > nextBufferPos)
+		return NULL;
+	*recordType = type;
+	*recordSize = length;
+	const uint8_t* content = buffer + nextReadPos + RECORD_HEADER_SIZE;
+	nextReadPos += RECORD_HEADER_SIZE + length;
+	return content;
+}
+
 /** Clear messageText in order to start building a new one
 */
 void Message::reset() {
 	nextBufferPos = 0;
-	nextTypesPos = 0;
+	nextReadPos = 0;
+}
+
+/** Sets size after content was written directly into bytes()
+@param size - number of bytes
+*/
+void Message::resize(uint8_t size) {
+	if (size > MAXIMUM_MESSAGE_SIZE)
+		error("Message overflow");
+	nextBufferPos = size;
+	nextReadPos = 0;
 }
 
 /** Size
@@ -143,6 +177,105 @@ void UART::add() {
 	uartSerial->begin(baud);
 }
 
+/** CRC-16/CCITT-FALSE: polynomial 0x1021, initial value 0xFFFF. Nibble table, a compromise between speed and size.
+@param data - data
+@param size - number of bytes
+@param crc - previous value, for calculation in parts
+@return - CRC
+*/
+uint16_t UART::crc16(const uint8_t* data, uint16_t size, uint16_t crc) {
+	static const uint16_t table[16] = { 0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+		0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF };
+	for (uint16_t i = 0; i < size; i++) {
+		crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] >> 4)];
+		crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] & 0x0F)];
+	}
+	return crc;
+}
+
+/** Reads all the available bytes, till the end of a frame. Never waits.
+@param message - output, decoded message. Changed only if a valid frame arrived.
+@return - true if a valid frame arrived
+*/
+bool UART::frameReceive(Message* message) {
+	while (uartSerial->available()) {
+		uint8_t data = uartSerial->read();
+		if (data != 0) { // Inside a frame
+			if (rxFrameNext >= MAXIMUM_FRAME_SIZE) {
+				if (!rxOverflow)
+					_frameOverflows++;
+				rxOverflow = true;
+			}
+			else
+				rxFrame[rxFrameNext++] = data;
+			continue;
+		}
+
+		// Delimiter: decode COBS in place. Each code byte tells where the next 0 was.
+		uint8_t encodedSize = rxFrameNext;
+		bool overflow = rxOverflow;
+		rxFrameNext = 0;
+		rxOverflow = false;
+		if (overflow || encodedSize == 0)
+			continue;
+		uint8_t decodedSize = 0;
+		uint8_t i = 0;
+		bool ok = true;
+		while (i < encodedSize) {
+			uint8_t code = rxFrame[i++];
+			if (i + code - 1 > encodedSize) {
+				ok = false;
+				break;
+			}
+			for (uint8_t j = 1; j < code; j++)
+				rxFrame[decodedSize++] = rxFrame[i++];
+			if (code != 0xFF && i < encodedSize)
+				rxFrame[decodedSize++] = 0;
+		}
+		if (!ok || decodedSize < 2 || decodedSize - 2 > MAXIMUM_MESSAGE_SIZE ||
+			crc16(rxFrame, decodedSize - 2) != (rxFrame[decodedSize - 2] | (rxFrame[decodedSize - 1] << 8))) {
+			_frameErrors++;
+			continue;
+		}
+		memcpy(message->bytes(), rxFrame, decodedSize - 2);
+		message->resize(decodedSize - 2);
+		return true;
+	}
+	return false;
+}
+
+/** Sends a message as a frame, with CRC, COBS encoded. The whole frame is prepared in a buffer and sent in a single write,
+so that the driver can transfer it in one block.
+@param message
+*/
+void UART::frameSend(Message& message) {
+	uint16_t crc = crc16(message.bytes(), message.size());
+	uint8_t crcBytes[2] = { (uint8_t)(crc & 0xFF), (uint8_t)(crc >> 8) };
+
+	uint16_t codeIndex = 0; // Where the current block's code byte goes
+	uint16_t next = 1;
+	uint8_t code = 1;
+	for (uint16_t i = 0; i < message.size() + 2u; i++) {
+		uint8_t data = i < message.size() ? message.bytes()[i] : crcBytes[i - message.size()];
+		if (data == 0) {
+			txFrame[codeIndex] = code;
+			codeIndex = next++;
+			code = 1;
+		}
+		else {
+			txFrame[next++] = data;
+			if (++code == 0xFF) {
+				txFrame[codeIndex] = code;
+				codeIndex = next++;
+				code = 1;
+			}
+		}
+	}
+	txFrame[codeIndex] = code;
+	txFrame[next++] = 0;
+	uartSerial->write(txFrame, next);
+}
+
 /**Get the number of bytes (characters) available for reading from the uartSerial port.
 @return - number of bytes.
 */
@@ -3,22 +3,22 @@
 
 /**
 Purpose: UART communication to a Raspberry Pi (or other) board
+Messages can be sent as frames: payload and CRC-16 are COBS encoded and terminated by 0, so the receiver can always find the start of the next frame
+and discard damaged ones. A frame may contain many records.
 @author MRMS team
-@version 0.1 2018-08-11
+@version 0.2 2026-10-19
 Licence: You can use this code any way you like.
 */
 
-#define MAXIMUM_MESSAGE_SIZE 16
+#define MAXIMUM_MESSAGE_SIZE 240 // Payload. Frame adds CRC (2 bytes), COBS overhead (1 byte for each 254 bytes) and delimiter (1 byte).
+#define MAXIMUM_FRAME_SIZE (MAXIMUM_MESSAGE_SIZE + 2 + (MAXIMUM_MESSAGE_SIZE + 2) / 254 + 1 + 1)
+#define RECORD_HEADER_SIZE 2 // Record type and length
 
 class Message {
-	typedef enum {INT8, INT16, INT32, UINT8, UINT16, UINT32 } Types;
-
 	HardwareSerial *bluetoothSerial; // Bluetooth port, for example
 	uint8_t buffer[MAXIMUM_MESSAGE_SIZE];
-	Types bufferTypes[MAXIMUM_MESSAGE_SIZE];
 	uint8_t nextBufferPos = 0;
 	uint8_t nextReadPos = 0;
-	uint8_t nextTypesPos = 0;
 
 	union Mix
 	{
@@ -61,6 +61,27 @@ public:
 	*/
 	void append(String data);
 
+	/** Continue building message by appending to the tail
+	@param data - data to be appended
+	@param size - number of bytes
+	*/
+	void append(const uint8_t* data, uint8_t size);
+
+	/** Appends a record: type, length and content. Many records can be batched in a message, the receiver reads them with recordNext().
+	@param recordType - user defined type
+	@param record - a plain struct, without pointers
+	*/
+	template <typename T> void appendRecord(uint8_t recordType, const T& record) {
+		append(recordType);
+		append((uint8_t)sizeof(T));
+		append((const uint8_t*)&record, sizeof(T));
+	}
+
+	/** Free space
+	@return - number of bytes that can still be appended
+	*/
+	uint8_t available() { return MAXIMUM_MESSAGE_SIZE - nextBufferPos; }
+
 	/** Buffer
 	@return - buffer
 	*/
@@ -85,10 +106,35 @@ public:
 	*/
 	String readString();
 
+	/** Next record, without copying it.
+	@param recordType - output, record's type
+	@param recordSize - output, record's length
+	@return - pointer to record's content inside the message, NULL if no more records. Content need not be aligned, use recordRead() to get a struct.
+	*/
+	const uint8_t* recordNext(uint8_t* recordType, uint8_t* recordSize);
+
+	/** Copies a record's content into a struct
+	@param content - pointer returned by recordNext()
+	@param recordSize - size returned by recordNext()
+	@param record - output
+	@return - true if sizes match
+	*/
+	template <typename T> static bool recordRead(const uint8_t* content, uint8_t recordSize, T* record) {
+		if (content == NULL || recordSize != sizeof(T))
+			return false;
+		memcpy(record, content, sizeof(T));
+		return true;
+	}
+
 	/** Clear message in order to start building a new one
 	*/
 	void reset();
 
+	/** Sets size after content was written directly into bytes()
+	@param size - number of bytes
+	*/
+	void resize(uint8_t size);
+
 	/** Size
 	@return - number of bytes
 	*/
@@ -101,6 +147,12 @@ class UART
 	HardwareSerial *uartSerial; //UART port
 	HardwareSerial *bluetoothSerial; // Bluetooth port, for example
 	uint32_t baud;
+	uint16_t _frameErrors = 0; // Frames discarded because of CRC or COBS errors.
+	uint16_t _frameOverflows = 0; // Frames discarded because too long.
+	uint8_t rxFrame[MAXIMUM_FRAME_SIZE]; // Frame being received, still COBS encoded.
+	uint8_t rxFrameNext = 0;
+	bool rxOverflow = false; // Discard bytes till next delimiter
+	uint8_t txFrame[MAXIMUM_FRAME_SIZE]; // Encoded frame, sent in a single write.
 
 	/** Print to all serial ports
 	@param message
@@ -122,6 +174,35 @@ public:
 	*/
 	void add();
 
+	/** CRC-16/CCITT-FALSE: polynomial 0x1021, initial value 0xFFFF
+	@param data - data
+	@param size - number of bytes
+	@param crc - previous value, for calculation in parts
+	@return - CRC
+	*/
+	static uint16_t crc16(const uint8_t* data, uint16_t size, uint16_t crc = 0xFFFF);
+
+	/** Number of damaged frames, discarded
+	@return - count
+	*/
+	uint16_t frameErrors() { return _frameErrors; }
+
+	/** Number of too long frames, discarded
+	@return - count
+	*/
+	uint16_t frameOverflows() { return _frameOverflows; }
+
+	/** Reads all the available bytes, till the end of a frame. Never waits.
+	@param message - output, decoded message. Changed only if a valid frame arrived.
+	@return - true if a valid frame arrived
+	*/
+	bool frameReceive(Message* message);
+
+	/** Sends a message as a frame, with CRC, COBS encoded.
+	@param message
+	*/
+	void frameSend(Message& message);
+
 	/**Get the number of bytes (characters) available for reading from the serial port.
 	@return - number of bytes.
 	*/
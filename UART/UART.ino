@@ -14,7 +14,7 @@ void setup(){
   Serial.begin(115200);
 
   message.append((uint8_t)0);
-  uart.write(message);
+  uart.frameSend(message);
 }
 
 void loop(){
@@ -33,8 +33,7 @@ void error(String message){
 }
 
 void handleMessages(){
-   if (uart.available()){
-    message = uart.readMessage();
+   if (uart.frameReceive(&message)){ // Only complete frames with a correct CRC
     uint8_t messageId = message.readUInt8();
     switch(message[0]){
       case 1:{
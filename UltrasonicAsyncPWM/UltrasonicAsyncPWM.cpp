@@ -3,6 +3,10 @@
 //Singleton, not important for a user
 UltrasonicAsyncPWM *UltrasonicAsyncPWM::_instance(NULL);
 
+// Interrupt functions, one for each sensor, generated from a template
+void (*const UltrasonicAsyncPWM::_echoIsr[MAX_ULTRASONIC_ASYNC_PWM])() = { _echo_isr<0>, _echo_isr<1>, _echo_isr<2>, _echo_isr<3>,
+	_echo_isr<4>, _echo_isr<5>, _echo_isr<6>, _echo_isr<7> };
+
 /**Constructor
 @param hardwareSerial - Serial, Serial1, Serial2,... - an optional serial port, for example for Bluetooth communication
 */
@@ -12,75 +16,6 @@ UltrasonicAsyncPWM::UltrasonicAsyncPWM(HardwareSerial * hardwareSerial) {
 	if (_instance == 0) _instance = this;//Singleton
 }
 
-// This part is important only if a trigger pulse is more than 0 ms long. If a signal is longer, the program will be waiting.
-// In general, 2 delays are possible: for a trigger pulse and for a returning pulse.
-#ifdef USE_TIMER_FOR_TRIGGER
-#if TRIGGER_PULSE_WIDTH != 0
-IntervalTimer timer0;// Radi samo za Teensy
-IntervalTimer timer1;// Radi samo za Teensy
-IntervalTimer timer2;// Radi samo za Teensy
-IntervalTimer timer3;// Radi samo za Teensy
-IntervalTimer timer4;// Radi samo za Teensy
-IntervalTimer timer5;// Radi samo za Teensy
-IntervalTimer timer6;// Radi samo za Teensy
-IntervalTimer timer7;// Radi samo za Teensy
-#endif
-#endif
-
-					 // Interrupt functions
-void UltrasonicAsyncPWM::_echo_isr0() { _echo_isr(0); }
-void UltrasonicAsyncPWM::_echo_isr1() { _echo_isr(1); }
-void UltrasonicAsyncPWM::_echo_isr2() { _echo_isr(2); }
-void UltrasonicAsyncPWM::_echo_isr3() { _echo_isr(3); }
-void UltrasonicAsyncPWM::_echo_isr4() { _echo_isr(4); }
-void UltrasonicAsyncPWM::_echo_isr5() { _echo_isr(5); }
-void UltrasonicAsyncPWM::_echo_isr6() { _echo_isr(6); }
-void UltrasonicAsyncPWM::_echo_isr7() { _echo_isr(7); }
-#ifdef USE_TIMER_FOR_TRIGGER
-#if TRIGGER_PULSE_WIDTH != 0
-void UltrasonicAsyncPWM::_timer0() {
-	UltrasonicAsyncPWM* _this = UltrasonicAsyncPWM::instance();
-	digitalWrite(_this->_trigger[0], LOW);
-	timer0.end();
-}
-void UltrasonicAsyncPWM::_timer1() {
-	UltrasonicAsyncPWM* _this = UltrasonicAsyncPWM::instance();
-	digitalWrite(_this->_trigger[1], LOW);
-	timer1.end();
-}
-void UltrasonicAsyncPWM::_timer2() {
-	UltrasonicAsyncPWM* _this = UltrasonicAsyncPWM::instance();
-	digitalWrite(_this->_trigger[2], LOW);
-	timer2.end();
-}
-void UltrasonicAsyncPWM::_timer3() {
-	UltrasonicAsyncPWM* _this = UltrasonicAsyncPWM::instance();
-	digitalWrite(_this->_trigger[3], LOW);
-	timer3.end();
-}
-void UltrasonicAsyncPWM::_timer4() {
-	UltrasonicAsyncPWM* _this = UltrasonicAsyncPWM::instance();
-	digitalWrite(_this->_trigger[4], LOW);
-	timer4.end();
-}
-void UltrasonicAsyncPWM::_timer5() {
-	UltrasonicAsyncPWM* _this = UltrasonicAsyncPWM::instance();
-	digitalWrite(_this->_trigger[5], LOW);
-	timer5.end();
-}
-void UltrasonicAsyncPWM::_timer6() {
-	UltrasonicAsyncPWM* _this = UltrasonicAsyncPWM::instance();
-	digitalWrite(_this->_trigger[6], LOW);
-	timer6.end();
-}
-void UltrasonicAsyncPWM::_timer7() {
-	UltrasonicAsyncPWM* _this = UltrasonicAsyncPWM::instance();
-	digitalWrite(_this->_trigger[7], LOW);
-	timer7.end();
-}
-#endif
-#endif
-
 /** Add a sensor
 @param trigger - Trigger pin.
 @param echo - Pin for reading echno signal. Not necessary a PWM pin, but it must support interrupts.
@@ -88,54 +23,150 @@ void UltrasonicAsyncPWM::_timer7() {
 void UltrasonicAsyncPWM::add(uint8_t trigger, uint8_t echo) {
 	if (nextFree >= MAX_ULTRASONIC_ASYNC_PWM)
 		error("Too many sensors. Increase MAX_ULTRASONIC_ASYNC_PWM.");
-	if (nextFree > 8)
-		error("Not enough interrupt handlers.");
 
 	_trigger[nextFree] = trigger;
 	_echo[nextFree] = echo;
 	_finished[nextFree] = false;
+	_distance[nextFree] = 0;
+	_readingMicros[nextFree] = 0;
+
+	// By default, a new sensor interferes with all the existing ones
+	_crosstalk[nextFree] = 0;
+	for (uint8_t i = 0; i < nextFree; i++) {
+		_crosstalk[i] |= 1 << nextFree;
+		_crosstalk[nextFree] |= 1 << i;
+	}
+	_groupsDirty = true;
+
 	pinMode(trigger, OUTPUT);
 	digitalWrite(trigger, PULSE_IS_HIGH ? LOW : HIGH);
 	pinMode(echo, INPUT);
-	switch (nextFree) {
-	case 0: attachInterrupt(digitalPinToInterrupt(echo), _echo_isr0, CHANGE); break;
-	case 1: attachInterrupt(digitalPinToInterrupt(echo), _echo_isr1, CHANGE); break;
-	case 2: attachInterrupt(digitalPinToInterrupt(echo), _echo_isr2, CHANGE); break;
-	case 3: attachInterrupt(digitalPinToInterrupt(echo), _echo_isr3, CHANGE); break;
-	case 4: attachInterrupt(digitalPinToInterrupt(echo), _echo_isr4, CHANGE); break;
-	case 5: attachInterrupt(digitalPinToInterrupt(echo), _echo_isr5, CHANGE); break;
-	case 6: attachInterrupt(digitalPinToInterrupt(echo), _echo_isr6, CHANGE); break;
-	case 7: attachInterrupt(digitalPinToInterrupt(echo), _echo_isr7, CHANGE); break;
-	}
+	attachInterrupt(digitalPinToInterrupt(echo), _echoIsr[nextFree], CHANGE);
 	nextFree++;
 }
 
+/** Declares that 2 sensors disturb each other so that they must not be fired together. By default all the sensors interfere.
+@param sensorNumber1 - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
+@param sensorNumber2 - Second sensor.
+@param interfere - if false, sensors can be fired together.
+*/
+void UltrasonicAsyncPWM::crosstalkSet(uint8_t sensorNumber1, uint8_t sensorNumber2, bool interfere) {
+	if (sensorNumber1 >= nextFree || sensorNumber2 >= nextFree || sensorNumber1 == sensorNumber2)
+		error("Out of range");
+	if (interfere) {
+		_crosstalk[sensorNumber1] |= 1 << sensorNumber2;
+		_crosstalk[sensorNumber2] |= 1 << sensorNumber1;
+	}
+	else {
+		_crosstalk[sensorNumber1] &= ~(1 << sensorNumber2);
+		_crosstalk[sensorNumber2] &= ~(1 << sensorNumber1);
+	}
+	_groupsDirty = true;
+}
+
 /** Distance in cm
 @param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
-@return - Distance.
+@return - Distance. 0 if no echo before ULTRASONIC_TIMEOUT_MICROS.
 */
 float UltrasonicAsyncPWM::distance(uint8_t sensorNumber) {
-	return (_impulsEnd[sensorNumber] - _impulsStart[sensorNumber]) / 58.0;
+	edgesProcess();
+	return _distance[sensorNumber];
 }
 
-/** Interrupt function
+/** Processes all the edges stored by interrupts.
+*/
+void UltrasonicAsyncPWM::edgesProcess() {
+	while (_edgeTail != _edgeHead) {
+		UltrasonicEdge* edge = &_edge[_edgeTail];
+		uint8_t bit = 1 << edge->sensorNumber;
+		if (edge->rising) {
+			_impulsStart[edge->sensorNumber] = edge->micros;
+			_highDetected |= bit;
+		}
+		else if (_highDetected & bit) {
+			_highDetected &= ~bit;
+			_distance[edge->sensorNumber] = (edge->micros - _impulsStart[edge->sensorNumber]) / 58.0;
+			_readingMicros[edge->sensorNumber] = edge->micros;
+			_finished[edge->sensorNumber] = true;
+			if (_pending & bit) {
+				_pending &= ~bit;
+				if (_pending == 0)
+					_guardMicros = edge->micros;
+			}
+		}
+		_edgeTail = (_edgeTail + 1) & (ULTRASONIC_EDGE_BUFFER_SIZE - 1);
+	}
+}
+
+/** Processes an edge in an interrupt. Only stores it, all the calculations are done in refresh().
+Interrupts of the same priority do not nest, so there is a single writer and no lock is needed.
 @param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
 */
-void UltrasonicAsyncPWM::_echo_isr(uint8_t sensorNumber) {
-	UltrasonicAsyncPWM* _this = UltrasonicAsyncPWM::instance();
-
-	switch (digitalRead(_this->_echo[sensorNumber])) {
-		case PULSE_IS_HIGH ? HIGH : LOW :
-			_this->_impulsStart[sensorNumber] = micros();
-			_this->_highDetected[sensorNumber] = true;
-			break;
-			case PULSE_IS_HIGH ? LOW : HIGH :
-				if (_this->_highDetected[sensorNumber]) {
-					_this->_impulsEnd[sensorNumber] = micros();
-					_this->_finished[sensorNumber] = true;
-				}
-									   break;
+void IRAM_ATTR UltrasonicAsyncPWM::_edgeStore(uint8_t sensorNumber) {
+	uint32_t now = micros();
+	uint8_t head = _edgeHead;
+	uint8_t next = (head + 1) & (ULTRASONIC_EDGE_BUFFER_SIZE - 1);
+	if (next == _edgeTail) {
+		_edgesLost++;
+		return;
+	}
+	_edge[head].micros = now;
+	_edge[head].sensorNumber = sensorNumber;
+	_edge[head].rising = digitalRead(_echo[sensorNumber]) == (PULSE_IS_HIGH ? HIGH : LOW);
+	_edgeHead = next;
+}
+
+/** Trigger pulse for all the sensors of a group at once.
+@param mask - bitwise, sensors to trigger.
+*/
+void UltrasonicAsyncPWM::fire(uint8_t mask) {
+	edgesProcess();
+	for (uint8_t i = 0; i < nextFree; i++)
+		if (mask & (1 << i)) {
+			_finished[i] = false;
+			digitalWrite(_trigger[i], PULSE_IS_HIGH ? HIGH : LOW);
+		}
+	_highDetected &= ~mask;
+	delayMicroseconds(TRIGGER_PULSE_WIDTH_MICROS);
+	for (uint8_t i = 0; i < nextFree; i++)
+		if (mask & (1 << i))
+			digitalWrite(_trigger[i], PULSE_IS_HIGH ? LOW : HIGH);
+	_firedMicros = micros();
+	_pending = mask;
+}
+
+/** Number of groups fired in turn. Sensors in a group are fired together.
+@return - count
+*/
+uint8_t UltrasonicAsyncPWM::groupCount() {
+	if (_groupsDirty)
+		groupsBuild();
+	return _groupCount;
+}
+
+/** Splits sensors into groups so that no 2 interfering sensors are in the same group. Greedy: each sensor goes to the first group
+without a conflict, which is optimal for the usual cases (neighbours interfere, opposite sides do not).
+*/
+void UltrasonicAsyncPWM::groupsBuild() {
+	_groupCount = 0;
+	for (uint8_t i = 0; i < nextFree; i++) {
+		uint8_t groupNumber = 0;
+		while (groupNumber < _groupCount && (_group[groupNumber] & _crosstalk[i]) != 0)
+			groupNumber++;
+		if (groupNumber == _groupCount)
+			_group[_groupCount++] = 0;
+		_group[groupNumber] |= 1 << i;
 	}
+	_groupCurrent = 0;
+	_groupsDirty = false;
+}
+
+/** Is the result ready?
+@param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
+*/
+bool UltrasonicAsyncPWM::isFinished(uint8_t sensorNumber) {
+	edgesProcess();
+	return _finished[sensorNumber];
 }
 
 /** Print to all serial ports
@@ -155,54 +186,62 @@ void UltrasonicAsyncPWM::print(String message, bool eol) {
 	}
 }
 
+/** Call as often as possible, in every loop pass. Processes echoes and fires the next group when the current one has finished.
+It never waits, except for the trigger pulse.
+*/
+void UltrasonicAsyncPWM::refresh() {
+	edgesProcess();
+	if (!_running || nextFree == 0)
+		return;
+	if (_groupsDirty)
+		groupsBuild();
+
+	uint32_t now = micros();
+	if (_pending != 0) {
+		if (now - _firedMicros < ULTRASONIC_TIMEOUT_MICROS)
+			return;
+		for (uint8_t i = 0; i < nextFree; i++) // No echo, nothing in range
+			if (_pending & (1 << i)) {
+				_distance[i] = 0;
+				_readingMicros[i] = now;
+				_finished[i] = true;
+			}
+		_pending = 0;
+		_guardMicros = now;
+	}
+
+	if (now - _guardMicros < ULTRASONIC_GUARD_MICROS)
+		return;
+
+	fire(_group[_groupCurrent]);
+	if (++_groupCurrent >= _groupCount)
+		_groupCurrent = 0;
+}
+
 /** Trigger a pulse.
 @param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
 */
 void UltrasonicAsyncPWM::start(uint8_t sensorNumber) {
-	_finished[sensorNumber] = false;
-	_highDetected[sensorNumber] = false;
-	digitalWrite(_trigger[sensorNumber], PULSE_IS_HIGH ? HIGH : LOW);
-	bool isTimer = false;
-#ifdef USE_TIMER_FOR_TRIGGER
-#if TRIGGER_PULSE_WIDTH != 0
-	switch (sensorNumber) {
-	case 0: timer0.begin(_timer0, 10000); break;
-	case 1: timer1.begin(_timer1, 10000); break;
-	case 2: timer2.begin(_timer2, 10000); break;
-	case 3: timer3.begin(_timer3, 10000); break;
-	case 4: timer4.begin(_timer4, 10000); break;
-	case 5: timer5.begin(_timer5, 10000); break;
-	case 6: timer6.begin(_timer6, 10000); break;
-	case 7: timer7.begin(_timer7, 10000); break;
-	} //10 msec
-	isTimer = true;
-#endif
-#endif
-	if (!isTimer) {
-		delayMicroseconds(TRIGGER_PULSE_WIDTH);
-		digitalWrite(_trigger[sensorNumber], PULSE_IS_HIGH ? LOW : HIGH);
-	}
+	fire(1 << sensorNumber);
 }
 
 /**Test
 @param breakWhen - A function returning bool, without arguments. If it returns true, the test() will be interrupted.
 */
 void UltrasonicAsyncPWM::test(BreakCondition breakWhen) {
+	print((String)groupCount() + " group(s)", true);
+	startContinuous();
+	uint32_t lastMs = millis();
 	while (breakWhen == 0 || !(*breakWhen)()) {
-		for (int i = 0; i < nextFree; i++) {
-			start(i); // Trigger a pulse
-			uint32_t startMs = millis();
-			bool ok = true;
-			while (!isFinished(i)) // Wait for the result. If more than 100 ms, signal timeout.
-				if (millis() - startMs > 100) {
-					print("Timeout for sensor " + (String)i + " ");
-					ok = false;
-					break;
-				}
-			if (ok) // If ok, print the result
+		refresh();
+		if (millis() - lastMs > 200) {
+			for (int i = 0; i < nextFree; i++)
 				print((String)distance(i) + "cm ");
+			if (_edgesLost != 0)
+				print("Lost: " + (String)_edgesLost);
+			print("", true);
+			lastMs = millis();
 		}
-		print("", true);
-		delay(200);
 	}
+	stop();
 }
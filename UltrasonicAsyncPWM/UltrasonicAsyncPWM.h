@@ -3,54 +3,86 @@
 
 /**
 Purpose: using PWM ultrasonic sensors without delays (polling), that means without Arduino pulseIn() function.
+Echo edges are timestamped in interrupts and stored in a lock-free buffer. Sensors that do not disturb each other are fired together.
 @author MRMS team, a part copied from internet
-@version 0.2 2018-02-19
+@version 0.3 2026-10-19
 Licence: You can use this code any way you like.
 */
 
-#define MAX_ULTRASONIC_ASYNC_PWM 4 // Maximum number of sensors.
+#define MAX_ULTRASONIC_ASYNC_PWM 8 // Maximum number of sensors.
 #define PULSE_IS_HIGH true // Usually true (pulse is a logic high voltage, like 3.3V, otherwise 0V), but for some sensors is false, like DFRobot URM37.
-#define TRIGGER_PULSE_WIDTH 100 // Trigger pulse's width in ms. It could be 100 (ms) but for some sensors 0 is enough.
-//#define USE_TIMER_FOR_TRIGGER // If this line is not commented, it will work completely asynchronous, but it consumes timers (and you may need them for 
-						//other purposes). Valid only for Teensy. If the TRIGGER_PULSE_WIDTH is 0, You will not need it.
+#define TRIGGER_PULSE_WIDTH_MICROS 10 // Trigger pulse's width in microseconds. 10 is enough for HC-SR04 and most other sensors.
+#define ULTRASONIC_EDGE_BUFFER_SIZE 32 // Echo edges buffer. Must be a power of 2.
+#define ULTRASONIC_TIMEOUT_MICROS 30000 // No echo after this time means no obstacle in range (about 5 m).
+#define ULTRASONIC_GUARD_MICROS 2000 // Pause after a group finished, to let the remaining echoes fade out.
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
 
 typedef bool(*BreakCondition)();
 
+/** An edge on an echo pin, recorded in an interrupt.
+*/
+struct UltrasonicEdge {
+	uint32_t micros; // Time of the edge.
+	uint8_t sensorNumber;
+	bool rising; // Start of the echo pulse, otherwise its end.
+};
+
 class UltrasonicAsyncPWM
 {
-	static void _echo_isr(uint8_t sensorNumber); // Interrupt functions
-	static void _echo_isr0();
-	static void _echo_isr1();
-	static void _echo_isr2();
-	static void _echo_isr3();
-	static void _echo_isr4();
-	static void _echo_isr5();
-	static void _echo_isr6();
-	static void _echo_isr7();
-	static void _timer0();
-	static void _timer1();
-	static void _timer2();
-	static void _timer3();
-	static void _timer4();
-	static void _timer5();
-	static void _timer6();
-	static void _timer7();
+	template<uint8_t sensorNumber> static void IRAM_ATTR _echo_isr() { _instance->_edgeStore(sensorNumber); } // Interrupt functions
+	static void (*const _echoIsr[MAX_ULTRASONIC_ASYNC_PWM])();
+
+	uint8_t _crosstalk[MAX_ULTRASONIC_ASYNC_PWM]; // Bitwise, sensors that interfere with this one.
+	float _distance[MAX_ULTRASONIC_ASYNC_PWM]; // Last measured distance in cm.
 	uint8_t _echo[MAX_ULTRASONIC_ASYNC_PWM]; // PWM pins, read pulses' widths
-	volatile bool _finished[MAX_ULTRASONIC_ASYNC_PWM]; // Results are ready and can be read
-	volatile bool _highDetected[MAX_ULTRASONIC_ASYNC_PWM]; // Front edge of impulses arrived.
-	volatile uint32_t _impulsEnd[MAX_ULTRASONIC_ASYNC_PWM]; // Times when resulting signals were read from _echo pins.
-	volatile uint32_t _impulsStart[MAX_ULTRASONIC_ASYNC_PWM]; // Times when resulting signals reading from _echo pins was started.
+	UltrasonicEdge _edge[ULTRASONIC_EDGE_BUFFER_SIZE]; // Ring buffer. Written only in interrupts, read only by refresh().
+	volatile uint8_t _edgeHead = 0; // Next free slot, changed only in interrupts.
+	volatile uint8_t _edgeTail = 0; // Next unread slot, changed only by refresh().
+	volatile uint16_t _edgesLost = 0; // Buffer overflows.
+	bool _finished[MAX_ULTRASONIC_ASYNC_PWM]; // Results are ready and can be read
+	uint32_t _firedMicros = 0; // Current group's trigger time.
+	uint8_t _group[MAX_ULTRASONIC_ASYNC_PWM]; // Bitwise, sensors fired together.
+	uint8_t _groupCount = 0;
+	uint8_t _groupCurrent = 0;
+	bool _groupsDirty = true; // Crosstalk changed, groups must be rebuilt.
+	uint32_t _guardMicros = 0; // Set when the current group completed.
+	uint8_t _highDetected = 0; // Bitwise, front edge of impulses arrived.
+	uint8_t _pending = 0; // Bitwise, sensors of the current group still waiting for echo.
+	uint32_t _impulsStart[MAX_ULTRASONIC_ASYNC_PWM]; // Times when resulting signals reading from _echo pins was started.
 	static UltrasonicAsyncPWM* _instance; //Singleton
+	uint32_t _readingMicros[MAX_ULTRASONIC_ASYNC_PWM]; // Time of the echo's end for the last distance.
+	bool _running = false;
 	uint8_t _trigger[MAX_ULTRASONIC_ASYNC_PWM]; // Trigger pins.
 	int nextFree;
 	HardwareSerial * serial; //Additional serial port
 
+	/** Processes an edge in an interrupt. Only stores it, all the calculations are done in refresh().
+	@param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
+	*/
+	void IRAM_ATTR _edgeStore(uint8_t sensorNumber);
+
+	/** Processes all the edges stored by interrupts.
+	*/
+	void edgesProcess();
+
+	/** Trigger pulse for all the sensors of a group at once.
+	@param mask - bitwise, sensors to trigger.
+	*/
+	void fire(uint8_t mask);
+
+	/** Splits sensors into groups so that no 2 interfering sensors are in the same group.
+	*/
+	void groupsBuild();
+
 	/** Print to all serial ports
 	@param message
 	@param eol - end of line
 	*/
 	void print(String message, bool eol = false);
-	
+
 public:
 	/**Constructor
 	@param hardwareSerial - Serial, Serial1, Serial2,... - an optional serial port, for example for Bluetooth communication
@@ -63,27 +95,63 @@ public:
 	*/
 	void add(uint8_t trigger, uint8_t echo);
 
+	/** Declares that 2 sensors disturb each other so that they must not be fired together. By default all the sensors interfere.
+	@param sensorNumber1 - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
+	@param sensorNumber2 - Second sensor.
+	@param interfere - if false, sensors can be fired together.
+	*/
+	void crosstalkSet(uint8_t sensorNumber1, uint8_t sensorNumber2, bool interfere = true);
+
 	/** Distance in cm
 	@param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
-	@return - Distance.
+	@return - Distance. 0 if no echo before ULTRASONIC_TIMEOUT_MICROS.
 	*/
 	float distance(uint8_t sensorNumber);
 
+	/** Number of lost edges because refresh() was not called often enough.
+	@return - count
+	*/
+	uint16_t edgesLost() { return _edgesLost; }
+
+	/** Number of groups fired in turn. Sensors in a group are fired together.
+	@return - count
+	*/
+	uint8_t groupCount();
+
 	/** Is the result ready?
 	@param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
 	*/
-	bool isFinished(uint8_t sensorNumber) { return _finished[sensorNumber]; }
+	bool isFinished(uint8_t sensorNumber);
 
 	/** A single object. This is not a user function.
 	@return - First object of this class.
 	*/
 	static UltrasonicAsyncPWM* instance() { return _instance; }
 
+	/** Time of the last measurement
+	@param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
+	@return - micros() when the echo ended.
+	*/
+	uint32_t readingMicros(uint8_t sensorNumber) { return _readingMicros[sensorNumber]; }
+
+	/** Call as often as possible, in every loop pass. Processes echoes and fires the next group when the current one has finished.
+	It never waits, except for the trigger pulse.
+	*/
+	void refresh();
+
 	/** Trigger a pulse.
 	@param sensorNumber - Sensor's index. Function add() assigns 0 to first sensor, 1 to second, etc.
 	*/
 	void start(uint8_t sensorNumber);
 
+	/** Starts firing all the sensors, group after group, in refresh().
+	*/
+	void startContinuous() { _running = true; _pending = 0; }
+
+	/** Stops continuous firing.
+	*/
+	void stop() { _running = false; }
+
 	/**Test
 	@param breakWhen - A function returning bool, without arguments. If it returns true, the test() will be interrupted.
 	*/
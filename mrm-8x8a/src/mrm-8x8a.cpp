@@ -1,6 +1,105 @@
 #include "mrm-8x8a.h"
 #include <mrm-robot.h>
 
+// 5x7 font, ASCII 32 - 126. 5 columns for each character, bit 0 is the top row.
+static const uint8_t font5x7[][5] = {
+	{ 0x00, 0x00, 0x00, 0x00, 0x00 }, //  
+	{ 0x00, 0x00, 0x5F, 0x00, 0x00 }, // !
+	{ 0x00, 0x07, 0x00, 0x07, 0x00 }, // "
+	{ 0x14, 0x7F, 0x14, 0x7F, 0x14 }, // #
+	{ 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, // $
+	{ 0x23, 0x13, 0x08, 0x64, 0x62 }, // %
+	{ 0x36, 0x49, 0x55, 0x22, 0x50 }, // &
+	{ 0x00, 0x05, 0x03, 0x00, 0x00 }, // '
+	{ 0x00, 0x1C, 0x22, 0x41, 0x00 }, // (
+	{ 0x00, 0x41, 0x22, 0x1C, 0x00 }, // )
+	{ 0x14, 0x08, 0x3E, 0x08, 0x14 }, // *
+	{ 0x08, 0x08, 0x3E, 0x08, 0x08 }, // +
+	{ 0x00, 0x50, 0x30, 0x00, 0x00 }, // ,
+	{ 0x08, 0x08, 0x08, 0x08, 0x08 }, // -
+	{ 0x00, 0x60, 0x60, 0x00, 0x00 }, // .
+	{ 0x20, 0x10, 0x08, 0x04, 0x02 }, // /
+	{ 0x3E, 0x51, 0x49, 0x45, 0x3E }, // 0
+	{ 0x00, 0x42, 0x7F, 0x40, 0x00 }, // 1
+	{ 0x42, 0x61, 0x51, 0x49, 0x46 }, // 2
+	{ 0x21, 0x41, 0x45, 0x4B, 0x31 }, // 3
+	{ 0x18, 0x14, 0x12, 0x7F, 0x10 }, // 4
+	{ 0x27, 0x45, 0x45, 0x45, 0x39 }, // 5
+	{ 0x3C, 0x4A, 0x49, 0x49, 0x30 }, // 6
+	{ 0x01, 0x71, 0x09, 0x05, 0x03 }, // 7
+	{ 0x36, 0x49, 0x49, 0x49, 0x36 }, // 8
+	{ 0x06, 0x49, 0x49, 0x29, 0x1E }, // 9
+	{ 0x00, 0x36, 0x36, 0x00, 0x00 }, // :
+	{ 0x00, 0x56, 0x36, 0x00, 0x00 }, // ;
+	{ 0x08, 0x14, 0x22, 0x41, 0x00 }, // <
+	{ 0x14, 0x14, 0x14, 0x14, 0x14 }, // =
+	{ 0x00, 0x41, 0x22, 0x14, 0x08 }, // >
+	{ 0x02, 0x01, 0x51, 0x09, 0x06 }, // ?
+	{ 0x32, 0x49, 0x79, 0x41, 0x3E }, // @
+	{ 0x7E, 0x11, 0x11, 0x11, 0x7E }, // A
+	{ 0x7F, 0x49, 0x49, 0x49, 0x36 }, // B
+	{ 0x3E, 0x41, 0x41, 0x41, 0x22 }, // C
+	{ 0x7F, 0x41, 0x41, 0x22, 0x1C }, // D
+	{ 0x7F, 0x49, 0x49, 0x49, 0x41 }, // E
+	{ 0x7F, 0x09, 0x09, 0x09, 0x01 }, // F
+	{ 0x3E, 0x41, 0x49, 0x49, 0x7A }, // G
+	{ 0x7F, 0x08, 0x08, 0x08, 0x7F }, // H
+	{ 0x00, 0x41, 0x7F, 0x41, 0x00 }, // I
+	{ 0x20, 0x40, 0x41, 0x3F, 0x01 }, // J
+	{ 0x7F, 0x08, 0x14, 0x22, 0x41 }, // K
+	{ 0x7F, 0x40, 0x40, 0x40, 0x40 }, // L
+	{ 0x7F, 0x02, 0x0C, 0x02, 0x7F }, // M
+	{ 0x7F, 0x04, 0x08, 0x10, 0x7F }, // N
+	{ 0x3E, 0x41, 0x41, 0x41, 0x3E }, // O
+	{ 0x7F, 0x09, 0x09, 0x09, 0x06 }, // P
+	{ 0x3E, 0x41, 0x51, 0x21, 0x5E }, // Q
+	{ 0x7F, 0x09, 0x19, 0x29, 0x46 }, // R
+	{ 0x46, 0x49, 0x49, 0x49, 0x31 }, // S
+	{ 0x01, 0x01, 0x7F, 0x01, 0x01 }, // T
+	{ 0x3F, 0x40, 0x40, 0x40, 0x3F }, // U
+	{ 0x1F, 0x20, 0x40, 0x20, 0x1F }, // V
+	{ 0x3F, 0x40, 0x38, 0x40, 0x3F }, // W
+	{ 0x63, 0x14, 0x08, 0x14, 0x63 }, // X
+	{ 0x07, 0x08, 0x70, 0x08, 0x07 }, // Y
+	{ 0x61, 0x51, 0x49, 0x45, 0x43 }, // Z
+	{ 0x00, 0x7F, 0x41, 0x41, 0x00 }, // [
+	{ 0x02, 0x04, 0x08, 0x10, 0x20 }, // backslash
+	{ 0x00, 0x41, 0x41, 0x7F, 0x00 }, // ]
+	{ 0x04, 0x02, 0x01, 0x02, 0x04 }, // ^
+	{ 0x40, 0x40, 0x40, 0x40, 0x40 }, // _
+	{ 0x00, 0x01, 0x02, 0x04, 0x00 }, // `
+	{ 0x20, 0x54, 0x54, 0x54, 0x78 }, // a
+	{ 0x7F, 0x48, 0x44, 0x44, 0x38 }, // b
+	{ 0x38, 0x44, 0x44, 0x44, 0x20 }, // c
+	{ 0x38, 0x44, 0x44, 0x48, 0x7F }, // d
+	{ 0x38, 0x54, 0x54, 0x54, 0x18 }, // e
+	{ 0x08, 0x7E, 0x09, 0x01, 0x02 }, // f
+	{ 0x0C, 0x52, 0x52, 0x52, 0x3E }, // g
+	{ 0x7F, 0x08, 0x04, 0x04, 0x78 }, // h
+	{ 0x00, 0x44, 0x7D, 0x40, 0x00 }, // i
+	{ 0x20, 0x40, 0x44, 0x3D, 0x00 }, // j
+	{ 0x7F, 0x10, 0x28, 0x44, 0x00 }, // k
+	{ 0x00, 0x41, 0x7F, 0x40, 0x00 }, // l
+	{ 0x7C, 0x04, 0x18, 0x04, 0x78 }, // m
+	{ 0x7C, 0x08, 0x04, 0x04, 0x78 }, // n
+	{ 0x38, 0x44, 0x44, 0x44, 0x38 }, // o
+	{ 0x7C, 0x14, 0x14, 0x14, 0x08 }, // p
+	{ 0x08, 0x14, 0x14, 0x18, 0x7C }, // q
+	{ 0x7C, 0x08, 0x04, 0x04, 0x08 }, // r
+	{ 0x48, 0x54, 0x54, 0x54, 0x20 }, // s
+	{ 0x04, 0x3F, 0x44, 0x40, 0x20 }, // t
+	{ 0x3C, 0x40, 0x40, 0x20, 0x7C }, // u
+	{ 0x1C, 0x20, 0x40, 0x20, 0x1C }, // v
+	{ 0x3C, 0x40, 0x30, 0x40, 0x3C }, // w
+	{ 0x44, 0x28, 0x10, 0x28, 0x44 }, // x
+	{ 0x0C, 0x50, 0x50, 0x50, 0x3C }, // y
+	{ 0x44, 0x64, 0x54, 0x4C, 0x44 }, // z
+	{ 0x00, 0x08, 0x36, 0x41, 0x00 }, // {
+	{ 0x00, 0x00, 0x7F, 0x00, 0x00 }, // |
+	{ 0x00, 0x41, 0x36, 0x08, 0x00 }, // }
+	{ 0x08, 0x04, 0x08, 0x10, 0x08 }, // ~
+};
+
 /** Constructor
 @param robot - robot containing this board
 @param esp32CANBusSingleton - a single instance of CAN Bus common library for all CAN Bus peripherals.
@@ -13,6 +112,7 @@ Mrm_8x8a::Mrm_8x8a(Robot* robot, uint8_t maxNumberOfBoards) : SensorBoard(robot,
 	lastOn = new std::vector<bool[MRM_8x8A_SWITCHES_COUNT]>(maxNumberOfBoards);
 	on = new std::vector<bool[MRM_8x8A_SWITCHES_COUNT]>(maxNumberOfBoards);
 	offOnAction = new std::vector<ActionBase* [MRM_8x8A_SWITCHES_COUNT]>(maxNumberOfBoards);
+	scroll = new std::vector<LED8x8Scroll>(maxNumberOfBoards);
 	//mrm_can_bus = esp32CANBusSingleton;
 	nextFree = 0;
 }
@@ -116,21 +216,40 @@ void Mrm_8x8a::bitmapDisplay(uint8_t bitmapId, uint8_t deviceNumber){
 */
 void Mrm_8x8a::bitmapCustomDisplay(uint8_t red[], uint8_t green[], uint8_t deviceNumber) {
 	alive(deviceNumber, true);
-	canData[0] = COMMAND_8X8_BITMAP_DISPLAY_PART1;
+#if SEGMENTED_TRANSFER
+	uint8_t bitmap[16];
+	memcpy(bitmap, green, 8);
+	memcpy(bitmap + 8, red, 8);
+	if (segmentedSend(COMMAND_8X8_BITMAP_DISPLAY_PART1, bitmap, 16, deviceNumber)) {
+		(*displayedTypeLast)[deviceNumber] = LED8x8Type::LED_8X8_CUSTOM;
+		return;
+	}
+#endif
+	bitmapFramesSend(red, green, deviceNumber);
+}
+
+/** Sends custom bitmap in 3 single frames, without checking if the display is alive and without waiting
+@param red - 8-byte array for red
+@param green - 8-byte array for green
+@param deviceNumber - Displays's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+*/
+void Mrm_8x8a::bitmapFramesSend(uint8_t red[], uint8_t green[], uint8_t deviceNumber) {
+	uint8_t frame[8]; // Not canData, scrolling sends from the background.
+	frame[0] = COMMAND_8X8_BITMAP_DISPLAY_PART1;
 	for (uint8_t i = 0; i < 7; i++) 
-		canData[i + 1] = green[i];
-	robotContainer->mrm_can_bus->messageSend((*idIn)[deviceNumber], 8, canData);
+		frame[i + 1] = green[i];
+	robotContainer->mrm_can_bus->messageSend((*idIn)[deviceNumber], 8, frame);
 
-	canData[0] = COMMAND_8X8_BITMAP_DISPLAY_PART2;
-	canData[1] = green[7];
+	frame[0] = COMMAND_8X8_BITMAP_DISPLAY_PART2;
+	frame[1] = green[7];
 	for (uint8_t i = 0; i < 6; i++) 
-		canData[i + 2] = red[i];
-	robotContainer->mrm_can_bus->messageSend((*idIn)[deviceNumber], 8, canData);
+		frame[i + 2] = red[i];
+	robotContainer->mrm_can_bus->messageSend((*idIn)[deviceNumber], 8, frame);
 
-	canData[0] = COMMAND_8X8_BITMAP_DISPLAY_PART3;
+	frame[0] = COMMAND_8X8_BITMAP_DISPLAY_PART3;
 	for (uint8_t i = 0; i < 2; i++) 
-		canData[i + 1] = red[i + 6];
-	robotContainer->mrm_can_bus->messageSend((*idIn)[deviceNumber], 3, canData);
+		frame[i + 1] = red[i + 6];
+	robotContainer->mrm_can_bus->messageSend((*idIn)[deviceNumber], 3, frame);
 
 	(*displayedTypeLast)[deviceNumber] = LED8x8Type::LED_8X8_CUSTOM;
 }
@@ -143,6 +262,14 @@ void Mrm_8x8a::bitmapCustomDisplay(uint8_t red[], uint8_t green[], uint8_t devic
 */
 void Mrm_8x8a::bitmapCustomStore(uint8_t red[], uint8_t green[], uint8_t address, uint8_t deviceNumber) {
 	alive(deviceNumber, true);
+#if SEGMENTED_TRANSFER
+	uint8_t bitmap[17];
+	memcpy(bitmap, green, 8);
+	memcpy(bitmap + 8, red, 8);
+	bitmap[16] = address;
+	if (segmentedSend(COMMAND_8X8_BITMAP_STORE_PART1, bitmap, 17, deviceNumber))
+		return;
+#endif
 
 	canData[0] = COMMAND_8X8_BITMAP_STORE_PART1;
 	for (uint8_t i = 0; i < 7; i++)
@@ -180,9 +307,10 @@ void Mrm_8x8a::bitmapCustomStoredDisplay(uint8_t address, uint8_t deviceNumber)
 /** Read CAN Bus message into local variables
 @param canId - CAN Bus id
 @param data - 8 bytes from CAN Bus message.
+@param length - number of data bytes
 @return - true if canId for this class
 */
-bool Mrm_8x8a::messageDecode(uint32_t canId, uint8_t data[8]) {
+bool Mrm_8x8a::messageDecode(uint32_t canId, uint8_t data[8], uint8_t length) {
 	for (uint8_t deviceNumber = 0; deviceNumber < nextFree; deviceNumber++)
 		if (isForMe(canId, deviceNumber)) {
 			if (!messageDecodeCommon(canId, data, deviceNumber)) {
@@ -196,9 +324,8 @@ bool Mrm_8x8a::messageDecode(uint32_t canId, uint8_t data[8]) {
 					}
 					(*on)[deviceNumber][switchNumber] = data[1] & 1;
 					if (data[0] == COMMAND_8X8_SWITCH_ON_REQUEST_NOTIFICATION) {
-						canData[0] = COMMAND_NOTIFICATION;
-						canData[1] = switchNumber; //todo - deviceNumber not taken into account
-						robotContainer->mrm_can_bus->messageSend((*idIn)[deviceNumber], 2, canData);
+						uint8_t frame[2] = { COMMAND_NOTIFICATION, switchNumber }; // Not canData, decoding may run in the CAN Bus task.
+						robotContainer->mrm_can_bus->messageSend((*idIn)[deviceNumber], 2, frame); //todo - deviceNumber not taken into account
 					}
 					(*_lastReadingMs)[deviceNumber] = millis();
 				}
@@ -281,6 +408,83 @@ void Mrm_8x8a::rotationSet(enum LED8x8Rotation rotation, uint8_t deviceNumber) {
 	robotContainer->mrm_can_bus->messageSend((*idIn)[deviceNumber], 2, canData);
 }
 
+/** Sends the current scroll frame, if different from the last one
+@param deviceNumber - Displays's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+*/
+void Mrm_8x8a::scrollFrameSend(uint8_t deviceNumber) {
+	LED8x8Scroll* s = &(*scroll)[deviceNumber];
+	uint8_t bitmap[8] = { 0, 0, 0, 0, 0, 0, 0, 0 }; // Row bytes, bit 7 is the leftmost column.
+	for (int8_t column = 0; column < 8; column++) {
+		int16_t i = column - s->x;
+		if (i >= 0 && i < s->count)
+			for (uint8_t row = 0; row < 8; row++)
+				if (s->columns[i] & (1 << row))
+					bitmap[row] |= 0x80 >> column;
+	}
+	if (memcmp(bitmap, s->lastBitmap, 8) == 0 && (*displayedTypeLast)[deviceNumber] == LED8x8Type::LED_8X8_CUSTOM)
+		return; // Blank space or repeated columns, nothing to send.
+	memcpy(s->lastBitmap, bitmap, 8);
+	uint8_t empty[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	bitmapFramesSend(s->red ? bitmap : empty, s->green ? bitmap : empty, deviceNumber); // Not segmented, it would wait for flow control.
+}
+
+/** Advances scrolling texts. Call as often as possible, Robot does it in noLoopWithoutThis(). It never waits. Stops if the display is dead.
+*/
+void Mrm_8x8a::scrollRefresh() {
+	for (uint8_t deviceNumber = 0; deviceNumber < nextFree; deviceNumber++) {
+		LED8x8Scroll* s = &(*scroll)[deviceNumber];
+		if (!s->active)
+			continue;
+		if (!alive(deviceNumber)) { // No scan here, it would block. Display dead or removed.
+			s->active = false;
+			continue;
+		}
+		uint32_t elapsedMs = millis() - s->frameStartMs;
+		if (elapsedMs < s->frameMs)
+			continue;
+		uint16_t frames = elapsedMs / s->frameMs; // If loop was late, skip frames so that the speed does not depend on loop's.
+		s->frameStartMs += frames * s->frameMs;
+		if (s->x - frames < -(int16_t)s->count)
+			s->active = false;
+		else {
+			s->x -= frames;
+			scrollFrameSend(deviceNumber);
+		}
+	}
+}
+
+/** Starts scrolling a text in background. Text is rasterised here and bitmaps sent, so the display's font is not used.
+@param content - text
+@param frameMs - ms between shifts
+@param green - green pixels
+@param red - red pixels. Both - yellow.
+@param deviceNumber - Displays's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+*/
+void Mrm_8x8a::scrollStart(const char content[], uint16_t frameMs, bool green, bool red, uint8_t deviceNumber) {
+	if (deviceNumber >= nextFree) {
+		strcpy(errorMessage, "mrm-8x8a doesn't exist");
+		return;
+	}
+	if (!alive(deviceNumber, true))
+		return;
+	LED8x8Scroll* s = &(*scroll)[deviceNumber];
+	s->count = 0;
+	for (uint8_t i = 0; content[i] != '\0' && s->count + 6 <= MRM_8X8A_SCROLL_COLUMNS; i++) {
+		uint8_t character = content[i] >= ' ' && content[i] <= '~' ? content[i] : '?';
+		for (uint8_t column = 0; column < 5; column++)
+			s->columns[s->count++] = font5x7[character - ' '][column];
+		s->columns[s->count++] = 0;
+	}
+	s->frameMs = frameMs == 0 ? 1 : frameMs;
+	s->frameStartMs = millis();
+	s->green = green;
+	s->red = red;
+	s->x = 7;
+	memset(s->lastBitmap, 0xFF, 8); // Cannot be the first frame, in which only the last column can be lit, so it will be sent.
+	s->active = true;
+	scrollFrameSend(deviceNumber);
+}
+
 /** If sensor not started, start it and wait for 1. message
 @param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
 @return - started or not
@@ -383,6 +587,11 @@ void Mrm_8x8a::test()
 @param deviceNumber - Displays's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
 */
 void Mrm_8x8a::text(char content[], uint8_t deviceNumber) {
+#if SEGMENTED_TRANSFER
+	uint16_t length = strlen(content) + 1;
+	if (segmentedSend(COMMAND_8X8_TEXT_1, (uint8_t*)content, length < MRM_8X8A_TEXT_LENGTH ? length : MRM_8X8A_TEXT_LENGTH, deviceNumber))
+		return;
+#endif
 	uint8_t message = 0;
 	bool unsent = false;
 	for (uint8_t i = 0; i < MRM_8X8A_TEXT_LENGTH; i++) {
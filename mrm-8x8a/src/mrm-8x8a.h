@@ -7,7 +7,7 @@
 /**
 Purpose: mrm-8x8a interface to CANBus.
 @author MRMS team
-@version 0.3 2019-09-07
+@version 0.4 2026-10-19
 Licence: You can use this code any way you like.
 */
 
@@ -50,12 +50,27 @@ Licence: You can use this code any way you like.
 
 #define MRM_8x8A_SWITCHES_COUNT 4
 #define MRM_8X8A_TEXT_LENGTH 44
+#define MRM_8X8A_SCROLL_COLUMNS (MRM_8X8A_TEXT_LENGTH * 6) // A letter is 5 columns wide, plus a space.
 
 #define MRM_8X8A_INACTIVITY_ALLOWED_MS 30000
 
 enum LED8x8Rotation { LED_8X8_BY_0_DEGREES, LED_8X8_BY_90_DEGREES, LED_8X8_BY_270_DEGREES };
 enum LED8x8Type{LED_8X8_CUSTOM, LED_8X8_STORED, LED_8X8_STORED_CUSTOM };
 
+/** Text being scrolled, rasterised once in scrollStart()
+*/
+struct LED8x8Scroll {
+	bool active = false;
+	uint8_t columns[MRM_8X8A_SCROLL_COLUMNS]; // One byte for each pixel column, bit 0 is the top row.
+	uint16_t count; // Columns used
+	uint16_t frameMs; // Time of 1 pixel shift
+	uint32_t frameStartMs;
+	bool green;
+	uint8_t lastBitmap[8]; // Rows of the last frame sent, not to send the same one again
+	bool red;
+	int16_t x; // Display column of the text's first column
+};
+
 class Mrm_8x8a : public SensorBoard
 {
 	bool _activeCheckIfStarted = true;
@@ -64,6 +79,19 @@ class Mrm_8x8a : public SensorBoard
 	std::vector<bool[MRM_8x8A_SWITCHES_COUNT]>* lastOn;
 	std::vector<bool[MRM_8x8A_SWITCHES_COUNT]>* on;
 	std::vector<ActionBase *[MRM_8x8A_SWITCHES_COUNT]>* offOnAction;
+	std::vector<LED8x8Scroll>* scroll;
+
+	/** Sends custom bitmap in 3 single frames, without checking if the display is alive and without waiting
+	@param red - 8-byte array for red
+	@param green - 8-byte array for green
+	@param deviceNumber - Displays's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	*/
+	void bitmapFramesSend(uint8_t red[], uint8_t green[], uint8_t deviceNumber);
+
+	/** Sends the current scroll frame, if different from the last one
+	@param deviceNumber - Displays's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	*/
+	void scrollFrameSend(uint8_t deviceNumber);
 
 	/** If sensor not started, start it and wait for 1. message
 	@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
@@ -125,9 +153,10 @@ public:
 	/** Read CAN Bus message into local variables
 	@param canId - CAN Bus id
 	@param data - 8 bytes from CAN Bus message.
+	@param length - number of data bytes
 	@return - true if canId for this class
 	*/
-	bool messageDecode(uint32_t canId, uint8_t data[8]);
+	bool messageDecode(uint32_t canId, uint8_t data[8], uint8_t length);
 
 	/** Displays 8-row progress bar. Useful for visual feedback of a long process.
 	@param period - total count (100%)
@@ -143,6 +172,30 @@ public:
 	*/
 	void rotationSet(enum LED8x8Rotation rotation = LED_8X8_BY_0_DEGREES, uint8_t deviceNumber = 0);
 
+	/** Advances scrolling texts. Call as often as possible, Robot does it in noLoopWithoutThis(). It never waits. Stops if the display is dead.
+	*/
+	void scrollRefresh();
+
+	/** Starts scrolling a text in background. Text is rasterised here and bitmaps sent, so the display's font is not used.
+	@param content - text
+	@param frameMs - ms between shifts
+	@param green - green pixels
+	@param red - red pixels. Both - yellow.
+	@param deviceNumber - Displays's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	*/
+	void scrollStart(const char content[], uint16_t frameMs = 60, bool green = true, bool red = false, uint8_t deviceNumber = 0);
+
+	/** Stops scrolling. Display keeps the last frame.
+	@param deviceNumber - Displays's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	*/
+	void scrollStop(uint8_t deviceNumber = 0) { (*scroll)[deviceNumber].active = false; }
+
+	/** Is text still scrolling?
+	@param deviceNumber - Displays's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@return - scrolling or not
+	*/
+	bool scrolling(uint8_t deviceNumber = 0) { return (*scroll)[deviceNumber].active; }
+
 	/** Read switch
 	@param switchNumber - 0 - 3
 	@deviceNumber - Displays's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
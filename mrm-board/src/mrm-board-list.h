@@ -0,0 +1,94 @@
+#pragma once
+#include <tuple>
+#include <type_traits>
+#include "Arduino.h"
+#include <mrm-board.h>
+
+/**
+Purpose: a robot's boards, listed at compile time. Decoding calls each listed board's own messageDecode() directly, not virtually, so that
+the compiler can inline it, and does not need Robot's dispatch table. Only the listed board classes are built. Robot's constructor and its
+actions still build and use all the mrm_* boards, so flash shrinks only when a robot that uses the list does not link them.
+Sample: BoardList<Mrm_lid_can_b2, Mrm_mot4x3_6can, Mrm_ref_can> boards(robot); robot->boardListSet(&boards);
+@author MRMS team
+@version 0.0 2026-10-19
+Licence: You can use this code any way you like.
+*/
+
+/** What Robot::messagesReceive() needs from a board list, independent of the boards in it
+*/
+class BoardListBase {
+public:
+	/** Offers the message to the listed boards, in order, till one decodes it. Completes the request the message answers, if any.
+	@param canId - CAN Bus id
+	@param data - 8 bytes from CAN Bus message.
+	@param length - number of data bytes
+	@return - decoded
+	*/
+	virtual bool messageDecode(uint32_t canId, uint8_t data[8], uint8_t length) = 0;
+};
+
+/** Position of a class in a list of classes
+*/
+template <typename B, typename... List> struct BoardIndex;
+template <typename B, typename... Rest> struct BoardIndex<B, B, Rest...> { static const size_t value = 0; };
+template <typename B, typename First, typename... Rest> struct BoardIndex<B, First, Rest...> {
+	static const size_t value = 1 + BoardIndex<B, Rest...>::value;
+};
+
+template <typename... Boards>
+class BoardList : public BoardListBase {
+	std::tuple<Boards...> _boards;
+
+	/** Decodes with board's own decoder, not virtually
+	@param board - board
+	@param canId - CAN Bus id
+	@param data - 8 bytes from CAN Bus message.
+	@param length - number of data bytes
+	@return - decoded
+	*/
+	template <typename B>
+	static bool decode(B& board, uint32_t canId, uint8_t data[8], uint8_t length) {
+		bool decoded = board.B::messageDecode(canId, data, length);
+		board.requestComplete();
+		return decoded;
+	}
+
+	/** Offers the message to the boards from the I-th on
+	@return - decoded
+	*/
+	template <size_t I>
+	typename std::enable_if<I == sizeof...(Boards), bool>::type decodeFrom(uint32_t canId, uint8_t data[8], uint8_t length) { return false; }
+	template <size_t I>
+	typename std::enable_if<(I < sizeof...(Boards)), bool>::type decodeFrom(uint32_t canId, uint8_t data[8], uint8_t length) {
+		return decode(std::get<I>(_boards), canId, data, length) || decodeFrom<I + 1>(canId, data, length);
+	}
+
+public:
+	/**
+	@param robot - robot containing the boards
+	*/
+	BoardList(Robot* robot) : _boards(((void)sizeof(Boards), robot)...) {}
+
+	/** Calls a function for each board, for example to add it to Robot's board[], which scanning and menus use
+	@param function - called with Board*
+	*/
+	template <typename F>
+	void forEach(F function) {
+		int each[] = { 0, (function(static_cast<Board*>(get<Boards>())), 0)... };
+		(void)each;
+	}
+
+	/** Board of a listed class
+	@return - board
+	*/
+	template <typename B>
+	B* get() { return &std::get<BoardIndex<B, Boards...>::value>(_boards); }
+
+	/** Offers the message to the listed boards, in order, till one decodes it. Completes the request the message answers, if any.
+	@param canId - CAN Bus id
+	@param data - 8 bytes from CAN Bus message.
+	@param length - number of data bytes
+	@return - decoded
+	*/
+	bool messageDecode(uint32_t canId, uint8_t data[8], uint8_t length) { return decodeFrom<0>(canId, data, length); }
+};
@@ -7,6 +7,16 @@
 
 /** Board is a single instance for all boards of the same type, not a single board (if there are more than 1 of the same type)! */
 
+/** Called when a notification request is answered or finally timed out
+@param board - board that sent the request
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@param response - 8 bytes of the response. NULL - no response.
+*/
+static void notificationResponse(Board* board, uint8_t deviceNumber, uint8_t* response) {
+	if (response == NULL)
+		sprintf(errorMessage, "Notification failed: %s", board->name(deviceNumber));
+}
+
 /**
 @param robot - robot containing this board
 @param esp32CANBusSingleton - a single instance of CAN Bus common library for all CAN Bus peripherals.
@@ -22,7 +32,12 @@ Board::Board(Robot* robot, uint8_t maxNumberOfBoards, uint8_t devicesOn1Board, c
 	_name = new std::vector<char[10]>(maxNumberOfBoards * devicesOn1Board);
 	fpsLast = new std::vector<uint16_t>(maxNumberOfBoards);
 	lastMessageReceivedMs = new std::vector<uint32_t>(maxNumberOfBoards * devicesOn1Board);
+	lastMessageReceivedMicros = new std::vector<uint32_t>(maxNumberOfBoards * devicesOn1Board);
+	_acquisitionMicros = new std::vector<uint32_t>(maxNumberOfBoards * devicesOn1Board);
+	clockSyncs = new std::vector<ClockSync>(maxNumberOfBoards * devicesOn1Board);
 	_lastReadingMs = new std::vector<uint32_t>(maxNumberOfBoards);
+	segmenter = new Segmenter(this, maxNumberOfBoards * devicesOn1Board);
+	pingMs = new std::vector<uint32_t>(maxNumberOfBoards * devicesOn1Board);
 	this->devicesOnABoard = devicesOn1Board;
 	this->maximumNumberOfBoards = maxNumberOfBoards;
 	strcpy(this->_boardsName, boardName);
@@ -55,8 +70,15 @@ void Board::add(char* deviceName, uint16_t canIn, uint16_t canOut) {
 	}
 	(*idIn)[nextFree] = canIn;
 	(*idOut)[nextFree] = canOut;
+	robotContainer->mrm_can_bus->filterIdAdd(canOut);
 	(*lastMessageReceivedMs)[nextFree] = 0;
+	(*lastMessageReceivedMicros)[nextFree] = 0;
+	(*_acquisitionMicros)[nextFree] = 0;
+	(*clockSyncs)[nextFree].samples = 0;
+	(*clockSyncs)[nextFree].timestamps = false;
 	(*fpsLast)[nextFree] = 0xFFFF;
+	(*pingMs)[nextFree] = 0;
+	segmenter->add(nextFree);
 	nextFree++;
 }
 
@@ -111,6 +133,33 @@ void Board::aliveSet(bool yesOrNo, uint8_t deviceNumber) {
 }
 
 
+/** Tells all the alive devices to switch to a new bitrate. They must have accepted it before.
+@param bitrateKbps - kbit/s
+*/
+void Board::bitrateCommit(uint16_t bitrateKbps) {
+	for (uint8_t deviceNumber = 0; deviceNumber < nextFree; deviceNumber++)
+		if (alive(deviceNumber)) {
+			canData[0] = COMMAND_BITRATE_COMMIT;
+			canData[1] = bitrateKbps & 0xFF;
+			canData[2] = bitrateKbps >> 8;
+			messageSend(canData, 3, deviceNumber);
+		}
+}
+
+/** Proposes a new bitrate to all the alive devices, without waiting for answers. Check bitrateAccepted() after requests complete.
+@param bitrateKbps - kbit/s
+*/
+void Board::bitratePropose(uint16_t bitrateKbps) {
+	_bitrateAccepted = 0;
+	for (uint8_t deviceNumber = 0; deviceNumber < nextFree; deviceNumber++)
+		if (alive(deviceNumber)) {
+			canData[0] = COMMAND_BITRATE_PROPOSE;
+			canData[1] = bitrateKbps & 0xFF;
+			canData[2] = bitrateKbps >> 8;
+			request(canData, 3, COMMAND_BITRATE_ACCEPT, deviceNumber);
+		}
+}
+
 /** Detects if there is a gap in CAN Bus addresses' sequence, like 0, 2, 3 (missing 1).
 @return - is there a gap.
 */
@@ -128,6 +177,75 @@ bool Board::canGap() {
 	return false;
 }
 
+/** Sends a clock sync request. The answer refines device's clock offset and drift.
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+*/
+void Board::clockSync(uint8_t deviceNumber) {
+	uint8_t frame[1] = { COMMAND_TIME_SYNC_REQUEST }; // Not canData, this runs in the background, maybe in the CAN Bus task.
+	ClockSync* sync = &(*clockSyncs)[deviceNumber];
+	sync->inFlight = false; // A late answer to the previous request must not be taken for this one's.
+	messageSend(frame, 1, deviceNumber);
+	sync->requestMicros = micros(); // After pacing's wait, which is not a part of the round trip.
+	__sync_synchronize(); // Stamp visible before the CAN Bus task sees the request in flight.
+	sync->inFlight = true; // An answer decoded in the CAN Bus task before this is ignored, lacking a valid start.
+}
+
+/** Processes device's answer to clock sync request. Round trip's middle is taken as the moment device read its clock. Offset and
+drift are corrected by a part of the error, so that a single bad sample does not spoil them.
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@param deviceMicros - device's micros() in the answer
+@param receivedMicros - robot's micros() when the answer was received
+*/
+void Board::clockSyncDecode(uint8_t deviceNumber, uint32_t deviceMicros, uint32_t receivedMicros) {
+	ClockSync* sync = &(*clockSyncs)[deviceNumber];
+	if (!sync->inFlight) // Not requested, or answered already
+		return;
+	sync->inFlight = false;
+	uint32_t roundTripMicros = receivedMicros - sync->requestMicros;
+	if ((int32_t)roundTripMicros < 0) // Received in the CAN Bus task before the request was stamped
+		return;
+	if (sync->samples != 0 && roundTripMicros > sync->roundTripMicros + CLOCK_SYNC_SLACK_MICROS) { // Delayed in a queue
+		sync->roundTripMicros += (roundTripMicros - sync->roundTripMicros) / 8; // Best round trip may have really grown.
+		return;
+	}
+	uint32_t middleMicros = sync->requestMicros + roundTripMicros / 2;
+	int32_t offsetMicros = (int32_t)(deviceMicros - middleMicros);
+	if (sync->samples == 0) {
+		sync->driftPpm = 0;
+		sync->offsetMicros = offsetMicros;
+		sync->roundTripMicros = roundTripMicros;
+	}
+	else {
+		float seconds = (int32_t)(middleMicros - sync->syncMicros) / 1000000.0;
+		float predicted = sync->offsetMicros + sync->driftPpm * seconds; // ppm * s = us
+		float error = offsetMicros - predicted;
+		sync->offsetMicros = predicted + CLOCK_OFFSET_GAIN * error;
+		if (seconds > 0)
+			sync->driftPpm += CLOCK_DRIFT_GAIN * error / seconds;
+		if (roundTripMicros < sync->roundTripMicros)
+			sync->roundTripMicros = roundTripMicros;
+	}
+	sync->syncMicros = middleMicros;
+	if (sync->samples < 0xFFFF)
+		sync->samples++;
+}
+
+/** Syncs the next device sending timestamps, if CLOCK_SYNC_PERIOD_MS passed. Call in each loop pass.
+*/
+void Board::clockSyncRefresh() {
+	if (millis() - _clockSyncMs < CLOCK_SYNC_PERIOD_MS || nextFree == 0)
+		return;
+	_clockSyncMs = millis();
+	for (uint8_t i = 0; i < nextFree; i++) {
+		uint8_t deviceNumber = (_clockSyncNext + i) % nextFree;
+		if ((*clockSyncs)[deviceNumber].timestamps) {
+			clockSync(deviceNumber);
+			_clockSyncNext = deviceNumber + 1;
+			return;
+		}
+	}
+}
+
 /** Did any device respond to last ping?
 @param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
 */
@@ -144,6 +262,19 @@ uint8_t Board::count() {
 */
 uint8_t Board::deadOrAliveCount() { return nextFree; }
 
+/** Converts device's time to robot's
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@param deviceMicros - device's micros()
+@return - robot's micros(). Unchanged if not synced.
+*/
+uint32_t Board::deviceToRobotMicros(uint8_t deviceNumber, uint32_t deviceMicros) {
+	ClockSync* sync = &(*clockSyncs)[deviceNumber];
+	if (sync->samples == 0)
+		return deviceMicros;
+	uint32_t robotMicros = deviceMicros - sync->offsetMicros; // Without drift, good enough to calculate drift's part.
+	return deviceMicros - (int32_t)(sync->offsetMicros + sync->driftPpm * (int32_t)(robotMicros - sync->syncMicros) / 1000000.0);
+}
+
 /** Ping devices and refresh alive array
 @param verbose - prints statuses
 @param mask - bitwise, 16 bits - no more than 16 devices! Bit == 1 - scan, 0 - no scan.
@@ -174,7 +305,7 @@ void Board::firmwareRequest(uint8_t deviceNumber) {
 	else {
 		if (alive(deviceNumber)) {
 			canData[0] = COMMAND_FIRMWARE_REQUEST;
-			messageSend(canData, 1, deviceNumber);
+			request(canData, 1, COMMAND_FIRMWARE_SENDING, deviceNumber);
 		}
 	}
 }
@@ -210,8 +341,8 @@ void Board::fpsRequest(uint8_t deviceNumber) {
 	else {
 		if (alive(deviceNumber)) {
 			canData[0] = COMMAND_FPS_REQUEST;
-			messageSend(canData, 1, deviceNumber);
 			(*fpsLast)[deviceNumber] = 0xFFFF;
+			request(canData, 1, COMMAND_FPS_SENDING, deviceNumber);
 		}
 	}
 }
@@ -226,13 +357,13 @@ void Board::info(uint8_t deviceNumber) {
 	else {
 		if (alive(deviceNumber)) {
 			canData[0] = COMMAND_INFO_REQUEST;
-			messageSend(canData, 1, deviceNumber);
-			delay(1);
+			request(canData, 1, COMMAND_INFO_SENDING_1, deviceNumber, NULL, BOARD_REQUEST_TIMEOUT_MS, 0); // Most devices do not answer.
 		}
 	}
 }
 
-/** Change CAN Bus id
+/** Change CAN Bus id. Frames with the new id pass the CAN Bus filter if a device with that number was added, as all the added
+devices' ids are registered.
 @param newId - CAN Bus id
 @param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
 */
@@ -276,9 +407,17 @@ bool Board::isFromMe(uint32_t canIdOut, uint8_t deviceNumber) {
 */
 bool Board::messageDecodeCommon(uint32_t canId, uint8_t data[8], uint8_t deviceNumber) {
 	(*lastMessageReceivedMs)[deviceNumber] = millis();
+	(*lastMessageReceivedMicros)[deviceNumber] = robotContainer->mrm_can_bus->receivedMicros();
+	(*_acquisitionMicros)[deviceNumber] = (*lastMessageReceivedMicros)[deviceNumber]; // Unless a timestamp follows
+	aliveSet(true, deviceNumber); // Any message proves the device is present.
+	if (_requestsPending != 0)
+		requestMatch(data, deviceNumber);
 	bool found = true;
 	uint8_t command = data[0];
 	switch (command) {
+	case COMMAND_BITRATE_ACCEPT:
+		_bitrateAccepted |= 1 << deviceNumber;
+		break;
 	case COMMAND_DUPLICATE_ID_ECHO:
 	case COMMAND_DUPLICATE_ID_PING:
 		break;
@@ -295,6 +434,10 @@ bool Board::messageDecodeCommon(uint32_t canId, uint8_t data[8], uint8_t deviceN
 	case COMMAND_FPS_SENDING:
 		(*fpsLast)[deviceNumber] = (data[2] << 8) | data[1];
 		break;
+	case COMMAND_TIME_SYNC_SENDING:
+		clockSyncDecode(deviceNumber, data[1] | (data[2] << 8) | (data[3] << 16) | ((uint32_t)data[4] << 24),
+			(*lastMessageReceivedMicros)[deviceNumber]);
+		break;
 	case COMMAND_MESSAGE_SENDING_1:
 		for (uint8_t i = 0; i < 7; i++)
 			_message[i] = data[i + 1];
@@ -314,6 +457,12 @@ bool Board::messageDecodeCommon(uint32_t canId, uint8_t data[8], uint8_t deviceN
 		break;
 	case COMMAND_NOTIFICATION:
 		break;
+	case COMMAND_SEGMENT_FIRST:
+	case COMMAND_SEGMENT_CONSECUTIVE:
+	case COMMAND_SEGMENT_FLOW_CONTROL:
+		if (!segmenter->decode(data, deviceNumber))
+			sprintf(errorMessage, "%s: transfer too big", name(deviceNumber));
+		break;
 	case COMMAND_REPORT_ALIVE:
 		if (_aliveReport)
 			robotContainer->print("%s alive.\n\r", name(deviceNumber));
@@ -395,30 +544,24 @@ char* Board::name(uint8_t deviceNumber) {
 	return (*_name)[deviceNumber];
 }
 
+/** Name of the device a frame is addressed to or originates from
+@param canId - CAN Bus id.
+@return - name, NULL if not this board's id
+*/
+char* Board::nameOfId(uint32_t canId) {
+	for (uint8_t deviceNumber = 0; deviceNumber < nextFree; deviceNumber++)
+		if (isForMe(canId, deviceNumber) || isFromMe(canId, deviceNumber))
+			return (*_name)[deviceNumber];
+	return NULL;
+}
+
 /** Request notification
 @param commandRequestingNotification
 @param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
 */
 void Board::notificationRequest(uint8_t commandRequestingNotification, uint8_t deviceNumber) {
-	printf("THIS FUNCTION DOESN'T WORK\n\r");
-	//while (1);
-	//uint8_t tries = 0;
-	//while (tries < 10) {
-	//	tries++;
-	//	canData[0] = commandRequestingNotification;
-	//	messageSend(canData, 1, deviceNumber);
-	//	while (tries != 0xFF && !dequeEmpty()) {
-	//		robotContainer->noLoopWithoutThis();
-	//		uint32_t id = dequeBack()->messageId;
-	//		//print("RCVD id 0x%x, data: 0x%x\n\r", id, mrm_can_bus->dequeBack->data[0]);
-	//		if (isForMe(id, deviceNumber) && dequeBack()->data[0] == COMMAND_NOTIFICATION) {
-	//			tries = 0xFF;
-	//			//robotContainer->print("OK...\n\r");
-	//		}
-	//	}
-	//}
-	//if (tries != 0xFF)
-	//	strcpy(errorMessage, "Notification failed");
+	canData[0] = commandRequestingNotification;
+	request(canData, 1, COMMAND_NOTIFICATION, deviceNumber, notificationResponse, BOARD_REQUEST_TIMEOUT_MS, 9);
 }
 
 
@@ -438,6 +581,18 @@ void Board::oscillatorTest(uint8_t deviceNumber) {
 	}
 }
 
+/** Background presence check, without waiting. Marks the device dead if it did not answer the previous check, and pings it again.
+Any message received from the device marks it alive.
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+*/
+void Board::presenceCheck(uint8_t deviceNumber) {
+	if ((*pingMs)[deviceNumber] != 0 && (int32_t)((*lastMessageReceivedMs)[deviceNumber] - (*pingMs)[deviceNumber]) < 0)
+		aliveSet(false, deviceNumber);
+	uint8_t frame[1] = { COMMAND_REPORT_ALIVE }; // Not canData, this may run while a caller is composing a message.
+	messageSend(frame, 1, deviceNumber);
+	(*pingMs)[deviceNumber] = millis();
+}
+
 /** Reset
 @param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0. 0xFF - all devices.
 */
@@ -451,6 +606,220 @@ void Board::reset(uint8_t deviceNumber) {
 	}
 }
 
+/** Sends a command and expects a response, without waiting. A request with the same response for the same device, still pending, is
+replaced. Many requests, to different devices, can be in flight at the same time. Call requestsRefresh() in each loop pass.
+@param data - payload
+@param dlc - data length
+@param responseCommand - first byte of the expected response
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@param callback - called when the response arrives or after last retry timed out. NULL - none, use requestStatus().
+@param timeoutMs - for each attempt
+@param retries - resends after the first attempt
+@return - handle for requestStatus(), REQUEST_NONE if no free slot
+*/
+uint16_t Board::request(uint8_t* data, uint8_t dlc, uint8_t responseCommand, uint8_t deviceNumber, RequestCallback callback,
+	uint16_t timeoutMs, uint8_t retries) {
+	if (dlc > 8) {
+		errorCode = 127;
+		errorInDeviceNumber = deviceNumber;
+		return REQUEST_NONE;
+	}
+	if (requests == NULL) {
+		uint16_t size = devicesMaximumNumberInAllBoards() * BOARD_REQUESTS_PER_DEVICE;
+		requests = new std::vector<BoardRequest>(size > 0xFF ? 0xFF : size); // Slot must fit handle's low byte.
+	}
+	uint8_t slotCount = requests->size();
+
+	// The same request still pending is replaced, otherwise the first free slot after the last used one.
+	uint8_t slot = 0xFF;
+	for (uint8_t i = 0; i < slotCount; i++) {
+		BoardRequest* r = &(*requests)[i];
+		if (r->status == REQUEST_PENDING && r->deviceNumber == deviceNumber && r->responseCommand == responseCommand) {
+			slot = i;
+			__sync_sub_and_fetch(&_requestsPending, 1);
+			break;
+		}
+	}
+	for (uint8_t i = 0; i < slotCount && slot == 0xFF; i++) {
+		uint8_t candidate = (_requestNext + i) % slotCount;
+		if ((*requests)[candidate].status != REQUEST_PENDING)
+			slot = candidate;
+	}
+	if (slot == 0xFF) {
+		sprintf(errorMessage, "%s: too many requests", _boardsName);
+		return REQUEST_NONE;
+	}
+	_requestNext = (slot + 1) % slotCount;
+
+	BoardRequest* r = &(*requests)[slot];
+	r->callback = callback;
+	r->deviceNumber = deviceNumber;
+	r->dlc = dlc;
+	r->generation++;
+	for (uint8_t i = 0; i < dlc; i++)
+		r->request[i] = data[i];
+	r->responseCommand = responseCommand;
+	r->retriesLeft = retries;
+	r->timeoutMs = timeoutMs;
+	r->sentMs = millis();
+	__sync_synchronize(); // Complete before decoding, maybe on the other core, sees it pending.
+	r->status = REQUEST_PENDING;
+	__sync_add_and_fetch(&_requestsPending, 1);
+	messageSend(r->request, dlc, deviceNumber);
+	return (r->generation << 8) | slot;
+}
+
+/** Completes the request the last decoded message answered, if any. Call after messageDecode(), so that the payload the board stores
+from the response is there when the request is seen done.
+*/
+void Board::requestComplete() {
+	if (_requestMatched == REQUEST_NONE)
+		return;
+	BoardRequest* r = &(*requests)[_requestMatched & 0xFF];
+	if (r->status == REQUEST_PENDING && r->generation == _requestMatched >> 8) { // Not replaced meanwhile
+		__sync_synchronize(); // Response and decoded payload complete before the loop sees it done.
+		r->status = REQUEST_DONE;
+		__sync_sub_and_fetch(&_requestsPending, 1);
+		if (r->callback != NULL)
+			(*r->callback)(this, r->deviceNumber, r->response);
+	}
+	_requestMatched = REQUEST_NONE;
+}
+
+/** Finds a pending request the message answers and keeps the response. The request stays pending till requestComplete(), called after
+the whole message is decoded.
+@param data - 8 bytes from CAN Bus message.
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+*/
+void Board::requestMatch(uint8_t data[8], uint8_t deviceNumber) {
+	for (uint8_t i = 0; i < requests->size(); i++) {
+		BoardRequest* r = &(*requests)[i];
+		if (r->status == REQUEST_PENDING && r->deviceNumber == deviceNumber && r->responseCommand == data[0]) {
+			for (uint8_t j = 0; j < 8; j++)
+				r->response[j] = data[j];
+			_requestMatched = (r->generation << 8) | i;
+			return;
+		}
+	}
+}
+
+/** Resends timed-out requests or fails them when no retry is left. Call in each loop pass.
+*/
+void Board::requestsRefresh() {
+	if (_requestsPending == 0)
+		return;
+	for (uint8_t i = 0; i < requests->size(); i++) {
+		BoardRequest* r = &(*requests)[i];
+		if (r->status != REQUEST_PENDING || millis() - r->sentMs < r->timeoutMs)
+			continue;
+		if (r->retriesLeft > 0) {
+			r->retriesLeft--;
+			_requestsRetried++;
+			r->sentMs = millis();
+			messageSend(r->request, r->dlc, r->deviceNumber);
+		}
+		else {
+			r->status = REQUEST_FAILED;
+			__sync_sub_and_fetch(&_requestsPending, 1);
+			_requestsFailed++;
+			if (r->callback != NULL)
+				(*r->callback)(this, r->deviceNumber, NULL);
+		}
+	}
+}
+
+/** Request's status
+@param handle - returned by request()
+@param response - output, 8 bytes of the response, if done. NULL - not needed.
+@return - status. REQUEST_UNKNOWN if the slot has been reused.
+*/
+RequestStatus Board::requestStatus(uint16_t handle, uint8_t* response) {
+	if (handle == REQUEST_NONE || requests == NULL || (handle & 0xFF) >= requests->size())
+		return REQUEST_UNKNOWN;
+	BoardRequest* r = &(*requests)[handle & 0xFF];
+	if (r->generation != handle >> 8)
+		return REQUEST_UNKNOWN;
+	if (r->status == REQUEST_DONE && response != NULL)
+		for (uint8_t i = 0; i < 8; i++)
+			response[i] = r->response[i];
+	return r->status;
+}
+
+/** Waits for a request to complete, keeping the robot's loop running
+@param handle - returned by request()
+@return - final status
+*/
+RequestStatus Board::requestWait(uint16_t handle) {
+	RequestStatus status;
+	while ((status = requestStatus(handle)) == REQUEST_PENDING)
+		robotContainer->noLoopWithoutThis();
+	return status;
+}
+
+/** Converts robot's time to device's
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@param robotMicros - robot's micros()
+@return - device's micros(). Unchanged if not synced.
+*/
+uint32_t Board::robotToDeviceMicros(uint8_t deviceNumber, uint32_t robotMicros) {
+	ClockSync* sync = &(*clockSyncs)[deviceNumber];
+	if (sync->samples == 0)
+		return robotMicros;
+	return robotMicros + (int32_t)(sync->offsetMicros + sync->driftPpm * (int32_t)(robotMicros - sync->syncMicros) / 1000000.0);
+}
+
+/** Sends a frame of a multi-frame transfer
+@param frame - data
+@param length - number of bytes
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+*/
+void Board::segmentFrameSend(uint8_t* frame, uint8_t length, uint8_t deviceNumber) {
+	messageSend(frame, length, deviceNumber);
+}
+
+/** Multi-frame transfer completed. Override to handle device specific commands.
+@param command - command carried by the transfer
+@param data - payload
+@param size - payload's size
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@return - command handled
+*/
+bool Board::segmentedReceived(uint8_t command, uint8_t* data, uint16_t size, uint8_t deviceNumber) {
+	switch (command) {
+	case COMMAND_MESSAGE_SENDING_1:
+		robotContainer->print("Message from %s: %s\n\r", (*_name)[deviceNumber], (char*)data);
+		return true;
+	default:
+		robotContainer->print("%s: unknown transfer 0x%02X, %i bytes\n\r", name(deviceNumber), command, size);
+		return false;
+	}
+}
+
+/** Sends a payload longer than a single CAN Bus frame allows, using first frame, flow control and consecutive frames.
+@param command - command carried by the transfer
+@param data - payload
+@param size - payload's size, up to SEGMENT_BUFFER_SIZE
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@return - true if sent, false if the device did not accept the transfer. Then the caller should use single-frame commands.
+*/
+bool Board::segmentedSend(uint8_t command, const uint8_t* data, uint16_t size, uint8_t deviceNumber) {
+	if (size > SEGMENT_BUFFER_SIZE) {
+		sprintf(errorMessage, "%s: transfer too big", name(deviceNumber));
+		return false;
+	}
+	return segmenter->send(command, data, size, deviceNumber);
+}
+
+/** Waits for flow control of a multi-frame transfer, decoding frames that arrive meanwhile
+@param micros - time to wait
+*/
+void Board::segmentWait(uint32_t micros) {
+	if (micros < 1000)
+		robotContainer->delayMicros(micros);
+	else
+		robotContainer->delayMs(micros / 1000);
+}
+
 
 /** Starts periodical CANBus messages that will be refreshing values that can be read by reading()
 @param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0. 0xFF - all devices.
@@ -519,6 +888,37 @@ void Board::swap(uint8_t deviceNumber1, uint8_t deviceNumber2) {
 	}
 }
 
+/** Sets measurement's acquisition time from device's timestamp. Call in derived decoders when a measurement carries one.
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@param timestamp - device's micros() / TIMESTAMP_UNIT_MICROS, lower 16 bits.
+*/
+void Board::timestampDecode(uint8_t deviceNumber, uint16_t timestamp) {
+	if ((*clockSyncs)[deviceNumber].samples == 0) // Receiving time stays.
+		return;
+	// Timestamp is device's clock shortly before receiving. Its upper bits are the same as receiving time's, unless they wrapped.
+	uint32_t receivedMicros = robotToDeviceMicros(deviceNumber, (*lastMessageReceivedMicros)[deviceNumber]);
+	uint16_t age = (uint16_t)(receivedMicros / TIMESTAMP_UNIT_MICROS) - timestamp;
+	(*_acquisitionMicros)[deviceNumber] = deviceToRobotMicros(deviceNumber, receivedMicros - (uint32_t)age * TIMESTAMP_UNIT_MICROS);
+}
+
+/** Device's measurements carry its timestamps. Periodic clock syncs start, too.
+@param on - on or off
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0. 0xFF - all devices.
+*/
+void Board::timestampsSet(bool on, uint8_t deviceNumber) {
+	if (deviceNumber == 0xFF) {
+		for (uint8_t i = 0; i < nextFree; i++)
+			if (alive(i))
+				timestampsSet(on, i);
+		return;
+	}
+	(*clockSyncs)[deviceNumber].timestamps = on;
+	canData[0] = COMMAND_TIMESTAMPS;
+	canData[1] = on;
+	messageSend(canData, 2, deviceNumber);
+	if (on)
+		clockSync(deviceNumber);
+}
 
 /**
 @param robot - robot containing this board
@@ -530,6 +930,10 @@ void Board::swap(uint8_t deviceNumber1, uint8_t deviceNumber2) {
 MotorBoard::MotorBoard(Robot* robot, uint8_t devicesOnABoard, const char* boardName, uint8_t maxNumberOfBoards, BoardId id) :
 	Board(robot, maxNumberOfBoards, devicesOnABoard, boardName, MOTOR_BOARD, id) {
 	encoderCount = new std::vector<uint32_t>(devicesOnABoard * maxNumberOfBoards);
+	encoderMicros = new std::vector<uint32_t>(devicesOnABoard * maxNumberOfBoards);
+	encoderTicksPerSecond = new std::vector<float>(devicesOnABoard * maxNumberOfBoards);
+	odometryGroup = new std::vector<MotorGroup*>(devicesOnABoard * maxNumberOfBoards);
+	odometryWheel = new std::vector<uint8_t>(devicesOnABoard * maxNumberOfBoards);
 	reversed = new std::vector<bool>(devicesOnABoard * maxNumberOfBoards);
 	lastSpeed = new std::vector<int8_t>(devicesOnABoard * maxNumberOfBoards);
 }
@@ -547,16 +951,27 @@ void MotorBoard::directionChange(uint8_t deviceNumber) {
 /** Read CAN Bus message into local variables
 @param canId - CAN Bus id
 @param data - 8 bytes from CAN Bus message.
+@param length - number of data bytes
 @return - true if canId for this class
 */
-bool MotorBoard::messageDecode(uint32_t canId, uint8_t data[8]) {
+bool MotorBoard::messageDecode(uint32_t canId, uint8_t data[8], uint8_t length) {
 	for (uint8_t deviceNumber = 0; deviceNumber < nextFree; deviceNumber++)
 		if (isForMe(canId, deviceNumber)) {
 			if (!messageDecodeCommon(canId, data, deviceNumber)) {
 				switch (data[0]) {
 				case COMMAND_SENSORS_MEASURE_SENDING: {
 					uint32_t enc = (data[4] << 24) | (data[3] << 16) | (data[2] << 8) | data[1];
+					uint32_t now = micros();
+					if ((*encoderMicros)[deviceNumber] != 0) {
+						int32_t ticks = odometryTicks(enc, (*encoderCount)[deviceNumber], (*reversed)[deviceNumber]);
+						uint32_t gapMicros = now - (*encoderMicros)[deviceNumber];
+						if (gapMicros != 0)
+							(*encoderTicksPerSecond)[deviceNumber] = ticks * 1000000.0 / gapMicros;
+						if ((*odometryGroup)[deviceNumber] != NULL)
+							(*odometryGroup)[deviceNumber]->encoderDecoded((*odometryWheel)[deviceNumber], ticks, now);
+					}
 					(*encoderCount)[deviceNumber] = enc;
+					(*encoderMicros)[deviceNumber] = now == 0 ? 1 : now;
 					(*_lastReadingMs)[deviceNumber] = millis();
 					break;
 				}
@@ -573,17 +988,30 @@ bool MotorBoard::messageDecode(uint32_t canId, uint8_t data[8]) {
 }
 
 
+/** Feeds motor's encoder changes to a group's odometry, as they are decoded
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@param group - group, NULL - none
+@param wheel - motor's index in the group
+*/
+void MotorBoard::odometryAttach(uint8_t deviceNumber, MotorGroup* group, uint8_t wheel) {
+	if (deviceNumber >= nextFree) {
+		strcpy(errorMessage, "MotorBoard doesn't exist");
+		return;
+	}
+	(*odometryGroup)[deviceNumber] = group;
+	(*odometryWheel)[deviceNumber] = wheel;
+}
+
 /** Encoder readings
 @param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
 @return - encoder value
 */
-uint16_t MotorBoard::reading(uint8_t deviceNumber) {
+uint32_t MotorBoard::reading(uint8_t deviceNumber) {
 	if (deviceNumber >= nextFree) {
 		strcpy(errorMessage, "MotorBoard doesn't exist");
 		return 0;
 	}
-	alive(deviceNumber, true);
-	if (started(deviceNumber))
+	if (alive(deviceNumber) && started(deviceNumber)) // No scan here, it would stall the loop.
 		return (*encoderCount)[deviceNumber];
 	else
 		return 0;
@@ -616,9 +1044,8 @@ void MotorBoard::speedSet(uint8_t motorNumber, int8_t speed) {
 	if ((*reversed)[motorNumber])
 		speed = -speed;
 
-	canData[0] = COMMAND_SPEED_SET;
-	canData[1] = speed + 128;
-	messageSend(canData, 2, motorNumber);
+	uint8_t frame[2] = { COMMAND_SPEED_SET, (uint8_t)(speed + 128) }; // Not canData, speed control calls it in the background.
+	messageSend(frame, 2, motorNumber);
 }
 
 /** If sensor not started, start it and wait for 1. message
@@ -829,6 +1256,8 @@ float SensorBoard::outlierlessAverage(uint8_t sampleCount, uint16_t sample[], fl
 
 MotorGroup::MotorGroup(Robot* robot){
 	this->robotContainer = robot;
+	if (robot != NULL)
+		robot->add(this);
 }
 
 /** Angle between -180 and 180 degrees
@@ -842,9 +1271,175 @@ float MotorGroup::angleNormalized(float angle) {
 	return angle;
 }
 
-/** Stop motors
+/** Integrates an encoder change into the pose. Called by MotorBoard while decoding its frame.
+@param wheel - motor's index in the group
+@param ticks - change since the previous frame, positive in motor's positive direction
+@param micros - frame's time
+*/
+void MotorGroup::encoderDecoded(uint8_t wheel, int32_t ticks, uint32_t micros) {
+	if (odometryMmPerTick == 0)
+		return;
+	float forward, right, rotation;
+	odometryWheel(wheel, ticks * odometryMmPerTick, &forward, &right, &rotation);
+	_odometry.wheelAdd(wheel, forward, right, rotation, micros);
+}
+
+/** Starts odometry. Motors' encoders must be running (MotorBoard::start()).
+@param ticksPerRevolution - encoder ticks for one wheel revolution
+@param wheelDiameterMm - wheel's diameter
+@param baseMm - differential drive: distance between left and right wheels. Star: distance between robot's center and a wheel.
+*/
+void MotorGroup::odometryStart(uint16_t ticksPerRevolution, float wheelDiameterMm, float baseMm) {
+	odometryBaseMm = baseMm;
+	odometryTicksPerRevolution = ticksPerRevolution;
+	odometryMmPerTick = wheelDiameterMm * PI / ticksPerRevolution;
+	poseSet();
+	uint8_t wheels = 0;
+	for (uint8_t i = 0; i < MAX_MOTORS_IN_GROUP; i++)
+		if (motorBoard[i] != NULL) {
+			motorBoard[i]->odometryAttach(motorNumber[i], this, i);
+			wheels |= 1 << i;
+		}
+	_odometry.wheelsSet(wheels);
+}
+
+/** A wheel's movement expressed as the robot's movement, in the robot's coordinate system. Wheels' contributions add up.
+@param wheel - motor's index in the group
+@param mm - wheel's movement, positive in motor's positive direction
+@param forward - output, mm
+@param right - output, mm
+@param rotation - output, radians, positive to the right
+*/
+void MotorGroup::odometryWheel(uint8_t wheel, float mm, float* forward, float* right, float* rotation) {
+	*forward = 0; // Geometry unknown
+	*right = 0;
+	*rotation = 0;
+}
+
+/** Current pose. Safe to call at any time, also while frames are being decoded, without locking.
+@return - pose
+*/
+OdometryPose MotorGroup::pose() {
+	return _odometry.pose();
+}
+
+/** Sets the pose, for example when the robot's position becomes known
+@param x - mm
+@param y - mm
+@param heading - degrees, positive to the right
+*/
+void MotorGroup::poseSet(float x, float y, float heading) {
+	_odometry.set(x, y, heading, micros());
+}
+
+/** Starts closed-loop speed control of all the wheels, with default gains. Motors' encoders must be running (MotorBoard::start()).
+Open-loop go() stops it.
+@param maxTicksPerSecond - wheel's speed at full duty, for feed-forward
+*/
+void MotorGroup::speedControlStart(float maxTicksPerSecond) {
+	float feedForward = 127 / maxTicksPerSecond;
+	for (uint8_t i = 0; i < MAX_MOTORS_IN_GROUP; i++) {
+		speedGainsSet(i, feedForward, feedForward * MOTOR_SPEED_KP, feedForward * MOTOR_SPEED_KI);
+		_speedIntegral[i] = 0;
+		_speedTarget[i] = 0;
+	}
+	_speedControlMicros = 0;
+	_speedControl = true;
+}
+
+/** Calculates and sends all the wheels' duties. If any duty is out of range, all are scaled down together, preserving direction, and
+integrators are held.
+@param micros - time
+*/
+void MotorGroup::speedControlStep(uint32_t micros) {
+	float seconds = _speedControlMicros == 0 ? 0 : (micros - _speedControlMicros) / 1000000.0;
+	_speedControlMicros = micros == 0 ? 1 : micros;
+
+	float duty[MAX_MOTORS_IN_GROUP];
+	float error[MAX_MOTORS_IN_GROUP];
+	float maxDuty = 0;
+	for (uint8_t i = 0; i < MAX_MOTORS_IN_GROUP; i++) {
+		if (motorBoard[i] == NULL)
+			continue;
+		WheelSpeedGains* gains = &_speedGains[i];
+		error[i] = _speedTarget[i] - motorBoard[i]->encoderSpeed(motorNumber[i]);
+		duty[i] = gains->feedForward * _speedTarget[i] + gains->kP * error[i] + _speedIntegral[i];
+		if (fabsf(duty[i]) > maxDuty)
+			maxDuty = fabsf(duty[i]);
+	}
+
+	bool saturated = maxDuty > 127;
+	float scale = saturated ? 127 / maxDuty : 1;
+	for (uint8_t i = 0; i < MAX_MOTORS_IN_GROUP; i++) {
+		if (motorBoard[i] == NULL)
+			continue;
+		if (!saturated) // Anti-windup
+			_speedIntegral[i] = constrain(_speedIntegral[i] + _speedGains[i].kI * error[i] * seconds, -127, 127);
+		motorBoard[i]->speedSet(motorNumber[i], (int8_t)roundf(duty[i] * scale));
+	}
+}
+
+/** Runs a speed control step if it is due. Called by Robot in each loop pass.
+*/
+void MotorGroup::speedControlRefresh() {
+	uint32_t now = micros();
+	if (_speedControl && now - _speedControlMicros >= MOTOR_SPEED_CONTROL_PERIOD_MS * 1000)
+		speedControlStep(now);
+}
+
+/** Stops speed control and motors
+*/
+void MotorGroup::speedControlStop() {
+	stop();
+}
+
+/** Sets a wheel's speed controller's gains, for example when a motor is weaker than the others
+@param wheel - motor's index in the group
+@param feedForward - duty per tick/s
+@param kP - duty per tick/s of error
+@param kI - duty per tick of accumulated error
+*/
+void MotorGroup::speedGainsSet(uint8_t wheel, float feedForward, float kP, float kI) {
+	if (wheel >= MAX_MOTORS_IN_GROUP) {
+		strcpy(errorMessage, "Wrong wheel");
+		return;
+	}
+	_speedGains[wheel].feedForward = feedForward;
+	_speedGains[wheel].kI = kI;
+	_speedGains[wheel].kP = kP;
+}
+
+/** Sets wheels' target speeds. The first control step is done at once.
+@param ticksPerSecond - for each wheel, positive in motor's positive direction
+*/
+void MotorGroup::wheelSpeedsSet(const float ticksPerSecond[MAX_MOTORS_IN_GROUP]) {
+	if (!_speedControl) {
+		strcpy(errorMessage, "Speed control off");
+		return;
+	}
+	for (uint8_t i = 0; i < MAX_MOTORS_IN_GROUP; i++)
+		_speedTarget[i] = ticksPerSecond[i];
+	speedControlStep(micros());
+}
+
+/** Wheel's angular speed, from encoder
+@param wheel - motor's index in the group
+@return - radians per second, positive in motor's positive direction
+*/
+float MotorGroup::wheelSpeed(uint8_t wheel) {
+	if (wheel >= MAX_MOTORS_IN_GROUP || motorBoard[wheel] == NULL || odometryTicksPerRevolution == 0)
+		return 0;
+	return motorBoard[wheel]->encoderSpeed(motorNumber[wheel]) * 2 * PI / odometryTicksPerRevolution;
+}
+
+/** Stops motors and speed control, clearing its targets and integrators
 */
 void MotorGroup::stop() {
+	_speedControl = false;
+	for (uint8_t i = 0; i < MAX_MOTORS_IN_GROUP; i++) {
+		_speedIntegral[i] = 0;
+		_speedTarget[i] = 0;
+	}
 	for (uint8_t i = 0; i < MAX_MOTORS_IN_GROUP; i++)
 		if (motorBoard[i] == NULL)
 			break;
@@ -893,6 +1488,7 @@ int16_t MotorGroupDifferential::checkBounds(int16_t speed) {
 @param speedLimit - Speed limit, 0 to 127. For example, 80 will limit all the speeds to 80/127%. 0 will turn the motors off.
 */
 void MotorGroupDifferential::go(int16_t leftSpeed, int16_t rightSpeed, int16_t lateralSpeedToRight, uint8_t speedLimit) {
+	_speedControl = false;
 	if (motorBoard[0] != NULL) {
 		if (speedLimit == 0)
 			stop();
@@ -923,6 +1519,28 @@ void MotorGroupDifferential::go(int16_t leftSpeed, int16_t rightSpeed, int16_t l
 	}
 }
 
+/** Drives with closed-loop speed control, started by speedControlStart()
+@param leftTicksPerSecond - left wheels' speed, positive forward
+@param rightTicksPerSecond - right wheels' speed, positive forward
+*/
+void MotorGroupDifferential::goSpeed(float leftTicksPerSecond, float rightTicksPerSecond) {
+	float speeds[MAX_MOTORS_IN_GROUP] = { leftTicksPerSecond, -rightTicksPerSecond, leftTicksPerSecond, -rightTicksPerSecond };
+	wheelSpeedsSet(speeds);
+}
+
+/** A wheel's movement expressed as the robot's movement. Left wheels (0 and 2) drive forward with positive speed, right ones (1 and 3)
+with negative, as in go().
+@param wheel - motor's index in the group
+@param mm - wheel's movement, positive in motor's positive direction
+@param forward - output, mm
+@param right - output, mm
+@param rotation - output, radians, positive to the right
+*/
+void MotorGroupDifferential::odometryWheel(uint8_t wheel, float mm, float* forward, float* right, float* rotation) {
+	uint8_t wheelsOnSide = motorBoard[wheel % 2 == 0 ? 2 : 3] == NULL ? 1 : 2;
+	odometryDifferential(wheel, mm, wheelsOnSide, odometryBaseMm, forward, right, rotation);
+}
+
 /**
 @param motorBoardFor45Degrees - motor controller for the motor which axle is inclined 45 degrees clockwise from robot's front.
 @param motorNumberFor45Degrees - Controller's output number.
@@ -954,6 +1572,7 @@ numbers because a value 100 turns on all the motors at maximal speed.
 @param speedLimit - Speed limit, 0 to 127. For example, 80 will limit all the speeds to 80/127%. 0 will turn the motors off.
 */
 void MotorGroupStar::go(float speed, float angleDegrees, float rotation, uint8_t speedLimit) {
+	_speedControl = false;
 	if (motorBoard[0] != NULL) {
 		if (speedLimit == 0)
 			stop();
@@ -991,6 +1610,33 @@ void MotorGroupStar::go(float speed, float angleDegrees, float rotation, uint8_t
 	}
 }
 
+/** Drives with closed-loop speed control, started by speedControlStart(). Wheels' speeds are calculated as in go().
+@param ticksPerSecond - translation speed, in wheel's encoder ticks per second
+@param angleDegrees - Movement direction in a robot's coordinate system, in degrees. 0 degree is the front of the robot and positive angles
+are to the right.
+@param rotationTicksPerSecond - rotation's share of each wheel's speed, positive to the right
+*/
+void MotorGroupStar::goSpeed(float ticksPerSecond, float angleDegrees, float rotationTicksPerSecond) {
+	float angleRadians = toRad(angleDegrees + 135);
+	float si = sinf(angleRadians);
+	float co = cosf(angleRadians);
+	float speeds[MAX_MOTORS_IN_GROUP] = { ticksPerSecond * si + rotationTicksPerSecond, -ticksPerSecond * co + rotationTicksPerSecond,
+		-ticksPerSecond * si + rotationTicksPerSecond, ticksPerSecond * co + rotationTicksPerSecond };
+	wheelSpeedsSet(speeds);
+}
+
+/** A wheel's movement expressed as the robot's movement. As in go(), a positive speed drives the wheel clockwise around the center.
+Inverse of go()'s kinematics for axles at 45, 135, -135 and -45 degrees.
+@param wheel - motor's index in the group
+@param mm - wheel's movement, positive in motor's positive direction
+@param forward - output, mm
+@param right - output, mm
+@param rotation - output, radians, positive to the right
+*/
+void MotorGroupStar::odometryWheel(uint8_t wheel, float mm, float* forward, float* right, float* rotation) {
+	odometryStar(wheel, mm, odometryBaseMm, forward, right, rotation);
+}
+
 /** Moves the robot in order to elinimate errors (for x and y directions).
 @param errorX - X axis error.
 @param errorY - Y axis error.
@@ -4,6 +4,9 @@
 #include <mrm-can-bus.h>
 #include <mrm-common.h>
 #include <mrm-pid.h>
+#include "mrm-segment.h"
+#include "mrm-odometry.h"
+#include "mrm-servo-motion.h"
 #include <vector>
 
 #define COMMAND_SENSORS_MEASURE_CONTINUOUS 0x10
@@ -35,13 +38,37 @@
 #define COMMAND_ID_CHANGE_REQUEST 0x40
 #define COMMAND_NOTIFICATION 0x41
 #define COMMAND_OSCILLATOR_TEST 0x43
+#define COMMAND_BITRATE_PROPOSE 0x44 // [command, kbit/s low, kbit/s high]. Device answers COMMAND_BITRATE_ACCEPT if it supports the bitrate.
+#define COMMAND_BITRATE_ACCEPT 0x45
+#define COMMAND_BITRATE_COMMIT 0x46 // [command, kbit/s low, kbit/s high]. Device switches. If it then receives nothing for CAN_BITRATE_CONFIRM_MS, it switches back.
+#define COMMAND_TIME_SYNC_REQUEST 0x47 // [command]. Device answers at once with COMMAND_TIME_SYNC_SENDING.
+#define COMMAND_TIME_SYNC_SENDING 0x48 // [command, device's micros(), 4 bytes, little endian]
+#define COMMAND_TIMESTAMPS 0x49 // [command, on]. If on, device appends its micros() / TIMESTAMP_UNIT_MICROS, 2 bytes, to measurements.
 #define COMMAND_ERROR 0xEE
 #define COMMAND_REPORT_ALIVE 0xFF
 
 
 #define MRM_MOTORS_INACTIVITY_ALLOWED_MS 10000
 
+#define SEGMENTED_TRANSFER 0 // Use multi-frame transfers for payloads longer than 8 bytes. Device's firmware must support COMMAND_SEGMENT_* commands.
+
+#define BOARD_REQUESTS_PER_DEVICE 2 // Requests' table size, per device. Allocated at first request.
+#define BOARD_REQUEST_RETRIES 2 // Resends after the first attempt timed out.
+#define BOARD_REQUEST_TIMEOUT_MS 50 // For each attempt.
+#define REQUEST_NONE 0xFFFF // Invalid request handle.
+
+
+#define CLOCK_DRIFT_GAIN 0.05 // Part of a sync sample's error attributed to clock drift.
+#define CLOCK_OFFSET_GAIN 0.3 // Part of a sync sample's error corrected in offset.
+#define CLOCK_SYNC_PERIOD_MS 250 // Devices sending timestamps are synced in turn, one each period.
+#define CLOCK_SYNC_SLACK_MICROS 300 // A sync with round trip longer than the best one plus this waited in a queue and is ignored.
+#define TIMESTAMP_UNIT_MICROS 16 // Measurements' 16-bit timestamps count device's micros() in these units, wrapping in about 1 s.
+
 #define MAX_MOTORS_IN_GROUP 4
+#define MOTOR_SPEED_CONTROL_PERIOD_MS 10 // Wheels' speed control runs at this rate, in the loop.
+#define MOTOR_SPEED_KI 2.0 // Default integral gain, relative to feed-forward gain, 1/s.
+#define MOTOR_SPEED_KP 0.5 // Default proportional gain, relative to feed-forward gain.
+
 
 #ifndef toRad
 #define toRad(x) ((x) / 180.0 * PI) // Degrees to radians
@@ -51,7 +78,7 @@
 #endif
 
 enum BoardId{ID_MRM_8x8A, ID_ANY, ID_MRM_BLDC2X50, ID_MRM_BLDC4x2_5, ID_MRM_COL_B, ID_MRM_COL_CAN, ID_MRM_FET_CAN, ID_MRM_IR_FINDER_2, 
-	ID_MRM_IR_FINDER3, ID_MRM_IR_FINDER_CAN, ID_MRM_LID_CAN_B, ID_MRM_LID_CAN_B2, ID_MRM_MOT2X50, ID_MRM_MOT4X3_6CAN, ID_MRM_MOT4X10, 
+	ID_MRM_IR_FINDER3, ID_MRM_IR_FINDER_CAN, ID_MRM_LID_CAN_B, ID_MRM_LID_CAN_B2, ID_MRM_LID_D, ID_MRM_MOT2X50, ID_MRM_MOT4X3_6CAN, ID_MRM_MOT4X10, 
 	ID_MRM_NODE, ID_MRM_REF_CAN, ID_MRM_SERVO, ID_MRM_SWITCH, ID_MRM_THERM_B_CAN, ID_MRM_US, ID_MRM_US_B, ID_MRM_US1};
 
 enum BoardType{ANY_BOARD, MOTOR_BOARD, SENSOR_BOARD};
@@ -59,6 +86,32 @@ enum BoardType{ANY_BOARD, MOTOR_BOARD, SENSOR_BOARD};
 class Robot;
 
 class Board;
+
+enum RequestStatus{REQUEST_DONE, REQUEST_FAILED, REQUEST_PENDING, REQUEST_UNKNOWN};
+
+/** Called when a request is answered or finally timed out
+@param board - board that sent the request
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@param response - 8 bytes of the response. NULL - no response.
+*/
+typedef void (*RequestCallback)(Board* board, uint8_t deviceNumber, uint8_t* response);
+
+/** A command sent to a device, waiting for the device's response
+*/
+struct BoardRequest{
+	RequestCallback callback;
+	uint8_t deviceNumber;
+	uint8_t dlc;
+	uint8_t generation = 0; // Increased each time the slot is reused, so that an old handle is not mistaken for a new request.
+	uint8_t request[8];
+	uint8_t response[8];
+	uint8_t responseCommand; // Expected response's first byte.
+	uint8_t retriesLeft;
+	uint32_t sentMs;
+	volatile RequestStatus status = REQUEST_UNKNOWN; // Changed by decoding, maybe on the other core.
+	uint16_t timeoutMs;
+};
+
 struct BoardInfo{
 	public:
 	Board * board;
@@ -67,12 +120,26 @@ struct BoardInfo{
 	uint8_t readingsCount;
 };
 
+/** Device's clock, relative to robot's micros(), estimated by COMMAND_TIME_SYNC_REQUEST exchanges
+*/
+struct ClockSync {
+	float driftPpm; // Device's clock rate error, parts per million, positive if it runs faster.
+	volatile bool inFlight; // Request sent, not answered yet. Answers without one are ignored.
+	int32_t offsetMicros; // Device's micros() minus robot's, at syncMicros
+	uint32_t requestMicros; // Time the last request was sent
+	uint32_t roundTripMicros; // Best round trip, slowly forgotten
+	uint16_t samples; // Accepted syncs. 0 - not synced.
+	uint32_t syncMicros; // Robot's time of the last accepted sync
+	bool timestamps; // Device appends timestamps and is synced periodically
+};
+
 /** Board is a class of all the boards of the same type, not a single board!
 */
-class Board{
+class Board : public SegmentLink{
 protected:
 	uint32_t _alive; // Responded to ping, maximum 32 devices of the same class, stored bitwise.
 	bool _aliveReport = false;
+	uint32_t _bitrateAccepted = 0; // Devices that accepted proposed bitrate, bitwise.
 	char _boardsName[12];
 	BoardType _boardType; // To differentiate derived boards
 	uint8_t canData[8]; // Array used to store temporary CAN Bus data
@@ -84,15 +151,28 @@ protected:
 	BoardId _id;
 	std::vector<uint32_t>* idIn;  // Inbound message id
 	std::vector<uint32_t>* idOut; // Outbound message id
+	std::vector<uint32_t>* _acquisitionMicros; // Last measurement's time, robot's micros(), from device's timestamp if it sends them.
+	std::vector<ClockSync>* clockSyncs;
+	uint32_t _clockSyncMs = 0;
+	uint8_t _clockSyncNext = 0; // Next device to be synced periodically
+	std::vector<uint32_t>* lastMessageReceivedMicros; // Taken when received, maybe in CAN Bus task.
 	std::vector<uint32_t>* lastMessageReceivedMs;
 	std::vector<uint32_t>* _lastReadingMs;
+	std::vector<uint32_t>* pingMs; // Last background presence check
 	uint8_t maximumNumberOfBoards;
 	uint8_t measuringMode = 0;
 	uint8_t measuringModeLimit = 0;
 	uint8_t _message[29]; // Message a device sent.
 	std::vector<char[10]>* _name;// Device's name
 	int nextFree;
+	std::vector<BoardRequest>* requests = NULL; // Commands waiting for response
+	uint8_t _requestNext = 0; // Next slot to try when a new request is needed
+	uint16_t _requestMatched = REQUEST_NONE; // Handle of the request answered by the message being decoded.
+	volatile uint8_t _requestsPending = 0;
+	uint16_t _requestsFailed = 0;
+	uint16_t _requestsRetried = 0;
 	Robot* robotContainer;
+	Segmenter* segmenter; // Multi-frame transfers
 
 	/** Common part of message decoding
 	@param canId - CAN Bus id
@@ -102,6 +182,48 @@ protected:
 	*/
 	bool messageDecodeCommon(uint32_t canId, uint8_t data[8], uint8_t deviceNumber = 0);
 
+	/** Processes device's answer to clock sync request. Round trip's middle is taken as the moment device read its clock. Offset and
+	drift are corrected by a part of the error, so that a single bad sample does not spoil them.
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@param deviceMicros - device's micros() in the answer
+	@param receivedMicros - robot's micros() when the answer was received
+	*/
+	void clockSyncDecode(uint8_t deviceNumber, uint32_t deviceMicros, uint32_t receivedMicros);
+
+	/** Sets measurement's acquisition time from device's timestamp. Call in derived decoders when a measurement carries one.
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@param timestamp - device's micros() / TIMESTAMP_UNIT_MICROS, lower 16 bits.
+	*/
+	void timestampDecode(uint8_t deviceNumber, uint16_t timestamp);
+
+	/** Finds a pending request the message answers and keeps the response. The request stays pending till requestComplete(), called after
+	the whole message is decoded.
+	@param data - 8 bytes from CAN Bus message.
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	*/
+	void requestMatch(uint8_t data[8], uint8_t deviceNumber);
+
+	/** Sends a frame of a multi-frame transfer
+	@param frame - data
+	@param length - number of bytes
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	*/
+	void segmentFrameSend(uint8_t* frame, uint8_t length, uint8_t deviceNumber);
+
+	/** Waits for flow control of a multi-frame transfer, decoding frames that arrive meanwhile
+	@param micros - time to wait
+	*/
+	void segmentWait(uint32_t micros);
+
+	/** Multi-frame transfer completed. Override to handle device specific commands.
+	@param command - command carried by the transfer
+	@param data - payload
+	@param size - payload's size
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@return - command handled
+	*/
+	virtual bool segmentedReceived(uint8_t command, uint8_t* data, uint16_t size, uint8_t deviceNumber);
+
 public:
 	
 	/**
@@ -133,17 +255,78 @@ public:
 	*/
 	bool canGap();
 
+	/** Time of the last measurement, corrected for device's clock if it sends timestamps, otherwise time of receiving.
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@return - robot's micros()
+	*/
+	uint32_t acquisitionMicros(uint8_t deviceNumber = 0) { return (*_acquisitionMicros)[deviceNumber]; }
+
+	/** Sends a clock sync request. The answer refines device's clock offset and drift.
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	*/
+	void clockSync(uint8_t deviceNumber = 0);
+
+	/** Syncs the next device sending timestamps, if CLOCK_SYNC_PERIOD_MS passed. Call in each loop pass.
+	*/
+	void clockSyncRefresh();
+
+	/** Device's clock estimate
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@return - estimate. samples is 0 if not synced yet.
+	*/
+	const ClockSync* clockSyncState(uint8_t deviceNumber = 0) { return &(*clockSyncs)[deviceNumber]; }
+
 	/** Did any device respond to last ping?
 	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
 	*/
 	uint8_t count();
 
+	/** Converts device's time to robot's
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@param deviceMicros - device's micros()
+	@return - robot's micros(). Unchanged if not synced.
+	*/
+	uint32_t deviceToRobotMicros(uint8_t deviceNumber, uint32_t deviceMicros);
+
+	/** Converts robot's time to device's
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@param robotMicros - robot's micros()
+	@return - device's micros(). Unchanged if not synced.
+	*/
+	uint32_t robotToDeviceMicros(uint8_t deviceNumber, uint32_t robotMicros);
+
+	/** Device's measurements carry its timestamps. Periodic clock syncs start, too.
+	@param on - on or off
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0. 0xFF - all devices.
+	*/
+	void timestampsSet(bool on, uint8_t deviceNumber = 0xFF);
+
 	/** Set aliveness
 	@param yesOrNo
 	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
 	*/
 	void aliveSet(bool yesOrNo, uint8_t deviceNumber = 0);
 
+	/** All devices' aliveness
+	@return - bitwise, bit 0 for device 0, etc.
+	*/
+	uint32_t aliveMask() { return _alive; }
+
+	/** Did all the alive devices accept the bitrate proposed by bitratePropose()?
+	@return - accepted
+	*/
+	bool bitrateAccepted() { return (_bitrateAccepted & _alive) == _alive; }
+
+	/** Tells all the alive devices to switch to a new bitrate. They must have accepted it before.
+	@param bitrateKbps - kbit/s
+	*/
+	void bitrateCommit(uint16_t bitrateKbps);
+
+	/** Proposes a new bitrate to all the alive devices, without waiting for answers. Check bitrateAccepted() after requests complete.
+	@param bitrateKbps - kbit/s
+	*/
+	void bitratePropose(uint16_t bitrateKbps);
+
 	BoardType boardType(){ return _boardType; }
 
 	/** Count all the devices, alive or not
@@ -202,7 +385,8 @@ public:
 	*/
 	BoardId id() { return _id; }
 
-	/** Change CAN Bus id
+	/** Change CAN Bus id. Frames with the new id pass the CAN Bus filter if a device with that number was added, as all the added
+	devices' ids are registered.
 	@param newDeviceNumber - new number
 	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
 	*/
@@ -236,9 +420,10 @@ public:
 	/** Read CAN Bus message into local variables
 	@param canId - CAN Bus id
 	@param data - 8 bytes from CAN Bus message.
+	@param length - number of data bytes
 	@return - true if canId for this class
 	*/
-	virtual bool messageDecode(uint32_t canId, uint8_t data[8]) = 0;
+	virtual bool messageDecode(uint32_t canId, uint8_t data[8], uint8_t length) = 0;
 
 	/** Prints a frame
 	@param msgId - messageId
@@ -267,6 +452,18 @@ public:
 	*/
 	char* name() {return _boardsName;}
 
+	/** CAN Bus id the device sends its messages with
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@return - id
+	*/
+	uint32_t idOutOf(uint8_t deviceNumber) { return (*idOut)[deviceNumber]; }
+
+	/** Name of the device a frame is addressed to or originates from
+	@param canId - CAN Bus id.
+	@return - name, NULL if not this board's id
+	*/
+	char* nameOfId(uint32_t canId);
+
 	/** Request notification
 	@param commandRequestingNotification
 	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
@@ -278,11 +475,87 @@ public:
 	*/
 	void oscillatorTest(uint8_t deviceNumber = 0xFF);
 
+	/** Background presence check, without waiting. Marks the device dead if it did not answer the previous check, and pings it again.
+	Any message received from the device marks it alive.
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	*/
+	void presenceCheck(uint8_t deviceNumber);
+
 	/** Reset
 	@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0. 0xFF - all devices.
 	*/
 	void reset(uint8_t deviceNumber = 0xFF);
 
+	/** Sends a command and expects a response, without waiting. A request with the same response for the same device, still pending, is
+	replaced. Many requests, to different devices, can be in flight at the same time. Call requestsRefresh() in each loop pass.
+	@param data - payload
+	@param dlc - data length
+	@param responseCommand - first byte of the expected response
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@param callback - called when the response arrives or after last retry timed out. NULL - none, use requestStatus().
+	@param timeoutMs - for each attempt
+	@param retries - resends after the first attempt
+	@return - handle for requestStatus(), REQUEST_NONE if no free slot
+	*/
+	uint16_t request(uint8_t* data, uint8_t dlc, uint8_t responseCommand, uint8_t deviceNumber = 0, RequestCallback callback = NULL,
+		uint16_t timeoutMs = BOARD_REQUEST_TIMEOUT_MS, uint8_t retries = BOARD_REQUEST_RETRIES);
+
+	/** Completes the request the last decoded message answered, if any. Call after messageDecode(), so that the payload the board stores
+	from the response is there when the request is seen done.
+	*/
+	void requestComplete();
+
+	/** Request's status
+	@param handle - returned by request()
+	@param response - output, 8 bytes of the response, if done. NULL - not needed.
+	@return - status. REQUEST_UNKNOWN if the slot has been reused.
+	*/
+	RequestStatus requestStatus(uint16_t handle, uint8_t* response = NULL);
+
+	/** Waits for a request to complete, keeping the robot's loop running
+	@param handle - returned by request()
+	@return - final status
+	*/
+	RequestStatus requestWait(uint16_t handle);
+
+	/** Requests not answered after all the retries
+	@return - count
+	*/
+	uint16_t requestsFailed() { return _requestsFailed; }
+
+	/** Any request in flight?
+	@return - pending or not
+	*/
+	bool requestsPending() { return _requestsPending != 0; }
+
+	/** Resends timed-out requests or fails them when no retry is left. Call in each loop pass.
+	*/
+	void requestsRefresh();
+
+	/** Attempts repeated because of a timeout
+	@return - count
+	*/
+	uint16_t requestsRetried() { return _requestsRetried; }
+
+	/** Sends a payload longer than a single CAN Bus frame allows, using first frame, flow control and consecutive frames.
+	@param command - command carried by the transfer
+	@param data - payload
+	@param size - payload's size, up to SEGMENT_BUFFER_SIZE
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@return - true if sent, false if the device did not accept the transfer. Then the caller should use single-frame commands.
+	*/
+	bool segmentedSend(uint8_t command, const uint8_t* data, uint16_t size, uint8_t deviceNumber = 0);
+
+	/** Transfers aborted due to a missing or out-of-order frame
+	@return - count
+	*/
+	uint16_t segmentsLost() { return segmenter->lost(); }
+
+	/** Transfers aborted because the other side did not respond
+	@return - count
+	*/
+	uint16_t segmentTimeouts() { return segmenter->timeouts(); }
+
 	/** Starts periodical CANBus messages that will be refreshing values that can be read by reading()
 	@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0. 0xFF - all devices.
 	@param measuringModeNow - Measuring mode id. Default 0.
@@ -311,9 +584,15 @@ public:
 
 
 
+class MotorGroup;
+
 class MotorBoard : public Board {
 protected:
 	std::vector<uint32_t>* encoderCount; // Encoder count
+	std::vector<uint32_t>* encoderMicros; // Time of last encoder frame, 0 - none yet
+	std::vector<float>* encoderTicksPerSecond; // From last 2 frames, in motor's positive direction
+	std::vector<MotorGroup*>* odometryGroup; // Group integrating this motor's encoder, NULL - none
+	std::vector<uint8_t>* odometryWheel; // Motor's index in the group
 	std::vector<bool>* reversed; // Change rotation
 	std::vector<int8_t>* lastSpeed;
 
@@ -339,18 +618,32 @@ public:
 	*/
 	void directionChange(uint8_t deviceNumber);
 
+	/** Encoder's speed, from the last 2 encoder frames
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@return - ticks per second, positive in motor's positive direction
+	*/
+	float encoderSpeed(uint8_t deviceNumber) { return (*encoderTicksPerSecond)[deviceNumber]; }
+
 	/** Read CAN Bus message into local variables
 	@param canId - CAN Bus id
 	@param data - 8 bytes from CAN Bus message.
+	@param length - number of data bytes
 	@return - true if canId for this class
 	*/
-	bool messageDecode(uint32_t canId, uint8_t data[8]);
+	bool messageDecode(uint32_t canId, uint8_t data[8], uint8_t length);
+
+	/** Feeds motor's encoder changes to a group's odometry, as they are decoded
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@param group - group, NULL - none
+	@param wheel - motor's index in the group
+	*/
+	void odometryAttach(uint8_t deviceNumber, MotorGroup* group, uint8_t wheel);
 
 	/** Encoder readings
 	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
 	@return - encoder value
 	*/
-	uint16_t reading(uint8_t deviceNumber);
+	uint32_t reading(uint8_t deviceNumber);
 
 	/** Print all readings in a line
 	*/
@@ -417,9 +710,10 @@ public:
 	/** Read CAN Bus message into local variables
 	@param canId - CAN Bus id
 	@param data - 8 bytes from CAN Bus message.
+	@param length - number of data bytes
 	@return - true if canId for this class
 	*/
-	virtual bool messageDecode(uint32_t canId, uint8_t data[8]){return false;}
+	virtual bool messageDecode(uint32_t canId, uint8_t data[8], uint8_t length){return false;}
 
 	/** All readings
 	@param subsensorNumberInSensor - like a single IR transistor in mrm-ref-can
@@ -433,22 +727,113 @@ public:
 
 //typedef void (*SpeedSetFunction)(uint8_t motorNumber, int8_t speed);
 
+/** Gains of a wheel's speed controller. Duty is -127 - 127, speed in encoder ticks per second.
+*/
+struct WheelSpeedGains {
+	float feedForward; // Duty per tick/s
+	float kI; // Duty per tick
+	float kP; // Duty per tick/s
+};
+
 class MotorGroup {
 protected:
 	MotorBoard* motorBoard[MAX_MOTORS_IN_GROUP] = { NULL, NULL, NULL, NULL }; // Motor board for each wheel. It can the same, but need not be.
 	uint8_t motorNumber[MAX_MOTORS_IN_GROUP];
+	float odometryBaseMm = 0; // Differential: track width. Star: center to wheel.
+	float odometryMmPerTick = 0; // 0 - odometry off
+	uint16_t odometryTicksPerRevolution = 0;
+	Odometry _odometry; // Integrated only by encoderDecoded()
 	Robot* robotContainer;
+	bool _speedControl = false;
+	uint32_t _speedControlMicros = 0; // Last control step, 0 - none yet
+	WheelSpeedGains _speedGains[MAX_MOTORS_IN_GROUP];
+	float _speedIntegral[MAX_MOTORS_IN_GROUP];
+	float _speedTarget[MAX_MOTORS_IN_GROUP]; // Ticks per second
 
 	/** Angle between -180 and 180 degrees
 	@return - angle
 	*/
 	float angleNormalized(float angle);
+
+	/** A wheel's movement expressed as the robot's movement, in the robot's coordinate system. Wheels' contributions add up.
+	@param wheel - motor's index in the group
+	@param mm - wheel's movement, positive in motor's positive direction
+	@param forward - output, mm
+	@param right - output, mm
+	@param rotation - output, radians, positive to the right
+	*/
+	virtual void odometryWheel(uint8_t wheel, float mm, float* forward, float* right, float* rotation);
+
+	/** Calculates and sends all the wheels' duties. If any duty is out of range, all are scaled down together, preserving direction, and
+	integrators are held.
+	@param micros - time
+	*/
+	void speedControlStep(uint32_t micros);
 public:
 	MotorGroup(Robot* robot);
 
-	/** Stop motors
+	/** Integrates an encoder change into the pose. Called by MotorBoard while decoding its frame.
+	@param wheel - motor's index in the group
+	@param ticks - change since the previous frame, positive in motor's positive direction
+	@param micros - frame's time
+	*/
+	void encoderDecoded(uint8_t wheel, int32_t ticks, uint32_t micros);
+
+	/** Starts odometry. Motors' encoders must be running (MotorBoard::start()).
+	@param ticksPerRevolution - encoder ticks for one wheel revolution
+	@param wheelDiameterMm - wheel's diameter
+	@param baseMm - differential drive: distance between left and right wheels. Star: distance between robot's center and a wheel.
+	*/
+	void odometryStart(uint16_t ticksPerRevolution, float wheelDiameterMm, float baseMm);
+
+	/** Current pose. Safe to call at any time, also while frames are being decoded, without locking.
+	@return - pose
+	*/
+	OdometryPose pose();
+
+	/** Sets the pose, for example when the robot's position becomes known
+	@param x - mm
+	@param y - mm
+	@param heading - degrees, positive to the right
+	*/
+	void poseSet(float x = 0, float y = 0, float heading = 0);
+
+	/** Starts closed-loop speed control of all the wheels, with default gains. Motors' encoders must be running (MotorBoard::start()).
+	Open-loop go() stops it.
+	@param maxTicksPerSecond - wheel's speed at full duty, for feed-forward
+	*/
+	void speedControlStart(float maxTicksPerSecond);
+
+	/** Runs a speed control step if it is due. Called by Robot in each loop pass.
+	*/
+	void speedControlRefresh();
+
+	/** Stops speed control and motors
+	*/
+	void speedControlStop();
+
+	/** Sets a wheel's speed controller's gains, for example when a motor is weaker than the others
+	@param wheel - motor's index in the group
+	@param feedForward - duty per tick/s
+	@param kP - duty per tick/s of error
+	@param kI - duty per tick of accumulated error
+	*/
+	void speedGainsSet(uint8_t wheel, float feedForward, float kP, float kI);
+
+	/** Stops motors and speed control, clearing its targets and integrators
 	*/
 	void stop();
+
+	/** Sets wheels' target speeds. The first control step is done at once.
+	@param ticksPerSecond - for each wheel, positive in motor's positive direction
+	*/
+	void wheelSpeedsSet(const float ticksPerSecond[MAX_MOTORS_IN_GROUP]);
+
+	/** Wheel's angular speed, from encoder
+	@param wheel - motor's index in the group
+	@return - radians per second, positive in motor's positive direction
+	*/
+	float wheelSpeed(uint8_t wheel);
 };
 
 /** Motor group for tank-like propulsion.
@@ -461,6 +846,17 @@ private:
 	*/
 	int16_t checkBounds(int16_t speed);
 
+protected:
+	/** A wheel's movement expressed as the robot's movement. Left wheels (0 and 2) drive forward with positive speed, right ones (1 and 3)
+	with negative, as in go().
+	@param wheel - motor's index in the group
+	@param mm - wheel's movement, positive in motor's positive direction
+	@param forward - output, mm
+	@param right - output, mm
+	@param rotation - output, radians, positive to the right
+	*/
+	void odometryWheel(uint8_t wheel, float mm, float* forward, float* right, float* rotation);
+
 public:
 	/** Constructor
 	@param motorBoardForLeft1 - Controller for one of the left wheels
@@ -481,11 +877,27 @@ public:
 	@param speedLimit - Speed limit, 0 to 127. For example, 80 will limit all the speeds to 80/127%. 0 will turn the motors off.
 	*/
 	void go(int16_t leftSpeed = 0, int16_t rightSpeed = 0, int16_t lateralSpeedToRight = 0, uint8_t speedLimit = 127);
+
+	/** Drives with closed-loop speed control, started by speedControlStart()
+	@param leftTicksPerSecond - left wheels' speed, positive forward
+	@param rightTicksPerSecond - right wheels' speed, positive forward
+	*/
+	void goSpeed(float leftTicksPerSecond, float rightTicksPerSecond);
 };
 
 /** Motors' axles for a star - they all point to a central point. Useful for driving soccer robots with omni-wheels.
 */
 class MotorGroupStar : public MotorGroup {
+protected:
+	/** A wheel's movement expressed as the robot's movement. As in go(), a positive speed drives the wheel clockwise around the center.
+	@param wheel - motor's index in the group
+	@param mm - wheel's movement, positive in motor's positive direction
+	@param forward - output, mm
+	@param right - output, mm
+	@param rotation - output, radians, positive to the right
+	*/
+	void odometryWheel(uint8_t wheel, float mm, float* forward, float* right, float* rotation);
+
 public:
 	/**
 	@param motorBoardFor45Degrees - motor controller for the motor which axle is inclined 45 degrees clockwise from robot's front.
@@ -510,6 +922,14 @@ public:
 	*/
 	void go(float speed, float angleDegrees = 0, float rotation = 0, uint8_t speedLimit = 127);
 
+	/** Drives with closed-loop speed control, started by speedControlStart(). Wheels' speeds are calculated as in go().
+	@param ticksPerSecond - translation speed, in wheel's encoder ticks per second
+	@param angleDegrees - Movement direction in a robot's coordinate system, in degrees. 0 degree is the front of the robot and positive angles
+	are to the right.
+	@param rotationTicksPerSecond - rotation's share of each wheel's speed, positive to the right
+	*/
+	void goSpeed(float ticksPerSecond, float angleDegrees = 0, float rotationTicksPerSecond = 0);
+
 	/** Moves the robot in order to elinimate errors (for x and y directions).
 	@param errorX - X axis error.
 	@param errorY - Y axis error.
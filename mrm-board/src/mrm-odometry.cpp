@@ -0,0 +1,158 @@
+#include "mrm-odometry.h"
+#include "Arduino.h"
+
+/** Angle between -180 and 180 degrees
+@param angle - degrees, -540 - 540
+@return - angle
+*/
+static float angleNormalized(float angle) {
+	if (angle < -180)
+		angle += 360;
+	else if (angle > 180)
+		angle -= 360;
+	return angle;
+}
+
+/** Adds a movement, given in the robot's coordinate system, at the heading in the middle of it
+@param forward - mm
+@param right - mm
+@param rotation - radians, positive to the right
+@param micros - time of the movement's end
+*/
+void Odometry::integrate(float forward, float right, float rotation, uint32_t micros) {
+	float headingMiddle = _headingRadians + rotation / 2; // Heading in the middle of the movement
+	float si = sinf(headingMiddle);
+	float co = cosf(headingMiddle);
+
+	_sequence++;
+	__sync_synchronize();
+	_pose.x += forward * si + right * co;
+	_pose.y += forward * co - right * si;
+	_headingRadians += rotation;
+	_pose.heading = angleNormalized(fmodf(_headingRadians * RAD_TO_DEG, 360));
+	_pose.micros = micros;
+	__sync_synchronize();
+	_sequence++;
+}
+
+/** Current pose. Safe to call at any time, also while it is being integrated.
+@return - pose
+*/
+OdometryPose Odometry::pose() {
+	OdometryPose copy;
+	uint32_t sequence;
+	do {
+		sequence = _sequence;
+		__sync_synchronize();
+		copy = _pose;
+		__sync_synchronize();
+	} while ((sequence & 1) || sequence != _sequence); // Written meanwhile
+	return copy;
+}
+
+/** Sets the pose
+@param x - mm
+@param y - mm
+@param heading - degrees, positive to the right
+@param micros - time
+*/
+void Odometry::set(float x, float y, float heading, uint32_t micros) {
+	_sequence++;
+	__sync_synchronize();
+	_pose.x = x;
+	_pose.y = y;
+	_pose.heading = angleNormalized(heading);
+	_pose.micros = micros;
+	_headingRadians = heading * DEG_TO_RAD;
+	__sync_synchronize();
+	_sequence++;
+	_wheelsForward = 0;
+	_wheelsRight = 0;
+	_wheelsRotation = 0;
+	_wheelsReported = 0;
+}
+
+/** Adds a wheel's share of the robot's movement. Wheels report in turn, so their shares are summed and integrated together when all
+the wheels have reported, or one reports again. Integrated separately, each wheel would turn the robot back and forth, and
+the error would add up.
+@param wheel - motor's index in the group
+@param forward - mm
+@param right - mm
+@param rotation - radians, positive to the right
+@param micros - frame's time
+*/
+void Odometry::wheelAdd(uint8_t wheel, float forward, float right, float rotation, uint32_t micros) {
+	if (_wheelsReported & (1 << wheel)) // Another wheel's frame lost
+		wheelsIntegrate(micros);
+	_wheelsForward += forward;
+	_wheelsRight += right;
+	_wheelsRotation += rotation;
+	_wheelsReported |= 1 << wheel;
+	if ((_wheelsReported & _wheelsUsed) == _wheelsUsed)
+		wheelsIntegrate(micros);
+}
+
+/** Integrates the wheels' movements summed so far
+@param micros - time of the last frame
+*/
+void Odometry::wheelsIntegrate(uint32_t micros) {
+	integrate(_wheelsForward, _wheelsRight, _wheelsRotation, micros);
+	_wheelsForward = 0;
+	_wheelsRight = 0;
+	_wheelsRotation = 0;
+	_wheelsReported = 0;
+}
+
+/** Wheels reporting
+@param mask - bitwise, wheel 0 in bit 0
+*/
+void Odometry::wheelsSet(uint8_t mask) {
+	_wheelsUsed = mask;
+	_wheelsReported = 0;
+}
+
+/** A differential (tank) drive wheel's movement expressed as the robot's movement. Left wheels (0 and 2) drive forward with positive
+movement, right ones (1 and 3) with negative.
+@param wheel - motor's index in the group
+@param mm - wheel's movement, positive in motor's positive direction
+@param wheelsOnSide - 1 or 2. Side's movement is its wheels' average.
+@param baseMm - track width
+@param forward - output, mm
+@param right - output, mm
+@param rotation - output, radians, positive to the right
+*/
+void odometryDifferential(uint8_t wheel, float mm, uint8_t wheelsOnSide, float baseMm, float* forward, float* right, float* rotation) {
+	bool left = wheel % 2 == 0;
+	float sideMm = (left ? mm : -mm) / wheelsOnSide;
+	*forward = sideMm / 2;
+	*right = 0;
+	*rotation = (left ? sideMm : -sideMm) / baseMm;
+}
+
+/** A star (omni wheels) drive wheel's movement expressed as the robot's movement. Axles are at 45, 135, -135 and -45 degrees, a positive
+movement drives the wheel clockwise around the center.
+@param wheel - motor's index in the group
+@param mm - wheel's movement, positive in motor's positive direction
+@param baseMm - center to wheel
+@param forward - output, mm
+@param right - output, mm
+@param rotation - output, radians, positive to the right
+*/
+void odometryStar(uint8_t wheel, float mm, float baseMm, float* forward, float* right, float* rotation) {
+	static const float axleDegrees[4] = { 45, 135, -135, -45 };
+	float axle = axleDegrees[wheel] * DEG_TO_RAD;
+	*forward = sinf(axle) * mm / 2;
+	*right = -cosf(axle) * mm / 2;
+	*rotation = mm / (4 * baseMm);
+}
+
+/** Encoder's change between 2 readings, correct when the counter wraps around
+@param count - new reading
+@param previous - previous reading
+@param reversed - motor mounted reversed
+@return - ticks, positive in motor's positive direction
+*/
+int32_t odometryTicks(uint32_t count, uint32_t previous, bool reversed) {
+	int32_t ticks = (int32_t)(count - previous);
+	return reversed ? -ticks : ticks;
+}
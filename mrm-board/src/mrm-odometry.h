@@ -0,0 +1,105 @@
+#pragma once
+#include <stdint.h>
+
+/**
+Purpose: odometry's kinematics and pose integration, used by MotorGroup. No hardware access, so the same code runs on a host computer.
+@author MRMS team
+@version 0.0 2026-10-19
+Licence: You can use this code any way you like.
+*/
+
+/** Robot's position and heading, relative to the pose at odometryStart() or poseSet(). y is robot's initial front, x to the right.
+*/
+struct OdometryPose {
+	float heading; // Degrees, -180 - 180, positive to the right.
+	uint32_t micros; // Time of the last encoder frame included
+	float x; // mm
+	float y; // mm
+};
+
+/** Pose integrated from the robot's movements. Written by one thread, read by any, without locking.
+*/
+class Odometry {
+	float _headingRadians = 0; // Not normalized
+	OdometryPose _pose = { 0, 0, 0, 0 };
+	volatile uint32_t _sequence = 0; // Odd while _pose is being written
+	float _wheelsForward = 0; // Wheels' movements since the last integration, summed
+	float _wheelsRight = 0;
+	float _wheelsRotation = 0;
+	uint8_t _wheelsReported = 0; // Bitwise
+	uint8_t _wheelsUsed = 0; // Bitwise
+
+	/** Integrates the wheels' movements summed so far
+	@param micros - time of the last frame
+	*/
+	void wheelsIntegrate(uint32_t micros);
+
+public:
+	/** Adds a movement, given in the robot's coordinate system, at the heading in the middle of it
+	@param forward - mm
+	@param right - mm
+	@param rotation - radians, positive to the right
+	@param micros - time of the movement's end
+	*/
+	void integrate(float forward, float right, float rotation, uint32_t micros);
+
+	/** Current pose. Safe to call at any time, also while it is being integrated.
+	@return - pose
+	*/
+	OdometryPose pose();
+
+	/** Sets the pose
+	@param x - mm
+	@param y - mm
+	@param heading - degrees, positive to the right
+	@param micros - time
+	*/
+	void set(float x, float y, float heading, uint32_t micros);
+
+	/** Adds a wheel's share of the robot's movement. Wheels report in turn, so their shares are summed and integrated together when all
+	the wheels have reported, or one reports again. Integrated separately, each wheel would turn the robot back and forth, and
+	the error would add up.
+	@param wheel - motor's index in the group
+	@param forward - mm
+	@param right - mm
+	@param rotation - radians, positive to the right
+	@param micros - frame's time
+	*/
+	void wheelAdd(uint8_t wheel, float forward, float right, float rotation, uint32_t micros);
+
+	/** Wheels reporting
+	@param mask - bitwise, wheel 0 in bit 0
+	*/
+	void wheelsSet(uint8_t mask);
+};
+
+/** A differential (tank) drive wheel's movement expressed as the robot's movement. Left wheels (0 and 2) drive forward with positive
+movement, right ones (1 and 3) with negative.
+@param wheel - motor's index in the group
+@param mm - wheel's movement, positive in motor's positive direction
+@param wheelsOnSide - 1 or 2. Side's movement is its wheels' average.
+@param baseMm - track width
+@param forward - output, mm
+@param right - output, mm
+@param rotation - output, radians, positive to the right
+*/
+void odometryDifferential(uint8_t wheel, float mm, uint8_t wheelsOnSide, float baseMm, float* forward, float* right, float* rotation);
+
+/** A star (omni wheels) drive wheel's movement expressed as the robot's movement. Axles are at 45, 135, -135 and -45 degrees, a positive
+movement drives the wheel clockwise around the center.
+@param wheel - motor's index in the group
+@param mm - wheel's movement, positive in motor's positive direction
+@param baseMm - center to wheel
+@param forward - output, mm
+@param right - output, mm
+@param rotation - output, radians, positive to the right
+*/
+void odometryStar(uint8_t wheel, float mm, float baseMm, float* forward, float* right, float* rotation);
+
+/** Encoder's change between 2 readings, correct when the counter wraps around
+@param count - new reading
+@param previous - previous reading
+@param reversed - motor mounted reversed
+@return - ticks, positive in motor's positive direction
+*/
+int32_t odometryTicks(uint32_t count, uint32_t previous, bool reversed);
@@ -0,0 +1,164 @@
+#include "mrm-segment.h"
+
+/** Constructor
+@param link - bus
+@param maxDevices - maximum number of devices
+*/
+Segmenter::Segmenter(SegmentLink* link, uint8_t maxDevices) {
+	_link = link;
+	_transfers = new std::vector<SegmentedTransfer*>(maxDevices);
+}
+
+/** Prepares a device's buffer
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+*/
+void Segmenter::add(uint8_t deviceNumber) {
+	(*_transfers)[deviceNumber] = new SegmentedTransfer();
+}
+
+/** Decodes a frame of a multi-frame transfer
+@param data - 8 bytes from CAN Bus message.
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@return - false if the announced transfer is too big. It is refused.
+*/
+bool Segmenter::decode(uint8_t data[8], uint8_t deviceNumber) {
+	SegmentedTransfer* transfer = (*_transfers)[deviceNumber];
+	switch (data[0]) {
+	case COMMAND_SEGMENT_FIRST:
+		if (transfer->receiving) // Previous transfer not finished
+			_lost++;
+		transfer->supported = true;
+		transfer->command = data[1];
+		transfer->size = data[2] | (data[3] << 8);
+		if (transfer->size > SEGMENT_BUFFER_SIZE) {
+			transfer->receiving = false;
+			flowControlSend(SEGMENT_FLOW_ABORT, deviceNumber);
+			return false;
+		}
+		transfer->received = transfer->size < 4 ? transfer->size : 4;
+		memcpy(transfer->buffer, data + 4, transfer->received);
+		transfer->sequence = 1;
+		transfer->blockReceived = 0;
+		transfer->lastFrameMs = millis();
+		transfer->receiving = transfer->received < transfer->size;
+		if (transfer->receiving)
+			flowControlSend(SEGMENT_FLOW_CONTINUE, deviceNumber);
+		else {
+			transfer->buffer[transfer->size] = '\0';
+			_link->segmentedReceived(transfer->command, transfer->buffer, transfer->size, deviceNumber);
+		}
+		break;
+	case COMMAND_SEGMENT_CONSECUTIVE: {
+		if (!transfer->receiving) // Rest of an aborted transfer
+			break;
+		if (data[1] != transfer->sequence || millis() - transfer->lastFrameMs > SEGMENT_TIMEOUT_MS) {
+			transfer->receiving = false;
+			_lost++;
+			flowControlSend(SEGMENT_FLOW_ABORT, deviceNumber);
+			break;
+		}
+		uint16_t count = transfer->size - transfer->received < 6 ? transfer->size - transfer->received : 6;
+		memcpy(transfer->buffer + transfer->received, data + 2, count);
+		transfer->received += count;
+		transfer->sequence++;
+		transfer->lastFrameMs = millis();
+		if (transfer->received >= transfer->size) {
+			transfer->receiving = false;
+			transfer->buffer[transfer->size] = '\0';
+			_link->segmentedReceived(transfer->command, transfer->buffer, transfer->size, deviceNumber);
+		}
+		else if (SEGMENT_BLOCK_SIZE != 0 && ++transfer->blockReceived >= SEGMENT_BLOCK_SIZE) {
+			transfer->blockReceived = 0;
+			flowControlSend(SEGMENT_FLOW_CONTINUE, deviceNumber);
+		}
+	}
+		break;
+	case COMMAND_SEGMENT_FLOW_CONTROL:
+		transfer->supported = true;
+		transfer->flowBlockSize = data[2];
+		transfer->flowSeparationMs = data[3];
+		transfer->flowStatus = data[1];
+		break;
+	}
+	return true;
+}
+
+/** Sends flow control frame for a transfer being received
+@param status - SEGMENT_FLOW_CONTINUE, SEGMENT_FLOW_WAIT or SEGMENT_FLOW_ABORT
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+*/
+void Segmenter::flowControlSend(uint8_t status, uint8_t deviceNumber) {
+	uint8_t frame[4]; // Not a shared buffer, a transfer can be received while another message is being composed.
+	frame[0] = COMMAND_SEGMENT_FLOW_CONTROL;
+	frame[1] = status;
+	frame[2] = SEGMENT_BLOCK_SIZE;
+	frame[3] = 0; // No separation needed, frames are queued.
+	_link->segmentFrameSend(frame, 4, deviceNumber);
+}
+
+/** Sends a payload longer than a single CAN Bus frame allows, using first frame, flow control and consecutive frames.
+@param command - command carried by the transfer
+@param data - payload
+@param size - payload's size, up to SEGMENT_BUFFER_SIZE
+@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@return - true if sent, false if the device did not accept the transfer. Then the caller should use single-frame commands.
+*/
+bool Segmenter::send(uint8_t command, const uint8_t* data, uint16_t size, uint8_t deviceNumber) {
+	SegmentedTransfer* transfer = (*_transfers)[deviceNumber];
+	if (size > SEGMENT_BUFFER_SIZE || !transfer->supported)
+		return false;
+
+	uint8_t frame[8]; // Not a shared buffer, it may be changed by messages received while waiting for flow control.
+	uint16_t sent = size < 4 ? size : 4;
+	frame[0] = COMMAND_SEGMENT_FIRST;
+	frame[1] = command;
+	frame[2] = size & 0xFF;
+	frame[3] = size >> 8;
+	memcpy(frame + 4, data, sent);
+	transfer->flowStatus = SEGMENT_FLOW_NONE;
+	_link->segmentFrameSend(frame, 4 + sent, deviceNumber);
+
+	uint8_t sequence = 1;
+	uint8_t waits = 0;
+	while (sent < size) {
+		// Wait for flow control
+		uint32_t startMs = millis();
+		while (transfer->flowStatus == SEGMENT_FLOW_NONE && millis() - startMs < SEGMENT_TIMEOUT_MS)
+			_link->segmentWait(100);
+
+		switch (transfer->flowStatus) {
+		case SEGMENT_FLOW_NONE: // Old firmware or device dead. Do not try again.
+			_timeouts++;
+			transfer->supported = false;
+			return false;
+		case SEGMENT_FLOW_WAIT:
+			if (++waits > SEGMENT_WAITS_LIMIT) {
+				_timeouts++;
+				return false;
+			}
+			transfer->flowStatus = SEGMENT_FLOW_NONE;
+			continue;
+		case SEGMENT_FLOW_CONTINUE:
+			break;
+		default:
+			_lost++;
+			return false;
+		}
+
+		// Send a block of consecutive frames
+		uint8_t blockSize = transfer->flowBlockSize;
+		uint8_t separationMs = transfer->flowSeparationMs;
+		transfer->flowStatus = SEGMENT_FLOW_NONE;
+		for (uint8_t i = 0; sent < size && (blockSize == 0 || i < blockSize); i++) {
+			uint8_t count = size - sent < 6 ? size - sent : 6;
+			frame[0] = COMMAND_SEGMENT_CONSECUTIVE;
+			frame[1] = sequence++;
+			memcpy(frame + 2, data + sent, count);
+			_link->segmentFrameSend(frame, 2 + count, deviceNumber);
+			sent += count;
+			if (separationMs != 0 && sent < size)
+				_link->segmentWait(separationMs * 1000UL);
+		}
+	}
+	return true;
+}
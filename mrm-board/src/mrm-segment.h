@@ -0,0 +1,123 @@
+#pragma once
+#include "Arduino.h"
+#include <vector>
+
+/**
+Purpose: multi-frame (segmented) CAN Bus transfers, for payloads longer than a single frame allows. Independent of Board and CAN Bus driver, which
+it reaches through SegmentLink, so that it can be tested with a simulated bus.
+@author MRMS team
+@version 0.0 2026-10-19
+Licence: You can use this code any way you like.
+*/
+
+#define COMMAND_SEGMENT_FIRST 0x2A
+#define COMMAND_SEGMENT_CONSECUTIVE 0x2B
+#define COMMAND_SEGMENT_FLOW_CONTROL 0x2C
+
+#define SEGMENT_BUFFER_SIZE 64 // Maximum payload of a single multi-frame transfer.
+#define SEGMENT_BLOCK_SIZE 8 // Consecutive frames a receiver accepts before it sends next flow control frame. 0 - no limit.
+#define SEGMENT_TIMEOUT_MS 20 // No flow control or consecutive frame in this time aborts the transfer.
+#define SEGMENT_WAITS_LIMIT 5 // Maximum number of wait requests from the receiver.
+#define SEGMENT_FLOW_CONTINUE 0
+#define SEGMENT_FLOW_WAIT 1
+#define SEGMENT_FLOW_ABORT 2
+#define SEGMENT_FLOW_NONE 0xFF // No flow control frame arrived yet.
+
+/** State of a multi-frame (segmented) transfer for a single device, both directions. Frames:
+first: [COMMAND_SEGMENT_FIRST, command, size low, size high, 4 bytes of data],
+consecutive: [COMMAND_SEGMENT_CONSECUTIVE, sequence (1, 2,..., wraps around), 6 bytes of data],
+flow control: [COMMAND_SEGMENT_FLOW_CONTROL, SEGMENT_FLOW_..., block size, separation in ms].
+*/
+struct SegmentedTransfer{
+	uint8_t buffer[SEGMENT_BUFFER_SIZE + 1]; // Reassembled payload. Additional byte for '\0' so that text can be printed.
+	uint8_t blockReceived; // Consecutive frames received after last flow control sent.
+	uint8_t command; // Command carried by the transfer being received.
+	uint8_t flowBlockSize; // Received flow control: consecutive frames to send before waiting for next flow control. 0 - all.
+	uint8_t flowSeparationMs; // Received flow control: minimum gap between 2 consecutive frames.
+	volatile uint8_t flowStatus = SEGMENT_FLOW_NONE; // Received flow control, SEGMENT_FLOW_NONE if none yet.
+	uint32_t lastFrameMs; // Last frame of the transfer being received.
+	bool receiving = false;
+	uint16_t received; // Bytes received so far.
+	uint8_t sequence; // Next expected sequence number.
+	uint16_t size; // Announced payload size.
+	bool supported = true; // Device's firmware responded to segmented transfer. Cleared after first timeout.
+};
+
+/** What the transfers need from the bus. Board implements it.
+*/
+class SegmentLink{
+public:
+	/** Sends a frame of a transfer
+	@param frame - data
+	@param length - number of bytes
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	*/
+	virtual void segmentFrameSend(uint8_t* frame, uint8_t length, uint8_t deviceNumber) = 0;
+
+	/** Waits, decoding frames that arrive meanwhile, so that flow control can arrive
+	@param micros - time to wait
+	*/
+	virtual void segmentWait(uint32_t micros) = 0;
+
+	/** Multi-frame transfer completed
+	@param command - command carried by the transfer
+	@param data - payload
+	@param size - payload's size
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@return - command handled
+	*/
+	virtual bool segmentedReceived(uint8_t command, uint8_t* data, uint16_t size, uint8_t deviceNumber) = 0;
+};
+
+/** Transfers of all the devices of a board class
+*/
+class Segmenter{
+	SegmentLink* _link;
+	uint16_t _lost = 0; // Transfers aborted due to a missing or out-of-order frame.
+	uint16_t _timeouts = 0; // Transfers aborted because the other side did not respond.
+	std::vector<SegmentedTransfer*>* _transfers; // One per device
+
+	/** Sends flow control frame for a transfer being received
+	@param status - SEGMENT_FLOW_CONTINUE, SEGMENT_FLOW_WAIT or SEGMENT_FLOW_ABORT
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	*/
+	void flowControlSend(uint8_t status, uint8_t deviceNumber);
+
+public:
+	/** Constructor
+	@param link - bus
+	@param maxDevices - maximum number of devices
+	*/
+	Segmenter(SegmentLink* link, uint8_t maxDevices);
+
+	/** Prepares a device's buffer
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	*/
+	void add(uint8_t deviceNumber);
+
+	/** Decodes a frame of a multi-frame transfer
+	@param data - 8 bytes from CAN Bus message.
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@return - false if the announced transfer is too big. It is refused.
+	*/
+	bool decode(uint8_t data[8], uint8_t deviceNumber);
+
+	/** Transfers aborted due to a missing or out-of-order frame
+	@return - count
+	*/
+	uint16_t lost() { return _lost; }
+
+	/** Sends a payload longer than a single CAN Bus frame allows, using first frame, flow control and consecutive frames.
+	@param command - command carried by the transfer
+	@param data - payload
+	@param size - payload's size, up to SEGMENT_BUFFER_SIZE
+	@param deviceNumber - Devices's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@return - true if sent, false if the device did not accept the transfer. Then the caller should use single-frame commands.
+	*/
+	bool send(uint8_t command, const uint8_t* data, uint16_t size, uint8_t deviceNumber);
+
+	/** Transfers aborted because the other side did not respond
+	@return - count
+	*/
+	uint16_t timeouts() { return _timeouts; }
+};
@@ -0,0 +1,59 @@
+#include "mrm-servo-motion.h"
+
+/** Position at a given time. Motion becomes inactive when finished.
+@param nowMs - time, millis()
+@return - degrees
+*/
+float ServoMotion::position(uint32_t nowMs) {
+	uint32_t elapsedMs = nowMs - startMs;
+	if (elapsedMs >= durationMs) {
+		active = false;
+		return toDegrees;
+	}
+	return fromDegrees + (toDegrees - fromDegrees) * servoProfilePath(profile, elapsedMs / (float)durationMs);
+}
+
+/** Starts a motion
+@param from - starting angle
+@param to - target angle
+@param ms - duration
+@param motionProfile - velocity profile
+@param nowMs - start time, millis()
+*/
+void ServoMotion::start(float from, float to, uint32_t ms, ServoProfile motionProfile, uint32_t nowMs) {
+	fromDegrees = from;
+	toDegrees = to;
+	durationMs = ms;
+	profile = motionProfile;
+	startMs = nowMs;
+	active = true;
+}
+
+/** Part of the path covered at a given part of motion's time. Trapezoidal profile accelerates and decelerates evenly,
+S-curve (minimum jerk) changes acceleration smoothly, too.
+@param profile - velocity profile
+@param time - 0 (start) - 1 (end)
+@return - 0 (start) - 1 (end)
+*/
+float servoProfilePath(ServoProfile profile, float time) {
+	if (time <= 0)
+		return 0;
+	if (time >= 1)
+		return 1;
+	switch (profile) {
+	case SERVO_PROFILE_TRAPEZOIDAL: {
+		const float accelerationPart = SERVO_PROFILE_ACCELERATION_PART;
+		const float maxSpeed = 1 / (1 - accelerationPart); // So that the whole path is 1
+		if (time < accelerationPart)
+			return maxSpeed * time * time / (2 * accelerationPart);
+		else if (time <= 1 - accelerationPart)
+			return maxSpeed * (time - accelerationPart / 2);
+		else
+			return 1 - maxSpeed * (1 - time) * (1 - time) / (2 * accelerationPart);
+	}
+	case SERVO_PROFILE_S_CURVE:
+		return time * time * time * (10 + time * (-15 + time * 6));
+	default:
+		return time;
+	}
+}
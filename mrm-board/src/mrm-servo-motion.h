@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+
+/**
+Purpose: servos' motion profiles, shared by mrm-servo and mrm-node. No hardware access, so the same code runs on a host computer.
+@author MRMS team
+@version 0.0 2026-10-19
+Licence: You can use this code any way you like.
+*/
+
+#define SERVO_PROFILE_ACCELERATION_PART 0.25 // Trapezoidal profile: part of the time spent accelerating, the same decelerating.
+
+enum ServoProfile { SERVO_PROFILE_LINEAR, SERVO_PROFILE_TRAPEZOIDAL, SERVO_PROFILE_S_CURVE };
+
+/** A servo's motion from one angle to another in a given time, calculated on the fly, without waiting.
+*/
+struct ServoMotion {
+	bool active = false;
+	uint32_t durationMs;
+	float fromDegrees;
+	ServoProfile profile;
+	uint32_t startMs;
+	float toDegrees;
+
+	/** Position at a given time. Motion becomes inactive when finished.
+	@param nowMs - time, millis()
+	@return - degrees
+	*/
+	float position(uint32_t nowMs);
+
+	/** Starts a motion
+	@param from - starting angle
+	@param to - target angle
+	@param ms - duration
+	@param motionProfile - velocity profile
+	@param nowMs - start time, millis()
+	*/
+	void start(float from, float to, uint32_t ms, ServoProfile motionProfile, uint32_t nowMs);
+};
+
+/** Part of the path covered at a given part of motion's time. Trapezoidal profile accelerates and decelerates evenly,
+S-curve (minimum jerk) changes acceleration smoothly, too.
+@param profile - velocity profile
+@param time - 0 (start) - 1 (end)
+@return - 0 (start) - 1 (end)
+*/
+float servoProfilePath(ServoProfile profile, float time);
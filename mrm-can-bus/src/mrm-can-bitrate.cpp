@@ -0,0 +1,36 @@
+#include "mrm-can-bitrate.h"
+
+/** Moves all the devices and the robot to a new bitrate. Each alive device must accept it first, otherwise nothing changes.
+After the switch, devices that do not respond are moved back, the robot too.
+@param link - robot
+@param bitrateKbps - 125, 250, 500, 800 or 1000
+@return - CAN_BITRATE_OK, or what went wrong. The bus is at the previous bitrate then.
+*/
+CANBusBitrateResult canBitrateNegotiate(CANBusBitrateLink* link, uint16_t bitrateKbps) {
+	uint16_t previousKbps = link->bitrateLocal();
+	if (bitrateKbps == previousKbps)
+		return CAN_BITRATE_OK;
+
+	// Phase 1: all the alive devices must accept. Nothing changed yet if any does not.
+	if (!link->bitrateDevicesPropose(bitrateKbps))
+		return CAN_BITRATE_REFUSED;
+
+	// Phase 2: switch devices, then the robot.
+	uint32_t aliveBefore = link->bitratePresence(false);
+	link->bitrateDevicesCommit(bitrateKbps);
+	if (!link->bitrateLocalSet(bitrateKbps)) {
+		link->bitrateWaitMs(CAN_BITRATE_CONFIRM_MS * 2); // Devices return by themselves.
+		return CAN_BITRATE_LOCAL_FAILED;
+	}
+
+	// Phase 3: the same devices must respond.
+	if (link->bitratePresence(true) == aliveBefore)
+		return CAN_BITRATE_OK;
+
+	link->bitrateDevicesCommit(previousKbps); // The ones that did switch. The others return by themselves.
+	link->bitrateLocalSet(previousKbps);
+	link->bitratePresence(true); // At once, otherwise the devices moved back would time out and switch again.
+	link->bitrateWaitMs(CAN_BITRATE_CONFIRM_MS * 2);
+	link->bitratePresence(true);
+	return CAN_BITRATE_DEVICES_LOST;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+
+/**
+Purpose: moving the whole CAN Bus to a new bitrate, with rollback. The protocol is independent of boards and driver, which it reaches
+through CANBusBitrateLink, so that it can be checked with a simulated bus.
+@author MRMS team
+@version 0.0 2026-10-19
+Licence: You can use this code any way you like.
+*/
+
+#define CAN_BITRATE_CONFIRM_MS 500 // Device returns to the previous bitrate if it receives no message for this time after switching.
+
+enum CANBusBitrateResult { CAN_BITRATE_OK, CAN_BITRATE_REFUSED, CAN_BITRATE_LOCAL_FAILED, CAN_BITRATE_DEVICES_LOST };
+
+/** What the negotiation needs from the robot. Robot implements it.
+*/
+class CANBusBitrateLink {
+public:
+	/** Robot's bitrate
+	@return - kbit/s
+	*/
+	virtual uint16_t bitrateLocal() = 0;
+
+	/** Switches the robot, after the messages queued so far are sent
+	@param bitrateKbps - kbit/s
+	@return - success
+	*/
+	virtual bool bitrateLocalSet(uint16_t bitrateKbps) = 0;
+
+	/** Tells all the alive devices to switch, without waiting
+	@param bitrateKbps - kbit/s
+	*/
+	virtual void bitrateDevicesCommit(uint16_t bitrateKbps) = 0;
+
+	/** Asks all the alive devices if they support a bitrate and waits for the answers
+	@param bitrateKbps - kbit/s
+	@return - all accepted
+	*/
+	virtual bool bitrateDevicesPropose(uint16_t bitrateKbps) = 0;
+
+	/** Devices alive
+	@param scan - scan first. Scanning confirms the bitrate to the devices that just switched.
+	@return - signature, changes when any device appears or disappears
+	*/
+	virtual uint32_t bitratePresence(bool scan) = 0;
+
+	/** Waits, receiving messages
+	@param ms - pause
+	*/
+	virtual void bitrateWaitMs(uint16_t ms) = 0;
+};
+
+/** Moves all the devices and the robot to a new bitrate. Each alive device must accept it first, otherwise nothing changes.
+After the switch, devices that do not respond are moved back, the robot too.
+@param link - robot
+@param bitrateKbps - 125, 250, 500, 800 or 1000
+@return - CAN_BITRATE_OK, or what went wrong. The bus is at the previous bitrate then.
+*/
+CANBusBitrateResult canBitrateNegotiate(CANBusBitrateLink* link, uint16_t bitrateKbps);
@@ -20,13 +20,6 @@ Licence: You can use this code any way you like.
 
 #define VERBOSE 0
 
-uint16_t bracketReceive[2] = { 0, 0 };
-uint16_t bracketSend[2] = { 0, 0 };
-uint8_t lastBracketReceive = 0;
-uint8_t lastBracketSend = 0;
-uint16_t _peakReceive = 0;
-uint16_t _peakSend = 0;
-
 CANBusMessage* receivedMessage = NULL;
 
 void CANBusMessage::print() {
@@ -36,39 +29,216 @@ void CANBusMessage::print() {
 	::print("\n\r");
 }
 
-Mrm_can_bus::Mrm_can_bus() {
+/**
+@param bitrateKbps - 125, 250, 500, 800 or 1000. All the devices must use the same.
+@param txQueueLength - driver's transmit queue
+@param rxQueueLength - driver's receive queue. Too short one loses messages when the loop is slow.
+*/
+Mrm_can_bus::Mrm_can_bus(uint16_t bitrateKbps, uint8_t txQueueLength, uint8_t rxQueueLength) {
+	_rxQueueLength = rxQueueLength;
+	_txQueueLength = txQueueLength;
+	pacingCalculate();
+	driverStart(bitrateKbps);
+
+	receivedMessage = new CANBusMessage();
+	_filterIds = new uint8_t[(CAN_FILTER_ID_MASK + 1) / 8]();
+	_idStatistics = new CANBusIdStatistics[CAN_STATISTICS_IDS];
+	statisticsReset();
+}
+
+/** Changes local bitrate, restarting the driver. Messages in queues are lost. Use Robot::canBusBitrateNegotiate() to change the
+whole bus. Not while a worker owns the bus, unless called by it.
+@param bitrateKbps - 125, 250, 500, 800 or 1000
+@return - success. If false, the previous bitrate is restored.
+*/
+bool Mrm_can_bus::bitrateSet(uint16_t bitrateKbps) {
+	if (bitrateKbps == _bitrateKbps)
+		return true;
+	if (queueing()) { // The worker would use the driver while it is being restarted.
+		strcpy(errorMessage, "Stop CAN task first");
+		return false;
+	}
+	uint16_t previousKbps = _bitrateKbps;
+	can_stop();
+	can_driver_uninstall();
+	if (driverStart(bitrateKbps))
+		return true;
+	can_stop();
+	can_driver_uninstall();
+	driverStart(previousKbps);
+	return false;
+}
+
+/** Installs and starts the driver
+@param bitrateKbps - 125, 250, 500, 800 or 1000
+@return - success
+*/
+bool Mrm_can_bus::driverStart(uint16_t bitrateKbps) {
 	can_general_config_t general_config = {
 	   .mode = CAN_MODE_NORMAL,
 	   .tx_io = (gpio_num_t)GPIO_NUM_5,
 	   .rx_io = (gpio_num_t)GPIO_NUM_4,
 	   .clkout_io = (gpio_num_t)CAN_IO_UNUSED,
 	   .bus_off_io = (gpio_num_t)CAN_IO_UNUSED,
-	   .tx_queue_len = 20,
-	   .rx_queue_len = 65,
+	   .tx_queue_len = _txQueueLength,
+	   .rx_queue_len = _rxQueueLength,
 	   .alerts_enabled = CAN_ALERT_NONE,
 	   .clkout_divider = 0 };
-	can_timing_config_t timing_config = CAN_TIMING_CONFIG_250KBITS();
+	can_timing_config_t timing_config;
+	switch (bitrateKbps) {
+	case 125:
+		timing_config = CAN_TIMING_CONFIG_125KBITS();
+		break;
+	case 250:
+		timing_config = CAN_TIMING_CONFIG_250KBITS();
+		break;
+	case 500:
+		timing_config = CAN_TIMING_CONFIG_500KBITS();
+		break;
+	case 800:
+		timing_config = CAN_TIMING_CONFIG_800KBITS();
+		break;
+	case 1000:
+		timing_config = CAN_TIMING_CONFIG_1MBITS();
+		break;
+	default:
+		sprintf(errorMessage, "CAN %i kbps unsupported", bitrateKbps);
+		return false;
+	}
 	can_filter_config_t filter_config = CAN_FILTER_CONFIG_ACCEPT_ALL();
+	if (_filterInstalled) {
+		filter_config.acceptance_code = _filter.code;
+		filter_config.acceptance_mask = _filter.mask;
+		filter_config.single_filter = !_filter.dual;
+	}
 
-	if (can_driver_install(&general_config, &timing_config, &filter_config) != ESP_OK)
+	if (can_driver_install(&general_config, &timing_config, &filter_config) != ESP_OK) {
 		strcpy(errorMessage, "Error init. CAN");
+		return false;
+	}
 
-	if (can_start() != ESP_OK)
+	if (can_start() != ESP_OK) {
 		strcpy(errorMessage, "Error start CAN");
+		return false;
+	}
+	_bitrateKbps = bitrateKbps;
+	pacingCalculate();
+	return true;
+}
 
-	receivedMessage = new CANBusMessage();
+/** Installs a new filter, if the registered ids or filter's state changed. Restarts the driver, so it waits for sending queued
+messages first. Messages received meanwhile are lost, so ids should be registered at start.
+*/
+void Mrm_can_bus::filterApply() {
+	if (queueing()) // The worker applies it, in its messageReceive().
+		return;
+	bool install = _filterEnabled && _filterIdCount > 0;
+	if (!_filterDirty && install == _filterInstalled)
+		return;
+	if (_filterDirty) {
+		uint16_t* ids = new uint16_t[_filterIdCount];
+		uint16_t count = 0;
+		for (uint16_t id = 0; id <= CAN_FILTER_ID_MASK; id++)
+			if (_filterIds[id >> 3] & (1 << (id & 7)))
+				ids[count++] = id;
+		CANBusFilter filter = canFilterCalculate(ids, count);
+		delete[] ids;
+		_filterDirty = false;
+		if (install == _filterInstalled && filter.code == _filter.code && filter.mask == _filter.mask && filter.dual == _filter.dual)
+			return; // New id already passed
+		_filter = filter;
+	}
+	flush(CAN_FILTER_FLUSH_MS);
+	can_stop();
+	can_driver_uninstall();
+	_filterInstalled = install;
+	_filterRestarts++;
+	if (!driverStart(_bitrateKbps)) { // Retry without filter
+		_filterInstalled = false;
+		driverStart(_bitrateKbps);
+	}
+}
+
+/** Enables or disables filtering. Sniffing needs all the frames, for example.
+@param enable - if false, all the frames are received
+*/
+void Mrm_can_bus::filterEnable(bool enable) {
+	_filterEnabled = enable;
+}
+
+/** Registers an id whose frames the robot receives. The filter is recalculated and installed at the next messageReceive().
+@param id - 11-bit CAN Bus id
+*/
+void Mrm_can_bus::filterIdAdd(uint16_t id) {
+	id &= CAN_FILTER_ID_MASK;
+	if (_filterIds[id >> 3] & (1 << (id & 7)))
+		return;
+	_filterIds[id >> 3] |= 1 << (id & 7);
+	_filterIdCount++;
+	_filterDirty = true;
+}
+
+/** Sends messages other threads queued. The worker owning the bus calls it in each pass.
+*/
+void Mrm_can_bus::transmitQueued() {
+	CANBusMessage message;
+	while (_txRing != NULL && _txRing->pop(&message))
+		messageTransmit(message.messageId, message.dlc, message.data);
+}
+
+/** Sets the thread owning the bus: the only one receiving and transmitting. Other threads' messageSend() queue messages for it.
+Only one other thread may send.
+@param worker - worker, NULL - none, any thread uses the bus directly.
+*/
+void Mrm_can_bus::workerSet(Worker* worker) {
+	if (_txRing == NULL)
+		_txRing = new SpscRing<CANBusMessage, CAN_TX_RING_SIZE>();
+	_worker = worker;
+}
+
+/** Waits till all the queued messages are transmitted: the ones queued for the worker, if any, and the driver's
+@param timeoutMs - maximum wait
+@return - true if transmit queue empty
+*/
+bool Mrm_can_bus::flush(uint16_t timeoutMs) {
+	uint32_t startMs = millis();
+	if (!queueing())
+		transmitQueued(); // Maybe left by a stopped worker
+	else
+		while (!_txRing->empty()) // The worker sends them.
+			if (millis() - startMs > timeoutMs)
+				return false;
+	can_status_info_t status;
+	while (can_get_status_info(&status) == ESP_OK && status.msgs_to_tx != 0)
+		if (millis() - startMs > timeoutMs)
+			return false;
+	return true;
 }
 
 /**Receive a CANBus message
 @return non-NULL - a message received, NULL - none
 */
 CANBusMessage* Mrm_can_bus::messageReceive() {
+	if (millis() - _windowStartMs >= CAN_STATISTICS_WINDOW_MS)
+		statisticsWindow();
+	if (_replaying)
+		return replayNext();
+	filterApply();
+
 	//Wait for message to be received
 	bool found = false;
 	can_message_t message;
-	esp_err_t status = can_receive(&message, pdMS_TO_TICKS(1)); // When 0, lost messages
+	esp_err_t status;
+	while ((status = can_receive(&message, pdMS_TO_TICKS(1))) == ESP_OK && _filterInstalled) { // When 0, lost messages
+		_filterPassed++;
+		if (_filterIds[message.identifier >> 3 & 0xFF] & (1 << (message.identifier & 7)))
+			break;
+		_filterLeaked++; // Passed by filter's mask only, not registered.
+		statisticsAdd(message.identifier, message.data_length_code, false);
+	}
 	switch(status){
 	case ESP_OK:
+		_receivedMicros = micros();
 		found = true;
 		break;
 	case ESP_ERR_TIMEOUT:
@@ -85,26 +255,9 @@ CANBusMessage* Mrm_can_bus::messageReceive() {
 			receivedMessage->data[i] = message.data[i];
 		receivedMessage->messageId = message.identifier;
 		receivedMessage->dlc = message.data_length_code;
-
-
-		uint16_t bracketNow = millis() % 1000;
-		if (bracketNow >= 500) {
-			if (lastBracketReceive == 0) {
-				lastBracketReceive = 1;
-				if (bracketReceive[0] > _peakReceive)
-					_peakReceive = bracketReceive[0];
-				bracketReceive[1] = 0;
-			}
-		}
-		else {
-			if (lastBracketReceive == 1) {
-				lastBracketReceive = 0;
-				if (bracketReceive[1] > _peakReceive)
-					_peakReceive = bracketReceive[1];
-				bracketReceive[0] = 0;
-			}
-		}
-		bracketReceive[lastBracketReceive]++;
+		if (_recording)
+			record(message.identifier, message.data_length_code, message.data, false);
+		statisticsAdd(message.identifier, message.data_length_code, false);
 
 		return receivedMessage;
 	}
@@ -116,39 +269,208 @@ CANBusMessage* Mrm_can_bus::messageReceive() {
 /** Number of received CAN Bus messages per second
 @return - number of messages
 */
-uint16_t Mrm_can_bus::messagesReceivedPerSecond() { return (lastBracketReceive == 1 ? bracketReceive[0] : bracketReceive[1]) * 2; }
+uint16_t Mrm_can_bus::messagesReceivedPerSecond() { return _receivedPerSecond; }
 
 /** Number of sent CAN Bus messages per second
 @return - number of messages
 */
-uint16_t Mrm_can_bus::messagesSentPerSecond() { return (lastBracketSend == 1 ? bracketSend[0] : bracketSend[1]) * 2; }
+uint16_t Mrm_can_bus::messagesSentPerSecond() { return _sentPerSecond; }
 
 /** Peak number of received CAN Bus messages per second
 @return - number of messages
 */
-uint16_t Mrm_can_bus::messagesPeakReceived() { return _peakReceive * 2; }
+uint16_t Mrm_can_bus::messagesPeakReceived() { return _peakReceived; }
 
 /** Peak number of received CAN Bus messages per second
 @return - number of messages
 */
-uint16_t Mrm_can_bus::messagesPeakSent() { return _peakSend * 2; }
+uint16_t Mrm_can_bus::messagesPeakSent() { return _peakSent; }
 
-void Mrm_can_bus::messagesReset() {
-	for (uint8_t i = 0; i < 2; i++) {
-		bracketReceive[i] = 0;
-		bracketSend[i] = 0;
+/** Store message into recorder's ring
+@param id - CAN Bus id
+@param dlc - data's used bytes count
+@param data - up to 8 data bytes
+@param outbound - sent, not received
+*/
+void Mrm_can_bus::record(uint32_t id, uint8_t dlc, uint8_t data[8], bool outbound) {
+	CANBusRecord* r = &_records[_recordHead];
+	r->micros = micros();
+	r->id = (id & 0x7FF) | (outbound ? CAN_RECORD_OUTBOUND : 0);
+	r->dlc = dlc;
+	memcpy(r->data, data, dlc);
+	r->reserved = 0;
+	_recordHead = (_recordHead + 1) & (CAN_RECORDER_SIZE - 1);
+	if (_recordCount < CAN_RECORDER_SIZE)
+		_recordCount++;
+	else
+		_recordsOverwritten++;
+}
+
+/** Starts recording all the received and sent messages into RAM ring. If ring is full, the oldest records are overwritten.
+@param erase - erase previous records
+*/
+void Mrm_can_bus::recordingStart(bool erase) {
+	if (_records == NULL)
+		_records = new CANBusRecord[CAN_RECORDER_SIZE];
+	if (erase) {
+		_recordCount = 0;
+		_recordHead = 0;
+		_recordsOverwritten = 0;
 	}
-	_peakReceive = 0;
-	_peakSend = 0;
+	_replaying = false;
+	_recording = true;
 }
 
-/**Send a CANBus message
+/** Writes all the records in binary format, described at CANBusRecord.
+@param output - for example Serial
+*/
+void Mrm_can_bus::recordsDump(Print* output) {
+	output->write((const uint8_t*)"MRMCAN", 6);
+	output->write((uint8_t)1); // Format version
+	output->write((uint8_t)(_recordCount & 0xFF));
+	output->write((uint8_t)(_recordCount >> 8));
+	uint16_t oldest = (_recordHead - _recordCount) & (CAN_RECORDER_SIZE - 1);
+	for (uint16_t i = 0; i < _recordCount; i++)
+		output->write((const uint8_t*)&_records[(oldest + i) & (CAN_RECORDER_SIZE - 1)], sizeof(CANBusRecord));
+}
+
+/** Loads records written by recordsDump(), replacing the ones in ring. Any text before "MRMCAN" is skipped, so a captured serial log can be
+passed as it is. Recording and replay stop.
+@param dump - dump's bytes
+@param size - number of bytes
+@return - number of records loaded, 0 if none or dump is not valid, with errorMessage set.
+*/
+uint16_t Mrm_can_bus::recordsLoad(const uint8_t* dump, uint32_t size) {
+	_recording = false;
+	_replaying = false;
+	uint32_t start = 0;
+	while (start + CAN_DUMP_HEADER_SIZE <= size && memcmp(dump + start, "MRMCAN", 6) != 0)
+		start++;
+	if (start + CAN_DUMP_HEADER_SIZE > size) {
+		strcpy(errorMessage, "No CAN dump");
+		return 0;
+	}
+	if (dump[start + 6] != 1) {
+		sprintf(errorMessage, "CAN dump v%i unsupported", dump[start + 6]);
+		return 0;
+	}
+	uint16_t count = dump[start + 7] | (dump[start + 8] << 8);
+	if (count > CAN_RECORDER_SIZE || size - start - CAN_DUMP_HEADER_SIZE < count * sizeof(CANBusRecord)) {
+		strcpy(errorMessage, "CAN dump cut short");
+		return 0;
+	}
+	if (_records == NULL)
+		_records = new CANBusRecord[CAN_RECORDER_SIZE];
+	memcpy(_records, dump + start + CAN_DUMP_HEADER_SIZE, count * sizeof(CANBusRecord));
+	_recordCount = count;
+	_recordHead = count & (CAN_RECORDER_SIZE - 1);
+	_recordsOverwritten = 0;
+	return count;
+}
+
+/** Next recorded inbound message, when its time comes
+@return - message or NULL if none due yet
+*/
+CANBusMessage* Mrm_can_bus::replayNext() {
+	uint16_t oldest = (_recordHead - _recordCount) & (CAN_RECORDER_SIZE - 1);
+	while (_replayIndex < _recordCount) {
+		CANBusRecord* r = &_records[(oldest + _replayIndex) & (CAN_RECORDER_SIZE - 1)];
+		if (r->id & CAN_RECORD_OUTBOUND) { // Robot's own messages are not received.
+			_replayIndex++;
+			continue;
+		}
+		if (_replaySpeed != 0 && micros() - _replayStartMicros < (r->micros - _replayFirstMicros) / _replaySpeed)
+			return NULL; // Not yet
+		receivedMessage->messageId = r->id;
+		receivedMessage->dlc = r->dlc;
+		memcpy(receivedMessage->data, r->data, r->dlc);
+		_receivedMicros = micros();
+		_replayIndex++;
+		return receivedMessage;
+	}
+	_replaying = false;
+	return NULL;
+}
+
+/** Starts replaying recorded inbound messages. Until finished, messageReceive() returns them instead of CAN Bus messages,
+keeping recorded time distances, and messageSend() sends nothing. Recording stops.
+@param speed - 1 - original speed, 2 - twice as fast,... 0 - as fast as possible.
+*/
+void Mrm_can_bus::replayStart(uint8_t speed) {
+	_recording = false;
+	if (_recordCount == 0) {
+		strcpy(errorMessage, "Nothing to replay");
+		return;
+	}
+	_replayFirstMicros = _records[(_recordHead - _recordCount) & (CAN_RECORDER_SIZE - 1)].micros;
+	_replayIndex = 0;
+	_replaySpeed = speed;
+	_replayStartMicros = micros();
+	_replaySuppressed = 0;
+	_replaying = true;
+}
+
+/** Calculates gap between sent messages from bitrate and measured bus load. Without other traffic, this robot's messages load the bus
+CAN_LOAD_TARGET percent. When the measured load is above the target, because of devices' messages, the gap grows proportionally.
+*/
+void Mrm_can_bus::pacingCalculate() {
+	uint32_t frameMicros = CAN_FRAME_BITS_MAX * 1000 / _bitrateKbps;
+	uint32_t gap = frameMicros * 100 / CAN_LOAD_TARGET; // 900 us for 250 kbps
+	if (_utilisation > CAN_LOAD_TARGET)
+		gap = gap * _utilisation / CAN_LOAD_TARGET;
+	_pacingMicros = gap > 0xFFFF ? 0xFFFF : gap;
+}
+
+/** Resets peaks
+*/
+void Mrm_can_bus::messagesReset() {
+	_peakReceived = 0;
+	_peakSent = 0;
+}
+
+/**Send a CANBus message. If a worker owns the bus and the caller is another thread, the message is only queued for the worker.
 @param stdId - CANBus message id
 @param dlc - data's used bytes count
 @param data - up to 8 data bytes
 @return - true if a message received
 */
 void Mrm_can_bus::messageSend(uint32_t stdId, uint8_t dlc, uint8_t data[8]) {
+	if (!queueing()) {
+		messageTransmit(stdId, dlc, data);
+		return;
+	}
+	CANBusMessage message;
+	message.messageId = stdId;
+	message.dlc = dlc;
+	for (uint8_t i = 0; i < dlc; i++)
+		message.data[i] = data[i];
+	if (_txRing->push(message))
+		return;
+	_txRingWaits++;
+	while (!_txRing->push(message)) {
+		if (!_worker->running()) { // Stopped meanwhile: the ring's messages first, then this one.
+			transmitQueued();
+			messageTransmit(stdId, dlc, data);
+			return;
+		}
+		delayMicroseconds(50);
+	}
+}
+
+/** Sends a message, in the calling thread
+@param stdId - CANBus message id
+@param dlc - data's used bytes count
+@param data - up to 8 data bytes
+*/
+void Mrm_can_bus::messageTransmit(uint32_t stdId, uint8_t dlc, uint8_t data[8]) {
+	if (_replaying) { // Replay must not depend on devices' answers.
+		_replaySuppressed++;
+		return;
+	}
+	if (_recording)
+		record(stdId, dlc, data, true);
+	uint32_t waitStartMicros = micros();
+
 	can_message_t message;
 	message.identifier = stdId;
 	message.flags = 0;
@@ -157,18 +479,19 @@ void Mrm_can_bus::messageSend(uint32_t stdId, uint8_t dlc, uint8_t data[8]) {
 		message.data[i] = data[i];
 	}
 
-	// Do not allow bus congestion, limit to 1250 messages per second. After 70 min. micros() resets, therefore the second term in the logical expression below
-#define MIN_MICROS_BETWEEN_CAN_BUS_MESSAGES 900 //900
-	while (micros() <= lastSentMicros + MIN_MICROS_BETWEEN_CAN_BUS_MESSAGES){
-		 if (micros() < lastSentMicros){ // micros() resetted
-			lastSentMicros = 0; // reset this variable, too
-		 }
-	}
+	// Do not allow bus congestion. Unsigned difference is correct after micros() overflows.
+	while (micros() - lastSentMicros < _pacingMicros)
+		;
 	lastSentMicros = micros();
 
 	//Queue message for transmission
 	if (can_transmit(&message, pdMS_TO_TICKS(1000)) != ESP_OK)
 		strcpy(errorMessage, "Error sending");
+	uint32_t waitMicros = micros() - waitStartMicros;
+	_txCount++;
+	_txWaitMicrosTotal += waitMicros;
+	if (waitMicros > _txWaitMicrosMax)
+		_txWaitMicrosMax = waitMicros;
 
 #if VERBOSE
 	printf("Send to 0x%04X, DLC %d, Data ", stdId, dlc);
@@ -178,22 +501,116 @@ void Mrm_can_bus::messageSend(uint32_t stdId, uint8_t dlc, uint8_t data[8]) {
 	printf("\n\r");
 #endif
 
-	uint16_t bracketNow = millis() % 1000;
-	if (bracketNow >= 500) {
-		if (lastBracketSend == 0) {
-			lastBracketSend = 1;
-			if (bracketSend[0] > _peakSend)
-				_peakSend = bracketSend[0];
-			bracketSend[1] = 0;
+	statisticsAdd(stdId, dlc, true);
+}
+
+/** Counts a frame
+@param id - CAN Bus id
+@param dlc - data's used bytes count
+@param outbound - sent, not received
+*/
+void Mrm_can_bus::statisticsAdd(uint32_t id, uint8_t dlc, bool outbound) {
+	_windowBits += 47 + 8 * dlc + (34 + 8 * dlc - 1) / 4; // Standard frame with interframe space, worst-case stuffing.
+	if (outbound)
+		_windowSent++;
+	else
+		_windowReceived++;
+
+	// Find id's slot, linear probing
+	uint16_t key = (id & 0x7FF) | (outbound ? CAN_RECORD_OUTBOUND : 0);
+	uint8_t slot = (key ^ (key >> 6)) & (CAN_STATISTICS_IDS - 1);
+	uint8_t probes = 0;
+	while (_idStatistics[slot].key != key && _idStatistics[slot].key != 0xFFFF) {
+		if (++probes == CAN_STATISTICS_IDS) {
+			_idsUntracked++;
+			return;
 		}
+		slot = (slot + 1) & (CAN_STATISTICS_IDS - 1);
+	}
+	CANBusIdStatistics* s = &_idStatistics[slot];
+	s->key = key;
+
+	uint32_t now = micros();
+	if (s->lastMicros != 0) {
+		uint32_t gap = now - s->lastMicros;
+		uint8_t bucket = 0;
+		for (uint32_t ms = gap / 1000; ms != 0 && bucket < CAN_JITTER_BUCKETS - 1; ms >>= 1)
+			bucket++;
+		if (s->jitter[bucket] != 0xFFFF)
+			s->jitter[bucket]++;
+		if (gap > s->gapMaxMicros)
+			s->gapMaxMicros = gap;
+		if (gap < s->gapMinMicros)
+			s->gapMinMicros = gap;
+	}
+	s->lastMicros = now == 0 ? 1 : now;
+	s->frames++;
+	s->total++;
+}
+
+/** Resets all the statistics
+*/
+void Mrm_can_bus::statisticsReset() {
+	for (uint8_t i = 0; i < CAN_STATISTICS_IDS; i++) {
+		CANBusIdStatistics* s = &_idStatistics[i];
+		s->key = 0xFFFF;
+		s->frames = 0;
+		s->framesPerSecond = 0;
+		for (uint8_t j = 0; j < CAN_JITTER_BUCKETS; j++)
+			s->jitter[j] = 0;
+		s->gapMaxMicros = 0;
+		s->gapMinMicros = 0xFFFFFFFF;
+		s->lastMicros = 0;
+		s->total = 0;
 	}
-	else {
-		if (lastBracketSend == 1) {
-			lastBracketSend = 0;
-			if (bracketSend[1] > _peakSend)
-				_peakSend = bracketSend[1];
-			bracketSend[0] = 0;
+	memset(&_errors, 0, sizeof(_errors));
+	_idsUntracked = 0;
+	_txCount = 0;
+	_txWaitMicrosMax = 0;
+	_txWaitMicrosTotal = 0;
+	_utilisation = 0;
+	_windowBits = 0;
+	_windowReceived = 0;
+	_windowSent = 0;
+	_windowStartMs = millis();
+	messagesReset();
+}
+
+/** Closes statistics window, if expired, and reads driver's error counters.
+*/
+void Mrm_can_bus::statisticsWindow() {
+	uint32_t elapsedMs = millis() - _windowStartMs;
+	if (elapsedMs < CAN_STATISTICS_WINDOW_MS)
+		return;
+	_receivedPerSecond = _windowReceived * 1000 / elapsedMs; // Window can be longer if loop was slow.
+	_sentPerSecond = _windowSent * 1000 / elapsedMs;
+	if (_receivedPerSecond > _peakReceived)
+		_peakReceived = _receivedPerSecond;
+	if (_sentPerSecond > _peakSent)
+		_peakSent = _sentPerSecond;
+	_utilisation = _windowBits * 100.0 / (_bitrateKbps * elapsedMs); // kbit/s is bit/ms
+	pacingCalculate();
+	for (uint8_t i = 0; i < CAN_STATISTICS_IDS; i++)
+		if (_idStatistics[i].key != 0xFFFF) {
+			_idStatistics[i].framesPerSecond = _idStatistics[i].frames * 1000 / elapsedMs;
+			_idStatistics[i].frames = 0;
 		}
+	_windowBits = 0;
+	_windowReceived = 0;
+	_windowSent = 0;
+	_windowStartMs = millis();
+
+	can_status_info_t status;
+	if (can_get_status_info(&status) == ESP_OK) {
+		bool busOff = status.state == CAN_STATE_BUS_OFF;
+		if (busOff && !_errors.busOff)
+			_errors.busOffCount++;
+		_errors.busOff = busOff;
+		_errors.arbitrationLost = status.arb_lost_count;
+		_errors.busErrors = status.bus_error_count;
+		_errors.rxErrors = status.rx_error_counter;
+		_errors.rxMissed = status.rx_missed_count;
+		_errors.txErrors = status.tx_error_counter;
+		_errors.txFailed = status.tx_failed_count;
 	}
-	bracketSend[lastBracketSend]++;
 }
\ No newline at end of file
@@ -1,5 +1,22 @@
 #pragma once
 #include <Arduino.h>
+#include "mrm-can-bitrate.h"
+#include "mrm-can-filter.h"
+#include <mrm-task.h>
+
+#define CAN_BITRATE_KBPS 250 // Default. 125, 250, 500, 800 or 1000.
+#define CAN_FILTER_FLUSH_MS 20 // Before restarting the driver with a new filter, sending queued messages.
+#define CAN_FRAME_BITS_MAX 135 // 8 data bytes, worst-case bit stuffing, with interframe space.
+#define CAN_JITTER_BUCKETS 8 // Inter-arrival times histogram: < 1 ms, 1 ms, 2 - 3 ms, 4 - 7 ms,... >= 64 ms.
+#define CAN_LOAD_TARGET 60 // Percent. Sending is paced so that the bus is not loaded more.
+#define CAN_RECORDER_SIZE 512 // Number of records in recorder's RAM ring, 16 bytes each. Power of 2.
+#define CAN_DUMP_HEADER_SIZE 9 // "MRMCAN", version, uint16_t count
+#define CAN_RECORD_OUTBOUND 0x8000 // Flag in CANBusRecord's id, message sent by this robot.
+#define CAN_RX_QUEUE_LENGTH 65 // Default driver's receive queue
+#define CAN_STATISTICS_IDS 64 // Number of different ids (inbound and outbound separately) statistics are kept for. Power of 2.
+#define CAN_STATISTICS_WINDOW_MS 1000 // Rates and bus utilisation are calculated for windows of this length.
+#define CAN_TX_QUEUE_LENGTH 20 // Default driver's transmit queue
+#define CAN_TX_RING_SIZE 32 // Messages sent by other threads while a worker owns the bus, waiting for the worker. Power of 2.
 
 struct CANBusMessage {
 	uint32_t messageId;
@@ -9,19 +26,225 @@ struct CANBusMessage {
 	void print();
 };
 
+/** Recorded message. recordsDump() writes "MRMCAN", version byte (1), uint16_t count, and then count records as they are in memory,
+little endian, 16 bytes each, the oldest first.
+*/
+struct CANBusRecord {
+	uint32_t micros; // Time of receiving or sending
+	uint16_t id; // 11-bit standard id, ORed with CAN_RECORD_OUTBOUND for sent messages.
+	uint8_t dlc;
+	uint8_t data[8];
+	uint8_t reserved; // Pads record to 16 bytes.
+};
+static_assert(sizeof(CANBusRecord) == 16, "CANBusRecord must be 16 bytes");
+
+/** CAN Bus controller's error counters, as reported by the driver
+*/
+struct CANBusErrors {
+	uint32_t arbitrationLost;
+	uint32_t busErrors;
+	bool busOff; // Now
+	uint16_t busOffCount; // Transitions to bus-off, observed when polling
+	uint32_t rxErrors; // Receive error counter
+	uint32_t rxMissed; // Lost because of full RX queue
+	uint32_t txErrors; // Transmit error counter
+	uint32_t txFailed;
+};
+
+/** Statistics of a CAN Bus id, either inbound or outbound
+*/
+struct CANBusIdStatistics {
+	uint16_t key = 0xFFFF; // Id, ORed with CAN_RECORD_OUTBOUND for sent messages. 0xFFFF - unused.
+	uint32_t frames; // Frames in current window
+	uint16_t framesPerSecond; // In the last complete window
+	uint16_t jitter[CAN_JITTER_BUCKETS]; // Inter-arrival times histogram, since statisticsReset().
+	uint32_t gapMaxMicros; // Longest inter-arrival time
+	uint32_t gapMinMicros; // Shortest inter-arrival time
+	uint32_t lastMicros; // Time of the previous frame, 0 - none yet.
+	uint32_t total; // Frames since statisticsReset()
+};
+
 class Mrm_can_bus {
 private:
+	uint16_t _bitrateKbps = CAN_BITRATE_KBPS;
 	uint32_t lastSentMicros = 0;
+	uint16_t _pacingMicros; // Minimum gap between 2 sent messages
+	uint32_t _receivedMicros = 0; // Time the last message was received
+	uint8_t _rxQueueLength;
+	uint8_t _txQueueLength;
+
+	CANBusFilter _filter; // Installed in driver, if _filterInstalled
+	bool _filterDirty = false; // Ids changed since _filter was calculated
+	bool _filterEnabled = true;
+	uint8_t* _filterIds; // Bitmap of registered ids, 2048 bits
+	uint16_t _filterIdCount = 0;
+	bool _filterInstalled = false; // false - driver accepts all
+	uint32_t _filterLeaked = 0; // Frames the driver passed, dropped by software
+	uint32_t _filterPassed = 0; // Frames received while filter installed
+	uint16_t _filterRestarts = 0;
+
+	CANBusErrors _errors;
+	CANBusIdStatistics* _idStatistics; // Hash table
+	uint16_t _idsUntracked = 0; // Frames with ids not tracked because the table was full
+	uint16_t _peakReceived = 0;
+	uint16_t _peakSent = 0;
+	uint16_t _receivedPerSecond = 0;
+	uint16_t _sentPerSecond = 0;
+	uint32_t _txCount = 0;
+	uint32_t _txWaitMicrosMax = 0; // Pacing and driver's queue, together
+	uint32_t _txWaitMicrosTotal = 0;
+	float _utilisation = 0; // Percent, in the last complete window
+	uint32_t _windowBits = 0;
+	uint16_t _windowReceived = 0;
+	uint16_t _windowSent = 0;
+	uint32_t _windowStartMs = 0;
+
+	SpscRing<CANBusMessage, CAN_TX_RING_SIZE>* _txRing = NULL; // Allocated in workerSet()
+	uint32_t _txRingWaits = 0; // messageSend() found the ring full
+	Worker* _worker = NULL; // Owns the bus, if running
+
+	CANBusRecord* _records = NULL; // Ring, allocated when recording starts the first time.
+	uint16_t _recordCount = 0;
+	uint16_t _recordHead = 0; // Next free record
+	uint32_t _recordsOverwritten = 0; // The oldest records lost because ring was full.
+	bool _recording = false;
+	uint32_t _replayFirstMicros; // Time of the first replayed record
+	uint16_t _replayIndex; // Next record to be replayed, 0 is the oldest one.
+	bool _replaying = false;
+	uint8_t _replaySpeed; // 1 - original speed, 2 - twice as fast,... 0 - as fast as possible.
+	uint32_t _replayStartMicros;
+	uint32_t _replaySuppressed = 0; // Messages not sent during replay
+
+	/** Store message into recorder's ring
+	@param id - CAN Bus id
+	@param dlc - data's used bytes count
+	@param data - up to 8 data bytes
+	@param outbound - sent, not received
+	*/
+	void record(uint32_t id, uint8_t dlc, uint8_t data[8], bool outbound);
+
+	/** Next recorded inbound message, when its time comes
+	@return - message or NULL if none due yet
+	*/
+	CANBusMessage* replayNext();
+
+	/** Installs and starts the driver
+	@param bitrateKbps - 125, 250, 500, 800 or 1000
+	@return - success
+	*/
+	bool driverStart(uint16_t bitrateKbps);
+
+	/** Installs a new filter, if the registered ids or filter's state changed. Restarts the driver, so it waits for sending queued
+	messages first. Messages received meanwhile are lost, so ids should be registered at start.
+	*/
+	void filterApply();
+
+	/** Sends a message, in the calling thread
+	@param stdId - CANBus message id
+	@param dlc - data's used bytes count
+	@param data - up to 8 data bytes
+	*/
+	void messageTransmit(uint32_t stdId, uint8_t dlc, uint8_t data[8]);
+
+	/** Calculates gap between sent messages from bitrate and measured bus load
+	*/
+	void pacingCalculate();
+
+	/** Must the caller leave the bus to the worker: is a worker running, and the caller another thread?
+	@return - yes
+	*/
+	bool queueing() { return _worker != NULL && _worker->running() && !_worker->isCurrent(); }
+
+	/** Counts a frame
+	@param id - CAN Bus id
+	@param dlc - data's used bytes count
+	@param outbound - sent, not received
+	*/
+	void statisticsAdd(uint32_t id, uint8_t dlc, bool outbound);
+
+	/** Closes statistics window, if expired, and reads driver's error counters.
+	*/
+	void statisticsWindow();
+
 public:
 
-	Mrm_can_bus();
+	/**
+	@param bitrateKbps - 125, 250, 500, 800 or 1000. All the devices must use the same.
+	@param txQueueLength - driver's transmit queue
+	@param rxQueueLength - driver's receive queue. Too short one loses messages when the loop is slow.
+	*/
+	Mrm_can_bus(uint16_t bitrateKbps = CAN_BITRATE_KBPS, uint8_t txQueueLength = CAN_TX_QUEUE_LENGTH,
+		uint8_t rxQueueLength = CAN_RX_QUEUE_LENGTH);
+
+	/** Bitrate in use
+	@return - kbit/s
+	*/
+	uint16_t bitrate() { return _bitrateKbps; }
+
+	/** Changes local bitrate, restarting the driver. Messages in queues are lost. Use Robot::canBusBitrateNegotiate() to change the
+	whole bus. Not while a worker owns the bus, unless called by it.
+	@param bitrateKbps - 125, 250, 500, 800 or 1000
+	@return - success. If false, the previous bitrate is restored.
+	*/
+	bool bitrateSet(uint16_t bitrateKbps);
+
+	/** Acceptance filter, valid if filterInstalled()
+	@return - filter
+	*/
+	const CANBusFilter* filter() { return &_filter; }
+
+	/** Enables or disables filtering. Sniffing needs all the frames, for example.
+	@param enable - if false, all the frames are received
+	*/
+	void filterEnable(bool enable);
+
+	/** Registers an id whose frames the robot receives. The filter is recalculated and installed at the next messageReceive().
+	@param id - 11-bit CAN Bus id
+	*/
+	void filterIdAdd(uint16_t id);
+
+	/** Number of registered ids. Changes when a device is added.
+	@return - count
+	*/
+	uint16_t filterIdCount() { return _filterIdCount; }
+
+	/** Is a hardware filter installed?
+	@return - installed
+	*/
+	bool filterInstalled() { return _filterInstalled; }
+
+	/** Frames the hardware filter passed but software dropped, because the filter's mask had to pass more ids than registered.
+	@return - count
+	*/
+	uint32_t filterLeaked() { return _filterLeaked; }
+
+	/** Frames received while hardware filter was installed. Frames it filtered are not visible to software and not counted.
+	@return - count
+	*/
+	uint32_t filterPassed() { return _filterPassed; }
+
+	/** Driver restarts because of a new filter
+	@return - count
+	*/
+	uint16_t filterRestarts() { return _filterRestarts; }
+
+	/** Waits till all the queued messages are transmitted: the ones queued for the worker, if any, and the driver's
+	@param timeoutMs - maximum wait
+	@return - true if transmit queue empty
+	*/
+	bool flush(uint16_t timeoutMs = 100);
+
+	/** Minimum gap between 2 sent messages
+	@return - microseconds
+	*/
+	uint16_t pacing() { return _pacingMicros; }
 
 	/**Receive a CANBus message
 	@return true - a message received, false - none
 	*/
 	CANBusMessage* messageReceive();
 
-	/**Send a CANBus message
+	/**Send a CANBus message. If a worker owns the bus and the caller is another thread, the message is only queued for the worker.
 	@param stdId - CANBus message id
 	@param dlc - data's used bytes count
 	@param data - up to 8 data bytes
@@ -29,6 +252,11 @@ public:
 	*/
 	void messageSend(uint32_t stdId, uint8_t dlc, uint8_t data[8]);
 
+	/** Time the last message messageReceive() returned was received, taken at once, in the receiving thread
+	@return - micros()
+	*/
+	uint32_t receivedMicros() { return _receivedMicros; }
+
 	/** Number of received CAN Bus messages per second
 	@return - number of messages
 	*/
@@ -49,5 +277,114 @@ public:
 	*/
 	uint16_t messagesPeakSent();
 
+	/** Resets peaks
+	*/
 	void messagesReset();
+
+	/** Controller's error counters, refreshed once in each statistics window
+	@return - counters
+	*/
+	const CANBusErrors* errors() { return &_errors; }
+
+	/** Statistics of an id
+	@param index - 0 - CAN_STATISTICS_IDS - 1
+	@return - statistics, NULL if the slot is unused
+	*/
+	const CANBusIdStatistics* idStatistics(uint8_t index) { return _idStatistics[index].key == 0xFFFF ? NULL : &_idStatistics[index]; }
+
+	/** Frames not counted per id because there was no free slot
+	@return - count
+	*/
+	uint16_t idsUntracked() { return _idsUntracked; }
+
+	/** Resets all the statistics
+	*/
+	void statisticsReset();
+
+	/** Average time messageSend() waited for pacing and driver's queue
+	@return - microseconds
+	*/
+	uint32_t txWaitMicrosAverage() { return _txCount == 0 ? 0 : _txWaitMicrosTotal / _txCount; }
+
+	/** Sends messages other threads queued. The worker owning the bus calls it in each pass.
+	*/
+	void transmitQueued();
+
+	/** Times messageSend() found the ring for the worker full and had to wait
+	@return - count
+	*/
+	uint32_t txRingWaits() { return _txRingWaits; }
+
+	/** Longest time messageSend() waited for pacing and driver's queue
+	@return - microseconds
+	*/
+	uint32_t txWaitMicrosMax() { return _txWaitMicrosMax; }
+
+	/** Bus utilisation, from frames' lengths in bits, including worst-case bit stuffing, in the last complete window
+	@return - percent
+	*/
+	float utilisation() { return _utilisation; }
+
+	/** Sets the thread owning the bus: the only one receiving and transmitting. Other threads' messageSend() queue messages for it.
+	Only one other thread may send.
+	@param worker - worker, NULL - none, any thread uses the bus directly.
+	*/
+	void workerSet(Worker* worker);
+
+	/** Is recorder on?
+	@return - on or off
+	*/
+	bool recording() { return _recording; }
+
+	/** Starts recording all the received and sent messages into RAM ring. If ring is full, the oldest records are overwritten.
+	@param erase - erase previous records
+	*/
+	void recordingStart(bool erase = true);
+
+	/** Stops recording
+	*/
+	void recordingStop() { _recording = false; }
+
+	/** Number of records in ring
+	@return - count
+	*/
+	uint16_t recordsCount() { return _recordCount; }
+
+	/** Writes all the records in binary format, described at CANBusRecord.
+	@param output - for example Serial
+	*/
+	void recordsDump(Print* output);
+
+	/** Loads records written by recordsDump(), replacing the ones in ring. Any text before "MRMCAN" is skipped, so a captured serial log can be
+	passed as it is. Recording and replay stop.
+	@param dump - dump's bytes
+	@param size - number of bytes
+	@return - number of records loaded, 0 if none or dump is not valid, with errorMessage set.
+	*/
+	uint16_t recordsLoad(const uint8_t* dump, uint32_t size);
+
+	/** The oldest records lost because ring was full
+	@return - count
+	*/
+	uint32_t recordsOverwritten() { return _recordsOverwritten; }
+
+	/** Is replay in progress?
+	@return - replaying or not
+	*/
+	bool replaying() { return _replaying; }
+
+	/** Starts replaying recorded inbound messages. Until finished, messageReceive() returns them instead of CAN Bus messages,
+	keeping recorded time distances, and messageSend() sends nothing. Recording stops.
+	@param speed - 1 - original speed, 2 - twice as fast,... 0 - as fast as possible.
+	*/
+	void replayStart(uint8_t speed = 1);
+
+	/** Stops replay
+	*/
+	void replayStop() { _replaying = false; }
+
+	/** Messages not sent because of replay
+	@return - count
+	*/
+	uint32_t replaySuppressed() { return _replaySuppressed; }
 };
\ No newline at end of file
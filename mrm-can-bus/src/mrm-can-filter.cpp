@@ -0,0 +1,112 @@
+#include "mrm-can-filter.h"
+
+/** Bits common to all the ids in a group
+*/
+struct IdGroup {
+	uint16_t code; // Common bits' values
+	uint16_t mask; // Bits 1 differ among ids
+	uint16_t count; // 0 - empty group
+};
+
+/** Adds an id to a group
+@param group - group
+@param id - 11-bit id
+*/
+static void groupAdd(IdGroup* group, uint16_t id) {
+	if (group->count++ == 0) {
+		group->code = id;
+		group->mask = 0;
+	}
+	else {
+		group->mask |= group->code ^ id;
+		group->code &= ~group->mask;
+	}
+}
+
+/** Number of ids a group's code and mask pass
+@param group - group
+@return - count
+*/
+static uint16_t groupPassing(const IdGroup* group) {
+	return 1 << __builtin_popcount(group->mask);
+}
+
+/** Number of ids 2 groups pass together
+@param a - first group
+@param b - second group
+@return - count
+*/
+static uint16_t groupsPassing(const IdGroup* a, const IdGroup* b) {
+	uint16_t passing = groupPassing(a) + groupPassing(b);
+	if (((a->code ^ b->code) & ~(a->mask | b->mask) & CAN_FILTER_ID_MASK) == 0) // Overlap
+		passing -= 1 << __builtin_popcount(a->mask & b->mask);
+	return passing;
+}
+
+/** The tightest filter passing all the ids. Single filter is tried, and dual one with ids split by each bit and at each id, when
+sorted. The one passing the fewest ids wins.
+@param ids - 11-bit ids
+@param count - number of ids
+@return - filter. Passes all the ids if count is 0.
+*/
+CANBusFilter canFilterCalculate(const uint16_t* ids, uint16_t count) {
+	CANBusFilter filter;
+	IdGroup all = { 0, 0, 0 };
+	for (uint16_t i = 0; i < count; i++)
+		groupAdd(&all, ids[i] & CAN_FILTER_ID_MASK);
+	if (count == 0)
+		all.mask = CAN_FILTER_ID_MASK;
+	filter.code = (uint32_t)all.code << 21;
+	filter.mask = (uint32_t)all.mask << 21 | 0x1FFFFF;
+	filter.dual = false;
+	filter.passing = groupPassing(&all);
+	if (count < 2)
+		return filter;
+
+	// Dual: candidate splits are by a bit and at an id. Each candidate is a predicate "id goes to the first group".
+	IdGroup best[2] = {};
+	uint16_t bestPassing = filter.passing;
+	for (uint16_t candidate = 0; candidate < CAN_FILTER_ID_BITS + count; candidate++) {
+		IdGroup group[2] = { { 0, 0, 0 }, { 0, 0, 0 } };
+		for (uint16_t i = 0; i < count; i++) {
+			uint16_t id = ids[i] & CAN_FILTER_ID_MASK;
+			bool first;
+			if (candidate < CAN_FILTER_ID_BITS)
+				first = id & (1 << candidate);
+			else
+				first = id < (ids[candidate - CAN_FILTER_ID_BITS] & CAN_FILTER_ID_MASK);
+			groupAdd(&group[first ? 0 : 1], id);
+		}
+		if (group[0].count == 0 || group[1].count == 0)
+			continue;
+		uint16_t passing = groupsPassing(&group[0], &group[1]);
+		if (passing < bestPassing) {
+			bestPassing = passing;
+			best[0] = group[0];
+			best[1] = group[1];
+		}
+	}
+
+	if (bestPassing < filter.passing) {
+		filter.code = (uint32_t)best[0].code << 21 | (uint32_t)best[1].code << 5;
+		filter.mask = (uint32_t)best[0].mask << 21 | 0x1F0000 | (uint32_t)best[1].mask << 5 | 0x1F; // RTR and data bits ignored.
+		filter.dual = true;
+		filter.passing = bestPassing;
+	}
+	return filter;
+}
+
+/** Does the filter pass the id? The same test the controller does.
+@param filter - filter
+@param id - 11-bit id
+@return - passes
+*/
+bool canFilterPasses(const CANBusFilter* filter, uint16_t id) {
+	uint32_t first = (uint32_t)(id & CAN_FILTER_ID_MASK) << 21;
+	if (((first ^ filter->code) & ~filter->mask & 0xFFE00000) == 0)
+		return true;
+	if (!filter->dual)
+		return false;
+	uint32_t second = (uint32_t)(id & CAN_FILTER_ID_MASK) << 5;
+	return ((second ^ filter->code) & ~filter->mask & 0xFFE0) == 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <stdint.h>
+
+/**
+Purpose: hardware acceptance filter for 11-bit CAN Bus ids. Pure calculation, without hardware access, so it compiles and can be
+checked on any computer.
+@author MRMS team
+@version 0.0 2026-10-19
+Licence: You can use this code any way you like.
+*/
+
+#define CAN_FILTER_ID_BITS 11
+#define CAN_FILTER_ID_MASK 0x7FF
+
+/** Filter in ESP32 CAN controller's format, for standard frames. Single filter: id in code's bits 31 - 21. Dual filter: first id in
+bits 31 - 21, second in 15 - 5. Mask's bits 1 are "don't care", so RTR and data bits are always 1.
+*/
+struct CANBusFilter {
+	uint32_t code;
+	uint32_t mask;
+	bool dual; // Dual filter mode
+	uint16_t passing; // Number of different ids the filter passes
+};
+
+/** The tightest filter passing all the ids. Single filter is tried, and dual one with ids split by each bit and at each id, when
+sorted. The one passing the fewest ids wins.
+@param ids - 11-bit ids
+@param count - number of ids
+@return - filter. Passes all the ids if count is 0.
+*/
+CANBusFilter canFilterCalculate(const uint16_t* ids, uint16_t count);
+
+/** Does the filter pass the id? The same test the controller does.
+@param filter - filter
+@param id - 11-bit id
+@return - passes
+*/
+bool canFilterPasses(const CANBusFilter* filter, uint16_t id);
@@ -0,0 +1,173 @@
+#include "mrm-echo.h"
+
+/** Forgets all the samples
+*/
+void EchoFilter::reset() {
+	_misses = 0;
+	_next = 0;
+	_output = 0;
+	_samples = 0;
+}
+
+/** Processes a measurement
+@param mm - nearest echo. 0 - no echo.
+@param micros - measurement's time, robot's micros()
+@return - filtered distance, mm. 0 - nothing in range.
+*/
+uint16_t EchoFilter::update(uint16_t mm, uint32_t micros) {
+	uint32_t elapsedMicros = micros - _micros;
+	if (_micros == 0 || elapsedMicros > ECHO_FILTER_STALE_MS * 1000UL)
+		reset();
+	_micros = micros;
+
+	if (mm == 0) {
+		if (++_misses > ECHO_FILTER_MISSES_ALLOWED)
+			reset();
+		return _output;
+	}
+	_misses = 0;
+
+	_window[_next] = mm;
+	_next = (_next + 1) % ECHO_FILTER_WINDOW;
+	if (_samples < ECHO_FILTER_WINDOW)
+		_samples++;
+
+	// Median. Insertion sort of a copy, the window is tiny.
+	uint16_t sorted[ECHO_FILTER_WINDOW];
+	for (uint8_t i = 0; i < _samples; i++) {
+		uint16_t value = _window[i];
+		int8_t j = i - 1;
+		for (; j >= 0 && sorted[j] > value; j--)
+			sorted[j + 1] = sorted[j];
+		sorted[j + 1] = value;
+	}
+	uint16_t median = sorted[_samples / 2];
+
+	if (_output == 0)
+		_output = median;
+	else {
+		uint32_t stepMax = (uint32_t)ECHO_FILTER_RATE_MM_PER_S * elapsedMicros / 1000000 + 1;
+		if (median > _output + stepMax) {
+			_output += stepMax;
+			_limited++;
+		}
+		else if (median + stepMax < _output) {
+			_output -= stepMax;
+			_limited++;
+		}
+		else
+			_output = median;
+	}
+	return _output;
+}
+
+/** Declares that 2 devices disturb each other so that they must not be fired together. By default all the devices interfere.
+@param deviceNumber1 - Device's ordinal number.
+@param deviceNumber2 - Second device.
+@param interfere - if false, devices can be fired together.
+@return - false if a device is out of range.
+*/
+bool EchoSchedule::crosstalkSet(uint8_t deviceNumber1, uint8_t deviceNumber2, bool interfere) {
+	if (deviceNumber1 >= _devices || deviceNumber2 >= _devices || deviceNumber1 == deviceNumber2)
+		return false;
+	if (interfere) {
+		_crosstalk[deviceNumber1] |= 1 << deviceNumber2;
+		_crosstalk[deviceNumber2] |= 1 << deviceNumber1;
+	}
+	else {
+		_crosstalk[deviceNumber1] &= ~(1 << deviceNumber2);
+		_crosstalk[deviceNumber2] &= ~(1 << deviceNumber1);
+	}
+	_groupsDirty = true;
+	return true;
+}
+
+/** Adds a device, interfering with all the existing ones
+@return - false if there is no room.
+*/
+bool EchoSchedule::deviceAdd() {
+	if (_devices >= ECHO_SCHEDULE_DEVICES_MAX)
+		return false;
+	_crosstalk[_devices] = 0;
+	for (uint8_t i = 0; i < _devices; i++) {
+		_crosstalk[i] |= 1 << _devices;
+		_crosstalk[_devices] |= 1 << i;
+	}
+	_devices++;
+	_groupsDirty = true;
+	return true;
+}
+
+/** Number of groups fired in turn
+@return - count
+*/
+uint8_t EchoSchedule::groupCount() {
+	if (_groupsDirty)
+		groupsBuild();
+	return _groupCount;
+}
+
+/** Splits devices into groups so that no 2 interfering devices are in the same group. Greedy: each device goes to the first group
+without a conflict.
+*/
+void EchoSchedule::groupsBuild() {
+	_groupCount = 0;
+	for (uint8_t i = 0; i < _devices; i++) {
+		uint8_t groupNumber = 0;
+		while (groupNumber < _groupCount && (_group[groupNumber] & _crosstalk[i]) != 0)
+			groupNumber++;
+		if (groupNumber == _groupCount)
+			_group[_groupCount++] = 0;
+		_group[groupNumber] |= 1 << i;
+	}
+	_groupCurrent = 0;
+	_groupsDirty = false;
+}
+
+/** A fired device answered
+@param deviceNumber - Device's ordinal number.
+@param micros - robot's micros()
+*/
+void EchoSchedule::received(uint8_t deviceNumber, uint32_t micros) {
+	uint8_t bit = 1 << deviceNumber;
+	if (_pending & bit) {
+		_pending &= ~bit;
+		if (_pending == 0)
+			_guardMicros = micros;
+	}
+}
+
+/** Which devices to fire now
+@param micros - robot's micros()
+@return - bitwise, devices the caller must fire at once. 0 - none.
+*/
+uint8_t EchoSchedule::refresh(uint32_t micros) {
+	if (_pending != 0) {
+		if (micros - _firedMicros < ECHO_SCHEDULE_TIMEOUT_MICROS)
+			return 0;
+		_pending = 0;
+		_guardMicros = micros;
+		_timeouts++;
+	}
+	if (!_running || _devices == 0 || micros - _guardMicros < ECHO_SCHEDULE_GUARD_MICROS)
+		return 0;
+	if (_groupsDirty)
+		groupsBuild();
+
+	uint8_t mask = _group[_groupCurrent];
+	if (++_groupCurrent >= _groupCount) {
+		_groupCurrent = 0;
+		_cycles++;
+	}
+	_firedMicros = micros;
+	_pending = mask;
+	return mask;
+}
+
+/** Starts firing
+*/
+void EchoSchedule::start() {
+	_guardMicros = 0;
+	_pending = 0;
+	_running = true;
+}
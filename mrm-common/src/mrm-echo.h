@@ -0,0 +1,140 @@
+#pragma once
+#include <stdint.h>
+
+/**
+Purpose: ultrasonic echoes' bookkeeping, common to all the ultrasonic boards: a list of echoes of one measurement, a temporal filter
+and a firing schedule that lets sensors not disturbing each other measure together. No hardware access, so the same code runs on a
+host computer, with simulated buses.
+@author MRMS team
+@version 0.0 2026-10-19
+Licence: You can use this code any way you like.
+*/
+
+#define ECHOES_MAX 9 // Echoes of a single measurement kept, nearest first.
+#define ECHO_FILTER_MISSES_ALLOWED 3 // Measurements without an echo, one after another, before the filter reports nothing in range.
+#define ECHO_FILTER_RATE_MM_PER_S 4000 // Fastest change of distance accepted. Faster changes are rate-limited, as they are mostly spikes.
+#define ECHO_FILTER_STALE_MS 500 // Filter restarts after a gap this long, old samples would only delay it.
+#define ECHO_FILTER_WINDOW 5 // Samples in median. Odd.
+#define ECHO_SCHEDULE_DEVICES_MAX 8 // Bitwise masks are uint8_t.
+#define ECHO_SCHEDULE_GUARD_MICROS 5000 // Pause after a group has finished, for late reflections to fade out.
+#define ECHO_SCHEDULE_TIMEOUT_MICROS 35000 // About 6 m round trip. A group not finished by then is considered finished.
+
+/** Echoes of a single measurement
+*/
+struct EchoList {
+	uint8_t count = 0; // 0 - nothing in range.
+	uint32_t micros = 0; // Time of the measurement, robot's micros(). 0 - none yet.
+	uint16_t mm[ECHOES_MAX]; // Distances, nearest first.
+};
+
+/** Median of the last ECHO_FILTER_WINDOW samples, followed by a rate limit. The median removes single spikes (a passing robot, a
+reflection from the floor) and the rate limit the rest of them, while a real change passes through with a delay of a few samples.
+*/
+class EchoFilter {
+	uint16_t _limited = 0;
+	uint32_t _micros = 0;
+	uint8_t _misses = 0;
+	uint8_t _next = 0;
+	uint16_t _output = 0;
+	uint8_t _samples = 0;
+	uint16_t _window[ECHO_FILTER_WINDOW];
+
+public:
+	/** Samples changed by the rate limit
+	@return - count
+	*/
+	uint16_t limited() { return _limited; }
+
+	/** Filtered distance
+	@return - mm. 0 - nothing in range.
+	*/
+	uint16_t output() { return _output; }
+
+	/** Forgets all the samples
+	*/
+	void reset();
+
+	/** Processes a measurement
+	@param mm - nearest echo. 0 - no echo.
+	@param micros - measurement's time, robot's micros()
+	@return - filtered distance, mm. 0 - nothing in range.
+	*/
+	uint16_t update(uint16_t mm, uint32_t micros);
+};
+
+/** Fires sensors in groups, so that no 2 sensors that disturb each other measure together, and the others do. A group is fired when the
+previous one has finished and the guard time has passed, so the update rate is limited by the number of groups, not of sensors.
+*/
+class EchoSchedule {
+	uint32_t _cycles = 0; // Passes through all the groups
+	uint8_t _crosstalk[ECHO_SCHEDULE_DEVICES_MAX]; // Bitwise, devices each device interferes with
+	uint8_t _devices = 0;
+	uint32_t _firedMicros = 0;
+	uint8_t _group[ECHO_SCHEDULE_DEVICES_MAX]; // Bitwise, devices fired together
+	uint8_t _groupCount = 0;
+	uint8_t _groupCurrent = 0;
+	bool _groupsDirty = true;
+	uint32_t _guardMicros = 0;
+	uint8_t _pending = 0; // Bitwise, fired devices that have not answered yet
+	bool _running = false;
+	uint16_t _timeouts = 0; // Groups with at least one device not answering
+
+	/** Splits devices into groups so that no 2 interfering devices are in the same group. Greedy: each device goes to the first group
+	without a conflict.
+	*/
+	void groupsBuild();
+
+public:
+	/** Declares that 2 devices disturb each other so that they must not be fired together. By default all the devices interfere.
+	@param deviceNumber1 - Device's ordinal number.
+	@param deviceNumber2 - Second device.
+	@param interfere - if false, devices can be fired together.
+	@return - false if a device is out of range.
+	*/
+	bool crosstalkSet(uint8_t deviceNumber1, uint8_t deviceNumber2, bool interfere);
+
+	/** Passes through all the groups
+	@return - count
+	*/
+	uint32_t cycles() { return _cycles; }
+
+	/** Adds a device, interfering with all the existing ones
+	@return - false if there is no room.
+	*/
+	bool deviceAdd();
+
+	/** Number of groups fired in turn
+	@return - count
+	*/
+	uint8_t groupCount();
+
+	/** A fired device answered
+	@param deviceNumber - Device's ordinal number.
+	@param micros - robot's micros()
+	*/
+	void received(uint8_t deviceNumber, uint32_t micros);
+
+	/** Which devices to fire now
+	@param micros - robot's micros()
+	@return - bitwise, devices the caller must fire at once. 0 - none.
+	*/
+	uint8_t refresh(uint32_t micros);
+
+	/** Is the schedule running?
+	@return - running
+	*/
+	bool running() { return _running; }
+
+	/** Starts firing
+	*/
+	void start();
+
+	/** Stops firing. Answers of the last group are still accepted.
+	*/
+	void stop() { _running = false; }
+
+	/** Groups with at least one device not answering
+	@return - count
+	*/
+	uint16_t timeouts() { return _timeouts; }
+};
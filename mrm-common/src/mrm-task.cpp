@@ -0,0 +1,82 @@
+#include "mrm-task.h"
+#ifndef ESP_PLATFORM
+#include <chrono>
+#endif
+
+/** Is the caller running in this worker's thread?
+@return - yes
+*/
+bool Worker::isCurrent() {
+#ifdef ESP_PLATFORM
+	return _task != NULL && xTaskGetCurrentTaskHandle() == _task;
+#else
+	return _thread != NULL && std::this_thread::get_id() == _thread->get_id();
+#endif
+}
+
+/** Thread's function
+@param worker - this
+*/
+void Worker::loop(void* worker) {
+	Worker* self = (Worker*)worker;
+	while (!self->_stopping) {
+		(*self->_pass)(self->_argument);
+#ifdef ESP_PLATFORM
+		vTaskDelay(1); // Lets idle task run, otherwise watchdog resets the core.
+#else
+		std::this_thread::yield();
+#endif
+	}
+	self->_running = false;
+#ifdef ESP_PLATFORM
+	self->_task = NULL;
+	vTaskDelete(NULL);
+#endif
+}
+
+/** Starts the thread
+@param pass - function called in each pass
+@param argument - pass' argument
+@param name - thread's name, for debugging
+@param core - ESP32's core, 0 or 1. Ignored on other platforms.
+@param stackBytes - stack size. Ignored on other platforms.
+@param priority - FreeRTOS priority. Ignored on other platforms.
+@return - started. false if already running or no memory.
+*/
+bool Worker::start(void (*pass)(void*), void* argument, const char* name, uint8_t core, uint32_t stackBytes, uint8_t priority) {
+	if (_running)
+		return false;
+	_pass = pass;
+	_argument = argument;
+	_stopping = false;
+	_running = true;
+#ifdef ESP_PLATFORM
+	if (xTaskCreatePinnedToCore(loop, name, stackBytes, this, priority, &_task, core) != pdPASS) {
+		_running = false;
+		return false;
+	}
+#else
+	(void)name;
+	(void)core;
+	(void)stackBytes;
+	(void)priority;
+	_thread = new std::thread(loop, this);
+#endif
+	return true;
+}
+
+/** Stops the thread after the current pass and waits for it
+*/
+void Worker::stop() {
+	if (!_running)
+		return;
+	_stopping = true;
+#ifdef ESP_PLATFORM
+	while (_running)
+		vTaskDelay(1);
+#else
+	_thread->join();
+	delete _thread;
+	_thread = NULL;
+#endif
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#else
+#include <thread>
+#endif
+
+/**
+Purpose: a function called in a loop in its own thread, and lock-free passing of data between threads. On ESP32 the thread is a FreeRTOS
+task pinned to a core, elsewhere a std::thread, so that the same code runs on a host computer.
+@author MRMS team
+@version 0.0 2026-10-19
+Licence: You can use this code any way you like.
+*/
+
+#define WORKER_PRIORITY 1 // The same as Arduino's loop.
+#define WORKER_STACK_BYTES 8192
+
+/** A function called repeatedly in its own thread, till stop()
+*/
+class Worker {
+	void* _argument;
+	void (*_pass)(void*);
+	volatile bool _running = false;
+	volatile bool _stopping = false;
+#ifdef ESP_PLATFORM
+	TaskHandle_t _task = NULL;
+#else
+	std::thread* _thread = NULL;
+#endif
+
+	/** Thread's function
+	@param worker - this
+	*/
+	static void loop(void* worker);
+
+public:
+	/** Is the caller running in this worker's thread?
+	@return - yes
+	*/
+	bool isCurrent();
+
+	/** Is it running?
+	@return - running
+	*/
+	bool running() { return _running; }
+
+	/** Starts the thread
+	@param pass - function called in each pass
+	@param argument - pass' argument
+	@param name - thread's name, for debugging
+	@param core - ESP32's core, 0 or 1. Ignored on other platforms.
+	@param stackBytes - stack size. Ignored on other platforms.
+	@param priority - FreeRTOS priority. Ignored on other platforms.
+	@return - started. false if already running or no memory.
+	*/
+	bool start(void (*pass)(void*), void* argument, const char* name, uint8_t core, uint32_t stackBytes = WORKER_STACK_BYTES,
+		uint8_t priority = WORKER_PRIORITY);
+
+	/** Stops the thread after the current pass and waits for it
+	*/
+	void stop();
+};
+
+/** Sequence lock: a single writer never waits, readers repeat reading if the writer changed the data meanwhile. Suitable for small data
+written often and read by another core.
+*/
+class SeqLock {
+	volatile uint32_t _sequence = 0; // Odd while writing
+
+public:
+	/** Reads consistently
+	@param read - function (usually lambda) copying the data. It may run more than once, so it must not have other side effects.
+	*/
+	template <typename Reader> void read(Reader read) {
+		uint32_t sequence;
+		do {
+			sequence = _sequence;
+			__sync_synchronize();
+			read();
+			__sync_synchronize();
+		} while ((sequence & 1) || sequence != _sequence);
+	}
+
+	/** Call before changing the data
+	*/
+	void writeBegin() {
+		_sequence++;
+		__sync_synchronize();
+	}
+
+	/** Call after changing the data
+	*/
+	void writeEnd() {
+		__sync_synchronize();
+		_sequence++;
+	}
+};
+
+/** Ring of items passed from one thread to another, without locking. Only one thread may push and only one pop.
+@param T - item
+@param SIZE - number of items, power of 2. One is always free, so SIZE - 1 can wait.
+*/
+template <typename T, uint16_t SIZE> class SpscRing {
+	static_assert((SIZE & (SIZE - 1)) == 0, "SIZE must be a power of 2");
+	T _items[SIZE];
+	volatile uint16_t _head = 0; // Next free, written only by the pushing thread
+	volatile uint16_t _tail = 0; // Next to be popped, written only by the popping thread
+
+public:
+	/** Is it empty? Another thread may push meanwhile.
+	@return - empty
+	*/
+	bool empty() { return _tail == _head; }
+
+	/** Takes the oldest item
+	@param item - output
+	@return - false if empty
+	*/
+	bool pop(T* item) {
+		if (_tail == _head)
+			return false;
+		__sync_synchronize(); // Item complete, as the pushing thread left it.
+		*item = _items[_tail];
+		__sync_synchronize(); // Copied before the slot is freed.
+		_tail = (_tail + 1) & (SIZE - 1);
+		return true;
+	}
+
+	/** Adds an item
+	@param item - copied
+	@return - false if full
+	*/
+	bool push(const T& item) {
+		uint16_t next = (_head + 1) & (SIZE - 1);
+		if (next == _tail)
+			return false;
+		_items[_head] = item;
+		__sync_synchronize(); // Complete before the popping thread sees it.
+		_head = next;
+		return true;
+	}
+};
@@ -0,0 +1,104 @@
+#include "mrm-imu-fusion.h"
+#include "Arduino.h"
+
+/** Angle between -180 and 180 degrees
+@param angle - any angle
+@return - angle
+*/
+static float angle180(float angle) {
+	angle = fmodf(angle, 360);
+	if (angle > 180)
+		angle -= 360;
+	else if (angle < -180)
+		angle += 360;
+	return angle;
+}
+
+/** Latest estimate. Safe to call at any time, without locking.
+@return - estimate
+*/
+ImuEstimate HeadingFusion::estimate() {
+	ImuEstimate copy;
+	uint32_t sequence;
+	do {
+		sequence = _estimateSequence;
+		__sync_synchronize();
+		copy = _estimate;
+		__sync_synchronize();
+	} while ((sequence & 1) || sequence != _estimateSequence); // Written meanwhile
+	return copy;
+}
+
+/** Publishes a new estimate, readable without locking
+@param heading - degrees, 0 - 360
+@param yawRate - degrees per second
+@param x - mm
+@param y - mm
+@param micros - time
+*/
+void HeadingFusion::publish(float heading, float yawRate, float x, float y, uint32_t micros) {
+	_estimateSequence++;
+	__sync_synchronize();
+	_estimate.heading = heading;
+	_estimate.micros = micros;
+	_estimate.x = x;
+	_estimate.y = y;
+	_estimate.yawRate = yawRate;
+	__sync_synchronize();
+	_estimateSequence++;
+}
+
+/** Starts from an absolute heading
+@param heading - degrees, 0 - 360
+@param odometry - current pose, NULL - no odometry
+@param micros - time
+*/
+void HeadingFusion::start(float heading, const OdometryPose* odometry, uint32_t micros) {
+	if (odometry != NULL)
+		_odometryLast = *odometry;
+	_absoluteRejects = 0;
+	publish(heading, 0, 0, 0, micros);
+}
+
+/** One fusion step
+@param micros - time
+@param yawRate - gyro's, degrees per second, positive clockwise
+@param odometry - current pose, NULL - no odometry
+@param absoluteHeading - degrees, 0 - 360. NULL - not read in this step.
+*/
+void HeadingFusion::step(uint32_t micros, float yawRate, const OdometryPose* odometry, const float* absoluteHeading) {
+	float seconds = (micros - _estimate.micros) / 1000000.0;
+
+	// Prediction: gyro, blended with odometry
+	float change = yawRate * seconds;
+	float x = _estimate.x;
+	float y = _estimate.y;
+	if (odometry != NULL) {
+		change = (1 - IMU_FUSION_ODOMETRY_WEIGHT) * change + IMU_FUSION_ODOMETRY_WEIGHT * angle180(odometry->heading - _odometryLast.heading);
+		// Odometry's displacement, rotated from its heading to the fused one
+		float offset = angle180(_estimate.heading + change - odometry->heading) * DEG_TO_RAD;
+		float dx = odometry->x - _odometryLast.x;
+		float dy = odometry->y - _odometryLast.y;
+		x += dx * cosf(offset) + dy * sinf(offset);
+		y += dy * cosf(offset) - dx * sinf(offset);
+		_odometryLast = *odometry;
+	}
+	float fused = _estimate.heading + change;
+
+	// Correction: absolute heading
+	if (absoluteHeading != NULL) {
+		float error = angle180(*absoluteHeading - fused);
+		if (fabsf(error) < IMU_FUSION_DISTURBANCE_DEGREES) {
+			fused += IMU_FUSION_ABSOLUTE_GAIN * error;
+			_absoluteRejects = 0;
+		}
+		else if (++_absoluteRejects > IMU_FUSION_DISTURBANCE_STEPS) { // Not a disturbance, estimate is wrong.
+			fused += error;
+			_absoluteRejects = 0;
+		}
+	}
+	fused = fmodf(fused, 360);
+	if (fused < 0)
+		fused += 360;
+	publish(fused, yawRate, x, y, micros);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <stdint.h>
+#include <mrm-odometry.h>
+
+/**
+Purpose: heading fusion of gyro, odometry and absolute heading, used by Mrm_imu. No sensor reads, so the same code runs on a host computer.
+@author MRMS team
+@version 0.0 2026-10-19
+Licence: You can use this code any way you like.
+*/
+
+#define IMU_FUSION_ABSOLUTE_GAIN 0.02 // Part of the difference to BNO055's absolute heading corrected in each absolute step.
+#define IMU_FUSION_ABSOLUTE_PERIOD_MS 100 // Absolute heading is read less often, it is slower and disturbed near motors.
+#define IMU_FUSION_DISTURBANCE_DEGREES 15 // Larger difference to absolute heading is treated as magnetic disturbance and ignored...
+#define IMU_FUSION_DISTURBANCE_STEPS 50 // ...unless it lasts this many absolute steps. Then the estimate is reset to absolute heading.
+#define IMU_FUSION_ODOMETRY_WEIGHT 0.2 // Odometry's share of heading change. Wheels slip, gyro drifts.
+#define IMU_FUSION_PERIOD_MS 10
+
+/** Fused heading and position, published by HeadingFusion::step()
+*/
+struct ImuEstimate {
+	float heading; // North is 0 degrees, clockwise are positive angles, values 0 - 360.
+	uint32_t micros; // Time of the estimate
+	float x; // mm, from odometry, rotated by fused heading. 0 without odometry.
+	float y; // mm
+	float yawRate; // Degrees per second, positive clockwise
+};
+
+/** Heading estimate: integrates gyro's yaw rate, blended with odometry's heading change, and slowly corrects drift towards the absolute
+heading, ignoring magnetic disturbances. Written by one thread, read by any, without locking.
+*/
+class HeadingFusion {
+	uint16_t _absoluteRejects = 0; // Consecutive absolute headings ignored as disturbed
+	ImuEstimate _estimate = { 0, 0, 0, 0, 0 };
+	volatile uint32_t _estimateSequence = 0; // Odd while _estimate is being written
+	OdometryPose _odometryLast;
+
+	/** Publishes a new estimate, readable without locking
+	@param heading - degrees, 0 - 360
+	@param yawRate - degrees per second
+	@param x - mm
+	@param y - mm
+	@param micros - time
+	*/
+	void publish(float heading, float yawRate, float x, float y, uint32_t micros);
+
+public:
+	/** Latest estimate. Safe to call at any time, without locking.
+	@return - estimate
+	*/
+	ImuEstimate estimate();
+
+	/** Starts from an absolute heading
+	@param heading - degrees, 0 - 360
+	@param odometry - current pose, NULL - no odometry
+	@param micros - time
+	*/
+	void start(float heading, const OdometryPose* odometry, uint32_t micros);
+
+	/** One fusion step
+	@param micros - time
+	@param yawRate - gyro's, degrees per second, positive clockwise
+	@param odometry - current pose, NULL - no odometry
+	@param absoluteHeading - degrees, 0 - 360. NULL - not read in this step.
+	*/
+	void step(uint32_t micros, float yawRate, const OdometryPose* odometry, const float* absoluteHeading);
+};
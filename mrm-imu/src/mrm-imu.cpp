@@ -38,6 +38,44 @@ void Mrm_imu::add(bool defaultI2CAddress) {
 	bno055Initialize(defaultI2CAddress);
 }
 
+#ifdef ESP_PLATFORM
+/** One fusion step, if IMU_FUSION_PERIOD_MS passed: reads gyro's yaw rate, absolute heading when due, and odometry's pose, and
+fuses them (HeadingFusion::step()). Call in each loop pass.
+*/
+void Mrm_imu::fusionRefresh() {
+	uint32_t now = micros();
+	if (!_fusing || now - _fusionMicros < IMU_FUSION_PERIOD_MS * 1000)
+		return;
+	_fusionMicros = now;
+
+	float rate = yawRate();
+	OdometryPose pose;
+	if (_odometry != NULL)
+		pose = _odometry->pose();
+	float absolute;
+	bool absoluteRead = millis() - _fusionAbsoluteMs >= IMU_FUSION_ABSOLUTE_PERIOD_MS;
+	if (absoluteRead) {
+		_fusionAbsoluteMs = millis();
+		absolute = heading();
+	}
+	_fusion.step(now, rate, _odometry == NULL ? NULL : &pose, absoluteRead ? &absolute : NULL);
+}
+
+/** Starts heading fusion, from the current absolute heading
+@param odometry - motor group with odometry started, NULL - gyro and absolute heading only
+*/
+void Mrm_imu::fusionStart(MotorGroup* odometry) {
+	_odometry = odometry;
+	OdometryPose pose;
+	if (odometry != NULL)
+		pose = odometry->pose();
+	_fusionAbsoluteMs = millis();
+	_fusionMicros = micros();
+	_fusion.start(heading(), odometry == NULL ? NULL : &pose, _fusionMicros);
+	_fusing = true;
+}
+#endif
+
 /**Compass
 @return - North is 0�, clockwise are positive angles, values 0 - 360.
 */
@@ -151,6 +189,16 @@ uint8_t Mrm_imu::systemCalibration() {
 	}
 }
 
+/** Yaw rate, from gyro. A single short I2C read.
+@return - Degrees per second, clockwise positive, like heading().
+*/
+float Mrm_imu::yawRate() {
+	float z;
+	if (bno055_convert_float_gyro_z_dps(&z) != BNO055_SUCCESS)
+		return 0;
+	return -z; // Gyro's z axis points up, so its positive rotation is counter-clockwise.
+}
+
 /**Test
 */
 void Mrm_imu::test() {
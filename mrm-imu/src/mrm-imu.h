@@ -3,6 +3,7 @@
 #include "bno055.h"// bno055.h and bno055.cpp files must be in Arduino libraries.
 #ifdef ESP_PLATFORM
 #include <mrm-board.h>
+#include "mrm-imu-fusion.h"
 #else
 #include <Arduino.h>
 #endif
@@ -25,6 +26,12 @@ class Mrm_imu
 	int nextFree;
 #ifdef ESP_PLATFORM
 	Robot* robotContainer;
+
+	HeadingFusion _fusion;
+	uint32_t _fusionAbsoluteMs = 0;
+	uint32_t _fusionMicros = 0;
+	bool _fusing = false;
+	MotorGroup* _odometry = NULL;
 #endif
 
 	void bno055Initialize(bool defaultI2CAddress = true); //IMU initialization of the sensor. It should be called once, after Wire.begin(). 
@@ -57,6 +64,32 @@ public:
 	*/
 	void add(bool defautI2CAddress = true);
 
+#ifdef ESP_PLATFORM
+	/** Latest fused estimate. Safe to call at any time, without locking.
+	@return - estimate
+	*/
+	ImuEstimate estimate() { return _fusion.estimate(); }
+
+	/** Is fusion running?
+	@return - running
+	*/
+	bool fusing() { return _fusing; }
+
+	/** One fusion step, if IMU_FUSION_PERIOD_MS passed: reads gyro's yaw rate, absolute heading when due, and odometry's pose, and
+	fuses them (HeadingFusion::step()). Call in each loop pass.
+	*/
+	void fusionRefresh();
+
+	/** Starts heading fusion, from the current absolute heading
+	@param odometry - motor group with odometry started, NULL - gyro and absolute heading only
+	*/
+	void fusionStart(MotorGroup* odometry = NULL);
+
+	/** Stops heading fusion
+	*/
+	void fusionStop() { _fusing = false; }
+#endif
+
 	/** Gyro calibration
 	@return - Calibration
 	*/
@@ -87,6 +120,11 @@ public:
 	*/
 	uint8_t systemCalibration();
 
+	/** Yaw rate, from gyro. A single short I2C read.
+	@return - Degrees per second, clockwise positive, like heading().
+	*/
+	float yawRate();
+
 	/**Test
 	*/
 	void test();
@@ -62,8 +62,9 @@ void Mrm_ir_finder_can::add(char * deviceName)
 /** Read CAN Bus message into local variables
 @param canId - CAN Bus id
 @param data - 8 bytes from CAN Bus message.
+@param length - number of data bytes
 */
-bool Mrm_ir_finder_can::messageDecode(uint32_t canId, uint8_t data[8]) {
+bool Mrm_ir_finder_can::messageDecode(uint32_t canId, uint8_t data[8], uint8_t length) {
 	for (uint8_t deviceNumber = 0; deviceNumber < nextFree; deviceNumber++)
 		if (isForMe(canId, deviceNumber)) {
 			if (!messageDecodeCommon(canId, data, deviceNumber)) {
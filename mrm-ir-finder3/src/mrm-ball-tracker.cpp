@@ -0,0 +1,102 @@
+#include "mrm-ball-tracker.h"
+#include "Arduino.h"
+
+/** Angle between -180 and 180 degrees
+@param angle - any angle
+@return - angle
+*/
+static float angle180(float angle) {
+	angle = fmodf(angle, 360);
+	if (angle > 180)
+		angle -= 360;
+	else if (angle < -180)
+		angle += 360;
+	return angle;
+}
+
+/** Estimate extrapolated to another time, for example to when the robot's command will take effect
+@param micros - robot's micros()
+@return - estimate. Confidence drops with extrapolation's length.
+*/
+BallEstimate BallTracker::predict(uint32_t micros) {
+	BallEstimate predicted = _estimate;
+	if (!_estimate.valid)
+		return predicted;
+	float seconds = (int32_t)(micros - _estimate.micros) / 1000000.0;
+	if (seconds * 1000 > BALL_TRACK_LOST_MS) {
+		predicted.valid = false;
+		predicted.confidence = 0;
+		return predicted;
+	}
+	predicted.angle = angle180(_estimate.angle + _estimate.angleRate * seconds);
+	if (_estimate.distance > 0)
+		predicted.distance = max(0.0f, _estimate.distance + _estimate.distanceRate * seconds);
+	predicted.confidence *= 1 - fabsf(seconds) * 1000 / BALL_TRACK_LOST_MS;
+	predicted.micros = micros;
+	return predicted;
+}
+
+/** Starts a new track
+@param angle - degrees
+@param distance - intensity, < 0 - unknown
+@param micros - measurement's time
+*/
+void BallTracker::restart(float angle, float distance, uint32_t micros) {
+	_estimate.angle = angle180(angle);
+	_estimate.angleRate = 0;
+	_estimate.confidence = 0.3;
+	_estimate.distance = distance < 0 ? 0 : distance;
+	_estimate.distanceRate = 0;
+	_estimate.micros = micros;
+	_estimate.valid = true;
+	_gateMisses = 0;
+}
+
+/** Processes a measurement
+@param angle - degrees, robot's front is 0 degrees, positive angles clockwise
+@param distance - intensity. 0 - no ball. < 0 - unknown, only angle measured.
+@param micros - measurement's time, robot's micros()
+@param weight - trust in this measurement, 0 - 1, scales filter's gains.
+*/
+void BallTracker::update(float angle, float distance, uint32_t micros, float weight) {
+	if (distance == 0) { // No ball in sight
+		_estimate.confidence *= 0.8;
+		if (_estimate.confidence < 0.05)
+			_estimate.valid = false;
+		return;
+	}
+	float seconds = (int32_t)(micros - _estimate.micros) / 1000000.0;
+	if (!_estimate.valid || seconds * 1000 > BALL_TRACK_LOST_MS) {
+		restart(angle, distance, micros);
+		return;
+	}
+	if (seconds <= 0) // Older than the estimate, or the same time
+		return;
+
+	float innovation = angle180(angle - (_estimate.angle + _estimate.angleRate * seconds));
+	if (fabsf(innovation) > BALL_TRACK_GATE_DEGREES) { // Outlier, or the ball really jumped.
+		if (++_gateMisses >= BALL_TRACK_GATE_MISSES)
+			restart(angle, distance, micros);
+		else
+			_estimate.confidence *= 0.7;
+		return;
+	}
+	_gateMisses = 0;
+	float alpha = BALL_TRACK_ALPHA * weight;
+	float beta = BALL_TRACK_BETA * weight;
+	_estimate.angle = angle180(_estimate.angle + _estimate.angleRate * seconds + alpha * innovation);
+	_estimate.angleRate += beta * innovation / seconds;
+	if (distance > 0) {
+		if (_estimate.distance == 0)
+			_estimate.distance = distance;
+		else {
+			float predicted = _estimate.distance + _estimate.distanceRate * seconds;
+			_estimate.distance = predicted + alpha * (distance - predicted);
+			_estimate.distanceRate += beta * (distance - predicted) / seconds;
+		}
+	}
+	else if (_estimate.distance > 0) // Angle only: distance extrapolated, as the estimate's time moves on.
+		_estimate.distance = max(0.0f, _estimate.distance + _estimate.distanceRate * seconds);
+	_estimate.confidence += (1 - _estimate.confidence) * 0.2 * weight;
+	_estimate.micros = micros;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <stdint.h>
+
+/**
+Purpose: ball tracking for mrm-ir-finder3. No hardware access, so the same code runs on a host computer.
+@author MRMS team
+@version 0.0 2026-10-19
+Licence: You can use this code any way you like.
+*/
+
+#define BALL_TRACK_ALPHA 0.4 // Part of the innovation (measured minus predicted) corrected in position. Raw readings use half.
+#define BALL_TRACK_BETA 0.02 // Part of the innovation corrected in velocity. Frames come each 10 ms or so, higher gain turns noise into false speed.
+#define BALL_TRACK_GATE_DEGREES 45 // Measurements farther from prediction are outliers...
+#define BALL_TRACK_GATE_MISSES 3 // ...unless so many come one after another. Then the ball really moved (kick) and track restarts.
+#define BALL_TRACK_LOST_MS 500 // Without a measurement for this time, the ball is lost.
+
+/** Ball's track: estimated position and velocity, relative to the robot
+*/
+struct BallEstimate {
+	float angle; // Robot's front is 0 degrees, positive angles clockwise, -180 - 180 degrees.
+	float angleRate; // Degrees per second
+	float confidence; // 0 - 1. Grows with consistent measurements, drops with outliers, missing ball and age.
+	float distance; // Intensity, like distance(). 0 - unknown.
+	float distanceRate; // Per second
+	uint32_t micros; // Time of the estimate, robot's micros()
+	bool valid; // false - no ball
+};
+
+/** Alpha-beta filter of ball's angle and distance with outliers' gating. No hardware access, so recorded frames can be replayed through it.
+*/
+class BallTracker {
+	BallEstimate _estimate;
+	uint8_t _gateMisses = 0;
+
+	/** Starts a new track
+	@param angle - degrees
+	@param distance - intensity, < 0 - unknown
+	@param micros - measurement's time
+	*/
+	void restart(float angle, float distance, uint32_t micros);
+
+public:
+	BallTracker() { _estimate.valid = false; }
+
+	/** Current estimate, at the time of the last measurement
+	@return - estimate
+	*/
+	const BallEstimate* estimate() { return &_estimate; }
+
+	/** Estimate extrapolated to another time, for example to when the robot's command will take effect
+	@param micros - robot's micros()
+	@return - estimate. Confidence drops with extrapolation's length.
+	*/
+	BallEstimate predict(uint32_t micros);
+
+	/** Processes a measurement
+	@param angle - degrees, robot's front is 0 degrees, positive angles clockwise
+	@param distance - intensity. 0 - no ball. < 0 - unknown, only angle measured.
+	@param micros - measurement's time, robot's micros()
+	@param weight - trust in this measurement, 0 - 1, scales filter's gains.
+	*/
+	void update(float angle, float distance, uint32_t micros, float weight = 1);
+};
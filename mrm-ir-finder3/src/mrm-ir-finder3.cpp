@@ -1,6 +1,8 @@
 #include "mrm-ir-finder3.h"
 #include <mrm-robot.h>
 
+#define RECEIVERS_FAR 6 // Long-range receivers, 60 degrees apart, used when the ball is not near. Receiver 0 points forward, the next ones clockwise.
+
 /** Constructor
 @param robot - robot containing this board
 @param maxNumberOfBoards - maximum number of boards
@@ -8,9 +10,12 @@
 Mrm_ir_finder3::Mrm_ir_finder3(Robot* robot, uint8_t maxNumberOfBoards) : 
 	SensorBoard(robot, 1, "IRFind3", maxNumberOfBoards, ID_MRM_IR_FINDER3, MRM_IR_FINDER3_SENSOR_COUNT) {
 	_angle = new std::vector<int16_t>(maxNumberOfBoards);
+	_ballTrackers = new std::vector<BallTracker>(maxNumberOfBoards);
 	_calculated = new std::vector<bool>(maxNumberOfBoards);
 	_distance = new std::vector<uint16_t>(maxNumberOfBoards);
 	_near = new std::vector<bool>(maxNumberOfBoards);
+	_rawFirst = new std::vector<uint8_t[7]>(maxNumberOfBoards);
+	_rawFirstValid = new std::vector<bool>(maxNumberOfBoards);
 	readings = new std::vector<uint16_t[MRM_IR_FINDER3_SENSOR_COUNT]>(maxNumberOfBoards);
 	measuringModeLimit = 2;
 }
@@ -77,6 +82,21 @@ int16_t Mrm_ir_finder3::angle(uint8_t deviceNumber) {
 		return 0;
 }
 
+/** Ball's tracked position and velocity, fused from calculated and raw readings, whichever the device sends.
+@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@param atMicros - robot's micros() to predict for, compensating loop's latency. 0 - now.
+@return - estimate
+*/
+BallEstimate Mrm_ir_finder3::ball(uint8_t deviceNumber, uint32_t atMicros) {
+	if (deviceNumber >= nextFree) {
+		strcpy(errorMessage, "mrm-ir-finder3 doesn't exist");
+		BallEstimate none;
+		none.valid = false;
+		return none;
+	}
+	return (*_ballTrackers)[deviceNumber].predict(atMicros == 0 ? micros() : atMicros);
+}
+
 /** If calculated mode not started, start it and wait for 1. message
 @param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
 @return - started or not
@@ -123,7 +143,6 @@ uint16_t Mrm_ir_finder3::distance(uint8_t deviceNumber) {
 @param length - number of data bytes
 */
 bool Mrm_ir_finder3::messageDecode(uint32_t canId, uint8_t data[8], uint8_t length) {
-	// Todo: a problem: one message can be for short range sensors, the other for long. A mixed data will be the result.
 	for (uint8_t deviceNumber = 0; deviceNumber < nextFree; deviceNumber++)
 		if (isForMe(canId, deviceNumber)) {
 			if (!messageDecodeCommon(canId, data, deviceNumber)) {
@@ -131,10 +150,19 @@ bool Mrm_ir_finder3::messageDecode(uint32_t canId, uint8_t data[8], uint8_t leng
 				uint8_t startIndex = 0;
 				uint8_t length = 7;
 				switch (data[0]) {
-				case COMMAND_IR_FINDER3_SENDING_SENSORS_1_TO_7:
-					any = true;
+				case COMMAND_IR_FINDER3_SENDING_SENSORS_1_TO_7: // Kept till the second frame arrives, not to mix short and long range.
+					for (uint8_t i = 0; i < 7; i++)
+						(*_rawFirst)[deviceNumber][i] = data[i + 1];
+					(*_rawFirstValid)[deviceNumber] = true;
 					break;
 				case COMMAND_IR_FINDER3_SENDING_SENSORS_8_TO_12:
+					if (!(*_rawFirstValid)[deviceNumber]) { // First frame lost, this one may belong to another range.
+						_rawFramesDropped++;
+						break;
+					}
+					(*_rawFirstValid)[deviceNumber] = false;
+					for (uint8_t i = 0; i < 7; i++)
+						(*readings)[deviceNumber][i] = (*_rawFirst)[deviceNumber][i];
 					startIndex = 7;
 					length = 5;
 					(*_near)[deviceNumber] = data[6];
@@ -146,6 +174,8 @@ bool Mrm_ir_finder3::messageDecode(uint32_t canId, uint8_t data[8], uint8_t leng
 					(*_distance)[deviceNumber] = (data[3] << 8) | data[4];
 					(*_near)[deviceNumber] = data[5];
 					(*_lastReadingMs)[deviceNumber] = millis();
+					(*_ballTrackers)[deviceNumber].update((*_angle)[deviceNumber], (*_distance)[deviceNumber],
+						acquisitionMicros(deviceNumber));
 					break;
 				default:
 					robotContainer->print("Unknown command. ");
@@ -154,15 +184,44 @@ bool Mrm_ir_finder3::messageDecode(uint32_t canId, uint8_t data[8], uint8_t leng
 					errorInDeviceNumber = deviceNumber;
 				}
 
-				if (any)
+				if (any) {
 					for (uint8_t i = 0; i < length; i++)
 						(*readings)[deviceNumber][startIndex + i] = data[i + 1];
+					float ballAngle;
+					uint16_t strongest = rawAngle(deviceNumber, &ballAngle);
+					(*_ballTrackers)[deviceNumber].update(ballAngle, strongest == 0 ? 0 : -1, acquisitionMicros(deviceNumber),
+						0.5); // Raw angle is coarser. Its intensity is on another scale, so distance is not updated.
+				}
 			}
 			return true;
 		}
 	return false;
 }
 
+/** Ball's direction and intensity from raw readings: circular weighted average of the strongest receiver and its neighbours.
+@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@param angle - output, degrees
+@return - strongest receiver's reading, 0 - no ball
+*/
+uint16_t Mrm_ir_finder3::rawAngle(uint8_t deviceNumber, float* angle) {
+	uint8_t count = (*_near)[deviceNumber] ? MRM_IR_FINDER3_SENSOR_COUNT : RECEIVERS_FAR;
+	uint16_t* values = (*readings)[deviceNumber];
+	uint8_t strongest = 0;
+	for (uint8_t i = 1; i < count; i++)
+		if (values[i] > values[strongest])
+			strongest = i;
+	float x = 0;
+	float y = 0;
+	for (int8_t offset = -1; offset <= 1; offset++) {
+		uint8_t i = (strongest + offset + count) % count;
+		float radians = toRad(i * 360.0 / count);
+		x += values[i] * sinf(radians);
+		y += values[i] * cosf(radians);
+	}
+	*angle = toDeg(atan2f(x, y));
+	return values[strongest];
+}
+
 /** Analog readings
 @param receiverNumberInSensor - single IR receiver in mrm-ir-finder3
 @param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
@@ -1,6 +1,7 @@
 #pragma once
 #include "Arduino.h"
 #include <mrm-board.h>
+#include "mrm-ball-tracker.h"
 
 /**
 Purpose: mrm-ir-finder3 interface to CANBus.
@@ -39,9 +40,20 @@ class Mrm_ir_finder3 : public SensorBoard
 {
 	std::vector<uint16_t[MRM_IR_FINDER3_SENSOR_COUNT]>* readings; // Cumulative readings of all sensors
 	std::vector<int16_t>* _angle;
+	std::vector<BallTracker>* _ballTrackers;
 	std::vector<bool>* _calculated; // If not, then for every sensor.
 	std::vector<uint16_t>* _distance;
 	std::vector<bool>*  _near;
+	std::vector<uint8_t[7]>* _rawFirst; // Sensors 1 - 7, waiting for 8 - 12, so that the two frames are used together or not at all.
+	std::vector<bool>* _rawFirstValid;
+	uint16_t _rawFramesDropped = 0; // Second frames without the first one
+
+	/** Ball's direction and intensity from raw readings: circular weighted average of the strongest receiver and its neighbours.
+	@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@param angle - output, degrees
+	@return - strongest receiver's reading, 0 - no ball
+	*/
+	uint16_t rawAngle(uint8_t deviceNumber, float* angle);
 
 	/** If calculated mode not started, start it and wait for 1. message
 	@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
@@ -78,6 +90,13 @@ public:
 	*/
 	int16_t angle(uint8_t deviceNumber = 0);
 
+	/** Ball's tracked position and velocity, fused from calculated and raw readings, whichever the device sends.
+	@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@param atMicros - robot's micros() to predict for, compensating loop's latency. 0 - now.
+	@return - estimate
+	*/
+	BallEstimate ball(uint8_t deviceNumber = 0, uint32_t atMicros = 0);
+
 	/** Ball's distance
 	@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
 	@return - this is analog value that represents infrared light intensity, so not directly distance, but the distance can be inferred. When ball is quite close, expect values up to about 3000.
@@ -100,6 +119,11 @@ public:
 	*/
 	uint16_t reading(uint8_t receiverNumberInSensor, uint8_t deviceNumber = 0);
 
+	/** Raw second frames dropped because their first frame was missing, so that the two are not mixed.
+	@return - count
+	*/
+	uint16_t rawFramesDropped() { return _rawFramesDropped; }
+
 	/** Print all readings in a line
 	*/
 	void readingsPrint();
@@ -189,6 +189,8 @@ bool Mrm_lid_can_b::messageDecode(uint32_t canId, uint8_t data[8], uint8_t lengt
 					uint16_t mm = (data[2] << 8) | data[1];
 					(*readings)[deviceNumber] = mm;
 					(*_lastReadingMs)[deviceNumber] = millis();
+					if (length >= 5) // Timestamp appended
+						timestampDecode(deviceNumber, data[3] | (data[4] << 8));
 				}
 				break;
 				default:
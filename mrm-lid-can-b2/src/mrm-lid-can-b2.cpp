@@ -188,6 +188,8 @@ bool Mrm_lid_can_b2::messageDecode(uint32_t canId, uint8_t data[8], uint8_t leng
 					uint16_t mm = (data[2] << 8) | data[1];
 					(*readings)[deviceNumber] = mm;
 					(*_lastReadingMs)[deviceNumber] = millis();
+					if (length >= 5) // Timestamp appended
+						timestampDecode(deviceNumber, data[3] | (data[4] << 8));
 				}
 				break;
 				case COMMAND_INFO_SENDING_1:
@@ -12,6 +12,7 @@ Mrm_node::Mrm_node(Robot* robot, uint8_t maxNumberOfBoards) :
 	readings = new std::vector<uint16_t[MRM_NODE_ANALOG_COUNT]>(maxNumberOfBoards);
 	switches = new std::vector<bool[MRM_NODE_SWITCHES_COUNT]>(maxNumberOfBoards);
 	servoDegrees = new std::vector<uint16_t[MRM_NODE_SERVO_COUNT]>(maxNumberOfBoards);
+	servoMotion = new std::vector<ServoMotion[MRM_NODE_SERVO_COUNT]>(maxNumberOfBoards);
 }
 
 Mrm_node::~Mrm_node()
@@ -65,8 +66,10 @@ void Mrm_node::add(char * deviceName)
 	for (uint8_t i = 0; i < MRM_NODE_SWITCHES_COUNT; i++)
 		(*switches)[nextFree][i] = 0;
 
-	for (uint8_t i = 0; i < MRM_NODE_SERVO_COUNT; i++)
+	for (uint8_t i = 0; i < MRM_NODE_SERVO_COUNT; i++) {
 		(*servoDegrees)[nextFree][i] = 0xFFFF;
+		(*servoMotion)[nextFree][i].active = false;
+	}
 
 	SensorBoard::add(deviceName, canIn, canOut);
 }
@@ -149,6 +152,71 @@ void Mrm_node::readingsPrint() {
 	}
 }
 
+/** Starts moving servo in background. servoRefresh() must be called often, Robot does it in noLoopWithoutThis().
+If the servo's position is not known yet, it is set immediately.
+@servoNumber - 0 - 2
+@degrees - target, 0 - 180 degrees
+@ms - duration of the motion
+@profile - velocity profile
+@deviceNumber - mrm-node id
+*/
+void Mrm_node::servoMove(uint8_t servoNumber, uint16_t degrees, uint16_t ms, ServoProfile profile, uint8_t deviceNumber) {
+	if (servoNumber >= MRM_NODE_SERVO_COUNT || deviceNumber >= nextFree) {
+		strcpy(errorMessage, "Servo not found");
+		return;
+	}
+	uint16_t current = (*servoDegrees)[deviceNumber][servoNumber];
+	if (current == 0xFFFF || ms == 0) // Unknown start, no path to follow
+		servoWrite(servoNumber, degrees, deviceNumber);
+	else {
+		(*servoMotion)[deviceNumber][servoNumber].start(current, degrees, ms, profile, millis());
+		servoRefreshMs = 0; // First step immediately
+		servoRefresh();
+	}
+}
+
+/** Is a motion in progress?
+@deviceNumber - mrm-node id
+@return - any of the device's servos moving
+*/
+bool Mrm_node::servoMoving(uint8_t deviceNumber) {
+	for (uint8_t servoNumber = 0; servoNumber < MRM_NODE_SERVO_COUNT; servoNumber++)
+		if ((*servoMotion)[deviceNumber][servoNumber].active)
+			return true;
+	return false;
+}
+
+/** Advances motions in progress. Call as often as possible.
+*/
+void Mrm_node::servoRefresh() {
+	uint32_t nowMs = millis();
+	if (servoRefreshMs != 0 && nowMs - servoRefreshMs < MRM_NODE_SERVO_REFRESH_MS)
+		return;
+	servoRefreshMs = nowMs;
+	for (uint8_t deviceNumber = 0; deviceNumber < nextFree; deviceNumber++)
+		for (uint8_t servoNumber = 0; servoNumber < MRM_NODE_SERVO_COUNT; servoNumber++)
+			if ((*servoMotion)[deviceNumber][servoNumber].active)
+				servoSend(servoNumber, (uint16_t)((*servoMotion)[deviceNumber][servoNumber].position(nowMs) + 0.5), deviceNumber);
+}
+
+/** Sends servo position, if changed
+@servoNumber - 0 - 2
+@degrees - 0 - 180 degrees
+@deviceNumber - mrm-node id
+*/
+void Mrm_node::servoSend(uint8_t servoNumber, uint16_t degrees, uint8_t deviceNumber) {
+	if (degrees != (*servoDegrees)[deviceNumber][servoNumber]) {
+		uint8_t frame[4]; // Not canData, servoRefresh() runs in the background, maybe while another message is being composed.
+		frame[0] = COMMAND_NODE_SERVO_SET;
+		frame[1] = servoNumber;
+		frame[2] = degrees >> 8;
+		frame[3] = degrees & 0xFF;
+		(*servoDegrees)[deviceNumber][servoNumber] = degrees;
+
+		robotContainer->mrm_can_bus->messageSend((*idIn)[deviceNumber], 4, frame);
+	}
+}
+
 /** Test servos
 */
 void Mrm_node::servoTest() {
@@ -169,7 +237,7 @@ void Mrm_node::servoTest() {
 	}
 }
 
-/** Move servo
+/** Move servo immediately, stopping its motion in progress, if any.
 @servoNumber - 0 - 2
 @degrees - 0 - 180 degrees
 @deviceNumber - mrm-node id
@@ -179,15 +247,8 @@ void Mrm_node::servoWrite(uint8_t servoNumber, uint16_t degrees, uint8_t deviceN
 		strcpy(errorMessage, "Servo not found");
 		return;
 	}
-	if (degrees != (*servoDegrees)[deviceNumber][servoNumber]) {
-		canData[0] = COMMAND_NODE_SERVO_SET;
-		canData[1] = servoNumber;
-		canData[2] = degrees >> 8;
-		canData[3] = degrees & 0xFF;
-		(*servoDegrees)[deviceNumber][servoNumber] = degrees;
-
-		robotContainer->mrm_can_bus->messageSend((*idIn)[deviceNumber], 4, canData);
-	}
+	(*servoMotion)[deviceNumber][servoNumber].active = false;
+	servoSend(servoNumber, degrees, deviceNumber);
 }
 
 /** If sensor not started, start it and wait for 1. message
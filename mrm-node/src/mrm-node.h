@@ -5,7 +5,7 @@
 /**
 Purpose: mrm-node interface to CANBus.
 @author MRMS team
-@version 0.1 2019-08-15
+@version 0.2 2026-10-19
 Licence: You can use this code any way you like.
 */
 
@@ -38,12 +38,22 @@ Licence: You can use this code any way you like.
 #define COMMAND_NODE_SERVO_SET 0x08
 
 #define MRM_NODE_INACTIVITY_ALLOWED_MS 10000
+#define MRM_NODE_SERVO_REFRESH_MS 20 // Servo positions of motions in progress are sent this often, not to flood CAN Bus.
 
 class Mrm_node : public SensorBoard
 {
 	std::vector<uint16_t[MRM_NODE_ANALOG_COUNT]>* readings; // Analog readings of all sensors
 	std::vector<bool[MRM_NODE_SWITCHES_COUNT]>* switches;
 	std::vector<uint16_t[MRM_NODE_SERVO_COUNT]>* servoDegrees;// = { 0xFFFF, 0xFFFF, 0xFFFF };
+	std::vector<ServoMotion[MRM_NODE_SERVO_COUNT]>* servoMotion; // Motions in progress
+	uint32_t servoRefreshMs = 0;
+
+	/** Sends servo position, if changed
+	@servoNumber - 0 - 2
+	@degrees - 0 - 180 degrees
+	@deviceNumber - mrm-node id
+	*/
+	void servoSend(uint8_t servoNumber, uint16_t degrees, uint8_t deviceNumber);
 
 	/** If sensor not started, start it and wait for 1. message
 	@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
@@ -86,11 +96,31 @@ public:
 	*/
 	void readingsPrint();
 
+	/** Starts moving servo in background. servoRefresh() must be called often, Robot does it in noLoopWithoutThis().
+	If the servo's position is not known yet, it is set immediately.
+	@servoNumber - 0 - 2
+	@degrees - target, 0 - 180 degrees
+	@ms - duration of the motion
+	@profile - velocity profile
+	@deviceNumber - mrm-node id
+	*/
+	void servoMove(uint8_t servoNumber, uint16_t degrees, uint16_t ms, ServoProfile profile = SERVO_PROFILE_TRAPEZOIDAL, uint8_t deviceNumber = 0);
+
+	/** Is a motion in progress?
+	@deviceNumber - mrm-node id
+	@return - any of the device's servos moving
+	*/
+	bool servoMoving(uint8_t deviceNumber = 0);
+
+	/** Advances motions in progress. Call as often as possible.
+	*/
+	void servoRefresh();
+
 	/** Test servos
 	*/
 	void servoTest();
 
-	/** Move servo
+	/** Move servo immediately, stopping its motion in progress, if any.
 	@deviceNumber - mrm-node id
 	@servoNumber - 0 - 2
 	@degrees - 0 - 180 degrees
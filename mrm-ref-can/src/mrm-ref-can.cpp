@@ -177,25 +177,25 @@ uint16_t Mrm_ref_can::calibrationDataGet(uint8_t receiverNumberInSensor, bool is
 @param waitForResult - Blocks program flow till results return.
 */
 void Mrm_ref_can::calibrationDataRequest(uint8_t deviceNumber, bool waitForResult) {
-	if (deviceNumber == 0xFF)
-		for (uint8_t i = 0; i < nextFree; i++)
-			calibrationDataRequest(i, waitForResult);
-	else if (alive(deviceNumber)){
-		if (waitForResult)
-			dataFreshCalibrationSet(false, deviceNumber);
-		canData[0] = COMMAND_REF_CAN_CALIBRATION_DATA_REQUEST;
-		robotContainer->mrm_can_bus->messageSend((*idIn)[deviceNumber], 1, canData);
+	if (deviceNumber == 0xFF) {
+		for (uint8_t i = 0; i < nextFree; i++) // All requests in flight at once
+			calibrationDataRequest(i, false);
 		if (waitForResult) {
-			uint32_t ms = millis();
-			while (!dataCalibrationFreshAsk(deviceNumber)) {
+			while (requestsPending())
 				robotContainer->noLoopWithoutThis();
-				if (millis() - ms > 1000) {
+			for (uint8_t i = 0; i < nextFree; i++)
+				if (alive(i) && !dataCalibrationFreshAsk(i))
 					strcpy(errorMessage, "Cal. data timeout.");
-					break;
-				}
-			}
 		}
 	}
+	else if (alive(deviceNumber)){
+		dataFreshCalibrationSet(false, deviceNumber);
+		canData[0] = COMMAND_REF_CAN_CALIBRATION_DATA_REQUEST;
+		uint16_t handle = request(canData, 1, COMMAND_REF_CAN_CALIBRATION_DATA_BRIGHT_7_TO_9, deviceNumber, NULL,
+			MRM_REF_CAN_CALIBRATION_TIMEOUT_MS);
+		if (waitForResult && (requestWait(handle) != REQUEST_DONE || !dataCalibrationFreshAsk(deviceNumber)))
+			strcpy(errorMessage, "Cal. data timeout.");
+	}
 }
 
 /** Print all calibration in a line
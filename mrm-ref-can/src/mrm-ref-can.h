@@ -49,6 +49,7 @@ Licence: You can use this code any way you like.
 #define COMMAND_REF_CAN_PNP_REQUEST 0x32
 #define COMMAND_REF_CAN_PNP_SENDING 0x33
 
+#define MRM_REF_CAN_CALIBRATION_TIMEOUT_MS 300 // For each attempt to get calibration data.
 #define MRM_REF_CAN_INACTIVITY_ALLOWED_MS 10000
 
 class Mrm_ref_can : public SensorBoard
@@ -36,8 +36,13 @@ ActionBase::ActionBase(Robot* robot, const char shortcut[4], const char text[20]
 
 void Action8x8Test::perform() { _robot->mrm_8x8a->test(); }
 void ActionBluetoothTest::perform() { _robot->bluetoothTest(); }
+void ActionCANBusBitrate::perform() { _robot->canBusBitrate(); }
+void ActionCANBusDump::perform() { _robot->canBusDump(); }
+void ActionCANBusRecord::perform() { _robot->canBusRecordToggle(); }
+void ActionCANBusReplay::perform() { _robot->canBusReplay(); }
 void ActionCANBusScan::perform() { _robot->devicesScan(true); }
 void ActionCANBusSniff::perform() { _robot->canBusSniffToggle(); }
+void ActionCANBusStatistics::perform() { _robot->canBusStatistics(); }
 void ActionCANBusStress::perform() { _robot->stressTest(); }
 void ActionColorBTest6Colors::perform() { _robot->mrm_col_b->test(false);}
 void ActionColorBTestHSV::perform() { _robot->mrm_col_b->test(true); }
@@ -49,6 +54,7 @@ void ActionColorPatternRecognize::perform() { _robot->colorPatternRecognize(); }
 void ActionColorPatternRecord::perform() { _robot->colorPatternRecord(); }
 void ActionColorTest6Colors::perform() { _robot->mrm_col_can->test(false);}
 void ActionColorTestHSV::perform() { _robot->mrm_col_can->test(true); }
+void ActionControlStatistics::perform() { _robot->controlStatistics(); }
 void ActionDeviceIdChange::perform() { _robot->canIdChange(); }
 void ActionFirmware::perform() { _robot->firmwarePrint(); }
 void ActionFPS::perform() { _robot->fpsPrint(); }
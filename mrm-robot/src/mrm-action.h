@@ -70,6 +70,30 @@ public:
 	ActionBluetoothTest(Robot* robot, LEDSign* ledSign = NULL) : ActionBase(robot, "blt", "Test Bluetooth", 16) {}
 };
 
+class ActionCANBusBitrate : public ActionBase {
+	void perform();
+public:
+	ActionCANBusBitrate(Robot* robot) : ActionBase(robot, "bit", "CAN Bus bitrate", 16) {}
+};
+
+class ActionCANBusDump : public ActionBase {
+	void perform();
+public:
+	ActionCANBusDump(Robot* robot) : ActionBase(robot, "dmp", "Dump recorded bus", 16) {}
+};
+
+class ActionCANBusRecord : public ActionBase {
+	void perform();
+public:
+	ActionCANBusRecord(Robot* robot) : ActionBase(robot, "rec", "Record bus toggle", 16) {}
+};
+
+class ActionCANBusReplay : public ActionBase {
+	void perform();
+public:
+	ActionCANBusReplay(Robot* robot) : ActionBase(robot, "rpl", "Replay recorded bus", 16) {}
+};
+
 class ActionCANBusScan : public ActionBase {
 	void perform();
 public:
@@ -82,6 +106,12 @@ public:
 	ActionCANBusSniff(Robot* robot) : ActionBase(robot, "sni", "Sniff bus toggle", 16) {}
 };
 
+class ActionCANBusStatistics : public ActionBase {
+	void perform();
+public:
+	ActionCANBusStatistics(Robot* robot) : ActionBase(robot, "bst", "CAN Bus statistics", 16) {}
+};
+
 class ActionCANBusStress : public ActionBase {
 	void perform();
 public:
@@ -148,6 +178,12 @@ public:
 	ActionColorTestHSV(Robot* robot, LEDSign* ledSign = NULL) : ActionBase(robot, "hsv", "Test HSV", 4, ID_MRM_COL_CAN) {}
 };
 
+class ActionControlStatistics : public ActionBase {
+	void perform();
+public:
+	ActionControlStatistics(Robot* robot) : ActionBase(robot, "ctl", "Control loop statistics", 16) {}
+};
+
 class ActionDeviceIdChange : public ActionBase {
 	void perform();
 public:
@@ -143,8 +143,13 @@ Robot::Robot(char name[15], char ssid[15], char wiFiPassword[15]) {
 
 	actionAdd(new Action8x8Test(this));
 	actionAdd(new ActionBluetoothTest(this, signTest));
+	actionAdd(new ActionCANBusBitrate(this));
+	actionAdd(new ActionCANBusDump(this));
+	actionAdd(new ActionCANBusRecord(this));
+	actionAdd(new ActionCANBusReplay(this));
 	actionAdd(new ActionCANBusScan(this));
 	actionAdd(new ActionCANBusSniff(this));
+	actionAdd(new ActionCANBusStatistics(this));
 	actionAdd(new ActionCANBusStress(this));
 	actionAdd(new ActionColorBTest6Colors(this, signTest));
 	actionAdd(new ActionColorBTestHSV(this, signTest));
@@ -156,6 +161,7 @@ Robot::Robot(char name[15], char ssid[15], char wiFiPassword[15]) {
 	actionAdd(new ActionColorPatternRecord(this));
 	actionAdd(new ActionColorTest6Colors(this, signTest));
 	actionAdd(new ActionColorTestHSV(this, signTest));
+	actionAdd(new ActionControlStatistics(this));
 	actionAdd(new ActionDeviceIdChange(this));
 	actionAdd(new ActionFirmware(this));
 	actionAdd(new ActionFPS(this));
@@ -380,7 +386,27 @@ void Robot::actionAdd(ActionBase* action) {
 		strcpy(errorMessage, "ACTIONS_LIMIT exceeded.");
 		return;
 	}
+	uint8_t slot = actionShortcutHash(action->_shortcut);
+	while (_actionHash[slot] != 0) { // Linear probing. If the shortcut is already taken, the first action keeps it.
+		if (strcmp(_action[_actionHash[slot] - 1]->_shortcut, action->_shortcut) == 0)
+			break;
+		slot = (slot + 1) & (ACTION_HASH_SIZE - 1);
+	}
+	if (_actionHash[slot] == 0)
+		_actionHash[slot] = _actionNextFree + 1;
 	_action[_actionNextFree++] = action;
+	_menuCacheLevel = 0;
+}
+
+/** Finds action by its shortcut.
+@param shortcut - shortcut
+@return - action, NULL if none
+*/
+ActionBase* Robot::actionFind(const char* shortcut) {
+	for (uint8_t slot = actionShortcutHash(shortcut); _actionHash[slot] != 0; slot = (slot + 1) & (ACTION_HASH_SIZE - 1))
+		if (strcmp(_action[_actionHash[slot] - 1]->_shortcut, shortcut) == 0)
+			return _action[_actionHash[slot] - 1];
+	return NULL;
 }
 
 /** Is this current action's initialization
@@ -455,16 +481,11 @@ void Robot::actionSet() {
 					uartRxCommandIndex = 0;
 				}
 
-				for (uint8_t i = 0; i < _actionNextFree; i++) {
-					if (strcmp(_action[i]->_shortcut, uartRxCommandCumulative) == 0) {
-						print(" ok.\r\n");
-						actionSet(_action[i]);
-						//commandPrevious = commandCurrent;
-						//commandCurrent = commands[i];
-						//commandCurrent->firstProcess = true;
-						found = 1;
-						break;
-					}
+				ActionBase* action = actionFind(uartRxCommandCumulative);
+				if (action != NULL) {
+					print(" ok.\r\n");
+					actionSet(action);
+					found = 1;
 				}
 				if (!found) {
 					print(" not found.\r\n");
@@ -512,6 +533,17 @@ void Robot::add(Board* aBoard) {
 	board[_boardNextFree++] = aBoard;
 }
 
+/** Add a motor group, so that stopAll() stops it and its speed control runs. Called by MotorGroup's constructor.
+@param group - the group.
+*/
+void Robot::add(MotorGroup* group) {
+	if (_motorGroupNextFree > MOTOR_GROUPS_LIMIT - 1) {
+		strcpy(errorMessage, "Too many motor groups");
+		return;
+	}
+	motorGroup[_motorGroupNextFree++] = group;
+}
+
 /** Blink LED
 */
 void Robot::blink() {
@@ -542,6 +574,65 @@ void Robot::blink() {
 	}
 }
 
+/** Robot's bitrate, for canBitrateNegotiate()
+@return - kbit/s
+*/
+uint16_t Robot::bitrateLocal() {
+	return mrm_can_bus->bitrate();
+}
+
+/** Switches the robot, after the messages queued so far are sent, for canBitrateNegotiate()
+@param bitrateKbps - kbit/s
+@return - success
+*/
+bool Robot::bitrateLocalSet(uint16_t bitrateKbps) {
+	mrm_can_bus->flush();
+	return mrm_can_bus->bitrateSet(bitrateKbps);
+}
+
+/** Tells all the alive devices to switch, without waiting, for canBitrateNegotiate()
+@param bitrateKbps - kbit/s
+*/
+void Robot::bitrateDevicesCommit(uint16_t bitrateKbps) {
+	for (uint8_t i = 0; i < _boardNextFree; i++)
+		board[i]->bitrateCommit(bitrateKbps);
+}
+
+/** Stops devices, asks all the alive ones if they support a bitrate and waits for the answers, for canBitrateNegotiate()
+@param bitrateKbps - kbit/s
+@return - all accepted
+*/
+bool Robot::bitrateDevicesPropose(uint16_t bitrateKbps) {
+	devicesStop();
+	for (uint8_t i = 0; i < _boardNextFree; i++)
+		board[i]->bitratePropose(bitrateKbps);
+	requestsWait();
+	for (uint8_t i = 0; i < _boardNextFree; i++)
+		if (!board[i]->bitrateAccepted()) {
+			print("%s: %i kbps refused\n\r", board[i]->name(), bitrateKbps);
+			return false;
+		}
+	return true;
+}
+
+/** Devices alive, for canBitrateNegotiate()
+@param scan - scan first
+@return - signature, changes when any device appears or disappears
+*/
+uint32_t Robot::bitratePresence(bool scan) {
+	if (scan)
+		for (uint8_t i = 0; i < _boardNextFree; i++)
+			board[i]->devicesScan(false);
+	return presenceSignature();
+}
+
+/** Waits, receiving messages, for canBitrateNegotiate()
+@param ms - pause
+*/
+void Robot::bitrateWaitMs(uint16_t ms) {
+	delayMs(ms);
+}
+
 /** Displays all boards
 @return - last board and device's index, 0 if none
 */
@@ -636,10 +727,92 @@ void Robot::bluetoothTest() {
 	}
 }
 
+/** Asks for a bitrate and moves the whole bus to it
+*/
+void Robot::canBusBitrate() {
+	print("Now %i kbps. New (125, 250, 500, 800, 1000)?\n\r", mrm_can_bus->bitrate());
+	uint16_t bitrateKbps = serialReadNumber(5000, 1000, false, 1000);
+	if (bitrateKbps != 0xFFFF && canBusBitrateNegotiate(bitrateKbps))
+		print("%i kbps, pacing %i us\n\r", mrm_can_bus->bitrate(), mrm_can_bus->pacing());
+	end();
+}
+
+/** Moves all the devices and this robot to a new bitrate. Each alive device must accept it first, otherwise nothing changes.
+After the switch, devices that do not respond are moved back, the robot too.
+@param bitrateKbps - 125, 250, 500, 800 or 1000
+@return - success
+*/
+bool Robot::canBusBitrateNegotiate(uint16_t bitrateKbps) {
+	uint16_t previousKbps = mrm_can_bus->bitrate();
+	bool task = canTaskRunning();
+	if (task) // The driver is restarted, the task must not use it meanwhile.
+		canTaskStop();
+	CANBusBitrateResult result = canBitrateNegotiate(this, bitrateKbps);
+	if (task)
+		canTaskStart(_canWorkerCore);
+	switch (result) {
+	case CAN_BITRATE_OK:
+		return true;
+	case CAN_BITRATE_LOCAL_FAILED:
+		print("Local switch failed, devices back to %i kbps\n\r", previousKbps);
+		return false;
+	case CAN_BITRATE_DEVICES_LOST:
+		print("Devices lost at %i kbps, back to %i kbps\n\r", bitrateKbps, previousKbps);
+		return false;
+	default: // Refused, bitrateDevicesPropose() printed by which device.
+		return false;
+	}
+}
+
+/** Writes recorded CAN Bus messages to Serial, in binary format described in mrm-can-bus.h
+*/
+void Robot::canBusDump() {
+	if (mrm_can_bus->recording())
+		mrm_can_bus->recordingStop();
+	print("%i records, %i lost\n\r", mrm_can_bus->recordsCount(), mrm_can_bus->recordsOverwritten());
+	mrm_can_bus->recordsDump(&Serial);
+	print("\n\r");
+	end();
+}
+
+/** Starts or stops recording CAN Bus messages into RAM
+*/
+void Robot::canBusRecordToggle() {
+	if (mrm_can_bus->recording()) {
+		mrm_can_bus->recordingStop();
+		print("Record off, %i records, %i lost\n\r", mrm_can_bus->recordsCount(), mrm_can_bus->recordsOverwritten());
+	}
+	else {
+		mrm_can_bus->recordingStart();
+		print("Record on\n\r");
+	}
+	end();
+}
+
+/** Feeds recorded messages to boards' decoding, as if received again, and reports decoding time.
+*/
+void Robot::canBusReplay() {
+	print("Speed (1 - original, 2-9 faster, 0 - max)?\n\r");
+	uint16_t speed = serialReadNumber(5000, 500, true, 9, false);
+	if (speed == 0xFFFF)
+		speed = 1;
+	_decodeCount = 0;
+	_decodeMicrosMax = 0;
+	_decodeMicrosTotal = 0;
+	uint32_t startMs = millis();
+	mrm_can_bus->replayStart(speed);
+	while (mrm_can_bus->replaying())
+		noLoopWithoutThis();
+	print("Replayed %i msg. in %i ms, decode avg. %i us, max. %i us, %i unsent\n\r", _decodeCount, millis() - startMs,
+		_decodeCount == 0 ? 0 : _decodeMicrosTotal / _decodeCount, _decodeMicrosMax, mrm_can_bus->replaySuppressed());
+	end();
+}
+
 /** Display all the incomming and outcomming CAN Bus messages
 */
 void Robot::canBusSniffToggle() {
 	_sniff = !_sniff;
+	mrm_can_bus->filterEnable(!_sniff); // Device-to-device frames, too
 	if (_sniff)
 		print("Sniff on\n\r");
 	else
@@ -647,6 +820,208 @@ void Robot::canBusSniffToggle() {
 	end();
 }
 
+/** Prints CAN Bus load, error counters and, for each id, rate and inter-arrival times' histogram. Resets the statistics afterwards.
+*/
+void Robot::canBusStatistics() {
+	print("Rx %i/s (peak %i), tx %i/s (peak %i), load %i%%", mrm_can_bus->messagesReceivedPerSecond(),
+		mrm_can_bus->messagesPeakReceived(), mrm_can_bus->messagesSentPerSecond(), mrm_can_bus->messagesPeakSent(),
+		(int)mrm_can_bus->utilisation());
+	print(", tx wait avg. %i us, max. %i us\n\r", mrm_can_bus->txWaitMicrosAverage(), mrm_can_bus->txWaitMicrosMax());
+	const CANBusErrors* errors = mrm_can_bus->errors();
+	print("Errors: tx %i, rx %i, tx failed %i, rx missed %i", errors->txErrors, errors->rxErrors, errors->txFailed, errors->rxMissed);
+	print(", arb. lost %i, bus %i, bus-off %i%s\n\r", errors->arbitrationLost, errors->busErrors, errors->busOffCount,
+		errors->busOff ? " (now)" : "");
+	if (mrm_can_bus->idsUntracked() != 0)
+		print("%i frames untracked\n\r", mrm_can_bus->idsUntracked());
+	if (mrm_can_bus->filterInstalled())
+		print("Filter %s, %i ids pass, %i frames passed, %i leaked, %i restarts\n\r", mrm_can_bus->filter()->dual ? "dual" : "single",
+			mrm_can_bus->filter()->passing, mrm_can_bus->filterPassed(), mrm_can_bus->filterLeaked(), mrm_can_bus->filterRestarts());
+	else
+		print("No filter\n\r");
+	print("Dir id device msg/s total min-max us, gaps <1 1 2 4 8 16 32 >=64 ms\n\r");
+	for (uint8_t i = 0; i < CAN_STATISTICS_IDS; i++) {
+		const CANBusIdStatistics* s = mrm_can_bus->idStatistics(i);
+		if (s == NULL)
+			continue;
+		uint16_t id = s->key & ~CAN_RECORD_OUTBOUND;
+		char* name = NULL;
+		for (uint8_t j = 0; j < _boardNextFree && name == NULL; j++)
+			name = board[j]->nameOfId(id);
+		print("%s 0x%02X %s %i %i %i-%i:", s->key & CAN_RECORD_OUTBOUND ? "Out" : "In", id, name == NULL ? "?" : name,
+			s->framesPerSecond, s->total, s->total < 2 ? 0 : s->gapMinMicros, s->gapMaxMicros);
+		for (uint8_t j = 0; j < CAN_JITTER_BUCKETS; j++)
+			print(" %i", s->jitter[j]);
+		print("\n\r");
+	}
+	mrm_can_bus->statisticsReset();
+	end();
+}
+
+/** CAN Bus worker's pass: sends queued messages, receives and decodes, retries requests and pings devices.
+@param robot - this
+*/
+void Robot::canTask(void* robot) {
+	Robot* self = (Robot*)robot;
+	self->mrm_can_bus->transmitQueued();
+	self->messagesReceive();
+	self->presenceRefresh();
+	self->requestsRefresh();
+	self->clockSyncRefresh();
+	self->ultrasonicRefresh();
+}
+
+/** Moves CAN Bus receiving, decoding, requests' retries and sending to another core, so that a slow action or web server does not
+delay decoding. Read decoded values that must be consistent with each other using snapshot().
+@param core - ESP32's core
+@return - started
+*/
+bool Robot::canTaskStart(uint8_t core) {
+	if (_canWorker == NULL)
+		_canWorker = new Worker();
+	mrm_can_bus->workerSet(_canWorker);
+	_canWorkerCore = core;
+	if (!_canWorker->start(canTask, this, "mrm-can", core)) {
+		strcpy(errorMessage, "CAN task not started");
+		return false;
+	}
+	return true;
+}
+
+/** Returns CAN Bus handling to the loop
+*/
+void Robot::canTaskStop() {
+	if (_canWorker != NULL)
+		_canWorker->stop();
+	mrm_can_bus->transmitQueued();
+}
+
+/** Syncs clocks of devices sending timestamps, a device in turn
+*/
+void Robot::clockSyncRefresh() {
+	for (uint8_t i = 0; i < _boardNextFree; i++)
+		board[i]->clockSyncRefresh();
+}
+
+/** Runs the control callback, if its deadline has come, and keeps the statistics. Called in each loop pass.
+*/
+void Robot::controlRefresh() {
+	if (!_control.running || _controlInside)
+		return;
+	uint32_t now = micros();
+	int32_t lateMicros = (int32_t)(now - _control.deadlineMicros); // Unsigned difference is correct after micros() overflows.
+	if (lateMicros < 0) // Not due yet
+		return;
+
+	// Missed deadlines: the next ones already passed. When all are run, each late run counts once.
+	uint32_t missed = lateMicros / _control.periodMicros;
+	if (missed > 0 && _control.catchUp == CONTROL_CATCH_UP_ALL)
+		missed = 1;
+	if (missed == 0)
+		_control.missed = 0;
+	else {
+		_control.missed += missed;
+		_control.missedTotal += missed;
+		if (_control.missedLimit != 0 && _control.missed >= _control.missedLimit) {
+			_control.running = false;
+			_control.stopped = true;
+			strcpy(errorMessage, "Control deadlines missed");
+			stopAll();
+			return;
+		}
+	}
+
+	uint8_t bucket = 0;
+	for (uint32_t limit = 16; bucket < CONTROL_JITTER_BUCKETS - 1 && (uint32_t)lateMicros >= limit; limit <<= 1)
+		bucket++;
+	_control.jitter[bucket]++;
+	if ((uint32_t)lateMicros > _control.lateMicrosMax)
+		_control.lateMicrosMax = lateMicros;
+
+	switch (_control.catchUp) {
+	case CONTROL_CATCH_UP_ALL:
+		_control.deadlineMicros += _control.periodMicros;
+		break;
+	case CONTROL_CATCH_UP_RESTART:
+		_control.deadlineMicros = now + _control.periodMicros;
+		break;
+	case CONTROL_CATCH_UP_SKIP:
+		_control.deadlineMicros += (lateMicros / _control.periodMicros + 1) * _control.periodMicros;
+		break;
+	}
+
+	float seconds = (now - _control.lastMicros) / 1000000.0;
+	_control.lastMicros = now;
+	_controlInside = true;
+	(*_control.callback)(this, seconds);
+	_controlInside = false;
+
+	uint32_t durationMicros = micros() - now;
+	if (durationMicros > _control.durationMicrosMax)
+		_control.durationMicrosMax = durationMicros;
+	uint32_t quarters = durationMicros * 4 / _control.periodMicros; // Run time in quarters of period
+	_control.duration[quarters < 4 ? quarters : (quarters < 8 ? 4 : 5)]++;
+	_control.runs++;
+}
+
+/** Starts a fixed-rate control loop. The callback runs in noLoopWithoutThis() at absolute deadlines, so its rate does not drift
+like with delayMs(). It should be short and never wait for long.
+@param callback - control function
+@param frequencyHz - for example 500
+@param catchUp - what to do after missed deadlines
+@param missedLimit - consecutive missed deadlines causing stopAll(). 0 - never stop.
+*/
+void Robot::controlStart(ControlCallback callback, uint16_t frequencyHz, ControlCatchUp catchUp, uint16_t missedLimit) {
+	if (callback == NULL || frequencyHz == 0) {
+		strcpy(errorMessage, "Control loop invalid");
+		return;
+	}
+	_control.callback = callback;
+	_control.catchUp = catchUp;
+	_control.missedLimit = missedLimit;
+	_control.periodMicros = 1000000 / frequencyHz;
+	controlStatisticsReset();
+	_control.deadlineMicros = micros();
+	_control.lastMicros = _control.deadlineMicros - _control.periodMicros;
+	_control.stopped = false;
+	_control.running = true;
+}
+
+/** Prints control loop's rate, missed deadlines, start delays' and run times' histograms. Resets the statistics afterwards.
+*/
+void Robot::controlStatistics() {
+	if (_control.periodMicros == 0)
+		print("Control loop never started\n\r");
+	else {
+		print("Control %i Hz %s, %i runs, %i missed, late max. %i us", 1000000 / _control.periodMicros,
+			_control.running ? "running" : (_control.stopped ? "stopped (missed)" : "stopped"), _control.runs,
+			_control.missedTotal, _control.lateMicrosMax);
+		print(", run max. %i us\n\r", _control.durationMicrosMax);
+		print("Late <16 16 32 64 128 256 512 1k 2k >=4k us:");
+		for (uint8_t i = 0; i < CONTROL_JITTER_BUCKETS; i++)
+			print(" %i", _control.jitter[i]);
+		print("\n\rRun <25 <50 <75 <100 <200 >=200 %% of period:");
+		for (uint8_t i = 0; i < CONTROL_DURATION_BUCKETS; i++)
+			print(" %i", _control.duration[i]);
+		print("\n\r");
+		controlStatisticsReset();
+	}
+	end();
+}
+
+/** Resets control loop's statistics
+*/
+void Robot::controlStatisticsReset() {
+	for (uint8_t i = 0; i < CONTROL_DURATION_BUCKETS; i++)
+		_control.duration[i] = 0;
+	_control.durationMicrosMax = 0;
+	for (uint8_t i = 0; i < CONTROL_JITTER_BUCKETS; i++)
+		_control.jitter[i] = 0;
+	_control.lateMicrosMax = 0;
+	_control.missed = 0;
+	_control.missedTotal = 0;
+	_control.runs = 0;
+}
+
 /** Detects if there is a gap in CAN Bus addresses' sequence of any device, like 0, 2, 3 (missing 1).
 @return - is there a gap.
 */
@@ -758,6 +1133,25 @@ void Robot::delayMicros(uint16_t pauseMicros) {
 	} while (micros() < startMicros + pauseMicros);
 }
 
+/** Builds decoding dispatch table from all the boards' devices. Ids sent by 2 boards stay unknown. Not used with a board list, set by
+boardListSet().
+*/
+void Robot::dispatchBuild() {
+	if (_boardOfId == NULL)
+		_boardOfId = new uint8_t[CAN_FILTER_ID_MASK + 1];
+	for (uint16_t id = 0; id <= CAN_FILTER_ID_MASK; id++)
+		_boardOfId[id] = 0;
+	for (uint8_t i = 0; i < _boardNextFree; i++)
+		for (uint8_t deviceNumber = 0; deviceNumber < board[i]->deadOrAliveCount(); deviceNumber++) {
+			uint16_t id = board[i]->idOutOf(deviceNumber) & CAN_FILTER_ID_MASK;
+			_boardOfId[id] = _boardOfId[id] == 0 || _boardOfId[id] == i + 1 ? i + 1 : 0xFF; // 0xFF - more boards, temporarily.
+		}
+	for (uint16_t id = 0; id <= CAN_FILTER_ID_MASK; id++)
+		if (_boardOfId[id] == 0xFF)
+			_boardOfId[id] = 0;
+	_dispatchIds = mrm_can_bus->filterIdCount();
+}
+
 /** Lists all the alive (responded to last ping) CAN Bus devices.
 @boardType - sensor, motor, or all boards
 @return count
@@ -850,11 +1244,9 @@ void Robot::errors() {
 /** Displays each CAN Bus device's firmware
 */
 void Robot::firmwarePrint() {
-	for (uint8_t i = 0; i < _boardNextFree; i++) {
+	for (uint8_t i = 0; i < _boardNextFree; i++)
 		board[i]->firmwareRequest();
-		// uint32_t startMs = millis();
-		delayMs(1);
-	}
+	requestsWait();
 	end();
 }
 
@@ -885,13 +1277,11 @@ void Robot::fpsPause() {
 void Robot::fpsPrint() {
 	print("CAN peaks: %i received/s, %i sent/s\n\r", mrm_can_bus->messagesPeakReceived(), mrm_can_bus->messagesPeakSent());
 	print("Arduino: %i FPS, low peak: %i FPS\n\r", (int)fpsGet(), fpsTopGap == 1000 ? 0 : (int)(1000 / (float)fpsTopGap));
-	for (uint8_t i = 0; i < _boardNextFree; i++) {
+	for (uint8_t i = 0; i < _boardNextFree; i++)
 		board[i]->fpsRequest();
-		uint32_t startMs = millis();
-		while (millis() - startMs < 30)
-			noLoopWithoutThis();
+	requestsWait();
+	for (uint8_t i = 0; i < _boardNextFree; i++)
 		board[i]->fpsDisplay();
-	}
 	fpsReset();
 	end();
 }
@@ -919,9 +1309,11 @@ void Robot::fpsUpdate() {
 
 
 /**Compass
-@return - North is 0 degrees, clockwise are positive angles, values 0 - 360.
+@return - North is 0 degrees, clockwise are positive angles, values 0 - 360. Fused estimate if mrm_imu->fusionStart() was called.
 */
 float Robot::heading() {
+	if (mrm_imu->fusing())
+		return mrm_imu->estimate().heading;
 	return mrm_imu->heading();
 }
 
@@ -953,10 +1345,9 @@ void Robot::i2cTest() {
 /** Request information
 */
 void Robot::info() {
-	for (uint8_t i = 0; i < _boardNextFree; i++) {
+	for (uint8_t i = 0; i < _boardNextFree; i++)
 		board[i]->info();
-		delay(1);
-	}
+	requestsWait();
 	end();
 }
 
@@ -1044,8 +1435,11 @@ void Robot::lidarCalibrate() {
 */
 void Robot::menu() {
 	// Print menu
-	if (_devicesScanBeforeMenu){
-		uint8_t cnt = devicesScan(false);
+	devicesStop();
+	if (_devicesScanBeforeMenu){ // No scanning, background presence checks keep aliveness current.
+		uint8_t cnt = 0;
+		for (uint8_t i = 0; i < _boardNextFree; i++)
+			cnt += board[i]->count();
 		if (cnt > _devicesAtStartup)  // Late-booters
 			_devicesAtStartup = cnt;
 		else if (cnt < _devicesAtStartup){
@@ -1053,29 +1447,22 @@ void Robot::menu() {
 			if (mrm_8x8a->alive(0, false))
 				mrm_8x8a->text((char*)"Error. Cnt.");
 		}
+		if (canGap())
+			strcpy(errorMessage, "CAN gap");
 	}
 	print("\r\n");
 
-	bool any = false;
+	if (_menuCacheLevel != menuLevel || _menuCachePresence != presenceSignature())
+		menuBuild();
+
+	bool any = _menuCacheCount > 0;
 	uint8_t column = 1;
 	uint8_t maxColumns = 2;
-	for (uint8_t i = 0; i < _actionNextFree; i++) {
-		if ((_action[i]->_menuLevel | menuLevel) == _action[i]->_menuLevel) {
-			bool anyAlive = false;
-			if (_action[i]->boardsId() == ID_ANY)
-				anyAlive = true;
-			else
-				for (uint8_t j = 0; j < _boardNextFree && !anyAlive; j++)
-					if (board[j]->alive(0xFF) && board[j]->id() == _action[i]->boardsId())
-						anyAlive = true;
-			if (anyAlive) {
-				print("%-3s - %-15s%s", _action[i]->_shortcut, _action[i]->_text, column == maxColumns ? "\n\r" : ""); // -19
-				delayMs(2);
-				any = true;
-				if (column++ == maxColumns)
-					column = 1;
-			}
-		}
+	for (uint8_t i = 0; i < _menuCacheCount; i++) {
+		ActionBase* action = _action[_menuCache[i]];
+		print("%-3s - %-15s%s", action->_shortcut, action->_text, column == maxColumns ? "\n\r" : ""); // -19
+		if (column++ == maxColumns)
+			column = 1;
 	}
 
 	if (!any)
@@ -1094,6 +1481,24 @@ void Robot::menu() {
 	_actionCurrent = _actionDoNothing;
 }
 
+/** Collects actions to be displayed in current menu, taking into account boards present.
+*/
+void Robot::menuBuild() {
+	uint32_t idsAlive = 0; // Bitwise, BoardId
+	for (uint8_t j = 0; j < _boardNextFree; j++)
+		if (board[j]->alive(0xFF))
+			idsAlive |= (uint32_t)1 << board[j]->id();
+
+	_menuCacheCount = 0;
+	for (uint8_t i = 0; i < _actionNextFree; i++)
+		if ((_action[i]->_menuLevel | menuLevel) == _action[i]->_menuLevel &&
+			(_action[i]->boardsId() == ID_ANY || ((idsAlive >> _action[i]->boardsId()) & 1)))
+			_menuCache[_menuCacheCount++] = i;
+
+	_menuCacheLevel = menuLevel;
+	_menuCachePresence = presenceSignature();
+}
+
 /** Color menu
 */
 void Robot::menuColor() {
@@ -1160,14 +1565,34 @@ void Robot::messagesReceive() {
 		#if REPORT_DEVICE_TO_DEVICE_MESSAGES_AS_UNKNOWN
 		bool any = false;
 		#endif
-		for (uint8_t boardId = 0; boardId < _boardNextFree; boardId++) {
- 			if (board[boardId]->messageDecode(id, _msg->data, _msg->dlc)) {
-				#if REPORT_DEVICE_TO_DEVICE_MESSAGES_AS_UNKNOWN
-				any = true;
-				break;
-				#endif
-			}
+		uint32_t decodeStartMicros = micros();
+		if (_boardList == NULL && _dispatchIds != mrm_can_bus->filterIdCount()) // Devices added
+			dispatchBuild();
+		uint8_t boardOfId = _boardList == NULL ? _boardOfId[id & CAN_FILTER_ID_MASK] : 0;
+		_decoded.writeBegin();
+		if (_boardList != NULL) // Listed boards' decoders, called directly
+			_boardList->messageDecode(id, _msg->data, _msg->dlc);
+		else if (boardOfId != 0) { // Only the board that sent it
+			board[boardOfId - 1]->messageDecode(id, _msg->data, _msg->dlc);
+			board[boardOfId - 1]->requestComplete();
 		}
+		else
+			for (uint8_t boardId = 0; boardId < _boardNextFree; boardId++) {
+				bool decoded = board[boardId]->messageDecode(id, _msg->data, _msg->dlc);
+				board[boardId]->requestComplete();
+				if (decoded) {
+					#if REPORT_DEVICE_TO_DEVICE_MESSAGES_AS_UNKNOWN
+					any = true;
+					break;
+					#endif
+				}
+			}
+		_decoded.writeEnd();
+		uint32_t decodeMicros = micros() - decodeStartMicros;
+		_decodeCount++;
+		_decodeMicrosTotal += decodeMicros;
+		if (decodeMicros > _decodeMicrosMax)
+			_decodeMicrosMax = decodeMicros;
 
 // #if REPORT_DEVICE_TO_DEVICE_MESSAGES_AS_UNKNOWN
 // 		if (!any)
@@ -1176,6 +1601,13 @@ void Robot::messagesReceive() {
 	}
 }
 
+/** Runs motor groups' speed control steps that are due. In the loop, not while decoding, so that commands are not sent from the CAN Bus thread.
+*/
+void Robot::motorGroupsRefresh() {
+	for (uint8_t i = 0; i < _motorGroupNextFree; i++)
+		motorGroup[i]->speedControlRefresh();
+}
+
 /** Tests motors
 */
 void Robot::motorTest() {
@@ -1198,7 +1630,19 @@ void Robot::nodeTest() {
 */
 void Robot::noLoopWithoutThis() {
 	blink(); // Keep-alive LED. Solder jumper must be shorted in order to work in mrm-esp32.
-	messagesReceive();
+	if (!canTaskRunning()) { // Otherwise in canTask(), on the other core.
+		messagesReceive();
+		presenceRefresh();
+		requestsRefresh(); // Timeouts and retries of commands waiting for response
+		clockSyncRefresh(); // Devices sending timestamps
+		ultrasonicRefresh(); // Firing groups, if started
+	}
+	mrm_servo->refresh(); // Servo motions in progress
+	mrm_node->servoRefresh();
+	mrm_8x8a->scrollRefresh(); // Scrolling text
+	mrm_imu->fusionRefresh(); // Heading estimate
+	motorGroupsRefresh(); // Wheels' speed control, if started
+	controlRefresh(); // Fixed-rate control loop, if started
 	fpsUpdate(); // Measure FPS. Less than 30 - a bad thing.
 	verbosePrint(); // Print FPS and maybe some additional data
 	errors();
@@ -1268,6 +1712,50 @@ void Robot::pnpSet(bool enable){
 	end();
 }
 
+/** Pings next device in background, if it is time to.
+*/
+void Robot::presenceRefresh() {
+	if (!_presencePinging || _sniff || _boardNextFree == 0 || millis() - _presenceMs < PRESENCE_PING_INTERVAL_MS)
+		return;
+	_presenceMs = millis();
+	if (_presenceDevice >= board[_presenceBoard]->deadOrAliveCount()) { // Next board
+		_presenceDevice = 0;
+		if (++_presenceBoard >= _boardNextFree)
+			_presenceBoard = 0;
+	}
+	if (_presenceDevice < board[_presenceBoard]->deadOrAliveCount())
+		board[_presenceBoard]->presenceCheck(_presenceDevice++);
+}
+
+/** Summary of all the devices' aliveness. Changes when any device appears or disappears.
+@return - signature
+*/
+uint32_t Robot::presenceSignature() {
+	uint32_t signature = 0;
+	for (uint8_t i = 0; i < _boardNextFree; i++)
+		signature = ((signature << 5) | (signature >> 27)) ^ board[i]->aliveMask();
+	return signature;
+}
+
+/** Resends boards' timed-out requests or fails them
+*/
+void Robot::requestsRefresh() {
+	for (uint8_t i = 0; i < _boardNextFree; i++)
+		board[i]->requestsRefresh();
+}
+
+/** Waits till all the boards' requests are answered or failed
+*/
+void Robot::requestsWait() {
+	bool pending = true;
+	while (pending) {
+		noLoopWithoutThis();
+		pending = false;
+		for (uint8_t i = 0; i < _boardNextFree && !pending; i++)
+			pending = board[i]->requestsPending();
+	}
+}
+
 /** Prints mrm-ref-can* calibration data
 */
 void Robot::reflectanceArrayCalibrationPrint() {
@@ -1284,6 +1772,7 @@ void Robot::refresh(){
 			menu();
 		else 
 			actionProcess(); // Process current command. The command will be executed while currentCommand is not NULL. Here state maching processing occurs, too.
+		scheduledRun(); // Background actions
 		noLoopWithoutThis(); // Receive all CAN Bus messages. This call should be included in any loop, like here.
 }
 
@@ -1304,6 +1793,68 @@ void Robot::run() {
 }
 
 
+/** Runs an action periodically in background, besides the current action. It must not call end() or setup(), as they refer to the current action.
+@param action - action
+@param periodMs - period. 0 - in each pass.
+@param priority - when more actions are due, the one with bigger priority runs first.
+@return - scheduled or not, if there is no room.
+*/
+bool Robot::schedule(ActionBase* action, uint32_t periodMs, uint8_t priority) {
+	unschedule(action);
+	if (_scheduledCount >= SCHEDULED_LIMIT) {
+		strcpy(errorMessage, "SCHEDULED_LIMIT exceeded.");
+		return false;
+	}
+	uint8_t i = _scheduledCount++;
+	for (; i > 0 && _scheduled[i - 1].priority < priority; i--) // Keep ordered by priority
+		_scheduled[i] = _scheduled[i - 1];
+	_scheduled[i].action = action;
+	_scheduled[i].lateMsMax = 0;
+	_scheduled[i].nextMs = millis();
+	_scheduled[i].overruns = 0;
+	_scheduled[i].periodMs = periodMs;
+	_scheduled[i].priority = priority;
+	_scheduled[i].runs = 0;
+	action->preprocessingStart();
+	return true;
+}
+
+/** Prints background actions' statistics
+*/
+void Robot::scheduledPrint() {
+	if (_scheduledCount == 0)
+		print("No background actions.\n\r");
+	for (uint8_t i = 0; i < _scheduledCount; i++)
+		print("%s: %i ms, pri. %i, runs %i, overruns %i, late max %i ms\n\r", _scheduled[i].action->_text, _scheduled[i].periodMs,
+			_scheduled[i].priority, _scheduled[i].runs, _scheduled[i].overruns, _scheduled[i].lateMsMax);
+}
+
+/** Runs background actions that are due, highest priority first. Missed periods are not caught up, but counted as overruns.
+*/
+void Robot::scheduledRun() {
+	for (uint8_t i = 0; i < _scheduledCount; i++) {
+		ScheduledAction* scheduled = &_scheduled[i];
+		uint32_t now = millis();
+		int32_t lateMs = (int32_t)(now - scheduled->nextMs);
+		if (lateMs < 0) // Not due yet
+			continue;
+		if ((uint32_t)lateMs > scheduled->lateMsMax)
+			scheduled->lateMsMax = lateMs;
+		if (scheduled->periodMs != 0 && (uint32_t)lateMs >= scheduled->periodMs) { // Deadline (next start) missed
+			scheduled->overruns += lateMs / scheduled->periodMs;
+			scheduled->nextMs = now;
+		}
+		scheduled->nextMs += scheduled->periodMs;
+
+		ActionBase* action = scheduled->action;
+		if (action->preprocessing())
+			action->performBefore();
+		action->perform();
+		action->preprocessingEnd();
+		scheduled->runs++;
+	}
+}
+
 /** Reads serial ASCII input and converts it into an integer
 @param timeoutFirst - timeout for first input
 @param timeoutBetween - timeout between inputs
@@ -1379,6 +1930,8 @@ void Robot::stopAll() {
 	for (uint8_t i = 0; i < _boardNextFree; i++)
 		if (board[i]->boardType() == MOTOR_BOARD && board[i]->count() > 0)
 			((MotorBoard*)board[i])->stop();
+	for (uint8_t i = 0; i < _motorGroupNextFree; i++)
+		motorGroup[i]->stop(); // Also their speed control, otherwise it would start the motors again.
 	end();
 }
 
@@ -1512,6 +2065,26 @@ void Robot::verbosePrint() {
 	}
 }
 
+/** Stops running an action in background
+@param action - action
+*/
+void Robot::unschedule(ActionBase* action) {
+	for (uint8_t i = 0; i < _scheduledCount; i++)
+		if (_scheduled[i].action == action) {
+			for (uint8_t j = i; j + 1 < _scheduledCount; j++)
+				_scheduled[j] = _scheduled[j + 1];
+			_scheduledCount--;
+			return;
+		}
+}
+
+/** Fires the next groups of ultrasonic sensors that are measuring in groups. On the CAN Bus thread, like decoding of their answers.
+*/
+void Robot::ultrasonicRefresh() {
+	mrm_us_b->scheduleRefresh();
+	mrm_us1->scheduleRefresh();
+}
+
 /** Verbose output toggle
 */
 void Robot::verboseToggle() {
@@ -1,5 +1,6 @@
 #pragma once
 #include <mrm-action.h>
+#include <mrm-board-list.h>
 #include <mrm-can-bus.h>
 #include <mrm-col-b.h>
 #include <Preferences.h>
@@ -8,10 +9,70 @@
 #endif
 
 #define ACTIONS_LIMIT 82 // Increase if more actions are needed.
+#define ACTION_HASH_SIZE 128 // Shortcuts' hash table. Power of 2, bigger than ACTIONS_LIMIT.
 #define BOARDS_LIMIT 30 // Maximum number of different board types.
+#define MOTOR_GROUPS_LIMIT 4 // Maximum number of motor groups.
 #define EEPROM_SIZE 12 // EEPROM size
 #define LED_ERROR 15 // mrm-esp32's pin number, hardware defined.
 #define LED_OK 2 // mrm-esp32's pin number, hardware defined.
+#define SCHEDULED_LIMIT 8 // Maximum number of actions run periodically in background.
+#define CAN_TASK_CORE 0 // Arduino's loop runs on core 1.
+#define CONTROL_DURATION_BUCKETS 6 // Run time histogram, as part of period: < 25%, < 50%, < 75%, < 100%, < 200%, >= 200%.
+#define CONTROL_JITTER_BUCKETS 10 // Start delay histogram: < 16 us, 16 - 31 us, 32 - 63 us,... >= 4096 us.
+#define CONTROL_MISSED_LIMIT 10 // Default number of consecutive missed deadlines causing stopAll().
+#define PRESENCE_PING_INTERVAL_MS 20 // Background ping of a single device, in turn. All devices are checked in about (number of devices) * 20 ms.
+
+static_assert(ACTION_HASH_SIZE > ACTIONS_LIMIT && (ACTION_HASH_SIZE & (ACTION_HASH_SIZE - 1)) == 0, "ACTION_HASH_SIZE must be a power of 2 bigger than ACTIONS_LIMIT");
+
+/** Hash of an up-to-3-letter shortcut. Can be evaluated at compile time.
+@param shortcut - shortcut
+@return - index in hash table
+*/
+constexpr uint8_t actionShortcutHash(const char* shortcut, uint8_t i = 0, uint16_t hash = 0) {
+	return i == 3 || shortcut[i] == '\0' ? hash & (ACTION_HASH_SIZE - 1) : actionShortcutHash(shortcut, i + 1, hash * 37 + shortcut[i]);
+}
+
+/** An action run periodically in background, besides the current action.
+*/
+struct ScheduledAction {
+	ActionBase* action;
+	uint32_t lateMsMax; // Worst start delay after the planned time.
+	uint32_t nextMs; // Planned start.
+	uint16_t overruns; // Starts missed because the previous run or other actions took too long.
+	uint32_t periodMs;
+	uint8_t priority; // Bigger number runs first when more actions are due.
+	uint32_t runs;
+};
+
+/** What the control loop does after it missed deadlines
+*/
+enum ControlCatchUp {
+	CONTROL_CATCH_UP_ALL, // Runs once for each missed deadline, one after another, so that the number of runs is right.
+	CONTROL_CATCH_UP_RESTART, // Next deadline is one period after the late start. Phase drifts.
+	CONTROL_CATCH_UP_SKIP // Skips missed deadlines, keeping the phase.
+};
+
+typedef void (*ControlCallback)(Robot* robot, float seconds); // seconds - since the previous run
+
+/** Fixed-rate control loop's state and statistics
+*/
+struct ControlLoop {
+	ControlCallback callback;
+	ControlCatchUp catchUp;
+	uint32_t deadlineMicros; // Next start
+	uint32_t duration[CONTROL_DURATION_BUCKETS]; // Run times' histogram
+	uint32_t durationMicrosMax;
+	uint32_t jitter[CONTROL_JITTER_BUCKETS]; // Start delays' histogram
+	uint32_t lateMicrosMax; // Worst start delay
+	uint32_t lastMicros; // Previous start
+	uint16_t missed; // Consecutive deadlines missed, now
+	uint16_t missedLimit; // stopAll() when reached. 0 - never.
+	uint32_t missedTotal;
+	uint32_t periodMicros = 0; // 0 - never started
+	bool running = false;
+	uint32_t runs;
+	bool stopped = false; // Stopped because of missed deadlines
+};
 
 // Forward declarations
 
@@ -45,10 +106,11 @@ class Mrm_us1;
 
 /** Base class for all robots.
 */
-class Robot {
+class Robot : public CANBusBitrateLink {
 
 protected:
 	ActionBase* _action[ACTIONS_LIMIT]; // Collection of all the robot's actions
+	uint8_t _actionHash[ACTION_HASH_SIZE] = { 0 }; // Index in _action + 1, by shortcut's hash. 0 - empty slot.
 	uint8_t _actionNextFree = 0;
 
 	// Robot's actions that can be callect directly, not just by iterating _action collection
@@ -66,21 +128,51 @@ protected:
 	BoardInfo * boardInfo;
 	uint8_t _boardNextFree = 0;
 
+	MotorGroup* motorGroup[MOTOR_GROUPS_LIMIT]; // Collection of all the robot's motor groups
+	uint8_t _motorGroupNextFree = 0;
+
 	uint8_t _devicesAtStartup = 0;
 	bool _devicesScanBeforeMenu = true;
 
+	Worker* _canWorker = NULL; // CAN Bus receiving, decoding and sending in another thread, if running.
+	uint8_t _canWorkerCore = CAN_TASK_CORE; // canTaskStart()'s, for restarting the task
+	SeqLock _decoded; // Written around each message's decoding, for snapshot().
+
+	ControlLoop _control;
+	bool _controlInside = false; // Callback running, blocks nested runs from its waits.
+
+	// Decoding dispatch: id's board, so that a message is not offered to all the boards.
+	BoardListBase* _boardList = NULL; // Compile-time list, decoding instead of the table. NULL - none.
+	uint8_t* _boardOfId = NULL; // Index + 1 in board[]. 0 - unknown, offered to all. Allocated in dispatchBuild().
+	uint16_t _dispatchIds = 0xFFFF; // Number of ids registered in mrm_can_bus when built.
+
+	// Decode cost, measured in messagesReceive()
+	uint32_t _decodeCount = 0;
+	uint32_t _decodeMicrosMax = 0;
+	uint32_t _decodeMicrosTotal = 0;
+
 	// FPS - frames per second calculation
 	uint32_t fpsMs[2] = { 0, 0 };
 	uint8_t fpsNextIndex = 0;
 	uint32_t fpsTopGap = 0;
 
+	uint8_t _menuCache[ACTIONS_LIMIT]; // Indices of actions displayed in menu, valid for _menuCacheLevel and _menuCachePresence.
+	uint8_t _menuCacheCount = 0;
+	uint8_t _menuCacheLevel = 0; // 0 - cache invalid.
+	uint32_t _menuCachePresence = 0;
 	uint8_t menuLevel = 1; // Submenus have bigger numbers
 	CANBusMessage* _msg;
 	char _name[16];
 	Preferences* preferences; // EEPROM
+	uint8_t _presenceBoard = 0; // Next board for background presence check.
+	uint8_t _presenceDevice = 0; // Next device for background presence check.
+	uint32_t _presenceMs = 0;
+	bool _presencePinging = true;
 	#if RADIO == 1
 	BluetoothSerial *serialBT = NULL;
 	#endif
+	ScheduledAction _scheduled[SCHEDULED_LIMIT]; // Ordered by priority, highest first.
+	uint8_t _scheduledCount = 0;
 	bool _sniff = false;
 	char _ssid[16];
 	char uartRxCommandCumulative[24];
@@ -104,6 +196,39 @@ protected:
 	*/
 	void actionSet(ActionBase* newAction);
 
+	/** Robot's bitrate, for canBitrateNegotiate()
+	@return - kbit/s
+	*/
+	uint16_t bitrateLocal();
+
+	/** Switches the robot, after the messages queued so far are sent, for canBitrateNegotiate()
+	@param bitrateKbps - kbit/s
+	@return - success
+	*/
+	bool bitrateLocalSet(uint16_t bitrateKbps);
+
+	/** Tells all the alive devices to switch, without waiting, for canBitrateNegotiate()
+	@param bitrateKbps - kbit/s
+	*/
+	void bitrateDevicesCommit(uint16_t bitrateKbps);
+
+	/** Stops devices, asks all the alive ones if they support a bitrate and waits for the answers, for canBitrateNegotiate()
+	@param bitrateKbps - kbit/s
+	@return - all accepted
+	*/
+	bool bitrateDevicesPropose(uint16_t bitrateKbps);
+
+	/** Devices alive, for canBitrateNegotiate()
+	@param scan - scan first
+	@return - signature, changes when any device appears or disappears
+	*/
+	uint32_t bitratePresence(bool scan);
+
+	/** Waits, receiving messages, for canBitrateNegotiate()
+	@param ms - pause
+	*/
+	void bitrateWaitMs(uint16_t ms);
+
 	/** Displays all boards
 	@return - last board and device's index, 0 if none
 	*/
@@ -127,14 +252,38 @@ protected:
 	*/
 	bool boardSelect(uint8_t selectedNumber, uint8_t *selectedBoardIndex, uint8_t* selectedDeviceIndex, uint8_t* maxInput);
 
+	/** CAN Bus worker's pass: sends queued messages, receives and decodes, retries requests and pings devices.
+	@param robot - this
+	*/
+	static void canTask(void* robot);
+
+	/** Syncs clocks of devices sending timestamps, a device in turn
+	*/
+	void clockSyncRefresh();
+
+	/** Runs the control callback, if its deadline has come, and keeps the statistics. Called in each loop pass.
+	*/
+	void controlRefresh();
+
 	/** Display number of CAN Bus devices using 8x8 display
 	*/
 	void devicesLEDCount();
 
+	/** Builds decoding dispatch table from all the boards' devices. Ids sent by 2 boards stay unknown. Not used with a board list, set by
+	boardListSet().
+	*/
+	void dispatchBuild();
+
 	/** Avoids FPS measuring in the next 2 cycles.
 	*/
 	void fpsPause();
 
+	/** Finds action by its shortcut.
+	@param shortcut - shortcut
+	@return - action, NULL if none
+	*/
+	ActionBase* actionFind(const char* shortcut);
+
 	/** Updates data for FPS calculation
 	*/
 	void fpsUpdate();
@@ -143,11 +292,44 @@ protected:
 	*/
 	void fpsReset();
 
+	/** Collects actions to be displayed in current menu, taking into account boards present.
+	*/
+	void menuBuild();
+
+	/** Runs motor groups' speed control steps that are due. In the loop, not while decoding, so that commands are not sent from the CAN Bus thread.
+	*/
+	void motorGroupsRefresh();
+
 	/** Enable or disable plug and play for all the connected boards.
 	 @param enable - enable or disable
 	*/
 	void pnpSet(bool enable);
 
+	/** Pings next device in background, if it is time to.
+	*/
+	void presenceRefresh();
+
+	/** Summary of all the devices' aliveness. Changes when any device appears or disappears.
+	@return - signature
+	*/
+	uint32_t presenceSignature();
+
+	/** Resends boards' timed-out requests or fails them
+	*/
+	void requestsRefresh();
+
+	/** Waits till all the boards' requests are answered or failed
+	*/
+	void requestsWait();
+
+	/** Runs background actions that are due, highest priority first.
+	*/
+	void scheduledRun();
+
+	/** Fires the next groups of ultrasonic sensors that are measuring in groups. On the CAN Bus thread, like decoding of their answers.
+	*/
+	void ultrasonicRefresh();
+
 	/** Prints additional data in every loop pass
 	*/
 	void verbosePrint();
@@ -208,10 +390,21 @@ public:
 	*/
 	void add(Board* aBoard);
 
+	/** Add a motor group, so that stopAll() stops it and its speed control runs. Called by MotorGroup's constructor.
+	@param group - the group.
+	*/
+	void add(MotorGroup* group);
+
 	/** Store bitmaps in mrm-led8x8a.
 	*/
 	virtual void bitmapsSet() = 0;
 
+	/** Decodes messages with a compile-time board list, calling the listed boards' decoders directly, instead of the dispatch table. Add the
+	list's boards with add(), too, so that scanning and menus reach them.
+	@param boardList - list, NULL - back to the dispatch table.
+	*/
+	void boardListSet(BoardListBase* boardList) { _boardList = boardList; }
+
 	/** Blink LED
 	*/
 	void blink();
@@ -220,15 +413,85 @@ public:
 	*/
 	void bluetoothTest();
 
+	/** Asks for a bitrate and moves the whole bus to it
+	*/
+	void canBusBitrate();
+
+	/** Moves all the devices and this robot to a new bitrate. Each alive device must accept it first, otherwise nothing changes.
+	After the switch, devices that do not respond are moved back, the robot too.
+	@param bitrateKbps - 125, 250, 500, 800 or 1000
+	@return - success
+	*/
+	bool canBusBitrateNegotiate(uint16_t bitrateKbps);
+
+	/** Writes recorded CAN Bus messages to Serial, in binary format described in mrm-can-bus.h
+	*/
+	void canBusDump();
+
+	/** Starts or stops recording CAN Bus messages into RAM
+	*/
+	void canBusRecordToggle();
+
+	/** Feeds recorded messages to boards' decoding, as if received again, and reports decoding time.
+	*/
+	void canBusReplay();
+
 	/** Display all the incomming and outcomming CAN Bus messages
 	*/
 	void canBusSniffToggle();
 
+	/** Prints CAN Bus load, error counters and, for each id, rate and inter-arrival times' histogram. Resets the statistics afterwards.
+	*/
+	void canBusStatistics();
+
 	/** Detects if there is a gap in CAN Bus addresses' sequence of any device, like 0, 2, 3 (missing 1).
 	@return - is there a gap.
 	*/
 	bool canGap();
 
+	/** Moves CAN Bus receiving, decoding, requests' retries and sending to another core, so that a slow action or web server does not
+	delay decoding. Read decoded values that must be consistent with each other using snapshot().
+	@param core - ESP32's core
+	@return - started
+	*/
+	bool canTaskStart(uint8_t core = CAN_TASK_CORE);
+
+	/** Is CAN Bus handled by another core?
+	@return - yes
+	*/
+	bool canTaskRunning() { return _canWorker != NULL && _canWorker->running(); }
+
+	/** Returns CAN Bus handling to the loop
+	*/
+	void canTaskStop();
+
+	/** Control loop's state and statistics
+	@return - control loop
+	*/
+	const ControlLoop* control() { return &_control; }
+
+	/** Starts a fixed-rate control loop. The callback runs in noLoopWithoutThis() at absolute deadlines, so its rate does not drift
+	like with delayMs(). It should be short and never wait for long.
+	@param callback - control function
+	@param frequencyHz - for example 500
+	@param catchUp - what to do after missed deadlines
+	@param missedLimit - consecutive missed deadlines causing stopAll(). 0 - never stop.
+	*/
+	void controlStart(ControlCallback callback, uint16_t frequencyHz, ControlCatchUp catchUp = CONTROL_CATCH_UP_SKIP,
+		uint16_t missedLimit = CONTROL_MISSED_LIMIT);
+
+	/** Prints control loop's rate, missed deadlines, start delays' and run times' histograms. Resets the statistics afterwards.
+	*/
+	void controlStatistics();
+
+	/** Resets control loop's statistics
+	*/
+	void controlStatisticsReset();
+
+	/** Stops the control loop
+	*/
+	void controlStop() { _control.running = false; }
+
 	/** Change device's id
 	*/
 	void canIdChange();
@@ -314,7 +577,7 @@ public:
 	virtual void goAhead() = 0;
 
 	/**Compass
-	@return - North is 0 degrees, clockwise are positive angles, values 0 - 360.
+	@return - North is 0 degrees, clockwise are positive angles, values 0 - 360. Fused estimate if mrm_imu->fusionStart() was called.
 	*/
 	float heading();
 
@@ -372,6 +635,12 @@ public:
 	*/
 	void messagesReceive();
 
+	/** Reads decoded values consistently, without locking, while canTaskRunning(). Otherwise just reads.
+	@param read - function (usually lambda) copying the values. It may run more than once. Example:
+		robot->snapshot([&] { left = lid->distance(0); right = lid->distance(1); });
+	*/
+	template <typename Reader> void snapshot(Reader read) { _decoded.read(read); }
+
 	/** Tests motors
 	*/
 	void motorTest();
@@ -410,6 +679,11 @@ public:
 	*/
 	void print(const char* fmt, ...);
 
+	/** Background presence checks. Devices are pinged in turn, without waiting for answers, so that menu needs no scanning.
+	@param enable - on or off. Default on.
+	*/
+	void presencePingingSet(bool enable) { _presencePinging = enable; }
+
 	/** Prints mrm-ref-can* calibration data
 	*/
 	void reflectanceArrayCalibrationPrint();
@@ -456,6 +730,18 @@ public:
 	 */
 	char* serialDataGet(){return uartRxCommandCumulative;}
 
+	/** Runs an action periodically in background, besides the current action. It must not call end() or setup(), as they refer to the current action.
+	@param action - action
+	@param periodMs - period. 0 - in each pass.
+	@param priority - when more actions are due, the one with bigger priority runs first.
+	@return - scheduled or not, if there is no room.
+	*/
+	bool schedule(ActionBase* action, uint32_t periodMs, uint8_t priority = 0);
+
+	/** Prints background actions' statistics
+	*/
+	void scheduledPrint();
+
 	/** Moves servo motor manually
 	*/
 	void servoInteractive();
@@ -485,6 +771,11 @@ public:
 	*/
 	void thermoTest();
 
+	/** Stops running an action in background
+	@param action - action
+	*/
+	void unschedule(ActionBase* action);
+
 	/** Checks if user tries to break the program
 	@return - true if break requested.
 	*/
@@ -7,10 +7,12 @@
 */
 Mrm_servo::Mrm_servo(Robot* robot, uint8_t maxNumberOfServos) {
 	_currentDegrees = new std::vector<uint16_t>(maxNumberOfServos);
+	_duty = new std::vector<uint16_t*>(maxNumberOfServos);
 	_minDegrees = new std::vector<uint16_t>(maxNumberOfServos);
 	_minDegreesPulseMs = new std::vector<float>(maxNumberOfServos);
 	_maxDegrees = new std::vector<uint16_t>(maxNumberOfServos);
 	_maxDegreesPulseMs = new std::vector<float>(maxNumberOfServos);
+	_motion = new std::vector<ServoMotion>(maxNumberOfServos);
 	_name = new std::vector<char[10]>(maxNumberOfServos);
 	_timerWidth = new std::vector<uint8_t>(maxNumberOfServos);
 	robotContainer = robot;
@@ -54,10 +56,18 @@ void Mrm_servo::add(uint8_t gpioPin, char* deviceName, uint16_t minDegrees, uint
 	// Standard servo, 0-180�: 20 ms period, duty 1 - 2 ms. 1.5 ms - neutral position.
 	// For pulseWidth=20 ms (50 Hz) and _timerWidth=12, tickLength = (1000 / 50) / (2^12 - 1) = 20/4095 = 0.004884 ms
 	// pulseHighWidth = numberOfTicks*tickLength
-	// numberOfTicksNeeded = pulseHighWidth/tickLength pulseHighWidthMicroSec/1000000/tickLength = pulseHighWidthMicroSec * f. For 90 degrees numberOfTicksNeeded = 1.5/0.004884 = 307. For 0 degrees numberOfTicksNeeded = 1/0.004884 = 205
+	// numberOfTicksNeeded = pulseHighWidth/tickLength pulseHighWidthMicroSec/1000000/tickLength = pulseHighWidthMs / tickLength. For 90 degrees numberOfTicksNeeded = 1.5/0.004884 = 307. For 0 degrees numberOfTicksNeeded = 1/0.004884 = 205
 
 	float tickLength = (1000 / (float)MRM_SERVO_FREQUENCY_HZ) / ((1 << timerWidth) - 1); //tickLength = pulsePeriod/(2^timerWidthBits-1) * 1000, in ms. 
-	f = 1 / tickLength;
+
+	// Ticks for each degree, so that no calculation is needed when moving.
+	uint16_t range = maxDegrees > minDegrees ? maxDegrees - minDegrees : 0;
+	(*_duty)[nextFree] = new uint16_t[range + 1];
+	for (uint16_t i = 0; i <= range; i++) {
+		float pulseMs = minDegreesPulseMs + (range == 0 ? 0 : (maxDegreesPulseMs - minDegreesPulseMs) * i / range);
+		(*_duty)[nextFree][i] = (uint16_t)(pulseMs / tickLength + 0.5);
+	}
+	(*_motion)[nextFree].active = false;
 	
 	/*double resFreq = */ledcSetup(nextFree, MRM_SERVO_FREQUENCY_HZ, timerWidth); // nextFree is channel number, which can be 0 - 15.
 	ledcAttachPin(gpioPin, nextFree); // gpioPin assigned to channel nextFree
@@ -67,6 +77,86 @@ void Mrm_servo::add(uint8_t gpioPin, char* deviceName, uint16_t minDegrees, uint
 	write((*_maxDegrees)[nextFree-1] / 2, nextFree - 1);
 }
 
+/** Sets pulse width
+@param degrees - angle, already inside servo's limits
+@param servoNumber - Servo's ordinal number. Each call of function add() assigns a increasing number to the servo, starting with 0.
+*/
+void Mrm_servo::dutyWrite(uint16_t degrees, uint8_t servoNumber) {
+	ledcWrite(servoNumber, (*_duty)[servoNumber][degrees - (*_minDegrees)[servoNumber]]);
+	(*_currentDegrees)[servoNumber] = degrees;
+}
+
+/** Starts moving servo in background. refresh() must be called often, Robot does it in noLoopWithoutThis().
+@param degrees - target angle
+@param servoNumber - Servo's ordinal number. Each call of function add() assigns a increasing number to the servo, starting with 0.
+@param ms - duration of the motion
+@param profile - velocity profile
+*/
+void Mrm_servo::move(uint16_t degrees, uint8_t servoNumber, uint16_t ms, ServoProfile profile) {
+	moveSynchronized(1, &servoNumber, &degrees, ms, profile);
+}
+
+/** Starts moving more servos in background so that they all finish at the same time.
+@param count - number of servos
+@param servoNumbers - servos' ordinal numbers
+@param degrees - target angles, one for each servo
+@param ms - duration of the motion. 0 - the longest path at MRM_SERVO_DEGREES_PER_S.
+@param profile - velocity profile
+*/
+void Mrm_servo::moveSynchronized(uint8_t count, const uint8_t servoNumbers[], const uint16_t degrees[], uint16_t ms, ServoProfile profile) {
+	uint16_t longest = 0;
+	for (uint8_t i = 0; i < count; i++) {
+		if (servoNumbers[i] >= nextFree) {
+			strcpy(errorMessage, "Servo doesn't exist");
+			return;
+		}
+		uint16_t current = (*_currentDegrees)[servoNumbers[i]];
+		uint16_t path = degrees[i] > current ? degrees[i] - current : current - degrees[i];
+		if (path > longest)
+			longest = path;
+	}
+	if (ms == 0)
+		ms = longest * 1000 / MRM_SERVO_DEGREES_PER_S;
+
+	uint32_t nowMs = millis(); // The same start for all
+	for (uint8_t i = 0; i < count; i++) {
+		uint8_t servoNumber = servoNumbers[i];
+		uint16_t target = constrain(degrees[i], (*_minDegrees)[servoNumber], (*_maxDegrees)[servoNumber]);
+		(*_motion)[servoNumber].start((*_currentDegrees)[servoNumber], target, ms, profile, nowMs);
+	}
+	_lastRefreshMs = 0; // First step immediately
+	refresh();
+}
+
+/** Is a motion in progress?
+@param servoNumber - Servo's ordinal number. Each call of function add() assigns a increasing number to the servo, starting with 0. 0xFF - any.
+@return - moving or not
+*/
+bool Mrm_servo::moving(uint8_t servoNumber) {
+	if (servoNumber == 0xFF) {
+		for (uint8_t i = 0; i < nextFree; i++)
+			if ((*_motion)[i].active)
+				return true;
+		return false;
+	}
+	return servoNumber < nextFree && (*_motion)[servoNumber].active;
+}
+
+/** Advances motions in progress, once in each pulse period. Call as often as possible.
+*/
+void Mrm_servo::refresh() {
+	uint32_t nowMs = millis();
+	if (_lastRefreshMs != 0 && nowMs - _lastRefreshMs < 1000 / MRM_SERVO_FREQUENCY_HZ) // A new pulse width has no effect before the next pulse.
+		return;
+	_lastRefreshMs = nowMs;
+	for (uint8_t servoNumber = 0; servoNumber < nextFree; servoNumber++)
+		if ((*_motion)[servoNumber].active) {
+			uint16_t degrees = (uint16_t)((*_motion)[servoNumber].position(nowMs) + 0.5);
+			if (degrees != (*_currentDegrees)[servoNumber])
+				dutyWrite(degrees, servoNumber);
+		}
+}
+
 void Mrm_servo::sweep() {
 	// If variables are not needed in any other function, and  must be persistent, they should be declared static:
 	static uint8_t servoDegrees = 90;
@@ -110,7 +200,7 @@ void Mrm_servo::test()
 /** Move servo
 @param degrees - Servo's target angle, 0 - 180�, or 0 - 360�, depending on model, counting clockwise
 @param servoNumber - Servo's ordinal number. Each call of function add() assigns a increasing number to the servo, starting with 0.
-@param ms - Duration of action in ms. 0 ms - immediately.
+@param ms - Duration of action in ms. 0 ms - immediately. Otherwise the motion continues in background, like in move().
 */
 void Mrm_servo::write( uint16_t degrees, uint8_t servoNumber, uint16_t ms) {
 	if (servoNumber >= nextFree) {
@@ -118,22 +208,13 @@ void Mrm_servo::write( uint16_t degrees, uint8_t servoNumber, uint16_t ms) {
 		strcpy(errorMessage, "Servo doesn't exist");
 		return;
 	}
+	if (ms != 0) {
+		move(degrees, servoNumber, ms);
+		return;
+	}
 	degrees = constrain(degrees, (*_minDegrees)[servoNumber], (*_maxDegrees)[servoNumber]);
-
-	ledcWrite(servoNumber, map(degrees, (*_minDegrees)[servoNumber], (*_maxDegrees)[servoNumber], (*_minDegreesPulseMs)[servoNumber] * f, (*_maxDegreesPulseMs)[servoNumber] * f));
-	// uint32_t startMs = millis();
-	// while (millis() - startMs < ms){
-	// 	uint16_t currentDegrees = map(millis(), startMs, startMs + ms, (*_currentDegrees)[servoNumber], degrees);
-	// 	ledcWrite(servoNumber, map(currentDegrees, (*_minDegrees)[servoNumber], (*_maxDegrees)[servoNumber], 
-	// 		(*_minDegreesPulseMs)[servoNumber] * f, (*_maxDegreesPulseMs)[servoNumber] * f));
-	// 	robotContainer->delayMs(10);
-	// }
-	(*_currentDegrees)[servoNumber] = degrees;
-
-	// uint16_t _minDegrees;
-	// uint16_t _minDegreesPulseMicroSec;
-	// uint16_t _maxDegrees;
-	// uint16_t _maxDegreesPulseMicroSec;
+	(*_motion)[servoNumber].active = false;
+	dutyWrite(degrees, servoNumber);
 }
 
 /** Position servo according to user input.
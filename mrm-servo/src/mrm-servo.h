@@ -7,7 +7,7 @@
 /**
 Purpose: MRMS servo library
 @author MRMS team
-@version 0.0 2019-09-01
+@version 0.1 2026-10-19
 Licence: You can use this code any way you like.
 For a deeper understanding check https://docs.espressif.com/projects/esp-idf/en/latest/api-reference/peripherals/ledc.html .
 */
@@ -15,21 +15,30 @@ For a deeper understanding check https://docs.espressif.com/projects/esp-idf/en/
 // Maximum number of servo motors, the number cannot be bigger than 16 since there are 16 PWM channels in ESP32
 #define MAX_SERVO_COUNT 16 // No more can fit in ESP32
 #define MRM_SERVO_FREQUENCY_HZ 50 // Pulse occures FREQUENCY_HZ times each second. For 50 Hz period of one pulse is 20 ms.
+#define MRM_SERVO_DEGREES_PER_S 180 // Speed used for synchronized motions without duration given.
 
 typedef bool(*BreakCondition)();
 
 class Mrm_servo
 {
 	std::vector<uint16_t>* _currentDegrees;
+	std::vector<uint16_t*>* _duty; // Timer ticks for each degree, from minimum to maximum angle, calculated in add().
+	uint32_t _lastRefreshMs = 0;
 	std::vector<uint16_t>* _minDegrees;
 	std::vector<float>* _minDegreesPulseMs;
 	std::vector<uint16_t>* _maxDegrees;
 	std::vector<float>* _maxDegreesPulseMs;
+	std::vector<ServoMotion>* _motion; // Motions in progress
 	std::vector<char[10]>* _name;// Device's name
 	int nextFree;
 	std::vector<uint8_t>* _timerWidth;
 	Robot* robotContainer;
-	float f;
+
+	/** Sets pulse width
+	@param degrees - angle, already inside servo's limits
+	@param servoNumber - Servo's ordinal number. Each call of function add() assigns a increasing number to the servo, starting with 0.
+	*/
+	void dutyWrite(uint16_t degrees, uint8_t servoNumber);
 
 public:
 	/** Constructor
@@ -51,6 +60,33 @@ public:
 	*/
 	void add(uint8_t gpioPin = 16, char* deviceName = (char *)"", uint16_t minDegrees = 0, uint16_t maxDegrees = 180, float minDegreesPulseMs = 1, float maxDegreesPulseMs = 2, uint8_t timerWidth = 12);
 
+	/** Starts moving servo in background. refresh() must be called often, Robot does it in noLoopWithoutThis().
+	@param degrees - target angle
+	@param servoNumber - Servo's ordinal number. Each call of function add() assigns a increasing number to the servo, starting with 0.
+	@param ms - duration of the motion
+	@param profile - velocity profile
+	*/
+	void move(uint16_t degrees, uint8_t servoNumber, uint16_t ms, ServoProfile profile = SERVO_PROFILE_TRAPEZOIDAL);
+
+	/** Starts moving more servos in background so that they all finish at the same time.
+	@param count - number of servos
+	@param servoNumbers - servos' ordinal numbers
+	@param degrees - target angles, one for each servo
+	@param ms - duration of the motion. 0 - the longest path at MRM_SERVO_DEGREES_PER_S.
+	@param profile - velocity profile
+	*/
+	void moveSynchronized(uint8_t count, const uint8_t servoNumbers[], const uint16_t degrees[], uint16_t ms = 0, ServoProfile profile = SERVO_PROFILE_TRAPEZOIDAL);
+
+	/** Is a motion in progress?
+	@param servoNumber - Servo's ordinal number. Each call of function add() assigns a increasing number to the servo, starting with 0. 0xFF - any.
+	@return - moving or not
+	*/
+	bool moving(uint8_t servoNumber = 0xFF);
+
+	/** Advances motions in progress, once in each pulse period. Call as often as possible.
+	*/
+	void refresh();
+
 	void sweep();
 
 	/**Test
@@ -60,7 +96,7 @@ public:
 	/** Move servo
 	@param degrees - Servo's target angle, 0 - 180�, or 0 - 360�, depending on model, counting clockwise
 	@param servoNumber - Servo's ordinal number. Each call of function add() assigns a increasing number to the servo, starting with 0.
-	@param ms - Duration of action in ms. 0 ms - immediately.
+	@param ms - Duration of action in ms. 0 ms - immediately. Otherwise the motion continues in background, like in move().
 	*/
 	void write(uint16_t degrees = 90, uint8_t servoNumber = 0, uint16_t ms = 0);
 
@@ -9,7 +9,8 @@
 */
 Mrm_us_b::Mrm_us_b(Robot* robot, uint8_t maxNumberOfBoards) : 
 	SensorBoard(robot, 1, "US-B", maxNumberOfBoards, ID_MRM_US_B, 1) {
-	readings = new std::vector<uint16_t>(maxNumberOfBoards);
+	_echoes = new std::vector<EchoList>(maxNumberOfBoards);
+	_filters = new std::vector<EchoFilter>(maxNumberOfBoards);
 }
 
 Mrm_us_b::~Mrm_us_b()
@@ -60,9 +61,47 @@ void Mrm_us_b::add(char * deviceName)
 		return;
 	}
 
+	_schedule.deviceAdd();
+
 	SensorBoard::add(deviceName, canIn, canOut);
 }
 
+/** Declares that 2 sensors disturb each other so that scheduleStart() does not fire them together. By default all the sensors interfere.
+@param deviceNumber1 - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@param deviceNumber2 - Second device.
+@param interfere - if false, sensors can be fired together.
+*/
+void Mrm_us_b::crosstalkSet(uint8_t deviceNumber1, uint8_t deviceNumber2, bool interfere) {
+	if (!_schedule.crosstalkSet(deviceNumber1, deviceNumber2, interfere))
+		strcpy(errorMessage, "mrm-us-b doesn't exist");
+}
+
+/** Filtered distance: median of the last few readings, rate-limited
+@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@return - mm. 0 - nothing in range.
+*/
+uint16_t Mrm_us_b::distance(uint8_t deviceNumber) {
+	if (deviceNumber >= nextFree) {
+		strcpy(errorMessage, "mrm-us-b doesn't exist");
+		return 0;
+	}
+	if (!_schedule.running())
+		started(deviceNumber);
+	return (*_filters)[deviceNumber].output();
+}
+
+/** Last measurement's echoes, with its time
+@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@return - echoes. NULL - no such a device.
+*/
+const EchoList* Mrm_us_b::echoes(uint8_t deviceNumber) {
+	if (deviceNumber >= nextFree) {
+		strcpy(errorMessage, "mrm-us-b doesn't exist");
+		return NULL;
+	}
+	return &(*_echoes)[deviceNumber];
+}
+
 /** Read CAN Bus message into local variables
 @param data - 8 bytes from CAN Bus message.
 @param length - number of data bytes
@@ -75,8 +114,15 @@ bool Mrm_us_b::messageDecode(uint32_t canId, uint8_t data[8], uint8_t length) {
 					case COMMAND_SENSORS_MEASURE_SENDING:
 					{
 						uint16_t mm = (data[2] << 8) | data[1];
-						(*readings)[deviceNumber] = mm;
+						if (length >= 5) // Timestamp appended
+							timestampDecode(deviceNumber, data[3] | (data[4] << 8));
+						EchoList* echoes = &(*_echoes)[deviceNumber];
+						echoes->count = mm == 0 ? 0 : 1;
+						echoes->mm[0] = mm;
+						echoes->micros = acquisitionMicros(deviceNumber);
+						(*_filters)[deviceNumber].update(mm, echoes->micros);
 						(*_lastReadingMs)[deviceNumber] = millis();
+						_schedule.received(deviceNumber, micros());
 					}
 					break;
 				// }
@@ -102,8 +148,8 @@ uint16_t Mrm_us_b::reading(uint8_t deviceNumber) {
 		return 0;
 	}
 	alive(deviceNumber, true);
-	if (started(deviceNumber))
-		return (*readings)[deviceNumber];
+	if (_schedule.running() || started(deviceNumber))
+		return (*_echoes)[deviceNumber].mm[0];
 	else
 		return 0;
 }
@@ -113,7 +159,25 @@ uint16_t Mrm_us_b::reading(uint8_t deviceNumber) {
 void Mrm_us_b::readingsPrint() {
 	robotContainer->print("US:");
 	for (uint8_t deviceNumber = 0; deviceNumber < nextFree; deviceNumber++) 
-			robotContainer->print(" %3i", (*readings)[deviceNumber]);
+			robotContainer->print(" %3i", (*_echoes)[deviceNumber].mm[0]);
+}
+
+/** Fires the next group of sensors, if the previous one has finished. Robot calls it in each loop pass.
+*/
+void Mrm_us_b::scheduleRefresh() {
+	uint8_t mask = _schedule.refresh(micros());
+	for (uint8_t deviceNumber = 0; deviceNumber < nextFree; deviceNumber++)
+		if (mask & (1 << deviceNumber)) {
+			uint8_t frame[1] = { COMMAND_SENSORS_MEASURE_ONCE }; // Not canData, this runs in the CAN Bus task while it is running.
+			messageSend(frame, 1, deviceNumber);
+		}
+}
+
+/** Stops continuous measuring and fires sensors in groups instead, sensors not disturbing each other together.
+*/
+void Mrm_us_b::scheduleStart() {
+	stop(0xFF);
+	_schedule.start();
 }
 
 /** If sensor not started, start it and wait for 1. message
@@ -147,6 +211,7 @@ bool Mrm_us_b::started(uint8_t deviceNumber) {
 void Mrm_us_b::test()
 {
 	static uint32_t lastMs = 0;
+	static uint32_t lastCycles = 0;
 
 	if (millis() - lastMs > 300) {
 		uint8_t pass = 0;
@@ -154,9 +219,14 @@ void Mrm_us_b::test()
 			if (alive(deviceNumber)) {
 				if (pass++)
 					robotContainer->print("| ");
-				robotContainer->print("%i ", reading(deviceNumber));
+				robotContainer->print("%i (%i) ", reading(deviceNumber), distance(deviceNumber));
 			}
 		}
+		if (pass && _schedule.running()) { // Update rate each sensor gets
+			robotContainer->print(" %i groups, %i/s, %i timeouts", _schedule.groupCount(),
+				(int)((_schedule.cycles() - lastCycles) * 1000 / (millis() - lastMs)), _schedule.timeouts());
+			lastCycles = _schedule.cycles();
+		}
 		lastMs = millis();
 		if (pass)
 			robotContainer->print("\n\r");
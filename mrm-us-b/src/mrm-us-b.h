@@ -1,6 +1,7 @@
 #pragma once
 #include "Arduino.h"
 #include <mrm-board.h>
+#include <mrm-echo.h>
 
 /**
 Purpose: mrm-us-b interface to CANBus.
@@ -31,7 +32,9 @@ Licence: You can use this code any way you like.
 
 class Mrm_us_b : public SensorBoard
 {
-	std::vector<uint16_t>* readings; // Analog readings of all sensors
+	std::vector<EchoList>* _echoes; // Last measurement of each sensor. This board reports only the nearest echo.
+	std::vector<EchoFilter>* _filters;
+	EchoSchedule _schedule;
 
 	/** If sensor not started, start it and wait for 1. message
 	@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
@@ -56,6 +59,25 @@ public:
 	*/
 	void add(char * deviceName = (char *)"");
 
+	/** Declares that 2 sensors disturb each other so that scheduleStart() does not fire them together. By default all the sensors interfere.
+	@param deviceNumber1 - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@param deviceNumber2 - Second device.
+	@param interfere - if false, sensors can be fired together.
+	*/
+	void crosstalkSet(uint8_t deviceNumber1, uint8_t deviceNumber2, bool interfere = true);
+
+	/** Filtered distance: median of the last few readings, rate-limited
+	@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@return - mm. 0 - nothing in range.
+	*/
+	uint16_t distance(uint8_t deviceNumber = 0);
+
+	/** Last measurement's echoes, with its time
+	@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@return - echoes. NULL - no such a device.
+	*/
+	const EchoList* echoes(uint8_t deviceNumber = 0);
+
 	/** Read CAN Bus message into local variables
 	@param canId - CAN Bus id
 	@param data - 8 bytes from CAN Bus message.
@@ -73,6 +95,18 @@ public:
 	*/
 	void readingsPrint();
 
+	/** Fires the next group of sensors, if the previous one has finished. Robot calls it in each loop pass.
+	*/
+	void scheduleRefresh();
+
+	/** Stops continuous measuring and fires sensors in groups instead, sensors not disturbing each other together.
+	*/
+	void scheduleStart();
+
+	/** Stops firing in groups
+	*/
+	void scheduleStop() { _schedule.stop(); }
+
 	/**Test
 	*/
 	void test();
@@ -7,8 +7,10 @@
 @param hardwareSerial - Serial, Serial1, Serial2,... - an optional serial port, for example for Bluetooth communication
 @param maxNumberOfBoards - maximum number of boards
 */
-Mrm_us::Mrm_us(Robot* robot, uint8_t maxNumberOfBoards) : SensorBoard(robot, 1, "US", maxNumberOfBoards, ID_MRM_US) {
-	readings = new std::vector<uint16_t[MRM_US_ECHOES_COUNT]>(maxNumberOfBoards);
+Mrm_us::Mrm_us(Robot* robot, uint8_t maxNumberOfBoards) : SensorBoard(robot, 1, "US", maxNumberOfBoards, ID_MRM_US, MRM_US_ECHOES_COUNT) {
+	_echoes = new std::vector<EchoList>(maxNumberOfBoards);
+	_echoesPending = new std::vector<EchoList>(maxNumberOfBoards);
+	_filters = new std::vector<EchoFilter>(maxNumberOfBoards);
 }
 
 Mrm_us::~Mrm_us()
@@ -59,25 +61,79 @@ void Mrm_us::add(char * deviceName)
 		return;
 	}
 
-	//for (uint8_t i = 0; i < MRM_NODE_SWITCHES_COUNT; i++)
-	//	(*reading)[nextFree][i] = 0;
-
 	SensorBoard::add(deviceName, canIn, canOut);
 }
 
+/** Filtered distance of the nearest echo: median of the last few measurements, rate-limited
+@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@return - mm. 0 - nothing in range.
+*/
+uint16_t Mrm_us::distance(uint8_t deviceNumber) {
+	if (deviceNumber >= nextFree) {
+		strcpy(errorMessage, "mrm-us doesn't exist");
+		return 0;
+	}
+	return (*_filters)[deviceNumber].output();
+}
+
+/** Last complete measurement's echoes, with its time
+@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+@return - echoes. NULL - no such a device.
+*/
+const EchoList* Mrm_us::echoes(uint8_t deviceNumber) {
+	if (deviceNumber >= nextFree) {
+		strcpy(errorMessage, "mrm-us doesn't exist");
+		return NULL;
+	}
+	return &(*_echoes)[deviceNumber];
+}
+
+/** Decodes a frame of echoes. A list is used only if all its frames arrived, in order.
+@param data - 8 bytes from CAN Bus message.
+@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+*/
+void Mrm_us::echoesDecode(uint8_t data[8], uint8_t deviceNumber) {
+	EchoList* pending = &(*_echoesPending)[deviceNumber];
+	uint8_t first = data[1];
+	if (first == 0) { // A new measurement
+		pending->count = 0;
+		pending->micros = acquisitionMicros(deviceNumber);
+	}
+	else if (first != pending->count || first >= MRM_US_ECHOES_COUNT) { // A frame of this measurement lost
+		_framesDropped++;
+		return;
+	}
+
+	bool complete = false;
+	for (uint8_t i = 0; i < MRM_US_ECHOES_IN_FRAME && !complete; i++) {
+		uint16_t mm = data[2 + 2 * i] | (data[3 + 2 * i] << 8);
+		if (mm == 0)
+			complete = true;
+		else {
+			pending->mm[pending->count++] = mm;
+			complete = pending->count == MRM_US_ECHOES_COUNT;
+		}
+	}
+
+	if (complete) {
+		(*_echoes)[deviceNumber] = *pending;
+		(*_filters)[deviceNumber].update(pending->count == 0 ? 0 : pending->mm[0], pending->micros);
+		(*_lastReadingMs)[deviceNumber] = millis();
+		pending->count = 0xFF; // Till the next first frame, no consecutive one fits.
+	}
+}
+
 /** Read CAN Bus message into local variables
 @param data - 8 bytes from CAN Bus message.
+@param length - number of data bytes
 */
-bool Mrm_us::messageDecode(uint32_t canId, uint8_t data[8]) {
+bool Mrm_us::messageDecode(uint32_t canId, uint8_t data[8], uint8_t length) {
 	for (uint8_t deviceNumber = 0; deviceNumber < nextFree; deviceNumber++) 
 		if (isForMe(canId, deviceNumber)) {
 			if (!messageDecodeCommon(canId, data, deviceNumber)) {
-				// bool any = false;
-				// uint8_t startIndex = 0;
 				switch (data[0]) {
 				case COMMAND_SENSORS_MEASURE_SENDING:
-					// startIndex = 0;
-					// any = true;
+					echoesDecode(data, deviceNumber);
 					break;
 				default:
 					print("Unknown command. ");
@@ -91,17 +147,18 @@ bool Mrm_us::messageDecode(uint32_t canId, uint8_t data[8]) {
 	return false;
 }
 
-/** Analog readings
-@param echoNumber - echoId
+/** Echo's distance
+@param echoNumber - echo id, 0 - the nearest
 @param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
-@return - analog value
+@return - mm. 0 - no such an echo.
 */
 uint16_t Mrm_us::reading(uint8_t echoNumber, uint8_t deviceNumber) {
-	if (deviceNumber >= nextFree || echoNumber > MRM_US_ECHOES_COUNT) {
+	if (deviceNumber >= nextFree || echoNumber >= MRM_US_ECHOES_COUNT) {
 		strcpy(errorMessage, "mrm-us doesn't exist");
 		return 0;
 	}
-	return (*readings)[deviceNumber][echoNumber];
+	EchoList* echoes = &(*_echoes)[deviceNumber];
+	return echoNumber < echoes->count ? echoes->mm[echoNumber] : 0;
 }
 
 /** Print all readings in a line
@@ -109,8 +166,8 @@ uint16_t Mrm_us::reading(uint8_t echoNumber, uint8_t deviceNumber) {
 void Mrm_us::readingsPrint() {
 	print("US:");
 	for (uint8_t deviceNumber = 0; deviceNumber < nextFree; deviceNumber++) {
-		for (uint8_t echoNumber = 0; echoNumber < MRM_US_ECHOES_COUNT; echoNumber++)
-			print(" %3i", (*readings)[deviceNumber][echoNumber]);
+		for (uint8_t echoNumber = 0; echoNumber < (*_echoes)[deviceNumber].count; echoNumber++)
+			print(" %3i", (*_echoes)[deviceNumber].mm[echoNumber]);
 	}
 }
 
@@ -127,9 +184,9 @@ void Mrm_us::test()
 			if (alive(deviceNumber)) {
 				if (pass++)
 					print("| ");
-				print("Echo:");
-				for (uint8_t i = 0; i < MRM_US_ECHOES_COUNT; i++)
-					print("%i ", (*readings)[deviceNumber][i]);
+				print("Echo (%i):", distance(deviceNumber));
+				for (uint8_t i = 0; i < (*_echoes)[deviceNumber].count; i++)
+					print("%i ", (*_echoes)[deviceNumber].mm[i]);
 			}
 		}
 		lastMs = millis();
@@ -1,6 +1,7 @@
 #pragma once
 #include "Arduino.h"
 #include <mrm-board.h>
+#include <mrm-echo.h>
 
 /**
 Purpose: mrm-us interface to CANBus.
@@ -26,14 +27,24 @@ Licence: You can use this code any way you like.
 #define CAN_ID_US7_IN 0x30E
 #define CAN_ID_US7_OUT 0x30F
 
-#define MRM_US_ECHOES_COUNT 9
-
+#define MRM_US_ECHOES_COUNT ECHOES_MAX
+#define MRM_US_ECHOES_IN_FRAME 3 // COMMAND_SENSORS_MEASURE_SENDING: [command, first echo's index, 3 echoes, 2 bytes each, little endian].
+// Echo 0 ends the list. A list is complete when an echo 0 arrives or when it is full.
 
 
 class Mrm_us : public SensorBoard
 {
-	std::vector<uint16_t[MRM_US_ECHOES_COUNT]>* readings; // Analog readings of all sensors
-	
+	std::vector<EchoList>* _echoes; // Last complete measurement of each sensor
+	std::vector<EchoList>* _echoesPending; // Measurement being assembled from frames
+	uint16_t _framesDropped = 0; // Frames not following the previous one of their measurement
+	std::vector<EchoFilter>* _filters;
+
+	/** Decodes a frame of echoes. A list is used only if all its frames arrived, in order.
+	@param data - 8 bytes from CAN Bus message.
+	@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	*/
+	void echoesDecode(uint8_t data[8], uint8_t deviceNumber);
+
 public:
 
 	/** Constructor
@@ -51,16 +62,34 @@ public:
 	*/
 	void add(char * deviceName = (char *)"");
 
+	/** Filtered distance of the nearest echo: median of the last few measurements, rate-limited
+	@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@return - mm. 0 - nothing in range.
+	*/
+	uint16_t distance(uint8_t deviceNumber = 0);
+
+	/** Last complete measurement's echoes, with its time
+	@param deviceNumber - Device's ordinal number. Each call of function add() assigns a increasing number to the device, starting with 0.
+	@return - echoes. NULL - no such a device.
+	*/
+	const EchoList* echoes(uint8_t deviceNumber = 0);
+
+	/** Frames dropped because a frame of the same measurement was lost
+	@return - count
+	*/
+	uint16_t framesDropped() { return _framesDropped; }
+
 	/** Read CAN Bus message into local variables
 	@param canId - CAN Bus id
 	@param data - 8 bytes from CAN Bus message.
+	@param length - number of data bytes
 	*/
-	bool messageDecode(uint32_t canId, uint8_t data[8]);
+	bool messageDecode(uint32_t canId, uint8_t data[8], uint8_t length);
 
-	/** Analog readings
-	@param echoNumber - echo id
+	/** Echo's distance
+	@param echoNumber - echo id, 0 - the nearest
 	@param sensorNumber - Sensor's ordinal number. Each call of function add() assigns a increasing number to the sensor, starting with 0.
-	@return - analog value
+	@return - mm. 0 - no such an echo.
 	*/
 	uint16_t reading(uint8_t echoNumber = 0, uint8_t sensorNumber = 0);
 
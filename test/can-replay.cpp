@@ -0,0 +1,44 @@
+// Replays a CAN Bus dump, written by recordsDump(), through the boards' decoding and lists the decoded messages.
+// make can-replay && build/can-replay dump.bin. Text before the dump, like the rest of a captured serial log, is skipped.
+#include "can-replay.h"
+#include <vector>
+
+int main(int argc, char* argv[]) {
+	if (argc != 2) {
+		fprintf(stderr, "Usage: can-replay <dump file>\n");
+		return 2;
+	}
+	FILE* file = fopen(argv[1], "rb");
+	if (file == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+	std::vector<uint8_t> dump;
+	uint8_t buffer[4096];
+	size_t size;
+	while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		dump.insert(dump.end(), buffer, buffer + size);
+	fclose(file);
+
+	hostMicros = 1000000;
+	ReplayRobot robot;
+	uint16_t count = robot.mrm_can_bus->recordsLoad(dump.data(), dump.size());
+	if (count == 0) {
+		fprintf(stderr, "%s: %s\n", argv[1], errorMessage[0] != '\0' ? errorMessage : "no records");
+		return 1;
+	}
+
+	robot.mrm_can_bus->replayStart(0);
+	CANBusMessage* message;
+	while ((message = robot.mrm_can_bus->messageReceive()) != NULL) {
+		char* name = robot.nameOfId(message->messageId);
+		bool decoded = robot.messageDecode(message);
+		printf("0x%03X %-10s%s", message->messageId, name == NULL ? "?" : name, decoded ? "" : " (not decoded)");
+		for (uint8_t i = 0; i < message->dlc; i++)
+			printf(" %02X", message->data[i]);
+		printf("\n");
+	}
+	printf("%i records, %i outbound skipped, %i decoded, %i not decoded\n", count, count - robot.decoded - robot.unknown,
+		robot.decoded, robot.unknown);
+	return 0;
+}
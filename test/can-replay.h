@@ -0,0 +1,234 @@
+#pragma once
+#include <check.h>
+#include <stdarg.h>
+#include <mrm-robot.h>
+
+/**
+Purpose: host build of the boards' decoding, for replaying CAN Bus dumps. Boards and their devices are Robot's default ones; only the
+drivers that build without ESP32's peripherals are included. Robot's members the drivers call are stubbed here, as Robot itself needs
+Bluetooth, I2C and the menus.
+@author MRMS team
+@version 0.0 2026-10-19
+Licence: You can use this code any way you like.
+*/
+
+void print(const char* fmt, ...); // Drivers' global print, Serial's on ESP32.
+
+#include "../mrm-common/src/mrm-common.cpp"
+#include "../mrm-common/src/mrm-echo.cpp"
+#include "../mrm-common/src/mrm-task.cpp"
+#include "../mrm-can-bus/src/mrm-can-bitrate.cpp"
+#include "../mrm-can-bus/src/mrm-can-filter.cpp"
+#include "../mrm-can-bus/src/mrm-can-bus.cpp"
+#include "../mrm-pid/src/mrm-pid.cpp"
+#include "../mrm-board/src/mrm-board.cpp"
+#include "../mrm-board/src/mrm-odometry.cpp"
+#include "../mrm-board/src/mrm-segment.cpp"
+#include "../mrm-board/src/mrm-servo-motion.cpp"
+#include "../mrm-bldc2x50/src/mrm-bldc2x50.cpp"
+#include "../mrm-bldc4x2.5/src/mrm-bldc4x2.5.cpp"
+#include "../mrm-col-b/src/mrm-col-b.cpp"
+#include "../mrm-fet-can/src/mrm-fet-can.cpp"
+#include "../mrm-ir-finder3/src/mrm-ball-tracker.cpp"
+#include "../mrm-ir-finder3/src/mrm-ir-finder3.cpp"
+#include "../mrm-lid-can-b/src/mrm-lid-can-b.cpp"
+#include "../mrm-lid-can-b2/src/mrm-lid-can-b2.cpp"
+#include "../mrm-lid-d/src/mrm-lid-d.cpp"
+#include "../mrm-mot2x50/src/mrm-mot2x50.cpp"
+#include "../mrm-mot4x10/src/mrm-mot4x10.cpp"
+#include "../mrm-mot4x3.6can/src/mrm-mot4x3.6can.cpp"
+#include "../mrm-node/src/mrm-node.cpp"
+#include "../mrm-ref-can/src/mrm-ref-can.cpp"
+#include "../mrm-therm-b-can/src/mrm-therm-b-can.cpp"
+#include "../mrm-us-b/src/mrm-us-b.cpp"
+#include "../mrm-us1/src/mrm-us1.cpp"
+
+void print(const char* fmt, ...) {
+	va_list argp;
+	va_start(argp, fmt);
+	vprintf(fmt, argp);
+	va_end(argp);
+}
+
+Robot::Robot(char name[15], char ssid[15], char wiFiPassword[15]) {
+	strcpy(_name, name);
+	mrm_can_bus = new Mrm_can_bus();
+}
+
+bool Robot::actionPreprocessing(bool andFinish) { return false; }
+
+uint16_t Robot::bitrateLocal() { return 250; }
+
+bool Robot::bitrateLocalSet(uint16_t bitrateKbps) { return false; }
+
+void Robot::bitrateDevicesCommit(uint16_t bitrateKbps) {}
+
+bool Robot::bitrateDevicesPropose(uint16_t bitrateKbps) { return false; }
+
+uint32_t Robot::bitratePresence(bool scan) { return 0; }
+
+void Robot::bitrateWaitMs(uint16_t ms) {}
+
+void Robot::add(Board* aBoard) {
+	if (_boardNextFree > BOARDS_LIMIT - 1) {
+		strcpy(errorMessage, "Too many boards");
+		return;
+	}
+	board[_boardNextFree++] = aBoard;
+}
+
+void Robot::add(MotorGroup* group) {
+	if (_motorGroupNextFree > MOTOR_GROUPS_LIMIT - 1) {
+		strcpy(errorMessage, "Too many motor groups");
+		return;
+	}
+	motorGroup[_motorGroupNextFree++] = group;
+}
+
+void Robot::delayMicros(uint16_t pauseMicros) { hostMicros += pauseMicros; }
+
+void Robot::delayMs(uint16_t pauseMs) { hostMicros += pauseMs * 1000; }
+
+void Robot::noLoopWithoutThis() {}
+
+void Robot::print(const char* fmt, ...) {
+	va_list argp;
+	va_start(argp, fmt);
+	vprintf(fmt, argp);
+	va_end(argp);
+}
+
+uint16_t Robot::serialReadNumber(uint16_t timeoutFirst, uint16_t timeoutBetween, bool onlySingleDigitInput, uint16_t limit, bool printWarnings) {
+	return 0xFFFF;
+}
+
+bool Robot::userBreak() { return false; }
+
+/** Robot with the default boards, decoding as Robot::messagesReceive() does, without the dispatch table.
+*/
+class ReplayRobot : public Robot {
+public:
+	uint32_t decoded = 0; // Messages some board decoded
+	uint32_t unknown = 0; // Messages no board decoded
+
+	ReplayRobot() {
+		mrm_bldc2x50 = new Mrm_bldc2x50(this);
+		mrm_bldc4x2_5 = new Mrm_bldc4x2_5(this);
+		mrm_col_b = new Mrm_col_b(this);
+		mrm_fet_can = new Mrm_fet_can(this);
+		mrm_ir_finder3 = new Mrm_ir_finder3(this);
+		mrm_lid_can_b = new Mrm_lid_can_b(this);
+		mrm_lid_can_b2 = new Mrm_lid_can_b2(this);
+		mrm_lid_d = new Mrm_lid_d(this);
+		mrm_mot2x50 = new Mrm_mot2x50(this);
+		mrm_mot4x3_6can = new Mrm_mot4x3_6can(this);
+		mrm_mot4x10 = new Mrm_mot4x10(this);
+		mrm_node = new Mrm_node(this);
+		mrm_ref_can = new Mrm_ref_can(this);
+		mrm_therm_b_can = new Mrm_therm_b_can(this);
+		mrm_us_b = new Mrm_us_b(this);
+		mrm_us1 = new Mrm_us1(this);
+
+		char name[15];
+		for (uint8_t i = 0; i < 4; i++) {
+			sprintf(name, "BL2x50-%i", i);
+			mrm_bldc2x50->add(false, name);
+			sprintf(name, "BL4x2.5-%i", i);
+			mrm_bldc4x2_5->add(false, name);
+			sprintf(name, "Mot4x10-%i", i);
+			mrm_mot4x10->add(false, name);
+			sprintf(name, "Thermo-%i", i);
+			mrm_therm_b_can->add(name);
+		}
+		for (uint8_t i = 0; i < 2; i++) {
+			sprintf(name, "Clr-%i", i);
+			mrm_col_b->add(name);
+			sprintf(name, "Node-%i", i);
+			mrm_node->add(name);
+		}
+		mrm_fet_can->add((char*)"FET-0");
+		mrm_ir_finder3->add((char*)"IR3Fin-0");
+		for (uint8_t i = 0; i < 6; i++) {
+			sprintf(name, "Mot2x50-%i", i);
+			mrm_mot2x50->add(false, name);
+		}
+		for (uint8_t i = 0; i < 8; i++) {
+			sprintf(name, "Mot3.6-%i", i);
+			mrm_mot4x3_6can->add(false, name);
+			sprintf(name, "Lidar4m-%i", i);
+			mrm_lid_can_b2->add(name);
+		}
+		for (uint8_t i = 0; i < 14; i++) {
+			sprintf(name, i < 10 ? "Lidar2m-%i" : "Lidar2m%i", i);
+			mrm_lid_can_b->add(name);
+		}
+		mrm_lid_d->add((char*)"LidMul-0");
+		for (uint8_t i = 0; i < 5; i++) {
+			sprintf(name, "RefArr-%i", i);
+			mrm_ref_can->add(name);
+		}
+		mrm_us_b->add((char*)"US-B-0");
+		mrm_us1->add((char*)"US1-0");
+
+		add(mrm_bldc2x50);
+		add(mrm_bldc4x2_5);
+		add(mrm_col_b);
+		add(mrm_fet_can);
+		add(mrm_ir_finder3);
+		add(mrm_lid_can_b);
+		add(mrm_lid_can_b2);
+		add(mrm_lid_d);
+		add(mrm_mot2x50);
+		add(mrm_mot4x10);
+		add(mrm_mot4x3_6can);
+		add(mrm_node);
+		add(mrm_ref_can);
+		add(mrm_therm_b_can);
+		add(mrm_us_b);
+		add(mrm_us1);
+	}
+
+	void bitmapsSet() {}
+	uint8_t boardsCount() { return _boardNextFree; }
+	void goAhead() {}
+	void loop() {}
+
+	/** Offers a message to all the boards
+	@param message - received or replayed message
+	@return - some board decoded it
+	*/
+	bool messageDecode(CANBusMessage* message) {
+		bool any = false;
+		for (uint8_t i = 0; i < _boardNextFree; i++) {
+			if (board[i]->messageDecode(message->messageId, message->data, message->dlc))
+				any = true;
+			board[i]->requestComplete();
+		}
+		any ? decoded++ : unknown++;
+		return any;
+	}
+
+	/** Decodes all the received (or replayed) messages
+	@return - number of messages
+	*/
+	uint32_t messagesDecode() {
+		uint32_t count = 0;
+		CANBusMessage* message;
+		while ((message = mrm_can_bus->messageReceive()) != NULL) {
+			messageDecode(message);
+			count++;
+		}
+		return count;
+	}
+
+	/** Name of the device that uses the id
+	@param id - CAN Bus id
+	@return - name or NULL if unknown
+	*/
+	char* nameOfId(uint16_t id) {
+		char* name = NULL;
+		for (uint8_t i = 0; i < _boardNextFree && name == NULL; i++)
+			name = board[i]->nameOfId(id);
+		return name;
+	}
+};
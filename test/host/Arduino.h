@@ -0,0 +1,103 @@
+#pragma once
+#include <algorithm>
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+/**
+Purpose: just enough of Arduino to build the libraries' platform independent parts on a host computer, for the tests in this directory.
+Time and pins are variables a test sets, interrupt handlers are stored so that a test can call them.
+@author MRMS team
+@version 0.0 2026-10-19
+Licence: You can use this code any way you like.
+*/
+
+#define CHANGE 3
+#define DEG_TO_RAD 0.017453292519943295
+#define FALLING 2
+#define HIGH 1
+#define INPUT 0
+#define INPUT_PULLUP 2
+#define IRAM_ATTR
+#define LOW 0
+#define OUTPUT 1
+#define PI 3.1415926535897932384626433832795
+#define RAD_TO_DEG 57.295779513082320876798154814105
+#define RISING 1
+#define HOST_PINS 64
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define digitalPinToInterrupt(p) (p)
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+inline uint32_t hostMicros = 1; // A test advances it. Not 0, as many libraries treat 0 as "never".
+inline uint8_t hostPin[HOST_PINS];
+inline void (*hostInterrupt[HOST_PINS])();
+
+class String : public std::string {
+public:
+	String() {}
+	String(const char* s) : std::string(s) {}
+	String(const std::string& s) : std::string(s) {}
+	String(char c) : std::string(1, c) {}
+	String(int i) : std::string(std::to_string(i)) {}
+	String(unsigned int i) : std::string(std::to_string(i)) {}
+	String(long i) : std::string(std::to_string(i)) {}
+	String(unsigned long i) : std::string(std::to_string(i)) {}
+	String(double d) : std::string(std::to_string(d)) {}
+};
+inline String operator+(const String& a, const String& b) { return String(std::string(a) + std::string(b)); }
+inline String operator+(const String& a, const char* b) { return String(std::string(a) + b); }
+inline String operator+(const char* a, const String& b) { return String(a + std::string(b)); }
+
+class Print {
+public:
+	virtual ~Print() {}
+	size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.size()); }
+	size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+	size_t print(int i) { return print(String(i)); }
+	size_t print(double d) { return print(String(d)); }
+	size_t println(const String& s = String()) { return print(s) + print("\n"); }
+	size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+	virtual size_t write(uint8_t c) { return write(&c, 1); }
+	virtual size_t write(const uint8_t* buffer, size_t size) { return size; }
+};
+
+class Stream : public Print {
+public:
+	virtual int available() { return 0; }
+	virtual int read() { return -1; }
+	size_t readBytes(uint8_t* buffer, size_t length) {
+		size_t count = 0;
+		while (count < length && available())
+			buffer[count++] = read();
+		return count;
+	}
+};
+
+class HardwareSerial : public Stream {
+public:
+	void begin(unsigned long) {}
+};
+inline HardwareSerial Serial;
+
+template<class T, class U> inline auto min(T a, U b) -> typename std::decay<decltype(a < b ? a : b)>::type { return a < b ? a : b; }
+template<class T, class U> inline auto max(T a, U b) -> typename std::decay<decltype(a < b ? a : b)>::type { return a < b ? b : a; }
+
+inline void attachInterrupt(uint8_t pin, void (*handler)(), int) { hostInterrupt[pin] = handler; }
+inline void delay(unsigned long ms) { hostMicros += ms * 1000; }
+inline void delayMicroseconds(unsigned int us) { hostMicros += us; }
+inline int digitalRead(uint8_t pin) { return hostPin[pin]; }
+inline void digitalWrite(uint8_t pin, uint8_t value) { hostPin[pin] = value; }
+inline void interrupts() {}
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) { return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin; }
+inline unsigned long micros() { return hostMicros; }
+inline unsigned long millis() { return hostMicros / 1000; }
+inline void noInterrupts() {}
+inline void pinMode(uint8_t, uint8_t) {}
@@ -0,0 +1,18 @@
+#pragma once
+#include "Arduino.h"
+
+/**
+Purpose: ESP32's Bluetooth serial port, for the tests in this directory. Nothing is connected.
+@author MRMS team
+@version 0.0 2026-10-19
+Licence: You can use this code any way you like.
+*/
+
+#define CONFIG_BLUEDROID_ENABLED 1
+#define CONFIG_BT_ENABLED 1
+
+class BluetoothSerial : public Stream {
+public:
+	bool begin(const char*) { return true; }
+	bool hasClient() { return false; }
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include "Arduino.h"
+
+/**
+Purpose: ESP32's non-volatile storage, for the tests in this directory. Nothing is stored, reads return defaults.
+@author MRMS team
+@version 0.0 2026-10-19
+Licence: You can use this code any way you like.
+*/
+
+class Preferences {
+public:
+	bool begin(const char*, bool = false) { return true; }
+	void end() {}
+	size_t getBytes(const char*, void*, size_t) { return 0; }
+	size_t getBytesLength(const char*) { return 0; }
+	float getFloat(const char*, float value = 0) { return value; }
+	uint8_t getUChar(const char*, uint8_t value = 0) { return value; }
+	uint32_t getUInt(const char*, uint32_t value = 0) { return value; }
+	uint16_t getUShort(const char*, uint16_t value = 0) { return value; }
+	bool isKey(const char*) { return false; }
+	size_t putBytes(const char*, const void*, size_t size) { return size; }
+	size_t putFloat(const char*, float) { return 4; }
+	size_t putUChar(const char*, uint8_t) { return 1; }
+	size_t putUInt(const char*, uint32_t) { return 4; }
+	size_t putUShort(const char*, uint16_t) { return 2; }
+	bool remove(const char*) { return true; }
+};
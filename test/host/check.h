@@ -0,0 +1,25 @@
+#pragma once
+#include <stdio.h>
+
+/**
+Purpose: minimal assertions for the host tests. A failed check is printed and counted, the test continues.
+@author MRMS team
+@version 0.0 2026-10-19
+Licence: You can use this code any way you like.
+*/
+
+inline int checkFailures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+	checkFailures++; } } while (0)
+
+#define CHECK_NEAR(value, expected, tolerance) do { double _v = (value), _e = (expected); if (_v - _e > (tolerance) || _e - _v > (tolerance)) { \
+	printf("%s:%d: %s is %g, expected %g\n", __FILE__, __LINE__, #value, _v, _e); checkFailures++; } } while (0)
+
+/** Prints the result
+@return - process' exit code
+*/
+inline int checkResult(const char* name) {
+	printf("%s: %s\n", name, checkFailures == 0 ? "passed" : "FAILED");
+	return checkFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "Arduino.h"
+#include <deque>
+
+/**
+Purpose: a mock of ESP32's CAN driver for the tests in this directory. Frames a test queues in hostCanReceived are received, sent ones
+are collected in hostCanSent. Acceptance filter is not simulated, all the frames pass.
+@author MRMS team
+@version 0.0 2026-10-19
+Licence: You can use this code any way you like.
+*/
+
+#define CAN_ALERT_NONE 0
+#define CAN_FILTER_CONFIG_ACCEPT_ALL() { 0, 0xFFFFFFFF, true }
+#define CAN_IO_UNUSED -1
+#define CAN_TIMING_CONFIG_125KBITS() { 125 }
+#define CAN_TIMING_CONFIG_1MBITS() { 1000 }
+#define CAN_TIMING_CONFIG_250KBITS() { 250 }
+#define CAN_TIMING_CONFIG_500KBITS() { 500 }
+#define CAN_TIMING_CONFIG_800KBITS() { 800 }
+#define ESP_ERR_TIMEOUT 0x107
+#define ESP_FAIL -1
+#define ESP_OK 0
+
+typedef int esp_err_t;
+typedef int gpio_num_t;
+
+enum can_mode_t { CAN_MODE_NORMAL };
+enum can_state_t { CAN_STATE_STOPPED, CAN_STATE_RUNNING, CAN_STATE_BUS_OFF, CAN_STATE_RECOVERING };
+
+struct can_general_config_t {
+	can_mode_t mode;
+	gpio_num_t tx_io;
+	gpio_num_t rx_io;
+	gpio_num_t clkout_io;
+	gpio_num_t bus_off_io;
+	uint32_t tx_queue_len;
+	uint32_t rx_queue_len;
+	uint32_t alerts_enabled;
+	uint32_t clkout_divider;
+};
+
+struct can_filter_config_t {
+	uint32_t acceptance_code;
+	uint32_t acceptance_mask;
+	bool single_filter;
+};
+
+struct can_message_t {
+	uint32_t flags;
+	uint32_t identifier;
+	uint8_t data_length_code;
+	uint8_t data[8];
+};
+
+struct can_status_info_t {
+	can_state_t state;
+	uint32_t msgs_to_tx;
+	uint32_t msgs_to_rx;
+	uint32_t tx_error_counter;
+	uint32_t rx_error_counter;
+	uint32_t tx_failed_count;
+	uint32_t rx_missed_count;
+	uint32_t arb_lost_count;
+	uint32_t bus_error_count;
+};
+
+struct can_timing_config_t {
+	uint16_t kbps;
+};
+
+inline uint16_t hostCanKbps = 0; // 0 - driver not installed
+inline std::deque<can_message_t> hostCanReceived; // Frames the bus will deliver
+inline std::deque<can_message_t> hostCanSent;
+
+inline esp_err_t can_driver_install(const can_general_config_t*, const can_timing_config_t* timing, const can_filter_config_t*) {
+	hostCanKbps = timing->kbps;
+	return ESP_OK;
+}
+inline esp_err_t can_driver_uninstall() {
+	hostCanKbps = 0;
+	return ESP_OK;
+}
+inline esp_err_t can_get_status_info(can_status_info_t* status) {
+	*status = {};
+	status->state = hostCanKbps == 0 ? CAN_STATE_STOPPED : CAN_STATE_RUNNING;
+	status->msgs_to_rx = hostCanReceived.size();
+	return ESP_OK;
+}
+inline esp_err_t can_receive(can_message_t* message, uint32_t) {
+	if (hostCanReceived.empty())
+		return ESP_ERR_TIMEOUT;
+	*message = hostCanReceived.front();
+	hostCanReceived.pop_front();
+	return ESP_OK;
+}
+inline esp_err_t can_start() { return hostCanKbps == 0 ? ESP_FAIL : ESP_OK; }
+inline esp_err_t can_stop() { return ESP_OK; }
+inline esp_err_t can_transmit(const can_message_t* message, uint32_t) {
+	hostCanSent.push_back(*message);
+	return ESP_OK;
+}
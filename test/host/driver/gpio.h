@@ -0,0 +1,5 @@
+#pragma once
+#include "driver/can.h"
+
+#define GPIO_NUM_4 4
+#define GPIO_NUM_5 5
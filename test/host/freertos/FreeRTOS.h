@@ -0,0 +1,13 @@
+#pragma once
+#include <stdint.h>
+
+/**
+Purpose: FreeRTOS names the libraries use outside their ESP_PLATFORM parts, for the tests in this directory. Threads are in mrm-task.
+@author MRMS team
+@version 0.0 2026-10-19
+Licence: You can use this code any way you like.
+*/
+
+#define pdMS_TO_TICKS(ms) (ms)
+
+typedef uint32_t TickType_t;
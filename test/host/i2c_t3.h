@@ -0,0 +1,54 @@
+#pragma once
+#include "Arduino.h"
+#include <deque>
+
+/**
+Purpose: a mock I2C bus for the tests in this directory. It counts transactions and answers requestFrom() with the bytes a test queued.
+@author MRMS team
+@version 0.0 2026-10-19
+Licence: You can use this code any way you like.
+*/
+
+#define HOST_WIRE_POLL_MICROS 100 // Each available() call takes this long, so that timeouts expire.
+
+class HostWire {
+public:
+	uint32_t beginTransmissions = 0;
+	uint8_t lastAddress = 0;
+	uint8_t lastRegister = 0;
+	std::deque<uint8_t> received; // Bytes requestFrom() returned, not read yet
+	uint32_t requests = 0;
+	std::deque<uint8_t> response; // Next requestFrom() answers with these. Fewer than requested - the device does not answer in full.
+
+	int available() {
+		hostMicros += HOST_WIRE_POLL_MICROS;
+		return received.size();
+	}
+	void beginTransmission(uint8_t address) {
+		beginTransmissions++;
+		lastAddress = address;
+	}
+	uint8_t endTransmission() { return 0; }
+	int read() {
+		if (received.empty())
+			return -1;
+		uint8_t data = received.front();
+		received.pop_front();
+		return data;
+	}
+	uint8_t requestFrom(int address, int quantity) {
+		requests++;
+		lastAddress = address;
+		for (int i = 0; i < quantity && !response.empty(); i++) {
+			received.push_back(response.front());
+			response.pop_front();
+		}
+		response.clear();
+		return received.size();
+	}
+	size_t write(uint8_t data) {
+		lastRegister = data;
+		return 1;
+	}
+};
+inline HostWire Wire;
@@ -0,0 +1,111 @@
+// Ball tracker on a replayed match: the ball rolls around the robot across 180 degrees, measured with noise and reflections, calculated
+// and raw frames interleaved. Then it is kicked to the other side and later leaves the field.
+#include <check.h>
+#include "../mrm-ir-finder3/src/mrm-ball-tracker.cpp"
+
+#define ANGLE_NOISE 5 // Degrees, calculated frames
+#define FRAME_MS 10 // Calculated and raw frames alternate.
+#define RATE 60 // Ball's angular speed, degrees per second
+
+static uint32_t seed = 12345;
+
+/** Repeatable noise
+@return - -1 - 1
+*/
+static float noise() {
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 16) & 0x7FFF) / 16383.5 - 1;
+}
+
+/** True ball's angle before the kick: rolling clockwise, behind the robot at 1 s
+@param ms - time
+@return - degrees, -180 - 180
+*/
+static float truth(uint32_t ms) {
+	return angle180(120 + RATE * ms / 1000.0);
+}
+
+int main() {
+	BallTracker tracker;
+	CHECK(!tracker.estimate()->valid);
+	CHECK(!tracker.predict(0).valid);
+
+	// Rolling, 2 s. Every 25th calculated frame is a reflection, far off.
+	float errorMax = 0, rawErrorMax = 0;
+	float heldErrorSum = 0, predictedErrorSum = 0, rateSum = 0; // Averages, as single frames are noisy.
+	int frame = 0, summed = 0;
+	for (uint32_t ms = 0; ms < 2000; ms += FRAME_MS, frame++) {
+		bool calculated = frame % 2 == 0;
+		float measured = truth(ms) + (calculated ? ANGLE_NOISE : 3 * ANGLE_NOISE) * noise();
+		if (calculated && frame % 50 == 20)
+			measured += 150; // Reflection
+		if (calculated)
+			tracker.update(measured, 200 - 50 * ms / 1000.0, ms * 1000);
+		else
+			tracker.update(measured, -1, ms * 1000, 0.5); // Raw: coarser, no distance
+		float error = fabsf(angle180(tracker.estimate()->angle - truth(ms)));
+		if (ms >= 300) { // Converged
+			errorMax = fmaxf(errorMax, error);
+			rawErrorMax = fmaxf(rawErrorMax, fabsf(angle180(measured - truth(ms))));
+		}
+		if (ms >= 1000) { // 100 ms ahead, for the robot's command to take effect: prediction against the last estimate
+			heldErrorSum += fabsf(angle180(tracker.estimate()->angle - truth(ms + 100)));
+			predictedErrorSum += fabsf(angle180(tracker.predict((ms + 100) * 1000).angle - truth(ms + 100)));
+			rateSum += tracker.estimate()->angleRate;
+			summed++;
+		}
+	}
+	const BallEstimate* estimate = tracker.estimate();
+	CHECK(estimate->valid);
+	CHECK(errorMax < 2 * ANGLE_NOISE); // Reflections rejected, wrap around 180 degrees followed
+	CHECK(rawErrorMax > 100);
+	CHECK_NEAR(rateSum / summed, RATE, 3);
+	CHECK_NEAR(estimate->angleRate, RATE, 20);
+	CHECK_NEAR(estimate->distance, 200 - 50 * 1.99, 10);
+	CHECK_NEAR(estimate->distanceRate, -50, 15);
+	CHECK(estimate->confidence > 0.8);
+	CHECK(predictedErrorSum / summed < 3);
+	CHECK(predictedErrorSum < heldErrorSum / 2);
+	printf("Error: measured max %.1f, tracked max %.1f, 100 ms ahead mean %.1f predicted, %.1f not. Rate mean %.1f degrees/s.\n",
+		rawErrorMax, errorMax, predictedErrorSum / summed, heldErrorSum / summed, rateSum / summed);
+
+	// Prediction is less confident, and none after BALL_TRACK_LOST_MS.
+	BallEstimate predicted = tracker.predict(2090 * 1000);
+	CHECK(predicted.valid && predicted.micros == 2090 * 1000);
+	CHECK(predicted.confidence < estimate->confidence);
+	CHECK(!tracker.predict((1990 + BALL_TRACK_LOST_MS + 10) * 1000).valid);
+
+	// Kick: the ball jumps 160 degrees. Single frames are outliers, BALL_TRACK_GATE_MISSES consecutive ones restart the track.
+	float kicked = angle180(truth(2000) + 160);
+	float before = estimate->angle;
+	for (uint8_t i = 0; i < BALL_TRACK_GATE_MISSES; i++) {
+		uint32_t ms = 2000 + i * FRAME_MS;
+		tracker.update(kicked, 250, ms * 1000);
+		if (i < BALL_TRACK_GATE_MISSES - 1)
+			CHECK(fabsf(angle180(tracker.estimate()->angle - before)) < 10); // Still the old track
+	}
+	CHECK_NEAR(tracker.estimate()->angle, kicked, 1);
+	CHECK(tracker.estimate()->angleRate == 0);
+	CHECK_NEAR(tracker.estimate()->distance, 250, 1);
+
+	// Stale and repeated frames change nothing.
+	BallEstimate copy = *tracker.estimate();
+	tracker.update(0, 100, 1990 * 1000);
+	tracker.update(0, 100, copy.micros);
+	CHECK(tracker.estimate()->angle == copy.angle && tracker.estimate()->micros == copy.micros);
+
+	// Out of the field: no ball in sight lowers confidence till the track ends.
+	uint32_t ms = 2100;
+	for (uint8_t i = 0; i < 30 && tracker.estimate()->valid; i++, ms += FRAME_MS)
+		tracker.update(0, 0, ms * 1000);
+	CHECK(!tracker.estimate()->valid);
+
+	// Back after a long pause: a new track, not a continuation.
+	tracker.update(-30, 150, 5000 * 1000);
+	CHECK(tracker.estimate()->valid && tracker.estimate()->angle == -30);
+	CHECK(tracker.predict((5000 + BALL_TRACK_LOST_MS + 10) * 1000).valid == false);
+	tracker.update(90, 150, (5000 + BALL_TRACK_LOST_MS + 10) * 1000); // Lost meanwhile: restarts, no gating
+	CHECK(tracker.estimate()->angle == 90);
+
+	return checkResult("ball-tracker");
+}
@@ -0,0 +1,98 @@
+// Compile-time board list on a sample robot (lidars, motors, reflectance array): the same decoding as Robot's boards, RAM and decoding time.
+#include "can-replay.h"
+#include <chrono>
+#include <new>
+
+static size_t allocatedBytes = 0; // By operator new, since start
+
+void* operator new(size_t size) {
+	allocatedBytes += size;
+	void* p = malloc(size);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+typedef BoardList<Mrm_lid_can_b2, Mrm_mot4x3_6can, Mrm_ref_can> SampleBoards;
+
+/** Nanoseconds per message
+@param decode - decodes a single message
+@param messages - messages, decoded in turn
+@param count - number of messages
+@param rounds - decodings
+*/
+template <typename Decode>
+static double nanosPerMessage(Decode decode, CANBusMessage* messages, uint8_t count, uint32_t rounds) {
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < rounds; i++) {
+		CANBusMessage* message = &messages[i % count];
+		decode(message);
+	}
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds;
+}
+
+int main() {
+	hostMicros = 1000000;
+	size_t startBytes = allocatedBytes;
+	ReplayRobot robot; // Robot's default boards
+	size_t robotBytes = allocatedBytes - startBytes;
+
+	startBytes = allocatedBytes;
+	SampleBoards* boards = new SampleBoards(&robot);
+	char name[15];
+	for (uint8_t i = 0; i < 4; i++) {
+		sprintf(name, "Lidar4m-%i", i);
+		boards->get<Mrm_lid_can_b2>()->add(name);
+		sprintf(name, "Mot3.6-%i", i);
+		boards->get<Mrm_mot4x3_6can>()->add(false, name);
+	}
+	boards->get<Mrm_ref_can>()->add((char*)"RefArr-0");
+	size_t listBytes = allocatedBytes - startBytes;
+
+	// Sample traffic: 4 lidars and 4 motors' encoders.
+	CANBusMessage messages[8];
+	for (uint8_t i = 0; i < 4; i++) {
+		uint16_t mm = 500 + 100 * i;
+		messages[i] = { (uint32_t)robot.mrm_lid_can_b2->idOutOf(i), 3, { COMMAND_SENSORS_MEASURE_SENDING, (uint8_t)(mm & 0xFF), (uint8_t)(mm >> 8) } };
+		uint32_t ticks = 1000 * (i + 1);
+		messages[4 + i] = { (uint32_t)robot.mrm_mot4x3_6can->idOutOf(i), 5, { COMMAND_SENSORS_MEASURE_SENDING, (uint8_t)(ticks & 0xFF),
+			(uint8_t)(ticks >> 8), 0, 0 } };
+	}
+
+	// The list decodes what Robot's boards do, with the same ids.
+	for (uint8_t i = 0; i < 8; i++) {
+		CHECK(robot.messageDecode(&messages[i]));
+		CHECK(boards->messageDecode(messages[i].messageId, messages[i].data, messages[i].dlc));
+	}
+	CHECK(boards->get<Mrm_lid_can_b2>()->distance(2) == robot.mrm_lid_can_b2->distance(2));
+	CHECK(boards->get<Mrm_lid_can_b2>()->distance(2) == 700);
+	CHECK(boards->get<Mrm_mot4x3_6can>()->reading(3) == 4000);
+	uint8_t unknown[8] = { COMMAND_SENSORS_MEASURE_SENDING };
+	CHECK(!boards->messageDecode(0x7F0, unknown, 1));
+	uint8_t added = 0;
+	boards->forEach([&added](Board* board) { added++; });
+	CHECK(added == 3);
+
+	// Robot's dispatch table, as Robot::dispatchBuild() makes it: id's board, then a virtual call.
+	uint8_t* boardOfId = new uint8_t[CAN_FILTER_ID_MASK + 1]();
+	Board* tableBoards[] = { robot.mrm_lid_can_b2, robot.mrm_mot4x3_6can };
+	for (uint8_t i = 0; i < 2; i++)
+		for (uint8_t deviceNumber = 0; deviceNumber < tableBoards[i]->deadOrAliveCount(); deviceNumber++)
+			boardOfId[tableBoards[i]->idOutOf(deviceNumber) & CAN_FILTER_ID_MASK] = i + 1;
+
+	const uint32_t ROUNDS = 400000;
+	double all = nanosPerMessage([&robot](CANBusMessage* m) { robot.messageDecode(m); }, messages, 8, ROUNDS);
+	double table = nanosPerMessage([&](CANBusMessage* m) {
+		Board* board = tableBoards[boardOfId[m->messageId & CAN_FILTER_ID_MASK] - 1];
+		board->messageDecode(m->messageId, m->data, m->dlc);
+		board->requestComplete();
+	}, messages, 8, ROUNDS);
+	double list = nanosPerMessage([boards](CANBusMessage* m) { boards->messageDecode(m->messageId, m->data, m->dlc); }, messages, 8, ROUNDS);
+	printf("Decoding: all %i boards %.0f ns, table %.0f ns, list of 3 %.0f ns per message. RAM: default boards %i B, list %i B.\n",
+		robot.boardsCount(), all, table, list, (int)robotBytes, (int)listBytes);
+
+	return checkResult("board-list");
+}
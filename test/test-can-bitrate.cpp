@@ -0,0 +1,157 @@
+// CAN Bus bitrate negotiation: propose, commit and rollback on a simulated bus with devices that refuse, miss messages or fail.
+#include <check.h>
+#include <vector>
+#include "../mrm-can-bus/src/mrm-can-bitrate.cpp"
+
+/** A device as the firmware behaves: accepts supported bitrates, switches on commit, returns if nothing arrives in time.
+*/
+struct SimulatedDevice {
+	uint16_t kbps = 250;
+	uint16_t previousKbps = 250;
+	uint32_t switchedMs = 0;
+	bool confirmed = true;
+	uint16_t maxKbps = 1000; // Supported up to
+	bool commitLost = false; // Does not receive the commit
+	uint16_t deafKbps = 0; // Switches to it, but its transceiver cannot work at it
+};
+
+struct SimulatedBus : public CANBusBitrateLink {
+	uint32_t nowMs = 0;
+	uint16_t robotKbps = 250;
+	bool localFails = false;
+	std::vector<SimulatedDevice> devices;
+	uint16_t proposals = 0;
+	uint16_t waitedMs = 0;
+
+	/** Does a device hear the robot and answer?
+	*/
+	bool reaches(SimulatedDevice& device) {
+		return device.kbps == robotKbps && device.kbps != device.deafKbps;
+	}
+
+	/** A message reached the device
+	*/
+	void heard(SimulatedDevice& device) { device.confirmed = true; }
+
+	/** Firmware's timeout
+	*/
+	void devicesRefresh() {
+		for (SimulatedDevice& device : devices)
+			if (!device.confirmed && nowMs - device.switchedMs >= CAN_BITRATE_CONFIRM_MS) {
+				device.kbps = device.previousKbps;
+				device.confirmed = true;
+			}
+	}
+
+	uint16_t bitrateLocal() { return robotKbps; }
+
+	bool bitrateLocalSet(uint16_t bitrateKbps) {
+		if (localFails)
+			return false;
+		robotKbps = bitrateKbps;
+		return true;
+	}
+
+	void bitrateDevicesCommit(uint16_t bitrateKbps) {
+		for (SimulatedDevice& device : devices)
+			if (reaches(device) && !device.commitLost) {
+				device.previousKbps = device.kbps;
+				device.kbps = bitrateKbps;
+				device.switchedMs = nowMs;
+				device.confirmed = false;
+			}
+	}
+
+	bool bitrateDevicesPropose(uint16_t bitrateKbps) {
+		proposals++;
+		bool all = true;
+		for (SimulatedDevice& device : devices)
+			if (reaches(device)) {
+				heard(device);
+				all &= bitrateKbps <= device.maxKbps;
+			}
+		return all;
+	}
+
+	uint32_t bitratePresence(bool scan) {
+		nowMs += 10;
+		devicesRefresh();
+		uint32_t mask = 0;
+		for (uint8_t i = 0; i < devices.size(); i++)
+			if (reaches(devices[i])) {
+				if (scan)
+					heard(devices[i]);
+				mask |= 1 << i;
+			}
+		return mask;
+	}
+
+	void bitrateWaitMs(uint16_t ms) {
+		waitedMs += ms;
+		nowMs += ms;
+		devicesRefresh();
+	}
+
+	/** All at the robot's bitrate, none waiting for confirmation
+	*/
+	bool settled(uint16_t kbps) {
+		if (robotKbps != kbps)
+			return false;
+		for (SimulatedDevice& device : devices)
+			if (device.kbps != kbps || !device.confirmed)
+				return false;
+		return true;
+	}
+};
+
+int main() {
+	SimulatedBus bus;
+	bus.devices.resize(4);
+
+	// Same bitrate: nothing sent
+	CHECK(canBitrateNegotiate(&bus, 250) == CAN_BITRATE_OK);
+	CHECK(bus.proposals == 0);
+
+	// All accept
+	CHECK(canBitrateNegotiate(&bus, 500) == CAN_BITRATE_OK);
+	CHECK(bus.settled(500));
+	CHECK(bus.waitedMs == 0);
+	bus.nowMs += CAN_BITRATE_CONFIRM_MS * 2; // Scan confirmed them, they stay.
+	bus.devicesRefresh();
+	CHECK(bus.settled(500));
+
+	// One refuses: nothing changes
+	bus.devices[2].maxKbps = 500;
+	CHECK(canBitrateNegotiate(&bus, 1000) == CAN_BITRATE_REFUSED);
+	CHECK(bus.settled(500));
+	bus.devices[2].maxKbps = 1000;
+
+	// Commit lost: the device stays behind, so the others and the robot return.
+	bus.devices[1].commitLost = true;
+	CHECK(canBitrateNegotiate(&bus, 1000) == CAN_BITRATE_DEVICES_LOST);
+	CHECK(bus.settled(500));
+	bus.devices[1].commitLost = false;
+
+	// A device switches but does not work at the new bitrate: it returns by itself, the rest by rollback.
+	bus.devices[3].deafKbps = 1000;
+	bus.waitedMs = 0;
+	CHECK(canBitrateNegotiate(&bus, 1000) == CAN_BITRATE_DEVICES_LOST);
+	CHECK(bus.waitedMs >= CAN_BITRATE_CONFIRM_MS);
+	CHECK(bus.settled(500));
+	bus.devices[3].deafKbps = 0;
+
+	// Robot cannot switch: devices return by themselves.
+	bus.localFails = true;
+	CHECK(canBitrateNegotiate(&bus, 125) == CAN_BITRATE_LOCAL_FAILED);
+	CHECK(bus.settled(500));
+	bus.localFails = false;
+
+	// A dead device does not block the others.
+	bus.devices[0].kbps = 0;
+	CHECK(canBitrateNegotiate(&bus, 125) == CAN_BITRATE_OK);
+	CHECK(bus.robotKbps == 125);
+	for (uint8_t i = 1; i < 4; i++)
+		CHECK(bus.devices[i].kbps == 125 && bus.devices[i].confirmed);
+
+	return checkResult("can-bitrate");
+}
@@ -0,0 +1,67 @@
+// CAN Bus acceptance filter: each calculated filter checked against all 2048 ids, as the controller tests them.
+#include <check.h>
+#include <stdlib.h>
+#include "../mrm-can-bus/src/mrm-can-filter.cpp"
+
+/** Ids the filter passes, counted one by one
+@param filter - filter
+@return - count
+*/
+static uint16_t passingCounted(const CANBusFilter* filter) {
+	uint16_t count = 0;
+	for (uint16_t id = 0; id <= CAN_FILTER_ID_MASK; id++)
+		count += canFilterPasses(filter, id);
+	return count;
+}
+
+/** Ids passing the tightest single filter: 2 to the power of the number of bits that differ among the ids
+@param ids - ids
+@param count - number of ids, at least 1
+@return - count
+*/
+static uint16_t passingSingle(const uint16_t* ids, uint16_t count) {
+	uint16_t differing = 0;
+	for (uint16_t i = 1; i < count; i++)
+		differing |= ids[i] ^ ids[0];
+	return 1 << __builtin_popcount(differing);
+}
+
+int main() {
+	// No ids: all pass.
+	CANBusFilter filter = canFilterCalculate(NULL, 0);
+	CHECK(filter.passing == CAN_FILTER_ID_MASK + 1);
+	CHECK(passingCounted(&filter) == filter.passing);
+
+	// One id: only it.
+	uint16_t one = 0x2A5;
+	filter = canFilterCalculate(&one, 1);
+	CHECK(filter.passing == 1 && passingCounted(&filter) == 1 && canFilterPasses(&filter, one));
+
+	// 2 distant groups: dual filter, 4 + 2 ids.
+	uint16_t groups[] = { 0x110, 0x111, 0x112, 0x113, 0x350, 0x351 };
+	filter = canFilterCalculate(groups, 6);
+	CHECK(filter.dual);
+	CHECK(filter.passing == 6);
+	CHECK(passingCounted(&filter) == 6);
+
+	// Random sets, some of devices' typical ids in a block: all of them pass, count correct, never worse than a single filter.
+	srand(1);
+	for (int test = 0; test < 5000; test++) {
+		uint16_t ids[40];
+		uint16_t count = 1 + rand() % 40;
+		for (uint16_t i = 0; i < count; i++)
+			ids[i] = test % 3 == 0 ? 0x100 + rand() % 64 * 2 : rand() % 2048;
+		filter = canFilterCalculate(ids, count);
+		uint16_t counted = passingCounted(&filter);
+		CHECK(counted == filter.passing);
+		CHECK(counted <= passingSingle(ids, count));
+		for (uint16_t i = 0; i < count; i++)
+			CHECK(canFilterPasses(&filter, ids[i]));
+		if (checkFailures > 0) {
+			printf("Failed with %i ids, dual %i\n", count, filter.dual);
+			break;
+		}
+	}
+
+	return checkResult("can-filter");
+}
@@ -0,0 +1,109 @@
+// CAN Bus dump's round trip: frames decoded live while recording, recordsDump(), recordsLoad() and replay decode to the same values.
+#include "can-replay.h"
+#include <vector>
+
+/** Collects written bytes, like a serial port's receiving end
+*/
+class MemoryPrint : public Print {
+public:
+	std::vector<uint8_t> bytes;
+
+	size_t write(const uint8_t* buffer, size_t size) {
+		bytes.insert(bytes.end(), buffer, buffer + size);
+		return size;
+	}
+};
+
+/** Queues a frame and decodes it
+@param robot - receiving robot
+@param id - CAN Bus id
+@param dlc - number of data bytes
+@param data - data
+*/
+static void frameReceive(ReplayRobot* robot, uint32_t id, uint8_t dlc, const uint8_t* data) {
+	can_message_t message = {};
+	message.identifier = id;
+	message.data_length_code = dlc;
+	memcpy(message.data, data, dlc);
+	hostCanReceived.push_back(message);
+	hostMicros += 1500;
+	CHECK(robot->messagesDecode() == 1);
+}
+
+static uint16_t distanceWhenDone; // Lidar's distance, as seen by request's callback
+
+/** Request's callback, reading what the board decoded from the response
+@param board - lidar board
+@param deviceNumber - lidar
+@param response - response, NULL if failed
+*/
+static void distanceRequestDone(Board* board, uint8_t deviceNumber, uint8_t* response) {
+	distanceWhenDone = ((Mrm_lid_can_b2*)board)->distance(deviceNumber);
+}
+
+int main() {
+	hostMicros = 1000000;
+	ReplayRobot live;
+	live.mrm_can_bus->recordingStart();
+
+	uint8_t lidar0[] = { COMMAND_SENSORS_MEASURE_SENDING, 1234 & 0xFF, 1234 >> 8 };
+	uint8_t lidar3[] = { COMMAND_SENSORS_MEASURE_SENDING, 567 & 0xFF, 567 >> 8, 0x10, 0x27 }; // With timestamp
+	uint8_t motor1[] = { COMMAND_SENSORS_MEASURE_SENDING, 0xA0, 0x86, 0x01, 0x00 }; // 100000 ticks
+	uint8_t lidar0Later[] = { COMMAND_SENSORS_MEASURE_SENDING, 1240 & 0xFF, 1240 >> 8 };
+	frameReceive(&live, live.mrm_lid_can_b2->idOutOf(0), sizeof(lidar0), lidar0);
+	frameReceive(&live, live.mrm_lid_can_b2->idOutOf(3), sizeof(lidar3), lidar3);
+	frameReceive(&live, live.mrm_mot4x3_6can->idOutOf(1), sizeof(motor1), motor1);
+	live.mrm_lid_can_b2->distanceMode(0, true); // Outbound, recorded but not replayed.
+	frameReceive(&live, live.mrm_lid_can_b2->idOutOf(0), sizeof(lidar0Later), lidar0Later);
+	CHECK(live.decoded == 4 && live.unknown == 0);
+	CHECK(live.mrm_can_bus->recordsCount() == 5);
+	CHECK(live.mrm_lid_can_b2->distance(0) == 1240);
+	CHECK(live.mrm_lid_can_b2->distance(3) == 567);
+	CHECK(live.mrm_mot4x3_6can->reading(1) == 100000);
+
+	// Dump, as captured from serial port, with log text before it.
+	const char* text = "Robot started.\r\nDump:\r\n";
+	MemoryPrint log;
+	log.print(text);
+	live.mrm_can_bus->recordsDump(&log);
+	CHECK(log.bytes.size() == strlen(text) + CAN_DUMP_HEADER_SIZE + 5 * sizeof(CANBusRecord));
+
+	// Loaded and replayed by another robot: the same readings, nothing sent.
+	ReplayRobot replay;
+	size_t sentBefore = hostCanSent.size();
+	CHECK(replay.mrm_can_bus->recordsLoad(log.bytes.data(), log.bytes.size()) == 5);
+	CHECK(!replay.mrm_can_bus->recording());
+	replay.mrm_can_bus->replayStart(0);
+	CHECK(replay.messagesDecode() == 4); // Outbound one skipped
+	CHECK(!replay.mrm_can_bus->replaying());
+	CHECK(replay.decoded == 4 && replay.unknown == 0);
+	CHECK(replay.mrm_lid_can_b2->distance(0) == 1240);
+	CHECK(replay.mrm_lid_can_b2->distance(3) == 567);
+	CHECK(replay.mrm_mot4x3_6can->reading(1) == 100000);
+	CHECK(hostCanSent.size() == sentBefore);
+
+	// A request is done only after the board stored the response's payload.
+	uint8_t measure[] = { COMMAND_SENSORS_MEASURE_ONCE };
+	uint16_t handle = replay.mrm_lid_can_b2->request(measure, 1, COMMAND_SENSORS_MEASURE_SENDING, 3, distanceRequestDone);
+	CHECK(replay.mrm_lid_can_b2->requestStatus(handle) == REQUEST_PENDING);
+	uint8_t lidar3Answer[] = { COMMAND_SENSORS_MEASURE_SENDING, 890 & 0xFF, 890 >> 8 };
+	frameReceive(&replay, replay.mrm_lid_can_b2->idOutOf(3), sizeof(lidar3Answer), lidar3Answer);
+	CHECK(replay.mrm_lid_can_b2->requestStatus(handle) == REQUEST_DONE);
+	CHECK(distanceWhenDone == 890);
+	CHECK(!replay.mrm_lid_can_b2->requestsPending());
+
+	// Invalid dumps are rejected, leaving the count 0.
+	ReplayRobot rejecting;
+	errorMessage[0] = '\0';
+	CHECK(rejecting.mrm_can_bus->recordsLoad(log.bytes.data(), log.bytes.size() - 1) == 0);
+	CHECK(strcmp(errorMessage, "CAN dump cut short") == 0);
+	std::vector<uint8_t> version2 = log.bytes;
+	version2[strlen(text) + 6] = 2;
+	CHECK(rejecting.mrm_can_bus->recordsLoad(version2.data(), version2.size()) == 0);
+	CHECK(strcmp(errorMessage, "CAN dump v2 unsupported") == 0);
+	CHECK(rejecting.mrm_can_bus->recordsLoad(log.bytes.data(), strlen(text) + 8) == 0);
+	CHECK(strcmp(errorMessage, "No CAN dump") == 0);
+	CHECK(rejecting.mrm_can_bus->recordsCount() == 0);
+
+	return checkResult("can-replay");
+}
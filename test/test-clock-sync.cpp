@@ -0,0 +1,53 @@
+// Clock sync: only an answer to the request in flight is taken, stamped after sending.
+#include "can-replay.h"
+
+/** Queues a device's clock sync answer and decodes it
+@param robot - receiving robot
+@param deviceMicros - device's clock
+*/
+static void answerReceive(ReplayRobot* robot, uint32_t deviceMicros) {
+	can_message_t message = {};
+	message.identifier = robot->mrm_lid_can_b2->idOutOf(0);
+	message.data_length_code = 5;
+	message.data[0] = COMMAND_TIME_SYNC_SENDING;
+	for (uint8_t i = 0; i < 4; i++)
+		message.data[i + 1] = deviceMicros >> (8 * i);
+	hostCanReceived.push_back(message);
+	robot->messagesDecode();
+}
+
+int main() {
+	hostMicros = 1000000;
+	ReplayRobot robot;
+	const ClockSync* sync = robot.mrm_lid_can_b2->clockSyncState(0);
+
+	// Not requested: ignored.
+	answerReceive(&robot, 5000000);
+	CHECK(sync->samples == 0);
+
+	// Device's clock 4 s ahead, round trip 400 us.
+	robot.mrm_lid_can_b2->clockSync(0);
+	CHECK(sync->inFlight);
+	uint32_t requestMicros = hostMicros;
+	hostMicros += 400;
+	answerReceive(&robot, requestMicros + 200 + 4000000);
+	CHECK(sync->samples == 1 && !sync->inFlight);
+	CHECK(sync->roundTripMicros == 400);
+	CHECK(sync->offsetMicros == 4000000);
+
+	// A duplicate answer, no request in flight: neither a sample nor a grown round trip.
+	hostMicros += 5000;
+	answerReceive(&robot, hostMicros + 4000000);
+	CHECK(sync->samples == 1 && sync->roundTripMicros == 400);
+
+	// Answered twice: only the first answer is a sample.
+	robot.mrm_lid_can_b2->clockSync(0);
+	requestMicros = hostMicros;
+	hostMicros += 300;
+	answerReceive(&robot, requestMicros + 150 + 4000000);
+	answerReceive(&robot, requestMicros + 150 + 4000000);
+	CHECK(sync->samples == 2);
+	CHECK(sync->roundTripMicros == 300);
+
+	return checkResult("clock-sync");
+}
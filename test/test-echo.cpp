@@ -0,0 +1,137 @@
+// Ultrasonic echoes: the temporal filter on spikes, misses and real steps, and the firing schedule on 4 simulated sensors, each answering
+// 12 ms after it is fired.
+#include <check.h>
+#include "../mrm-common/src/mrm-echo.cpp"
+
+#define ECHO_MICROS 12000 // A sensor answers this long after it is fired.
+#define SAMPLE_MICROS 20000 // Filter's samples
+
+/** Runs a schedule for 1 s, sensors answering after ECHO_MICROS, except the silent ones
+@param schedule - started schedule of 4 sensors
+@param silent - bitwise, sensors never answering
+@param crosstalk - bitwise for each sensor, sensors it interferes with. Checked against each fired group.
+@param fired - output, times each sensor was fired
+@return - groups fired with interfering sensors together
+*/
+static uint16_t run(EchoSchedule* schedule, uint8_t silent, const uint8_t crosstalk[4], uint16_t fired[4]) {
+	uint16_t conflicts = 0;
+	uint8_t pending = 0;
+	uint32_t firedMicros = 0;
+	for (uint32_t micros = 10000; micros < 1010000; micros += 100) {
+		if (pending && micros - firedMicros >= ECHO_MICROS) {
+			for (uint8_t i = 0; i < 4; i++)
+				if (pending & ~silent & (1 << i))
+					schedule->received(i, micros);
+			pending = 0;
+		}
+		uint8_t mask = schedule->refresh(micros);
+		if (mask) {
+			for (uint8_t i = 0; i < 4; i++)
+				if (mask & (1 << i)) {
+					fired[i]++;
+					if (mask & crosstalk[i])
+						conflicts++;
+				}
+			pending = mask;
+			firedMicros = micros;
+		}
+	}
+	return conflicts;
+}
+
+int main() {
+	// Filter: a single spike and a single miss do not pass, a real step does, rate-limited.
+	EchoFilter filter;
+	uint32_t micros = 1000;
+	uint16_t before[] = { 500, 510, 3000, 505, 0, 500, 520 };
+	for (uint16_t mm : before) {
+		micros += SAMPLE_MICROS;
+		uint16_t output = filter.update(mm, micros);
+		CHECK(output >= 500 && output <= 520);
+	}
+	CHECK(filter.limited() == 0);
+	uint16_t last = filter.output();
+	uint8_t samples = 0;
+	while (filter.output() != 1500 && samples < 50) { // Step to 1500 mm
+		micros += SAMPLE_MICROS;
+		filter.update(1500, micros);
+		CHECK(filter.output() >= last); // Never overshoots back
+		CHECK(filter.output() - last <= ECHO_FILTER_RATE_MM_PER_S * SAMPLE_MICROS / 1000000 + 1);
+		last = filter.output();
+		samples++;
+	}
+	CHECK(filter.output() == 1500);
+	CHECK(samples == 2 + 13); // The median follows after 3 samples of 5, then 1000 mm at 81 mm per sample.
+	CHECK(filter.limited() > 0);
+
+	// Nothing in range: more than ECHO_FILTER_MISSES_ALLOWED misses in a row.
+	for (uint8_t i = 0; i < ECHO_FILTER_MISSES_ALLOWED; i++)
+		CHECK(filter.update(0, micros += SAMPLE_MICROS) == 1500);
+	CHECK(filter.update(0, micros += SAMPLE_MICROS) == 0);
+	CHECK(filter.update(800, micros += SAMPLE_MICROS) == 800); // Starts anew, no rate limit
+
+	// After a long gap old samples are forgotten.
+	micros += ECHO_FILTER_STALE_MS * 1000 + 1;
+	CHECK(filter.update(300, micros) == 300);
+
+	// Schedule: by default all 4 sensors interfere and are fired one by one.
+	uint8_t all[4] = { 0x0E, 0x0D, 0x0B, 0x07 };
+	uint16_t fired[4] = { 0, 0, 0, 0 };
+	EchoSchedule single;
+	for (uint8_t i = 0; i < 4; i++)
+		CHECK(single.deviceAdd());
+	CHECK(single.refresh(100000) == 0); // Not started
+	single.start();
+	CHECK(run(&single, 0, all, fired) == 0);
+	CHECK(single.groupCount() == 4);
+	CHECK(single.timeouts() == 0);
+	uint32_t singleCycles = single.cycles(); // In 1 s
+	CHECK(singleCycles >= 14 && singleCycles <= 15); // 12 ms echo and 5 ms guard, 4 times
+	for (uint8_t i = 0; i < 4; i++)
+		CHECK(fired[i] >= singleCycles && fired[i] <= singleCycles + 1);
+
+	// Opposite sensors (0 and 2, 1 and 3) do not hear each other: 2 groups, twice the rate, still no conflicts.
+	EchoSchedule pairs;
+	for (uint8_t i = 0; i < 4; i++)
+		pairs.deviceAdd();
+	CHECK(pairs.crosstalkSet(0, 2, false));
+	CHECK(pairs.crosstalkSet(1, 3, false));
+	CHECK(!pairs.crosstalkSet(0, 4, false)); // No such a device
+	CHECK(!pairs.crosstalkSet(1, 1, false));
+	uint8_t opposite[4] = { 0x0A, 0x05, 0x0A, 0x05 };
+	pairs.start();
+	CHECK(run(&pairs, 0, opposite, fired) == 0);
+	CHECK(pairs.groupCount() == 2);
+	CHECK(pairs.cycles() >= 2 * singleCycles - 1);
+	printf("Cycles per second: %u fired one by one, %u in pairs.\n", singleCycles, pairs.cycles());
+
+	// A silent sensor times its group out, the others go on at a lower rate.
+	EchoSchedule silent;
+	for (uint8_t i = 0; i < 4; i++)
+		silent.deviceAdd();
+	silent.crosstalkSet(0, 2, false);
+	silent.crosstalkSet(1, 3, false);
+	silent.start();
+	for (uint8_t i = 0; i < 4; i++)
+		fired[i] = 0;
+	run(&silent, 1 << 3, opposite, fired);
+	CHECK(silent.timeouts() > 0);
+	CHECK(silent.timeouts() >= silent.cycles() - 1 && silent.timeouts() <= silent.cycles() + 1); // Each pass, once
+	CHECK(silent.cycles() > 10 && silent.cycles() < pairs.cycles());
+	CHECK(fired[0] > 10 && fired[3] == fired[1]);
+
+	// Stopped: nothing fired.
+	silent.stop();
+	CHECK(!silent.running());
+	for (uint32_t t = 2000000; t < 2100000; t += 1000)
+		CHECK(silent.refresh(t) == 0);
+
+	// At most ECHO_SCHEDULE_DEVICES_MAX devices.
+	EchoSchedule full;
+	for (uint8_t i = 0; i < ECHO_SCHEDULE_DEVICES_MAX; i++)
+		CHECK(full.deviceAdd());
+	CHECK(!full.deviceAdd());
+	CHECK(full.groupCount() == ECHO_SCHEDULE_DEVICES_MAX);
+
+	return checkResult("echo");
+}
@@ -0,0 +1,82 @@
+// Encoders: quadrature decoding and edge-period velocity on synthetic edge streams.
+#include <check.h>
+#include "../Encoders/Encoders.cpp"
+
+#define PIN_A 4
+#define PIN_B 5
+#define PIN_SINGLE 6
+
+void error(String message) {
+	printf("error: %s\n", message.c_str());
+	checkFailures++;
+}
+
+/** Moves a quadrature encoder by quarter steps, calling the interrupt of the pin that changed.
+@param steps - quarter steps, negative backwards
+@param micros - time between edges
+*/
+static void quadrature(int steps, uint32_t micros) {
+	static const uint8_t gray[4] = { 0b00, 0b01, 0b11, 0b10 }; // A in bit 1. Forward: B leads.
+	static int position = 0;
+	for (int i = 0; i < abs(steps); i++) {
+		uint8_t before = gray[position & 3];
+		position += steps > 0 ? -1 : 1;
+		uint8_t after = gray[position & 3];
+		hostMicros += micros;
+		hostPin[PIN_A] = after >> 1;
+		hostPin[PIN_B] = after & 1;
+		(*hostInterrupt[(before ^ after) & 0b10 ? PIN_A : PIN_B])();
+	}
+}
+
+int main() {
+	Encoders encoders;
+	encoders.add(PIN_A, PIN_B);
+	encoders.add(PIN_SINGLE);
+
+	// Forward
+	quadrature(400, 100);
+	CHECK(encoders.counter(0) == 400);
+	CHECK_NEAR(encoders.velocity(0), 10000, 1);
+
+	// Backwards, past 0
+	quadrature(-1000, 250);
+	CHECK(encoders.counter(0) == -600);
+	CHECK(encoders.counter(0) < 0); // Not wrapped around
+	CHECK_NEAR(encoders.velocity(0), -4000, 1);
+
+	EncodersSnapshot snapshot;
+	encoders.snapshot(&snapshot);
+	CHECK(snapshot.counter[0] == -600);
+	CHECK(snapshot.direction[0] == -1);
+	CHECK(snapshot.periodMicros[0] == 250);
+
+	// A skipped step (both channels changed) is ignored, not counted in either direction.
+	hostPin[PIN_A] ^= 1;
+	hostPin[PIN_B] ^= 1;
+	(*hostInterrupt[PIN_A])();
+	CHECK(encoders.counter(0) == -600);
+
+	// Slowing down: time since the last edge is used once it is longer than the last period, then 0 when stopped.
+	hostMicros += 1000;
+	CHECK_NEAR(encoders.velocity(0), -1000, 1);
+	hostMicros += ENCODER_STOPPED_MICROS;
+	CHECK(encoders.velocity(0) == 0);
+
+	// Single channel counts only forward.
+	for (int i = 0; i < 10; i++) {
+		hostMicros += 1000;
+		(*hostInterrupt[PIN_SINGLE])();
+	}
+	CHECK(encoders.counter(1) == 10);
+	CHECK_NEAR(encoders.velocity(1), 1000, 1);
+
+	encoders.set(0, -5);
+	encoders.backup();
+	encoders.reset();
+	CHECK(encoders.counter(0) == 0);
+	encoders.reset(false);
+	CHECK(encoders.counter(0) == -5);
+
+	return checkResult("encoders");
+}
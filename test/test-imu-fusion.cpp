@@ -0,0 +1,139 @@
+// Heading fusion on a recorded-like run: a gyro with bias, odometry with wheel slip and a delayed, noisy absolute heading disturbed near
+// motors. Fused heading's drift and latency are compared with gyro alone and with the raw absolute heading.
+#include <check.h>
+#include "../mrm-imu/src/mrm-imu-fusion.cpp"
+
+#define ABSOLUTE_DELAY_MS 40 // BNO055's absolute heading lags behind.
+#define GYRO_BIAS 0.5 // Degrees per second
+#define SLIP 0.05 // Odometry's heading change is this much short.
+
+static uint32_t seed = 12345;
+
+/** Repeatable noise
+@return - -1 - 1
+*/
+static float noise() {
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 16) & 0x7FFF) / 16383.5 - 1;
+}
+
+/** Difference of 2 headings
+@return - degrees, -180 - 180
+*/
+static float difference(float a, float b) {
+	return angle180(a - b);
+}
+
+/** Robot's run: straight, turns, a motor near the compass, later a permanent magnetic offset
+*/
+struct Run {
+	float truth[8000]; // Heading each 10 ms, degrees
+	int steps = 0;
+
+	/** True yaw rate
+	@param ms - time
+	@return - degrees per second
+	*/
+	static float rate(uint32_t ms) {
+		if (ms >= 5000 && ms < 5500) // Sharp turn right, 90 degrees
+			return 180;
+		if (ms >= 12000 && ms < 14000) // Slow turn left, 90 degrees
+			return -45;
+		if (ms >= 30000 && ms < 31000) // 180 degrees
+			return 180;
+		return 0;
+	}
+
+	/** Absolute heading as read
+	@param step - 10 ms each
+	@return - degrees, 0 - 360
+	*/
+	float absolute(int step) {
+		int delayed = step - ABSOLUTE_DELAY_MS / 10;
+		float heading = truth[delayed < 0 ? 0 : delayed] + noise();
+		uint32_t ms = step * 10;
+		if (ms >= 20000 && ms < 23000) // A motor near the compass
+			heading += 40;
+		if (ms >= 50000) // Permanent, for example a magnet fixed
+			heading += 30;
+		return fmodf(heading + 720, 360);
+	}
+};
+
+int main() {
+	Run run;
+	HeadingFusion fusion;
+	HeadingFusion fusionOdometry;
+	OdometryPose pose = { 0, 0, 0, 0 };
+	run.truth[0] = 100;
+	fusion.start(100, NULL, 0);
+	fusionOdometry.start(100, &pose, 0);
+	float gyroOnly = 100;
+	float absoluteLast = 100; // Raw absolute heading as a program reading it sees it
+	float fusedErrorMax = 0, odometryErrorMax = 0, absoluteErrorMax = 0;
+	float fusedLatencyMs = -1, absoluteLatencyMs = -1; // After the sharp turn ends, till within 2 degrees
+	for (int step = 1; step < 7000; step++) {
+		uint32_t ms = step * 10;
+		float trueRate = Run::rate(ms);
+		run.truth[step] = fmodf(run.truth[step - 1] + trueRate * 0.01 + 360, 360);
+		float gyro = trueRate + GYRO_BIAS + 0.3 * noise();
+		gyroOnly += gyro * 0.01;
+
+		// Odometry: driving straight at 200 mm/s, turning in place, heading change short by slip
+		pose.heading = angle180(pose.heading + trueRate * 0.01 * (1 - SLIP));
+		if (trueRate == 0) {
+			pose.x += 2 * sinf(pose.heading * DEG_TO_RAD);
+			pose.y += 2 * cosf(pose.heading * DEG_TO_RAD);
+		}
+		pose.micros = ms * 1000;
+
+		float absolute;
+		bool absoluteRead = ms % IMU_FUSION_ABSOLUTE_PERIOD_MS == 0;
+		if (absoluteRead) {
+			absolute = run.absolute(step);
+			absoluteLast = absolute;
+		}
+		fusion.step(ms * 1000, gyro, NULL, absoluteRead ? &absolute : NULL);
+		fusionOdometry.step(ms * 1000, gyro, &pose, absoluteRead ? &absolute : NULL);
+
+		float fusedError = fabsf(difference(fusion.estimate().heading, run.truth[step]));
+		float odometryError = fabsf(difference(fusionOdometry.estimate().heading, run.truth[step]));
+		float absoluteError = fabsf(difference(absoluteLast, run.truth[step]));
+		if (ms >= 5500 && ms < 6000) { // Latency after the sharp turn
+			if (fusedLatencyMs < 0 && fusedError < 2)
+				fusedLatencyMs = ms - 5500;
+			if (absoluteLatencyMs < 0 && absoluteError < 2)
+				absoluteLatencyMs = ms - 5500;
+		}
+		if (ms < 50000) { // Before the permanent offset
+			fusedErrorMax = fmaxf(fusedErrorMax, fusedError);
+			odometryErrorMax = fmaxf(odometryErrorMax, odometryError);
+			absoluteErrorMax = fmaxf(absoluteErrorMax, absoluteError);
+		}
+		if (ms == 49990) { // Drift after 50 s, gyro alone drifted 25 degrees.
+			CHECK_NEAR(difference(gyroOnly, run.truth[step]), 50 * GYRO_BIAS, 1);
+			CHECK(fusedError < 3);
+			CHECK(odometryError < fusedError); // Odometry does not drift.
+		}
+		if (ms == 51000) // Permanent offset not accepted yet
+			CHECK(fusedError < 5);
+	}
+
+	// Permanent offset: after IMU_FUSION_DISTURBANCE_STEPS absolute steps the estimate follows the absolute heading.
+	CHECK(fabsf(difference(fusion.estimate().heading, run.truth[6999] + 30)) < 3);
+
+	// The motor's disturbance is ignored and turns are followed at once. Raw absolute heading is off by 40 degrees, and lags.
+	CHECK(absoluteErrorMax > 30);
+	CHECK(fusedErrorMax < 5);
+	CHECK(odometryErrorMax < 4);
+	CHECK(fusedLatencyMs == 0);
+	CHECK(absoluteLatencyMs >= ABSOLUTE_DELAY_MS);
+	printf("Max error: absolute %.1f, fused %.1f, with odometry %.1f. Latency: absolute %.0f ms, fused %.0f ms.\n", absoluteErrorMax,
+		fusedErrorMax, odometryErrorMax, absoluteLatencyMs, fusedLatencyMs);
+
+	// Odometry's position follows the fused heading: driven straight after the turns it moved, not drifted.
+	ImuEstimate estimate = fusionOdometry.estimate();
+	CHECK(estimate.x != 0 || estimate.y != 0);
+
+	return checkResult("imu-fusion");
+}
@@ -0,0 +1,46 @@
+// IRReceivers: sliding window hits, noise threshold and vector-sum direction.
+#include <check.h>
+#include "../IRReceivers/IRReceivers.cpp"
+
+void error(String message) {
+	printf("error: %s\n", message.c_str());
+	checkFailures++;
+}
+
+int main() {
+	IRReceivers receivers;
+	for (uint8_t i = 0; i < 8; i++) {
+		hostPin[10 + i] = HIGH; // No hit
+		receivers.add(10 + i, i * 45);
+	}
+
+	// A single noise hit is not a source, with the default threshold.
+	hostPin[12] = LOW;
+	receivers.update();
+	hostPin[12] = HIGH;
+	for (int i = 0; i < 5; i++)
+		receivers.update();
+	CHECK(!receivers.anyIRSource());
+	CHECK(receivers.anyIRSource(0));
+
+	// It leaves the window after SAMPLE_LENGTH samples.
+	for (int i = 0; i < SAMPLE_LENGTH; i++)
+		receivers.update();
+	CHECK(!receivers.anyIRSource(0));
+	CHECK(!receivers.irSource().any);
+
+	// A ball between receivers at 90 and 135 degrees, seen by the first one more often.
+	for (int i = 0; i < SAMPLE_LENGTH; i++) {
+		hostPin[12] = LOW;
+		hostPin[13] = i % 3 == 0 ? LOW : HIGH;
+		receivers.update();
+	}
+	CHECK(receivers.anyIRSource());
+	IRSource source = receivers.irSource();
+	CHECK(source.any);
+	CHECK(source.strength == SAMPLE_LENGTH + (SAMPLE_LENGTH + 2) / 3);
+	CHECK(source.angle > 90 && source.angle < 112.5);
+	CHECK(source.confidence > 0.9);
+
+	return checkResult("ir-receivers");
+}
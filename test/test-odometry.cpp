@@ -0,0 +1,164 @@
+// Odometry: differential and star kinematics integrated from encoder frames, with counter wrap around and reversed motors.
+#include <check.h>
+#include "../mrm-board/src/mrm-odometry.cpp"
+
+#define BASE_MM 150.0
+#define FRAMES 200 // Encoder frames for each movement
+
+/** Motor's encoder as MotorBoard sees it: a 32-bit counter that wraps around, maybe mounted reversed
+*/
+struct Encoder {
+	uint32_t count;
+	uint32_t previous;
+	bool reversed;
+	float mmPerTick;
+	float carry; // Part of a tick not counted yet
+
+	/** Wheel moves, counter changes
+	@param mm - in motor's positive direction
+	@return - ticks decoded, positive in motor's positive direction
+	*/
+	int32_t move(float mm) {
+		carry += mm / mmPerTick;
+		int32_t ticks = (int32_t)lroundf(carry);
+		carry -= ticks;
+		count += reversed ? -ticks : ticks;
+		int32_t decoded = odometryTicks(count, previous, reversed);
+		previous = count;
+		return decoded;
+	}
+};
+
+/** Drives a differential robot: each side's movement split into frames, wheels reporting in turn
+@param odometry - pose
+@param encoders - left 1, right 1, left 2, right 2
+@param leftMm - left side forward
+@param rightMm - right side forward
+*/
+static void differential(Odometry* odometry, Encoder encoders[4], float leftMm, float rightMm, int lostEvery = 0) {
+	for (int frame = 0; frame < FRAMES; frame++)
+		for (uint8_t wheel = 0; wheel < 4; wheel++) {
+			float mm = (wheel % 2 == 0 ? leftMm : -rightMm) / FRAMES; // Right motors turn backwards to drive forward.
+			if (lostEvery != 0 && wheel == 3 && frame % lostEvery == 0 && frame != FRAMES - 1) { // Counts, but the frame is lost.
+				encoders[wheel].carry += mm / encoders[wheel].mmPerTick;
+				continue;
+			}
+			int32_t ticks = encoders[wheel].move(mm);
+			float forward, right, rotation;
+			odometryDifferential(wheel, ticks * encoders[wheel].mmPerTick, 2, BASE_MM, &forward, &right, &rotation);
+			hostMicros += 1000;
+			odometry->wheelAdd(wheel, forward, right, rotation, hostMicros);
+		}
+}
+
+/** Drives a star robot, wheels' movements as go() sets speeds
+@param odometry - pose
+@param forwardMm - translation forward
+@param rightMm - translation right
+@param rotationDegrees - to the right
+*/
+static void star(Odometry* odometry, float forwardMm, float rightMm, float rotationDegrees) {
+	static const float axleDegrees[4] = { 45, 135, -135, -45 };
+	for (int frame = 0; frame < FRAMES; frame++)
+		for (uint8_t wheel = 0; wheel < 4; wheel++) {
+			float axle = axleDegrees[wheel] * DEG_TO_RAD;
+			float mm = (sinf(axle) * forwardMm - cosf(axle) * rightMm + rotationDegrees * DEG_TO_RAD * BASE_MM) / FRAMES;
+			float forward, right, rotation;
+			odometryStar(wheel, mm, BASE_MM, &forward, &right, &rotation);
+			odometry->wheelAdd(wheel, forward, right, rotation, hostMicros);
+		}
+}
+
+int main() {
+	// Counter wrap around and reversed motors
+	CHECK(odometryTicks(5, 0xFFFFFFFB, false) == 10);
+	CHECK(odometryTicks(0xFFFFFFFB, 5, false) == -10);
+	CHECK(odometryTicks(5, 0xFFFFFFFB, true) == -10);
+	CHECK(odometryTicks(0x80000010, 0x7FFFFFF0, false) == 0x20);
+
+	// Differential, counters starting just below wrap around, right front motor reversed
+	Encoder encoders[4] = {
+		{ 0xFFFFFF00, 0xFFFFFF00, false, 0.25 },
+		{ 0x100, 0x100, true, 0.25 },
+		{ 0xFFFFFFF0, 0xFFFFFFF0, false, 0.25 },
+		{ 0, 0, false, 0.25 }
+	};
+	Odometry odometry;
+	odometry.wheelsSet(0b1111);
+	differential(&odometry, encoders, 500, 500); // Straight
+	OdometryPose pose = odometry.pose();
+	CHECK_NEAR(pose.x, 0, 0.001);
+	CHECK_NEAR(pose.y, 500, 0.5);
+	CHECK_NEAR(pose.heading, 0, 0.01);
+	CHECK(pose.micros == hostMicros);
+
+	float quarter = BASE_MM * PI / 4; // Each side's path for 90 degrees in place
+	differential(&odometry, encoders, quarter, -quarter); // Right in place
+	pose = odometry.pose();
+	CHECK_NEAR(pose.heading, 90, 0.5);
+	CHECK_NEAR(pose.x, 0, 0.5);
+	CHECK_NEAR(pose.y, 500, 0.5);
+
+	// Arc to the right, radius 300 mm: a quarter circle ends 300 right and 300 ahead, now heading 180.
+	odometry.set(0, 0, 0, hostMicros);
+	float radius = 300;
+	differential(&odometry, encoders, (radius + BASE_MM / 2) * PI / 2, (radius - BASE_MM / 2) * PI / 2);
+	pose = odometry.pose();
+	CHECK_NEAR(pose.heading, 90, 0.5);
+	CHECK_NEAR(pose.x, radius, 2);
+	CHECK_NEAR(pose.y, radius, 2);
+	differential(&odometry, encoders, (radius + BASE_MM / 2) * PI / 2, (radius - BASE_MM / 2) * PI / 2);
+	pose = odometry.pose();
+	CHECK_NEAR(fabsf(pose.heading), 180, 0.5); // -180 and 180 are the same
+	CHECK_NEAR(pose.x, 2 * radius, 2);
+	CHECK_NEAR(pose.y, 0, 2);
+
+	// Lost frames: the next one carries the whole change
+	odometry.set(0, 0, 0, hostMicros);
+	differential(&odometry, encoders, 500, 500, 7);
+	pose = odometry.pose();
+	CHECK_NEAR(pose.x, 0, 1); // A little off, as the right side lags a frame then
+	CHECK_NEAR(pose.y, 500, 0.5);
+	CHECK_NEAR(pose.heading, 0, 0.1);
+
+	// Full circles keep heading normalized
+	odometry.set(0, 0, 170, hostMicros);
+	for (int i = 0; i < 8; i++)
+		differential(&odometry, encoders, quarter, -quarter);
+	pose = odometry.pose();
+	CHECK_NEAR(pose.heading, 170, 1);
+	CHECK_NEAR(pose.x, 0, 0.5);
+
+	// Star: pure translations do not turn the robot.
+	odometry.set(0, 0, 0, hostMicros);
+	star(&odometry, 400, 0, 0);
+	pose = odometry.pose();
+	CHECK_NEAR(pose.x, 0, 0.01);
+	CHECK_NEAR(pose.y, 400, 0.01);
+	CHECK_NEAR(pose.heading, 0, 0.01);
+	star(&odometry, 0, 300, 0);
+	pose = odometry.pose();
+	CHECK_NEAR(pose.x, 300, 0.01);
+	CHECK_NEAR(pose.y, 400, 0.01);
+
+	// Star: a square, turning in place at the corners, ends where it started.
+	odometry.set(0, 0, 0, hostMicros);
+	for (int side = 0; side < 4; side++) {
+		star(&odometry, 500, 0, 0);
+		star(&odometry, 0, 0, 90);
+	}
+	pose = odometry.pose();
+	CHECK_NEAR(pose.x, 0, 0.5);
+	CHECK_NEAR(pose.y, 0, 0.5);
+	CHECK_NEAR(pose.heading, 0, 0.1);
+
+	// Star: translating while rotating. Forward in robot's frame while turning 90 degrees is an arc, as the differential one.
+	odometry.set(0, 0, 0, hostMicros);
+	star(&odometry, radius * PI / 2, 0, 90);
+	pose = odometry.pose();
+	CHECK_NEAR(pose.heading, 90, 0.1);
+	CHECK_NEAR(pose.x, radius, 1);
+	CHECK_NEAR(pose.y, radius, 1);
+
+	return checkResult("odometry");
+}
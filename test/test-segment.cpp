@@ -0,0 +1,186 @@
+// Segmented transfers: robot and device sides on a simulated bus that loses, delays and alters frames.
+#include <check.h>
+#include <deque>
+#include <functional>
+#include <vector>
+#include "../mrm-board/src/mrm-segment.cpp"
+
+struct Node;
+
+/** Frames in flight. One is delivered each time a side waits, so that flow control arrives between consecutive frames as on a real bus.
+*/
+struct Bus {
+	struct Frame {
+		Node* to;
+		std::vector<uint8_t> data;
+	};
+	std::deque<Frame> frames;
+	std::function<bool(Frame&)> lose = [](Frame&) { return false; }; // A test sets it. true - frame lost.
+	std::function<void(Frame&)> before = [](Frame&) {}; // A test sets it to queue frames in front of a frame.
+	std::function<void(Frame&)> arriving = [](Frame&) {}; // A test sets it to delay a frame.
+	uint16_t sent = 0;
+
+	bool deliverOne();
+	void drain() { while (deliverOne()); }
+};
+
+struct Node : public SegmentLink {
+	Bus* bus;
+	Node* peer;
+	Segmenter segmenter;
+	std::vector<uint8_t> received;
+	uint8_t receivedCommand = 0;
+	uint16_t transfers = 0;
+
+	Node(Bus* bus) : bus(bus), segmenter(this, 1) { segmenter.add(0); }
+
+	void segmentFrameSend(uint8_t* frame, uint8_t length, uint8_t deviceNumber) {
+		Bus::Frame sending = { peer, std::vector<uint8_t>(frame, frame + length) };
+		bus->sent++;
+		if (bus->lose(sending))
+			return;
+		bus->before(sending);
+		bus->frames.push_back(sending);
+	}
+
+	void segmentWait(uint32_t micros) {
+		hostMicros += micros;
+		bus->deliverOne();
+	}
+
+	bool segmentedReceived(uint8_t command, uint8_t* data, uint16_t size, uint8_t deviceNumber) {
+		receivedCommand = command;
+		received.assign(data, data + size);
+		transfers++;
+		return true;
+	}
+};
+
+bool Bus::deliverOne() {
+	if (frames.empty())
+		return false;
+	Frame frame = frames.front();
+	frames.pop_front();
+	arriving(frame);
+	uint8_t data[8] = { 0 };
+	memcpy(data, frame.data.data(), frame.data.size());
+	frame.to->segmenter.decode(data, 0);
+	return true;
+}
+
+static std::vector<uint8_t> payload(uint16_t size) {
+	std::vector<uint8_t> data(size);
+	for (uint16_t i = 0; i < size; i++)
+		data[i] = i * 7 + 1;
+	return data;
+}
+
+int main() {
+	Bus bus;
+	Node robot(&bus);
+	Node device(&bus);
+	robot.peer = &device;
+	device.peer = &robot;
+
+	// Full buffer: first frame, block of 8 consecutive frames, flow control, 2 more.
+	std::vector<uint8_t> data = payload(SEGMENT_BUFFER_SIZE);
+	CHECK(robot.segmenter.send(0x55, data.data(), data.size(), 0));
+	bus.drain();
+	CHECK(device.transfers == 1);
+	CHECK(device.receivedCommand == 0x55);
+	CHECK(device.received == data);
+	CHECK(bus.sent == 1 + 10 + 2); // First, consecutive, flow control after first and after the block
+	CHECK(robot.segmenter.lost() == 0 && device.segmenter.lost() == 0);
+
+	// Fits the first frame: no flow control needed.
+	data = payload(3);
+	bus.sent = 0;
+	CHECK(robot.segmenter.send(0x56, data.data(), data.size(), 0));
+	bus.drain();
+	CHECK(device.transfers == 2 && device.received == data);
+	CHECK(bus.sent == 1);
+
+	// Too big to send, nothing on the bus.
+	data = payload(SEGMENT_BUFFER_SIZE + 1);
+	bus.sent = 0;
+	CHECK(!robot.segmenter.send(0x57, data.data(), data.size(), 0));
+	CHECK(bus.sent == 0);
+
+	// Too big to receive: refused with abort.
+	uint8_t first[8] = { COMMAND_SEGMENT_FIRST, 0x58, SEGMENT_BUFFER_SIZE + 1, 0, 1, 2, 3, 4 };
+	CHECK(!device.segmenter.decode(first, 0));
+	CHECK(bus.frames.size() == 1 && bus.frames.front().data[1] == SEGMENT_FLOW_ABORT);
+	bus.frames.clear();
+
+	// A lost consecutive frame: the device aborts, the robot stops at the next flow control.
+	data = payload(SEGMENT_BUFFER_SIZE);
+	bus.lose = [](Bus::Frame& frame) { return frame.data[0] == COMMAND_SEGMENT_CONSECUTIVE && frame.data[1] == 3; };
+	CHECK(!robot.segmenter.send(0x59, data.data(), data.size(), 0));
+	bus.drain();
+	CHECK(device.transfers == 2);
+	CHECK(device.segmenter.lost() == 1);
+	CHECK(robot.segmenter.lost() == 1);
+	bus.lose = [](Bus::Frame&) { return false; };
+
+	// Retry succeeds
+	CHECK(robot.segmenter.send(0x5A, data.data(), data.size(), 0));
+	bus.drain();
+	CHECK(device.transfers == 3 && device.received == data);
+
+	// Device asks to wait twice, then continues.
+	int waits = 2;
+	bus.before = [&](Bus::Frame& frame) {
+		if (frame.data[0] == COMMAND_SEGMENT_FLOW_CONTROL && frame.data[1] == SEGMENT_FLOW_CONTINUE)
+			for (; waits > 0; waits--)
+				bus.frames.push_back({ frame.to, { COMMAND_SEGMENT_FLOW_CONTROL, SEGMENT_FLOW_WAIT, 0, 0 } });
+	};
+	CHECK(robot.segmenter.send(0x5B, data.data(), data.size(), 0));
+	bus.drain();
+	CHECK(device.transfers == 4 && device.received == data);
+	CHECK(robot.segmenter.timeouts() == 0);
+
+	// Waiting too long gives up, but the device stays usable.
+	waits = SEGMENT_WAITS_LIMIT + 1;
+	CHECK(!robot.segmenter.send(0x5C, data.data(), data.size(), 0));
+	CHECK(robot.segmenter.timeouts() == 1);
+	bus.before = [](Bus::Frame&) {};
+	bus.drain(); // Device forgets the unfinished transfer when the next one starts.
+	CHECK(robot.segmenter.send(0x5D, data.data(), data.size(), 0));
+	bus.drain();
+	CHECK(device.transfers == 5 && device.received == data);
+	CHECK(device.segmenter.lost() == 2); // The abandoned transfer
+
+	// Flow control lost: timeout, then no more attempts as the device probably has old firmware...
+	bus.lose = [](Bus::Frame& frame) { return frame.data[0] == COMMAND_SEGMENT_FLOW_CONTROL; };
+	uint32_t startMicros = hostMicros;
+	CHECK(!robot.segmenter.send(0x5E, data.data(), data.size(), 0));
+	CHECK(hostMicros - startMicros >= (SEGMENT_TIMEOUT_MS - 1) * 1000); // millis() resolution
+	CHECK(robot.segmenter.timeouts() == 2);
+	bus.drain();
+	bus.sent = 0;
+	CHECK(!robot.segmenter.send(0x5F, data.data(), data.size(), 0));
+	CHECK(bus.sent == 0);
+
+	// ...until it starts a transfer itself.
+	bus.lose = [](Bus::Frame&) { return false; };
+	std::vector<uint8_t> answer = payload(20);
+	CHECK(device.segmenter.send(0x60, answer.data(), answer.size(), 0));
+	bus.drain();
+	CHECK(robot.transfers == 1 && robot.received == answer);
+	CHECK(robot.segmenter.send(0x61, data.data(), data.size(), 0));
+	bus.drain();
+	CHECK(device.received == data);
+
+	// Device too slow between consecutive frames: transfer dropped as lost.
+	bus.arriving = [](Bus::Frame& frame) {
+		if (frame.data[0] == COMMAND_SEGMENT_CONSECUTIVE && frame.data[1] == 2)
+			hostMicros += (SEGMENT_TIMEOUT_MS + 1) * 1000;
+	};
+	uint16_t lost = device.segmenter.lost();
+	robot.segmenter.send(0x62, data.data(), data.size(), 0);
+	bus.drain();
+	CHECK(device.segmenter.lost() == lost + 1);
+	CHECK(device.receivedCommand == 0x61);
+
+	return checkResult("segment");
+}
@@ -0,0 +1,64 @@
+// Servo motion profiles: path's ends, symmetry, monotony, continuity and speed limits.
+#include <algorithm>
+#include <check.h>
+#include "../mrm-board/src/mrm-servo-motion.cpp"
+
+#define STEPS 1000
+
+int main() {
+	const ServoProfile profiles[] = { SERVO_PROFILE_LINEAR, SERVO_PROFILE_TRAPEZOIDAL, SERVO_PROFILE_S_CURVE };
+	for (ServoProfile profile : profiles) {
+		// Ends, also out of range
+		CHECK(servoProfilePath(profile, 0) == 0);
+		CHECK(servoProfilePath(profile, 1) == 1);
+		CHECK(servoProfilePath(profile, -0.5) == 0);
+		CHECK(servoProfilePath(profile, 1.5) == 1);
+		CHECK_NEAR(servoProfilePath(profile, 0.5), 0.5, 1e-5);
+
+		float maxSpeed = 0;
+		float last = 0;
+		for (int i = 1; i <= STEPS; i++) {
+			float time = i / (float)STEPS;
+			float path = servoProfilePath(profile, time);
+			CHECK(path >= last - 1e-6); // Never backwards, but for float rounding
+			CHECK(path - last < 3.0 / STEPS); // No jumps: speed at most 2 (S-curve: 1.875)
+			CHECK_NEAR(path + servoProfilePath(profile, 1 - time), 1, 1e-5); // Accelerates as it decelerates
+			maxSpeed = std::max(maxSpeed, (path - last) * STEPS);
+			last = path;
+		}
+
+		// Starts and stops smoothly, except linear
+		float startSpeed = servoProfilePath(profile, 1.0 / STEPS) * STEPS;
+		if (profile == SERVO_PROFILE_LINEAR) {
+			CHECK_NEAR(startSpeed, 1, 1e-3);
+			CHECK_NEAR(maxSpeed, 1, 1e-2);
+		}
+		else
+			CHECK(startSpeed < 0.01);
+		if (profile == SERVO_PROFILE_TRAPEZOIDAL)
+			CHECK_NEAR(maxSpeed, 1 / (1 - SERVO_PROFILE_ACCELERATION_PART), 1e-2);
+		if (profile == SERVO_PROFILE_S_CURVE)
+			CHECK_NEAR(maxSpeed, 1.875, 1e-2);
+	}
+
+	// Trapezoidal: constant speed between acceleration and deceleration
+	float speed1 = (servoProfilePath(SERVO_PROFILE_TRAPEZOIDAL, 0.31) - servoProfilePath(SERVO_PROFILE_TRAPEZOIDAL, 0.30)) * 100;
+	float speed2 = (servoProfilePath(SERVO_PROFILE_TRAPEZOIDAL, 0.70) - servoProfilePath(SERVO_PROFILE_TRAPEZOIDAL, 0.69)) * 100;
+	CHECK_NEAR(speed1, speed2, 1e-3);
+
+	// Motion: degrees in time, also downwards, and the end, also across millis() wrap around
+	ServoMotion motion;
+	motion.start(120, 30, 400, SERVO_PROFILE_S_CURVE, 0xFFFFFF00);
+	CHECK(motion.active);
+	CHECK(motion.position(0xFFFFFF00) == 120);
+	CHECK_NEAR(motion.position(0xFFFFFF00 + 200), 75, 1e-3);
+	CHECK(motion.active);
+	CHECK(motion.position(0xFFFFFF00 + 390) > 30);
+	CHECK(motion.position(0xFFFFFF00 + 400) == 30);
+	CHECK(!motion.active);
+
+	motion.start(0, 180, 0, SERVO_PROFILE_TRAPEZOIDAL, 1000); // No duration: at once
+	CHECK(motion.position(1000) == 180 && !motion.active);
+
+	return checkResult("servo-motion");
+}
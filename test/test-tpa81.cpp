@@ -0,0 +1,77 @@
+// TPA81 on a mock I2C bus: one transaction per frame, cached frames, timeouts and the sub-pixel hotspot.
+#include <check.h>
+#include "../ThermalSensorsTPA81/ThermalSensorsTPA81.cpp"
+
+void error(String message) {
+	printf("error: %s\n", message.c_str());
+	checkFailures++;
+}
+
+/** Queues a frame for the next requestFrom()
+@param ambient - degrees Celsius
+@param pixels - 8 pixels, degrees Celsius
+*/
+static void frameQueue(uint8_t ambient, const uint8_t pixels[TPA81_RAYS]) {
+	Wire.response.push_back(ambient);
+	for (uint8_t i = 0; i < TPA81_RAYS; i++)
+		Wire.response.push_back(pixels[i]);
+}
+
+int main() {
+	ThermalSensorsTPA81 sensors;
+	sensors.add(0x68);
+	hostMicros = 1000000;
+
+	// An 8-ray scan: one transaction, reading the whole frame from the ambient register.
+	uint8_t pixels[TPA81_RAYS] = { 20, 22, 25, 40, 50, 30, 21, 20 };
+	frameQueue(18, pixels);
+	for (uint8_t ray = 0; ray < TPA81_RAYS; ray++)
+		CHECK(sensors.temperature(0, ray) == pixels[ray]);
+	CHECK(sensors.ambient(0) == 18);
+	CHECK(sensors.transactions() == 1 && sensors.frame(0)->valid);
+	CHECK(Wire.beginTransmissions == 1 && Wire.requests == 1);
+	CHECK(Wire.lastAddress == 0x68 && Wire.lastRegister == TPA81_REGISTER_AMBIENT);
+
+	// Hotspot between rays 3 and 4: parabola through 40, 50 and 30 has its vertex at 4 - 1/6.
+	float position;
+	CHECK(sensors.hotspot(0, &position) == 50);
+	CHECK_NEAR(position, 4 - 1 / 6.0, 0.001);
+
+	// No new transaction while the frame is not older than TPA81_FRAME_MAX_AGE_MS.
+	hostMicros += TPA81_FRAME_MAX_AGE_MS * 1000;
+	for (uint8_t ray = 0; ray < TPA81_RAYS; ray++)
+		sensors.temperature(0, ray);
+	CHECK(sensors.transactions() == 1 && Wire.beginTransmissions == 1 && Wire.requests == 1);
+
+	// Older: read again, once. Hotspot at the edge is not interpolated.
+	hostMicros += 1000;
+	uint8_t edge[TPA81_RAYS] = { 60, 40, 20, 20, 20, 20, 20, 20 };
+	frameQueue(19, edge);
+	CHECK(sensors.hotspot(0, &position) == 60);
+	CHECK(position == 0);
+	CHECK(sensors.temperature(0, 7) == 20);
+	CHECK(sensors.transactions() == 2 && Wire.beginTransmissions == 2 && Wire.requests == 2);
+
+	// Timeout: the sensor answers only in part. The frame is invalid, the partial answer discarded, old temperatures kept.
+	hostMicros += (TPA81_FRAME_MAX_AGE_MS + 1) * 1000;
+	Wire.response.push_back(21);
+	Wire.response.push_back(99);
+	uint32_t startMicros = hostMicros;
+	CHECK(!sensors.frameRead(0));
+	CHECK(hostMicros - startMicros > TPA81_TIMEOUT_MICROS);
+	CHECK(sensors.timeouts() == 1);
+	CHECK(!sensors.frame(0)->valid);
+	CHECK(sensors.transactions() == 3);
+	CHECK(Wire.received.empty());
+	CHECK(sensors.temperature(0, 0) == 60); // Not retried at once
+	CHECK(sensors.transactions() == 3);
+
+	// Next frame after the timeout is valid again.
+	hostMicros += (TPA81_FRAME_MAX_AGE_MS + 1) * 1000;
+	frameQueue(18, pixels);
+	sensors.refresh();
+	CHECK(sensors.timeouts() == 1 && sensors.transactions() == 4);
+	CHECK(sensors.frame(0)->valid && sensors.temperature(0, 4) == 50);
+
+	return checkResult("tpa81");
+}
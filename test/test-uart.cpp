@@ -0,0 +1,143 @@
+// UART: COBS framing with CRC-16 over a loopback serial port, damaged frames and record batches.
+#include <check.h>
+#include <deque>
+#include "../UART/UART.cpp"
+
+void error(String message) {
+	printf("error: %s\n", message.c_str());
+	checkFailures++;
+}
+
+/** Everything written can be read back
+*/
+class LoopbackSerial : public HardwareSerial {
+public:
+	std::deque<uint8_t> bytes;
+	int available() { return bytes.size(); }
+	int read() {
+		if (bytes.empty())
+			return -1;
+		uint8_t data = bytes.front();
+		bytes.pop_front();
+		return data;
+	}
+	size_t write(const uint8_t* buffer, size_t size) {
+		bytes.insert(bytes.end(), buffer, buffer + size);
+		return size;
+	}
+};
+
+struct Pose {
+	int16_t x;
+	int16_t y;
+	float heading;
+};
+
+int main() {
+	LoopbackSerial serial;
+	UART uart(&serial);
+	Message sent;
+	Message received;
+	srand(1);
+
+	// Every payload length, with zeros that COBS must remove from the frame.
+	for (uint16_t length = 0; length <= MAXIMUM_MESSAGE_SIZE; length++) {
+		sent.reset();
+		for (uint16_t i = 0; i < length; i++)
+			sent.append((uint8_t)(i % 7 == 0 ? 0 : rand()));
+		uart.frameSend(sent);
+		CHECK(std::count(serial.bytes.begin(), serial.bytes.end(), 0) == 1 && serial.bytes.back() == 0); // Only the delimiter
+		CHECK(uart.frameReceive(&received)); // Even an empty payload, as CRC follows it
+		CHECK(received.size() == length);
+		CHECK(memcmp(received.bytes(), sent.bytes(), length) == 0);
+	}
+	CHECK(uart.frameErrors() == 0);
+
+	// Long runs of non-zero bytes
+	sent.reset();
+	for (uint16_t i = 0; i < MAXIMUM_MESSAGE_SIZE; i++)
+		sent.append((uint8_t)(1 + i % 255));
+	uart.frameSend(sent);
+	CHECK(uart.frameReceive(&received) && received.size() == MAXIMUM_MESSAGE_SIZE);
+
+	// A damaged frame is dropped and the next one is received.
+	sent.reset();
+	sent.append((uint8_t)1);
+	sent.append((uint16_t)0x1234);
+	uart.frameSend(sent);
+	serial.bytes[2] ^= 0x10;
+	uart.frameSend(sent);
+	CHECK(uart.frameReceive(&received));
+	CHECK(uart.frameErrors() == 1);
+	CHECK(received.size() == 3 && received.readUInt8() == 1 && received.readUInt16() == 0x1234);
+
+	// Garbage and a too long frame before a good one
+	for (int i = 0; i < MAXIMUM_FRAME_SIZE + 10; i++)
+		serial.bytes.push_back(0x55);
+	serial.bytes.push_back(0);
+	uart.frameSend(sent);
+	CHECK(uart.frameReceive(&received));
+	CHECK(uart.frameOverflows() == 1);
+
+	// A frame arriving in parts: nothing till the delimiter.
+	uart.frameSend(sent);
+	std::deque<uint8_t> rest(serial.bytes.begin() + 2, serial.bytes.end());
+	serial.bytes.resize(2);
+	CHECK(!uart.frameReceive(&received));
+	serial.bytes = rest;
+	CHECK(uart.frameReceive(&received) && received.size() == 3);
+
+	// Batched records
+	sent.reset();
+	Pose pose = { -120, 340, 1.5 };
+	sent.appendRecord(7, pose);
+	sent.append(String("ok"));
+	sent.appendRecord(8, (uint8_t)42);
+	uart.frameSend(sent);
+	CHECK(uart.frameReceive(&received));
+	uint8_t type;
+	uint8_t size;
+	const uint8_t* content = received.recordNext(&type, &size);
+	Pose copy;
+	CHECK(type == 7 && Message::recordRead(content, size, &copy));
+	CHECK(copy.x == -120 && copy.y == 340 && copy.heading == 1.5);
+
+	// A batch of consecutive records, read one after another till the end of the batch
+	sent.reset();
+	uint8_t recordsCount = 0;
+	while (sent.available() >= RECORD_HEADER_SIZE + sizeof(Pose) + RECORD_HEADER_SIZE + sizeof(uint16_t)) { // Room for the last one
+		Pose next = { (int16_t)recordsCount, (int16_t)-recordsCount, recordsCount * 0.5f };
+		sent.appendRecord(recordsCount, next);
+		recordsCount++;
+	}
+	sent.appendRecord(200, (uint16_t)0xBEEF); // Another size
+	uart.frameSend(sent);
+	CHECK(uart.frameReceive(&received));
+	uint8_t recordsRead = 0;
+	while ((content = received.recordNext(&type, &size)) != NULL && type != 200) {
+		CHECK(type == recordsRead && Message::recordRead(content, size, &copy));
+		CHECK(copy.x == recordsRead && copy.y == -recordsRead && copy.heading == recordsRead * 0.5f);
+		recordsRead++;
+	}
+	CHECK(recordsRead == recordsCount);
+	uint16_t last = 0;
+	CHECK(content != NULL && !Message::recordRead(content, size, &copy)); // Size differs
+	CHECK(Message::recordRead(content, size, &last) && last == 0xBEEF);
+	CHECK(received.recordNext(&type, &size) == NULL); // End of the batch
+	CHECK(received.recordNext(&type, &size) == NULL);
+
+	// A record cut short is not returned.
+	sent.reset();
+	sent.appendRecord(1, (uint8_t)5);
+	sent.append((uint8_t)2);
+	sent.append((uint8_t)4); // Claims 4 bytes, 1 follows.
+	sent.append((uint8_t)9);
+	uart.frameSend(sent);
+	CHECK(uart.frameReceive(&received));
+	CHECK(received.recordNext(&type, &size) != NULL && type == 1);
+	CHECK(received.recordNext(&type, &size) == NULL);
+
+	CHECK(UART::crc16((const uint8_t*)"123456789", 9) == 0x29B1); // CRC-16/CCITT-FALSE check value
+
+	return checkResult("uart");
+}
@@ -0,0 +1,74 @@
+// mrm-us: echo lists assembled from consecutive frames, a lost frame dropping the rest of its measurement, full lists without a terminator.
+#include "can-replay.h"
+#include "../mrm-us/src/mrm-us.cpp"
+
+/** Queues a frame with up to 3 echoes and decodes it
+@param robot - receiving robot
+@param us - mrm-us board
+@param first - first echo's index
+@param mm - 3 distances, 0 ends the list
+*/
+static void framesReceive(ReplayRobot* robot, Mrm_us* us, uint8_t first, const uint16_t mm[MRM_US_ECHOES_IN_FRAME]) {
+	can_message_t message = {};
+	message.identifier = us->idOutOf(0);
+	message.data_length_code = 8;
+	message.data[0] = COMMAND_SENSORS_MEASURE_SENDING;
+	message.data[1] = first;
+	for (uint8_t i = 0; i < MRM_US_ECHOES_IN_FRAME; i++) {
+		message.data[2 + 2 * i] = mm[i] & 0xFF;
+		message.data[3 + 2 * i] = mm[i] >> 8;
+	}
+	hostCanReceived.push_back(message);
+	hostMicros += 1000;
+	robot->messagesDecode();
+}
+
+int main() {
+	hostMicros = 1000000;
+	ReplayRobot robot;
+	Mrm_us* us = new Mrm_us(&robot);
+	us->add((char*)"US-0");
+	robot.add(us);
+
+	// In order: 5 echoes in 2 frames, terminated by 0.
+	uint16_t frame0[] = { 300, 450, 800 };
+	uint16_t frame1[] = { 1200, 2500, 0 };
+	framesReceive(&robot, us, 0, frame0);
+	CHECK(us->echoes(0)->count == 0); // Not complete yet
+	framesReceive(&robot, us, 3, frame1);
+	const EchoList* echoes = us->echoes(0);
+	CHECK(echoes->count == 5);
+	CHECK(echoes->mm[0] == 300 && echoes->mm[2] == 800 && echoes->mm[4] == 2500);
+	CHECK(us->reading(3, 0) == 1200 && us->reading(5, 0) == 0);
+	CHECK(us->framesDropped() == 0);
+
+	// Middle frame lost: the rest of the measurement is dropped and counted, the previous list stays.
+	uint16_t frameA[] = { 310, 460, 810 };
+	uint16_t frameC[] = { 2000, 2600, 0 };
+	framesReceive(&robot, us, 0, frameA);
+	framesReceive(&robot, us, 6, frameC);
+	CHECK(us->framesDropped() == 1);
+	CHECK(echoes->count == 5 && echoes->mm[0] == 300);
+
+	// ECHOES_MAX echoes, no terminator: complete when full.
+	uint16_t full[3][MRM_US_ECHOES_IN_FRAME] = { { 100, 200, 300 }, { 400, 500, 600 }, { 700, 800, 900 } };
+	static_assert(ECHOES_MAX == 3 * MRM_US_ECHOES_IN_FRAME, "Frames below fill the list exactly");
+	for (uint8_t i = 0; i < 3; i++)
+		framesReceive(&robot, us, i * MRM_US_ECHOES_IN_FRAME, full[i]);
+	CHECK(echoes->count == ECHOES_MAX);
+	CHECK(echoes->mm[0] == 100 && echoes->mm[ECHOES_MAX - 1] == 900);
+	CHECK(us->framesDropped() == 1);
+
+	// A complete list is not extended by a frame beyond it.
+	framesReceive(&robot, us, ECHOES_MAX, frame1);
+	CHECK(us->framesDropped() == 2);
+	CHECK(echoes->count == ECHOES_MAX);
+
+	// Nothing in range: the first frame's terminator gives an empty list.
+	uint16_t none[] = { 0, 0, 0 };
+	framesReceive(&robot, us, 0, none);
+	CHECK(echoes->count == 0);
+	CHECK(us->reading(0, 0) == 0);
+
+	return checkResult("us");
+}
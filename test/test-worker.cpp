@@ -0,0 +1,119 @@
+// Worker thread, SeqLock and SpscRing: data passed between 2 threads arrives whole, in order, without loss.
+#include <check.h>
+#include "../mrm-common/src/mrm-task.cpp"
+
+/** Written by the worker, each pass keeping a + b == 0
+*/
+struct Pair {
+	long a;
+	long b;
+};
+
+static Pair pair = { 0, 0 };
+static SeqLock pairLock;
+static volatile long passes = 0;
+static volatile bool workerCurrent = false;
+
+/** Worker's pass: changes both fields under the lock
+*/
+static void pairWrite(void* worker) {
+	pairLock.writeBegin();
+	pair.a++;
+	pair.b--;
+	pairLock.writeEnd();
+	passes++;
+	workerCurrent = ((Worker*)worker)->isCurrent();
+}
+
+/** Message as CAN Bus sends it
+*/
+struct Message {
+	uint32_t sequence;
+	uint8_t data[8];
+};
+
+static SpscRing<Message, 32> ring;
+static uint32_t pushed = 0; // Messages pushed by the worker
+static const uint32_t MESSAGES = 200000;
+
+/** Worker's pass: pushes messages while there is room, data derived from the sequence
+*/
+static void ringPush(void*) {
+	while (pushed < MESSAGES) {
+		Message message;
+		message.sequence = pushed;
+		for (uint8_t i = 0; i < 8; i++)
+			message.data[i] = (uint8_t)(pushed >> i);
+		if (!ring.push(message))
+			return;
+		pushed++;
+	}
+}
+
+int main() {
+	// SeqLock: the reader never sees a half-written pair.
+	Worker worker;
+	CHECK(worker.start(pairWrite, &worker, "pair", 0));
+	CHECK(worker.running());
+	CHECK(!worker.start(pairWrite, &worker, "pair", 0)); // Already running
+	CHECK(!worker.isCurrent());
+	long torn = 0;
+	for (long i = 0; i < 1000000; i++) {
+		Pair copy;
+		pairLock.read([&] { copy = pair; });
+		if (copy.a != -copy.b)
+			torn++;
+	}
+	worker.stop();
+	CHECK(torn == 0);
+	CHECK(!worker.running());
+	CHECK(passes > 0);
+	CHECK(workerCurrent);
+	long passesStopped = passes;
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	CHECK(passes == passesStopped); // Stopped for good
+
+	// Restart after stop
+	CHECK(worker.start(pairWrite, &worker, "pair", 0));
+	while (passes == passesStopped)
+		std::this_thread::yield(); // The machine may have a single core.
+	worker.stop();
+
+	// SpscRing, single thread: one slot always free, order kept over wrap around.
+	SpscRing<Message, 4> small = {};
+	Message message = { 0, {} };
+	CHECK(small.empty());
+	CHECK(!small.pop(&message));
+	for (uint32_t i = 0; i < 3; i++) {
+		message.sequence = i;
+		CHECK(small.push(message));
+	}
+	CHECK(!small.push(message)); // Full
+	for (uint32_t round = 0; round < 10; round++) {
+		CHECK(small.pop(&message) && message.sequence == round);
+		message.sequence = round + 3;
+		CHECK(small.push(message));
+	}
+
+	// SpscRing, 2 threads: the worker pushes, this thread pops. Each message arrives once, whole and in order.
+	CHECK(worker.start(ringPush, NULL, "ring", 0));
+	uint32_t expected = 0;
+	uint32_t wrong = 0;
+	while (expected < MESSAGES) {
+		if (!ring.pop(&message)) {
+			std::this_thread::yield();
+			continue;
+		}
+		if (message.sequence != expected)
+			wrong++;
+		for (uint8_t i = 0; i < 8; i++)
+			if (message.data[i] != (uint8_t)(message.sequence >> i))
+				wrong++;
+		expected = message.sequence + 1;
+	}
+	worker.stop();
+	CHECK(wrong == 0);
+	CHECK(ring.empty());
+
+	return checkResult("worker");
+}